@@ -4,9 +4,16 @@
 #include <math.h>
 
 #ifdef ON_SERVER
+#include <algorithm>
 #include <string.h>
 #include <sstream>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace sail;
 
 #endif
@@ -121,6 +128,113 @@ bool isSpeedRealistic(int s) {
   return (s < (100 << 8)) && (s >= 0);
 }
 
+#ifdef ON_SERVER
+// The bytes that end the body of a sentence in NP_STATE_CMD.
+bool isEndOfBody(char c) {
+  return c == '*' || c == '\r' || c == '\n' || c == '$';
+}
+
+#if defined(__SSE2__)
+unsigned endOfBodyMask(__m128i x) {
+  return _mm_movemask_epi8(_mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('*')),
+                   _mm_cmpeq_epi8(x, _mm_set1_epi8('$'))),
+      _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\r')),
+                   _mm_cmpeq_epi8(x, _mm_set1_epi8('\n')))));
+}
+#endif
+
+#if defined(__AVX2__)
+unsigned endOfBodyMask(__m256i x) {
+  return _mm256_movemask_epi8(_mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('*')),
+                      _mm256_cmpeq_epi8(x, _mm256_set1_epi8('$'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')),
+                      _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')))));
+}
+#endif
+
+// Returns the first end of body in [p, end), or end.
+const char *findEndOfBody(const char *p, const char *end) {
+#if defined(__AVX2__)
+  for (; 32 <= end - p; p += 32) {
+    unsigned mask = endOfBodyMask(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  for (; 16 <= end - p; p += 16) {
+    unsigned mask = endOfBodyMask(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (p < end && !isEndOfBody(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+// Calls f with the position of every comma in p[0..n), until it
+// returns false.
+template <typename F>
+void forEachComma(const char *p, size_t n, F f) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= n; i += 32) {
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)),
+        _mm256_set1_epi8(',')));
+    for (; mask != 0; mask &= mask - 1) {
+      if (!f(i + __builtin_ctz(mask))) {
+        return;
+      }
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  for (; i + 16 <= n; i += 16) {
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)),
+        _mm_set1_epi8(',')));
+    for (; mask != 0; mask &= mask - 1) {
+      if (!f(i + __builtin_ctz(mask))) {
+        return;
+      }
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (p[i] == ',' && !f(i)) {
+      return;
+    }
+  }
+}
+
+// The XOR of n bytes, 8 at a time.
+Byte xorBytes(const char *p, size_t n) {
+  uint64_t x = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t word;
+    memcpy(&word, p + i, 8);
+    x ^= word;
+  }
+  for (; i < n; ++i) {
+    x ^= Byte(p[i]);
+  }
+  x ^= x >> 32;
+  x ^= x >> 16;
+  x ^= x >> 8;
+  return Byte(x);
+}
+#endif
+
 }  // namespace
 
 NmeaParser::NmeaParser() {
@@ -242,6 +356,59 @@ NmeaParser::NmeaSentence NmeaParser::processByte(Byte input) {
   return ret;
 }
 
+#ifdef ON_SERVER
+size_t NmeaParser::processBuffer(const char *data, size_t n,
+                                 NmeaSentence *sentence) {
+  const char *p = data;
+  const char *end = data + n;
+  *sentence = NMEA_NONE;
+  while (p < end) {
+    if (state_ == NP_STATE_SOM) {
+      const char *start = static_cast<const char *>(memchr(p, '$', end - p));
+      if (start == nullptr) {
+        start = end;
+      }
+      numBytes_ += start - p;
+      p = start;
+    } else if (state_ == NP_STATE_CMD) {
+      // Up to the end of the body, the bytes only go to data_, argv_ and
+      // the checksum. The last two bytes before data_ is full are left
+      // to processByte, which knows how to fail on overflow.
+      size_t room = NP_MAX_DATA_LEN - 1 - index_;
+      size_t count = std::min<size_t>(findEndOfBody(p, end) - p,
+                                      1 < room? room - 1 : 0);
+      char *body = data_ + index_;
+      memcpy(body, p, count);
+      forEachComma(p, count, [&](size_t i) {
+        if ((argc_ + 1) >= NP_MAX_ARGS) {
+          count = i + 1;
+          state_ = NP_STATE_SOM;
+          numErr_++;
+          return false;
+        }
+        body[i] = '\0';
+        argv_[argc_++] = body + i + 1;
+        return true;
+      });
+      checksum_ ^= xorBytes(p, count);
+      index_ += count;
+      numBytes_ += count;
+      p += count;
+      if (state_ != NP_STATE_CMD) {
+        continue;
+      }
+    }
+    if (p < end) {
+      *sentence = processByte(*p++);
+      if (*sentence != NMEA_NONE) {
+        break;
+      }
+    }
+  }
+  return p - data;
+}
+#endif
+
 char NmeaParser::computeChecksum() const {
   int i;
   char checksum = 0;
@@ -139,6 +139,14 @@ class NmeaParser {
 
   NmeaParser();
   NmeaSentence processByte(Byte data);
+#ifdef ON_SERVER
+  // Same as calling processByte on each byte of data[0..n), but returns
+  // after the first byte that completes a sentence. Returns the number of
+  // bytes consumed, and sets *sentence to the result for the last of them.
+  // The bytes between delimiters are copied in bulk, so that large logs
+  // are parsed much faster than byte by byte.
+  size_t processBuffer(const char *data, size_t n, NmeaSentence *sentence);
+#endif
   void printSentence();
   void putSentence(void (*_putc)(char));
 #ifdef ON_SERVER
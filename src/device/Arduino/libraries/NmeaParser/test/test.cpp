@@ -3,6 +3,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <gmock/gmock-matchers.h>
@@ -456,3 +459,59 @@ TEST(NmeaParserTest, TestHDM) {
   EXPECT_EQ(NmeaParser::NMEA_HDM,
             sendSentence("$HCHDM,26,M*03", &parser));
 }
+
+namespace {
+
+// The sentences reported for every byte, followed by the counters
+// of the parser. With a chunkSize, the log is passed to processBuffer
+// in chunks of that size, otherwise byte by byte to processByte.
+std::vector<int> parseLog(const std::string& log, int chunkSize = 0) {
+  NmeaParser parser;
+  std::vector<int> sentences;
+  if (chunkSize == 0) {
+    for (char c: log) {
+      sentences.push_back(parser.processByte(c));
+    }
+  }
+  for (size_t i = 0; 0 < chunkSize && i < log.size(); i += chunkSize) {
+    const char* data = log.data() + i;
+    size_t n = std::min(log.size() - i, size_t(chunkSize));
+    while (0 < n) {
+      NmeaParser::NmeaSentence sentence;
+      size_t consumed = parser.processBuffer(data, n, &sentence);
+      EXPECT_LT(0, consumed);
+      sentences.insert(sentences.end(), consumed - 1, NmeaParser::NMEA_NONE);
+      sentences.push_back(sentence);
+      data += consumed;
+      n -= consumed;
+    }
+  }
+  sentences.push_back(parser.numBytes());
+  sentences.push_back(parser.numErr());
+  sentences.push_back(parser.numSentences());
+  return sentences;
+}
+
+}  // namespace
+
+TEST(NmeaParserTest, ProcessBufferMatchesProcessByte) {
+  std::string log =
+    "garbage before $IIVLW,00430,N,002.3,N*55\r\n"
+    "$IIMWV,010,R,004.8,N,A*2E\r\n"
+    "$IIVWT,045.,L,19.6,N,10.1,M,036.3,K*11\r\n"  // Wrong checksum
+    "$IIMWV,290.65,R,7.03,N,A*31$HCHDM,306,M*32\n"
+    "$IIRSA,4.3,A,,V*7E"
+    "$IIXDR,A,-25.8,D,RUDDER\r\n"  // No checksum
+    "$" + std::string(120, 'X') + ",1,2,3\r\n"  // Too long
+    "$" + std::string(98, 'Y') + ",,,*00\r\n"
+    "$A" + std::string(40, ',') + "\r\n"  // Too many fields
+    "$IIMWV,72,R,0.0,N,A*16\r\n"
+    "$GNRMC,,V,,,,,,,,,,N*4D\r\n"
+    "$IIXDR,A,64,D,ROLL*54\r\n"
+    "trailing $IIMWV,10";
+
+  std::vector<int> expected = parseLog(log);
+  for (int chunkSize: {1, 3, 16, 31, 64, 4096}) {
+    EXPECT_EQ(expected, parseLog(log, chunkSize)) << chunkSize;
+  }
+}
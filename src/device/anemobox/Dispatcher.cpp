@@ -1,6 +1,7 @@
 #include <device/anemobox/Dispatcher.h>
 #include <server/common/string.h>
 
+#include <algorithm>
 #include <assert.h>
 
 namespace sail {
@@ -34,6 +35,36 @@ Dispatcher::Dispatcher() {
       new DispatchDataProxy<TYPE>(HANDLE));
   FOREACH_CHANNEL(REGISTER_PROXY);
 #undef REGISTER_PROXY
+
+  int maxCode = 0;
+  for (auto code: allDataCodes()) {
+    maxCode = std::max(maxCode, int(code));
+  }
+  _channels.resize(maxCode + 1);
+  for (auto kv: _currentSource) {
+    _channels[kv.first].proxy = kv.second.get();
+  }
+}
+
+SourceId Dispatcher::registerSource(const std::string& source) {
+  auto found = _sourceIds.find(source);
+  if (found != _sourceIds.end()) {
+    return found->second;
+  }
+  SourceId id = _sourceNames.size();
+  _sourceNames.push_back(source);
+  _sourceIdPriority.push_back(sourcePriority(source));
+  _sourceIds[source] = id;
+  return id;
+}
+
+void Dispatcher::setChannelSource(
+    DataCode code, SourceId source, DispatchData* d) {
+  auto& sources = _channels[code].sources;
+  if (sources.size() <= size_t(source)) {
+    sources.resize(source + 1, nullptr);
+  }
+  sources[source] = d;
 }
 
   std::shared_ptr<DispatchData> Dispatcher::dispatchDataForSource(DataCode code, const std::string& source) const {
@@ -92,11 +123,16 @@ Dispatcher::Dispatcher() {
     } else {
       _sourcePriority[source] = priority;
     }
+    auto id = _sourceIds.find(source);
+    if (id != _sourceIds.end()) {
+      _sourceIdPriority[id->second] = sourcePriority(source);
+    }
   }
 
   void Dispatcher::set(DataCode code, const std::string &srcName,
       const std::shared_ptr<DispatchData> &d) {
     _data[code][srcName] = d;
+    setChannelSource(code, registerSource(srcName), d.get());
   }
 
   int Dispatcher::maxPriority() const {
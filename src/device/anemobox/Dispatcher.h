@@ -9,6 +9,8 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <device/anemobox/BinarySignal.h>
 #include <device/anemobox/ValueDispatcher.h>
@@ -233,6 +235,9 @@ TypedDispatchData<typename TypeForCode<Code>::type>* toTypedDispatchData(Dispatc
   return dynamic_cast<TypedDispatchData<typename TypeForCode<Code>::type>*>(data);
 }
 
+// Integer handle for a source name, see Dispatcher::registerSource.
+typedef int SourceId;
+
 //! Dispatcher: the hub for all values processed by the anemobox.
 // the data() method allows enumeration of all components.
 class Dispatcher : public Clock {
@@ -329,10 +334,25 @@ class Dispatcher : public Clock {
   int onNewSource(std::function<void(DataCode, const std::string&)> f);
   void removeNewSourceListener(int);
 
+  // Returns the id of a source name. The same name always maps
+  // to the same id. Producers that publish many samples should
+  // register their sources once and publish using the id.
+  SourceId registerSource(const std::string& source);
+  const std::string& sourceName(SourceId id) const {
+    return _sourceNames[id];
+  }
+
   template <typename T>
   void publishValue(DataCode code, const std::string& source, T value) {
-    TypedDispatchData<T>* dispatchData =
-      createDispatchDataForSource<T>(code, source, maxBufferLength());
+    publishValue<T>(code, registerSource(source), value);
+  }
+
+  // Fast path: After the first sample of a (code, source) pair,
+  // this is a table lookup and does not allocate.
+  template <typename T>
+  void publishValue(DataCode code, SourceId source, T value) {
+    TypedDispatchData<T>* dispatchData = dispatchDataForId<T>(code, source);
+    updateCurrentSource(code, source, dispatchData);
     dispatchData->setValue(value);
   }
 
@@ -349,12 +369,26 @@ class Dispatcher : public Clock {
 
   template<class T>
   void updateCurrentSource(DataCode code, TypedDispatchData<T>* dispatchData) {
-    auto proxy = dynamic_cast<DispatchDataProxy<T>*>(this->dispatchData(code));
-    assert(proxy != 0);
+    assert(dispatchData != nullptr);
+    updateCurrentSource(code, registerSource(dispatchData->source()),
+                        dispatchData);
+  }
 
-    if (!proxy->hasDispatcher() || prefers(dispatchData, proxy->realDispatcher())) {
+  template<class T>
+  void updateCurrentSource(DataCode code, SourceId source,
+                           TypedDispatchData<T>* dispatchData) {
+    Channel& channel = _channels[code];
+    auto proxy = static_cast<DispatchDataProxy<T>*>(channel.proxy);
+    DispatchData* current = proxy->realDispatcher();
+    if (current == dispatchData) {
+      return;
+    }
+
+    if (current == nullptr || prefers(source, dispatchData,
+                                      channel.activeSource, current)) {
       assert(dispatchData != nullptr);
       proxy->setActiveDispatcher(dispatchData);
+      channel.activeSource = source;
 
       // Fire an event saying that 'code' is now provided by another source.
       dataSwitchedSource(dispatchData);
@@ -423,6 +457,42 @@ class Dispatcher : public Clock {
     return nullptr;
   }
  private:
+  // Per DataCode: the proxy in _currentSource, the source it currently
+  // forwards to, and the dispatch data of every source indexed by SourceId.
+  struct Channel {
+    DispatchData* proxy = nullptr;
+    SourceId activeSource = -1;
+    std::vector<DispatchData*> sources;
+  };
+
+  // Same as prefers(a, b) above, for a != b, but using
+  // the priorities cached per SourceId.
+  bool prefers(SourceId aId, DispatchData* a,
+               SourceId bId, DispatchData* b) const {
+    if (b == nullptr || !b->isFresh()) {
+      return true;
+    }
+    return _sourceIdPriority[aId] > _sourceIdPriority[bId];
+  }
+
+  template <typename T>
+  TypedDispatchData<T>* dispatchDataForId(DataCode code, SourceId source) {
+    auto& sources = _channels[code].sources;
+    if (size_t(source) < sources.size() && sources[source] != nullptr) {
+      return static_cast<TypedDispatchData<T>*>(sources[source]);
+    }
+    // Copy the name: registering new sources may reallocate _sourceNames.
+    std::string name = _sourceNames[source];
+    return findOrCreateDispatchData<T>(code, name, maxBufferLength());
+  }
+
+  // Like createDispatchDataForSource, but without source selection.
+  template <typename T>
+  TypedDispatchData<T>* findOrCreateDispatchData(
+      DataCode code, const std::string& source, int size);
+
+  void setChannelSource(DataCode code, SourceId source, DispatchData* d);
+
   template <typename T>
   TypedDispatchData<T>* createNewTypedDispatchData(
       DataCode code, const std::string& source, int size) {
@@ -445,6 +515,14 @@ class Dispatcher : public Clock {
   std::map<DataCode, std::shared_ptr<DispatchData>> _currentSource;
 
   std::map<std::string, int> _sourcePriority;
+
+  // Indexed by DataCode.
+  std::vector<Channel> _channels;
+
+  // Indexed by SourceId.
+  std::vector<std::string> _sourceNames;
+  std::vector<int> _sourceIdPriority;
+  std::unordered_map<std::string, SourceId> _sourceIds;
 };
 
 // A convenient visitor to subscribe to any dispatch data type.
@@ -491,7 +569,7 @@ class SubscribeVisitor : public DispatchDataVisitor {
 
 
 template <typename T>
-TypedDispatchData<T>* Dispatcher::createDispatchDataForSource(
+TypedDispatchData<T>* Dispatcher::findOrCreateDispatchData(
     DataCode code, const std::string& source, int size) {
   auto ptr = dispatchDataForSource(code, source);
 
@@ -499,13 +577,22 @@ TypedDispatchData<T>* Dispatcher::createDispatchDataForSource(
   if (!ptr) {
     dispatchData = createNewTypedDispatchData<T>(code, source, size);
     _data[code][source] = std::shared_ptr<DispatchData>(dispatchData);
+    setChannelSource(code, registerSource(source), dispatchData);
     newDispatchData(dispatchData);
   } else {
     dispatchData = dynamic_cast<TypedDispatchData<T>*>(ptr.get());
     // wrong type for this code.
     assert(dispatchData);
+    setChannelSource(code, registerSource(source), dispatchData);
   }
+  return dispatchData;
+}
 
+template <typename T>
+TypedDispatchData<T>* Dispatcher::createDispatchDataForSource(
+    DataCode code, const std::string& source, int size) {
+  TypedDispatchData<T>* dispatchData =
+    findOrCreateDispatchData<T>(code, source, size);
   updateCurrentSource(code, dispatchData);
   return dispatchData;
 }
@@ -3,58 +3,27 @@
 namespace sail {
 
 Angle<double> DispatcherFilter::filterAngle(
-    const DispatchAngleData *angles, Duration<> window) const {
-  HorizontalMotion<double> accumulator = HorizontalMotion<double>::zero();
-  double accumulatedWeight = 0;
-
-  TimeStamp now = _dispatcher->currentTime();
-
-  const TimedSampleCollection<Angle<double>>& angleValues =
-    angles->dispatcher()->values();
-
-  for (size_t i = 0; i < angleValues.size(); ++i) {
-    Duration<> delta = now - angleValues.back(i).time;
-    if (delta > window) {
-      break;
-    }
-    double factor = 1 - delta.seconds() / window.seconds(); 
-    accumulator = accumulator + HorizontalMotion<double>::polar(
-        Velocity<double>::knots(factor), angleValues.back(i).value);
-    accumulatedWeight += factor;
-  }
-
-  if (accumulatedWeight == 0) {
+    const DispatchAngleData *angles, Duration<> window,
+    AngleWindowFilter *filter) const {
+  AngleWindowFilter::Vec sinCos;
+  if (!filter->mean(angles->dispatcher()->values(),
+                    _dispatcher->currentTime(), window, &sinCos)) {
     // TODO: return something invalid.
     return Angle<>::degrees(0);
   }
-  return accumulator.angle();
+  return Angle<double>::radians(atan2(sinCos[0], sinCos[1]));
 }
 
 Velocity<double> DispatcherFilter::filterVelocity(
-    DispatchVelocityData *velocities, Duration<> window) const {
-  TimeStamp now = _dispatcher->currentTime();
-
-  const TimedSampleCollection<Velocity<double>>& velocityValues =
-    velocities->dispatcher()->values();
-  Velocity<double> velocityAccumulator = Velocity<double>::knots(0);
-
-  double velocityAccumulatedWeight = 0;
-  for (size_t i = 0; i < velocityValues.size(); ++i) {
-    const TimedValue<Velocity<double>>& timedValue = velocityValues.back(i);
-    Duration<> delta = now - timedValue.time;
-    if (delta > window) {
-      break;
-    }
-    double factor = 1 - delta.seconds() / window.seconds(); 
-    velocityAccumulator += timedValue.value.scaled(factor);
-    velocityAccumulatedWeight += factor;
-  }
-  if (velocityAccumulatedWeight == 0) {
+    DispatchVelocityData *velocities, Duration<> window,
+    VelocityWindowFilter *filter) const {
+  VelocityWindowFilter::Vec knots;
+  if (!filter->mean(velocities->dispatcher()->values(),
+                    _dispatcher->currentTime(), window, &knots)) {
     // TODO: return something invalid.
     return Velocity<>::knots(0);
   }
-
-  return velocityAccumulator.scaled(1.0 / velocityAccumulatedWeight);
+  return Velocity<double>::knots(knots[0]);
 }
 
 }  // namespace sail
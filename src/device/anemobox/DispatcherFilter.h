@@ -3,6 +3,7 @@
 
 #include <device/Arduino/libraries/PhysicalQuantity/PhysicalQuantity.h>
 #include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/IncrementalWindowFilter.h>
 #include <device/anemobox/ValueDispatcher.h>
 #include <server/common/TimeStamp.h>
 
@@ -19,8 +20,30 @@ struct DispatcherFilterParams {
     gpsMotionWindow(Duration<>::seconds(3)) { }
 };
 
+// Angles are averaged as unit vectors.
+struct AngleFilterTraits {
+  static const int dim = 2;
+  static void toVector(const Angle<double>& x, double* dst) {
+    x.sincos(dst, dst + 1);
+  }
+};
+
+struct VelocityFilterTraits {
+  static const int dim = 1;
+  static void toVector(const Velocity<double>& x, double* dst) {
+    dst[0] = x.knots();
+  }
+};
+
+typedef IncrementalWindowFilter<Angle<double>, AngleFilterTraits>
+  AngleWindowFilter;
+typedef IncrementalWindowFilter<Velocity<double>, VelocityFilterTraits>
+  VelocityWindowFilter;
+
 // This class is in charge of applying a temporal filter on measured data.
 // It adapts the Dispatcher to functions such as computeTrueWind.
+// Each channel keeps running sums over its window, so that
+// the filtered values are cheap to compute at any sample rate.
 class DispatcherFilter {
  public:
    typedef double type;
@@ -28,30 +51,37 @@ class DispatcherFilter {
   // The dispatcher is expected to remain valid during
   // the lifetime of the DispatcherFilter.
   DispatcherFilter(Dispatcher* dispatcher,
-                   DispatcherFilterParams params) : _dispatcher(dispatcher) { }
+                   DispatcherFilterParams params)
+    : _dispatcher(dispatcher), _params(params) { }
 
   Angle<> awa() const {
-    return filterAngle(_dispatcher->get<AWA>(), _params.apparentWindWindow);
+    return filterAngle(_dispatcher->get<AWA>(), _params.apparentWindWindow,
+                       &_awaFilter);
   }
 
   Velocity<> aws() const {
-    return filterVelocity(_dispatcher->get<AWS>(), _params.apparentWindWindow);
+    return filterVelocity(_dispatcher->get<AWS>(), _params.apparentWindWindow,
+                          &_awsFilter);
   }
 
   Angle<> magHdg() const {
-    return filterAngle(_dispatcher->get<MAG_HEADING>(), _params.waterMotionWindow);
+    return filterAngle(_dispatcher->get<MAG_HEADING>(),
+                       _params.waterMotionWindow, &_magHdgFilter);
   }
 
   Velocity<> watSpeed() const {
-    return filterVelocity(_dispatcher->get<WAT_SPEED>(), _params.waterMotionWindow);
+    return filterVelocity(_dispatcher->get<WAT_SPEED>(),
+                          _params.waterMotionWindow, &_watSpeedFilter);
   }
 
   Velocity<> gpsSpeed() const {
-    return filterVelocity(_dispatcher->get<GPS_SPEED>(), _params.gpsMotionWindow);
+    return filterVelocity(_dispatcher->get<GPS_SPEED>(),
+                          _params.gpsMotionWindow, &_gpsSpeedFilter);
   }
 
   Angle<> gpsBearing() const {
-    return filterAngle(_dispatcher->get<GPS_BEARING>(), _params.gpsMotionWindow);
+    return filterAngle(_dispatcher->get<GPS_BEARING>(),
+                       _params.gpsMotionWindow, &_gpsBearingFilter);
   }
 
   HorizontalMotion<double> gpsMotion() const {
@@ -62,12 +92,21 @@ class DispatcherFilter {
  private:
 
   Angle<double> filterAngle(const DispatchAngleData *angles,
-                            Duration<> window) const;
+                            Duration<> window,
+                            AngleWindowFilter *filter) const;
   Velocity<double> filterVelocity(DispatchVelocityData *velocities,
-                                  Duration<> window) const;
+                                  Duration<> window,
+                                  VelocityWindowFilter *filter) const;
 
   Dispatcher* _dispatcher;
   DispatcherFilterParams _params;
+
+  mutable AngleWindowFilter _awaFilter;
+  mutable VelocityWindowFilter _awsFilter;
+  mutable AngleWindowFilter _magHdgFilter;
+  mutable VelocityWindowFilter _watSpeedFilter;
+  mutable VelocityWindowFilter _gpsSpeedFilter;
+  mutable AngleWindowFilter _gpsBearingFilter;
 };
 
 }  // namespace sail
@@ -2,9 +2,53 @@
 #include <device/anemobox/FakeClockDispatcher.h>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <random>
 
 using namespace sail;
 
+namespace {
+
+// The filters as they used to be computed: a loop over the whole window.
+template <DataCode Code>
+Angle<double> referenceAngle(Dispatcher *dispatcher, Duration<> window) {
+  const auto& values = dispatcher->values<Code>();
+  TimeStamp now = dispatcher->currentTime();
+  HorizontalMotion<double> accumulator = HorizontalMotion<double>::zero();
+  double accumulatedWeight = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    Duration<> delta = now - values.back(i).time;
+    if (delta > window) {
+      break;
+    }
+    double factor = 1 - delta.seconds() / window.seconds();
+    accumulator = accumulator + HorizontalMotion<double>::polar(
+        Velocity<double>::knots(factor), values.back(i).value);
+    accumulatedWeight += factor;
+  }
+  return accumulatedWeight == 0? Angle<>::degrees(0) : accumulator.angle();
+}
+
+template <DataCode Code>
+Velocity<double> referenceVelocity(Dispatcher *dispatcher, Duration<> window) {
+  const auto& values = dispatcher->values<Code>();
+  TimeStamp now = dispatcher->currentTime();
+  Velocity<double> accumulator = Velocity<double>::knots(0);
+  double accumulatedWeight = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    Duration<> delta = now - values.back(i).time;
+    if (delta > window) {
+      break;
+    }
+    double factor = 1 - delta.seconds() / window.seconds();
+    accumulator += values.back(i).value.scaled(factor);
+    accumulatedWeight += factor;
+  }
+  return accumulatedWeight == 0? Velocity<>::knots(0)
+    : accumulator.scaled(1.0 / accumulatedWeight);
+}
+
+}  // namespace
+
 TEST(DispatcherFilterTest, singleValTest) {
   FakeClockDispatcher dispatcher;
 
@@ -62,3 +106,44 @@ TEST(DispatcherFilterTest, noisyValueTest) {
   EXPECT_NEAR(7, filter.watSpeed().knots(), .1);
 }
 
+
+TEST(DispatcherFilterTest, matchesFullWindowTest) {
+  FakeClockDispatcher dispatcher;
+  DispatcherFilterParams params;
+  DispatcherFilter filter(&dispatcher, params);
+
+  std::default_random_engine rng(17);
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  // Irregular rates, pauses long enough for the windows to run empty,
+  // and a switch of source half way.
+  for (int i = 0; i < 20000; ++i) {
+    std::string source = i < 10000? "a" : "b";
+    double awa = 360 * unit(rng) - 180;
+    dispatcher.publishValue(AWA, source, Angle<double>::degrees(awa));
+    dispatcher.publishValue(AWS, source, Velocity<double>::knots(
+        10 + 3 * unit(rng)));
+    if (i % 3 == 0) {
+      dispatcher.publishValue(GPS_BEARING, source,
+                              Angle<double>::degrees(360 * unit(rng)));
+      dispatcher.publishValue(GPS_SPEED, source,
+                              Velocity<double>::knots(6 * unit(rng)));
+    }
+    dispatcher.advance(Duration<>::milliseconds(
+        i % 5000 == 4999? 20000 : int(80 * unit(rng))));
+
+    double tolerance = 1e-6;
+    EXPECT_NEAR(0, (filter.awa() - referenceAngle<AWA>(
+        &dispatcher, params.apparentWindWindow)).normalizedAt0().degrees(),
+        tolerance);
+    EXPECT_NEAR(referenceVelocity<AWS>(
+        &dispatcher, params.apparentWindWindow).knots(),
+        filter.aws().knots(), tolerance);
+    EXPECT_NEAR(0, (filter.gpsBearing() - referenceAngle<GPS_BEARING>(
+        &dispatcher, params.gpsMotionWindow)).normalizedAt0().degrees(),
+        tolerance);
+    EXPECT_NEAR(referenceVelocity<GPS_SPEED>(
+        &dispatcher, params.gpsMotionWindow).knots(),
+        filter.gpsSpeed().knots(), tolerance);
+  }
+}
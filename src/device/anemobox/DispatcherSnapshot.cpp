@@ -0,0 +1,261 @@
+#include <device/anemobox/DispatcherSnapshot.h>
+
+#include <algorithm>
+#include <cstring>
+#include <device/anemobox/DispatcherUtils.h>
+#include <fstream>
+#include <limits>
+#include <server/common/MappedFile.h>
+#include <server/common/logging.h>
+#include <type_traits>
+
+namespace sail {
+
+// Layout, with every item padded to a multiple of 8 bytes:
+//
+//   magic                      "ANMSNP01"
+//   uint64 byteOrderMark       kByteOrderMark
+//   uint64 priorityCount
+//   priorityCount times:
+//     uint64 length, char source[length], int64 priority
+//   uint64 channelCount
+//   channelCount times:
+//     uint32 code, uint32 valueSize, uint64 sampleCount,
+//     uint64 length, char source[length],
+//     int64 times[sampleCount], T values[sampleCount]
+
+namespace {
+
+  const char kMagic[] = "ANMSNP01";
+  const int kMagicSize = 8;
+  const uint64_t kByteOrderMark = 0x0102030405060708ull;
+
+  size_t padding(size_t size) {
+    return (8 - size % 8) % 8;
+  }
+
+  class SnapshotWriter {
+   public:
+    SnapshotWriter(std::ostream* dst) : _dst(dst) {}
+
+    void write(const void* data, size_t size) {
+      static const char zeros[8] = {0};
+      _dst->write(static_cast<const char*>(data), size);
+      _dst->write(zeros, padding(size));
+    }
+
+    void writeUint64(uint64_t x) {
+      write(&x, sizeof(x));
+    }
+
+    void writeString(const std::string& s) {
+      writeUint64(s.size());
+      write(s.data(), s.size());
+    }
+
+    // Called by visitDispatcherChannelsConst
+    template <DataCode Code, typename T>
+    void visit(const char*, const std::string& source,
+               const std::shared_ptr<DispatchData>&,
+               const TimedSampleCollection<T>& values) {
+      static_assert(std::is_trivially_copyable<T>::value
+                    && alignof(T) <= 8,
+                    "Values are written as raw, 8-byte aligned bytes");
+      uint32_t header[2] = {uint32_t(Code), uint32_t(sizeof(T))};
+      auto samples = values.samples();
+      _dst->write(reinterpret_cast<const char*>(header), sizeof(header));
+      writeUint64(samples.size());
+      writeString(source);
+      write(samples.times(), samples.size()*sizeof(int64_t));
+      write(samples.values(), samples.size()*sizeof(T));
+    }
+   private:
+    std::ostream* _dst;
+  };
+
+  // Reads items from the mapped file, checking that they fit.
+  class SnapshotReader {
+   public:
+    SnapshotReader(const char* data, size_t size)
+      : _at(data), _end(data + size) {}
+
+    // Returns null if there are not 'size' more bytes.
+    const char* take(size_t size) {
+      size_t padded = size + padding(size);
+      if (size_t(_end - _at) < padded) {
+        return nullptr;
+      }
+      const char* data = _at;
+      _at += padded;
+      return data;
+    }
+
+    bool readUint64(uint64_t* dst) {
+      const char* data = take(sizeof(*dst));
+      if (data == nullptr) {
+        return false;
+      }
+      memcpy(dst, data, sizeof(*dst));
+      return true;
+    }
+
+    bool readString(std::string* dst) {
+      uint64_t length = 0;
+      if (!readUint64(&length) || size_t(_end - _at) < length) {
+        return false;
+      }
+      const char* data = take(length);
+      if (data == nullptr) {
+        return false;
+      }
+      dst->assign(data, length);
+      return true;
+    }
+   private:
+    const char* _at;
+    const char* _end;
+  };
+
+  template <typename T>
+  bool loadColumns(DataCode code, const std::string& source,
+                   size_t valueSize, uint64_t count,
+                   SnapshotReader* src, Dispatcher* dst) {
+    if (valueSize != sizeof(T)) {
+      LOG(ERROR) << "Snapshot of " << wordIdentifierForCode(code)
+        << " has values of " << valueSize << " bytes, expected "
+        << sizeof(T) << ". Is it from another build?";
+      return false;
+    }
+    if (count > std::numeric_limits<size_t>::max()
+        / std::max(sizeof(T), sizeof(int64_t))) {
+      return false;
+    }
+    const char* times = src->take(count*sizeof(int64_t));
+    const char* values = times == nullptr?
+      nullptr : src->take(count*sizeof(T));
+    if (values == nullptr) {
+      return false;
+    }
+
+    // The mapping is page aligned and every item is padded to 8 bytes,
+    // so the columns can be used in place.
+    auto timePtr = reinterpret_cast<const int64_t*>(times);
+    if (!std::is_sorted(timePtr, timePtr + count)) {
+      LOG(ERROR) << "Snapshot times of " << wordIdentifierForCode(code)
+        << " from " << source << " are not sorted";
+      return false;
+    }
+    TypedDispatchData<T>* data =
+      dst->createDispatchDataForSource<T>(code, source, count);
+    data->dispatcher()->mutableValues()->appendColumns(
+        timePtr, reinterpret_cast<const T*>(values), count);
+    return true;
+  }
+
+  bool loadChannel(SnapshotReader* src, Dispatcher* dst) {
+    const char* header = src->take(2*sizeof(uint32_t));
+    uint64_t count = 0;
+    std::string source;
+    if (header == nullptr || !src->readUint64(&count)
+        || !src->readString(&source)) {
+      return false;
+    }
+    uint32_t codeAndSize[2];
+    memcpy(codeAndSize, header, sizeof(codeAndSize));
+    switch (codeAndSize[0]) {
+#define LOAD_CHANNEL(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+      case HANDLE: return loadColumns<TYPE>( \
+          HANDLE, source, codeAndSize[1], count, src, dst);
+      FOREACH_CHANNEL(LOAD_CHANNEL)
+#undef LOAD_CHANNEL
+      default:
+        LOG(ERROR) << "Unknown data code in snapshot: " << codeAndSize[0];
+        return false;
+    }
+  }
+
+  bool loadSnapshot(SnapshotReader* src, Dispatcher* dst) {
+    const char* magic = src->take(kMagicSize);
+    uint64_t byteOrderMark = 0;
+    if (magic == nullptr || memcmp(magic, kMagic, kMagicSize) != 0
+        || !src->readUint64(&byteOrderMark)
+        || byteOrderMark != kByteOrderMark) {
+      LOG(ERROR) << "Not a snapshot, or from another architecture";
+      return false;
+    }
+
+    // Set the priorities first, as for LogLoader::addToDispatcher.
+    uint64_t priorityCount = 0;
+    if (!src->readUint64(&priorityCount)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < priorityCount; i++) {
+      std::string source;
+      uint64_t priority = 0;
+      if (!src->readString(&source) || !src->readUint64(&priority)) {
+        return false;
+      }
+      dst->setSourcePriority(source, int(int64_t(priority)));
+    }
+
+    uint64_t channelCount = 0;
+    if (!src->readUint64(&channelCount)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < channelCount; i++) {
+      if (!loadChannel(src, dst)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+}  // namespace
+
+bool saveDispatcherSnapshot(const std::string& filename,
+                            const Dispatcher& src) {
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  SnapshotWriter writer(&file);
+  writer.write(kMagic, kMagicSize);
+  writer.writeUint64(kByteOrderMark);
+
+  const auto& priorities = src.sourcePriority();
+  writer.writeUint64(priorities.size());
+  for (const auto& kv: priorities) {
+    writer.writeString(kv.first);
+    writer.writeUint64(uint64_t(int64_t(kv.second)));
+  }
+
+  writer.writeUint64(countChannels(&src));
+  visitDispatcherChannelsConst(&src, &writer);
+  if (!file.flush()) {
+    LOG(ERROR) << "Failed to write the snapshot " << filename;
+    return false;
+  }
+  return true;
+}
+
+bool isDispatcherSnapshot(const std::string& filename) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  char magic[kMagicSize];
+  return file.read(magic, kMagicSize)
+    && memcmp(magic, kMagic, kMagicSize) == 0;
+}
+
+std::shared_ptr<Dispatcher> loadDispatcherSnapshot(
+    const std::string& filename) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    LOG(ERROR) << "Cannot open the snapshot " << filename;
+    return std::shared_ptr<Dispatcher>();
+  }
+  auto dst = std::make_shared<Dispatcher>();
+  SnapshotReader reader(file.data(), file.size());
+  if (!loadSnapshot(&reader, dst.get())) {
+    LOG(ERROR) << "Failed to load the snapshot " << filename;
+    return std::shared_ptr<Dispatcher>();
+  }
+  return dst;
+}
+
+}  // namespace sail
@@ -0,0 +1,33 @@
+#ifndef DEVICE_ANEMOBOX_DISPATCHERSNAPSHOT_H_
+#define DEVICE_ANEMOBOX_DISPATCHERSNAPSHOT_H_
+
+// Binary snapshots of a Dispatcher, to cache the result of an expensive
+// processing stage. Unlike saveDispatcher, which goes through the Logger,
+// a snapshot holds the sorted time column and the raw value column of
+// every channel and source, together with the source priorities. The
+// columns are 8-byte aligned in the file, so that loading one is little
+// more than a copy from the mapped file.
+//
+// Values are stored in their in-memory representation: a snapshot is
+// meant to be read back by the same build, on the same architecture.
+// The value size of every channel is checked when loading.
+
+#include <device/anemobox/Dispatcher.h>
+#include <memory>
+#include <string>
+
+namespace sail {
+
+bool saveDispatcherSnapshot(const std::string& filename,
+                            const Dispatcher& src);
+
+// True if the file starts like a snapshot.
+bool isDispatcherSnapshot(const std::string& filename);
+
+// Returns null if the file can't be read or is not a valid snapshot.
+std::shared_ptr<Dispatcher> loadDispatcherSnapshot(
+    const std::string& filename);
+
+}  // namespace sail
+
+#endif  // DEVICE_ANEMOBOX_DISPATCHERSNAPSHOT_H_
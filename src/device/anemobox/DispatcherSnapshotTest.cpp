@@ -0,0 +1,89 @@
+#include <device/anemobox/DispatcherSnapshot.h>
+#include <device/anemobox/DispatcherUtils.h>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace sail;
+
+namespace {
+  auto offset = TimeStamp::UTC(2016, 02, 26, 16, 4, 0);
+  auto s = Duration<double>::seconds(1.0);
+
+  std::shared_ptr<Dispatcher> makeTestDispatcher() {
+    auto d = std::make_shared<Dispatcher>();
+    d->setSourcePriority("NMEA2000", 3);
+    d->setSourcePriority("Simulated", -2);
+    d->insertValues<Angle<double>>(AWA, "NMEA2000", {
+      {offset, Angle<double>::degrees(34.0)},
+      {offset + 1.0*s, Angle<double>::degrees(35.5)},
+      {offset + 2.5*s, Angle<double>::degrees(-12.0)}
+    });
+    d->insertValues<Angle<double>>(AWA, "Simulated", {
+      {offset + 0.5*s, Angle<double>::degrees(30.0)}
+    });
+    d->insertValues<GeographicPosition<double>>(GPS_POS, "Internal GPS", {
+      {offset, GeographicPosition<double>(
+          Angle<double>::degrees(11.9), Angle<double>::degrees(57.7))},
+      {offset + 1.0*s, GeographicPosition<double>(
+          Angle<double>::degrees(11.8), Angle<double>::degrees(57.6))}
+    });
+    d->insertValues<BinaryEdge>(USER_DEF_SESSION, "user", {
+      {offset, BinaryEdge::ToOn},
+      {offset + 3.0*s, BinaryEdge::ToOff}
+    });
+    return d;
+  }
+
+  template <DataCode Code>
+  void expectSameValues(const Dispatcher& a, const Dispatcher& b,
+                        const std::string& source) {
+    auto x = a.values<Code>(source).samples();
+    auto y = b.values<Code>(source).samples();
+    ASSERT_EQ(x.size(), y.size());
+    for (size_t i = 0; i < x.size(); i++) {
+      EXPECT_EQ(x.times()[i], y.times()[i]);
+      EXPECT_EQ(0, memcmp(&x.values()[i], &y.values()[i],
+                          sizeof(x.values()[i])));
+    }
+  }
+}
+
+TEST(DispatcherSnapshotTest, SaveAndLoad) {
+  const char filename[] = "/tmp/dispatcher_snapshot_test.snap";
+  auto src = makeTestDispatcher();
+  EXPECT_TRUE(saveDispatcherSnapshot(filename, *src));
+  EXPECT_TRUE(isDispatcherSnapshot(filename));
+
+  auto dst = loadDispatcherSnapshot(filename);
+  ASSERT_TRUE(bool(dst));
+  EXPECT_EQ(countChannels(src.get()), countChannels(dst.get()));
+  EXPECT_EQ(countValues(src.get()), countValues(dst.get()));
+  EXPECT_EQ(src->sourcePriority(), dst->sourcePriority());
+  EXPECT_EQ(src->dispatchData(AWA)->source(),
+            dst->dispatchData(AWA)->source());
+
+  expectSameValues<AWA>(*src, *dst, "NMEA2000");
+  expectSameValues<AWA>(*src, *dst, "Simulated");
+  expectSameValues<GPS_POS>(*src, *dst, "Internal GPS");
+  expectSameValues<USER_DEF_SESSION>(*src, *dst, "user");
+}
+
+TEST(DispatcherSnapshotTest, RejectTruncated) {
+  const char filename[] = "/tmp/dispatcher_snapshot_test.snap";
+  const char truncated[] = "/tmp/dispatcher_snapshot_test_truncated.snap";
+  EXPECT_TRUE(saveDispatcherSnapshot(filename, *makeTestDispatcher()));
+
+  std::string bytes;
+  {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(file),
+                 std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream file(truncated, std::ios::out | std::ios::binary);
+    file.write(bytes.data(), bytes.size() - 8);
+  }
+  EXPECT_TRUE(isDispatcherSnapshot(truncated));
+  EXPECT_FALSE(bool(loadDispatcherSnapshot(truncated)));
+  EXPECT_FALSE(isDispatcherSnapshot("/tmp/this_file_should_not_exist.txt"));
+}
@@ -40,6 +40,30 @@ TEST(DispatcherTest, PriorityTest) {
   EXPECT_NEAR(6, dispatcher.val<AWA>().degrees(), 1e-6);
 }
 
+TEST(DispatcherTest, SourceIdTest) {
+  Dispatcher dispatcher;
+  SourceId low = dispatcher.registerSource("low");
+  SourceId high = dispatcher.registerSource("high");
+  EXPECT_NE(low, high);
+  EXPECT_EQ(low, dispatcher.registerSource("low"));
+  EXPECT_EQ("high", dispatcher.sourceName(high));
+
+  // Priorities set after registration are taken into account.
+  dispatcher.setSourcePriority("high", 10);
+
+  dispatcher.publishValue(AWA, low, Angle<>::degrees(1));
+  EXPECT_EQ("low", dispatcher.get<AWA>()->source());
+  dispatcher.publishValue(AWA, high, Angle<>::degrees(2));
+  EXPECT_EQ("high", dispatcher.get<AWA>()->source());
+  dispatcher.publishValue(AWA, low, Angle<>::degrees(3));
+  dispatcher.publishValue(AWA, "low", Angle<>::degrees(4));
+  EXPECT_EQ("high", dispatcher.get<AWA>()->source());
+
+  EXPECT_EQ(3, dispatcher.values<AWA>("low").size());
+  EXPECT_EQ(1, dispatcher.values<AWA>("high").size());
+  EXPECT_EQ(2, dispatcher.sourcesForChannel(AWA).size());
+}
+
 TEST(DispatcherTest, FreshTest) {
   Dispatcher dispatcher;
 
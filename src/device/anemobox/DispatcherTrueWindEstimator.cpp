@@ -49,57 +49,32 @@ void DispatcherTrueWindEstimator::compute() const {
   compute(sourceName());
 }
 
-void DispatcherTrueWindEstimator::compute(const std::string &srcName) const {
-  Angle<> twdir;
-  Angle<> twa;
-  Velocity<> tws;
+namespace {
+
+// Reads the measurements from the active channels of a Dispatcher.
+class DispatcherInput {
+ public:
+  DispatcherInput(Dispatcher* dispatcher) : _dispatcher(dispatcher) { }
 
-  TimeStamp freshLimit = _dispatcher->currentTime() - Duration<double>::seconds(5);
+  TimeStamp currentTime() const { return _dispatcher->currentTime(); }
 
-  if (!_dispatcher->get<GPS_SPEED>()->dispatcher()->hasFreshValue(freshLimit)
-      || !_dispatcher->get<AWA>()->dispatcher()->hasFreshValue(freshLimit)
-      || !_dispatcher->get<AWS>()->dispatcher()->hasFreshValue(freshLimit)) {
-    // we can't compute anything useful without GPS.
-    return;
+  template <DataCode Code>
+  bool hasFreshValue(TimeStamp limit) const {
+    return _dispatcher->get<Code>()->dispatcher()->hasFreshValue(limit);
   }
 
-  if (_validParameters) {
-    HorizontalMotion<double> wind =
-      TrueWindEstimator::computeTrueWind(_parameters.params, _filter);
-    twdir = calcTwdir(wind);
-    tws = wind.norm();
-
-    _dispatcher->publishValue(TWDIR, srcName, twdir);
-    _dispatcher->publishValue(TWS, srcName, tws);
-
-    // Todo: compute TWA with TrueWindEstimator.
-    twa = (twdir - _filter.gpsBearing());
-    _dispatcher->publishValue(TWA, srcName, twa);
-  } else {
-    if (!_dispatcher->get<TWA>()->dispatcher()->hasFreshValue(freshLimit)
-        || !_dispatcher->get<TWS>()->dispatcher()->hasFreshValue(freshLimit)) {
-      return;
-    }
-    twa = _dispatcher->get<TWA>()->dispatcher()->lastValue();
-    tws = _dispatcher->get<TWS>()->dispatcher()->lastValue();
-  } 
-  
-  if (_validTargetSpeedTable) {
-    Velocity<> targetVmg = getVmgTarget(_targetSpeedTable, twa, tws);
-
-    // getVmgTarget returns -1 when the value is invalid. In this case,
-    // nothing should be published.
-    if (targetVmg.knots() >= 0) {
-      _dispatcher->publishValue(TARGET_VMG, srcName, targetVmg);
-    }
+  template <DataCode Code>
+  typename TypeForCode<Code>::type lastValue() const {
+    return _dispatcher->get<Code>()->dispatcher()->lastValue();
   }
+ private:
+  Dispatcher* _dispatcher;
+};
 
-  // TODO: When the TrueWindEstimator will handle current, use water speed
-  // instead.
-  Velocity<> boatSpeed = _filter.gpsSpeed();
+}  // namespace
 
-  Velocity<> vmg = cos(twa) * boatSpeed;
-  _dispatcher->publishValue(VMG, srcName, vmg);
+void DispatcherTrueWindEstimator::compute(const std::string &srcName) const {
+  compute(DispatcherInput(_dispatcher), _filter, srcName, _dispatcher);
 }
 
 std::string DispatcherTrueWindEstimator::info() const {
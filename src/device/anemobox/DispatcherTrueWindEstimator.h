@@ -23,6 +23,17 @@ class DispatcherTrueWindEstimator {
   // Compute and publish using a specific source name
   void compute(const std::string &srcName) const;
 
+  // The computation behind compute(), on measurements from any source.
+  // 'Input' provides
+  //   TimeStamp currentTime() const;
+  //   template <DataCode Code> bool hasFreshValue(TimeStamp limit) const;
+  //   template <DataCode Code> TypeForCode<Code>::type lastValue() const;
+  // 'Filter' has the interface of DispatcherFilter, and the results
+  // are published with output->publishValue(code, srcName, value).
+  template <typename Input, typename Filter, typename Output>
+  void compute(const Input& input, const Filter& filter,
+               const std::string &srcName, Output* output) const;
+
   static const char* sourceName() { return "Anemomind estimator"; }
 
   std::string info() const;
@@ -38,6 +49,62 @@ class DispatcherTrueWindEstimator {
   DispatcherFilter _filter;
 };
 
+template <typename Input, typename Filter, typename Output>
+void DispatcherTrueWindEstimator::compute(
+    const Input& input, const Filter& filter,
+    const std::string &srcName, Output* output) const {
+  Angle<> twdir;
+  Angle<> twa;
+  Velocity<> tws;
+
+  TimeStamp freshLimit = input.currentTime() - Duration<double>::seconds(5);
+
+  if (!input.template hasFreshValue<GPS_SPEED>(freshLimit)
+      || !input.template hasFreshValue<AWA>(freshLimit)
+      || !input.template hasFreshValue<AWS>(freshLimit)) {
+    // we can't compute anything useful without GPS.
+    return;
+  }
+
+  if (_validParameters) {
+    HorizontalMotion<double> wind =
+      TrueWindEstimator::computeTrueWind(_parameters.params, filter);
+    twdir = calcTwdir(wind);
+    tws = wind.norm();
+
+    output->publishValue(TWDIR, srcName, twdir);
+    output->publishValue(TWS, srcName, tws);
+
+    // Todo: compute TWA with TrueWindEstimator.
+    twa = (twdir - filter.gpsBearing());
+    output->publishValue(TWA, srcName, twa);
+  } else {
+    if (!input.template hasFreshValue<TWA>(freshLimit)
+        || !input.template hasFreshValue<TWS>(freshLimit)) {
+      return;
+    }
+    twa = input.template lastValue<TWA>();
+    tws = input.template lastValue<TWS>();
+  }
+
+  if (_validTargetSpeedTable) {
+    Velocity<> targetVmg = getVmgTarget(_targetSpeedTable, twa, tws);
+
+    // getVmgTarget returns -1 when the value is invalid. In this case,
+    // nothing should be published.
+    if (targetVmg.knots() >= 0) {
+      output->publishValue(TARGET_VMG, srcName, targetVmg);
+    }
+  }
+
+  // TODO: When the TrueWindEstimator will handle current, use water speed
+  // instead.
+  Velocity<> boatSpeed = filter.gpsSpeed();
+
+  Velocity<> vmg = cos(twa) * boatSpeed;
+  output->publishValue(VMG, srcName, vmg);
+}
+
 }  // namespace sail
 
 #endif // ANEMOBOX_DISPATCHER_TRUE_WIND_ESTIMATOR_H
@@ -5,6 +5,7 @@
 
 #include <device/anemobox/DispatcherUtils.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <device/anemobox/logger/Logger.h>
 #include <server/common/MultiMerge.h>
@@ -123,7 +124,7 @@ namespace {
 
   template <>
   bool isValidColl(const TimedSampleCollection<BinaryEdge> &coll) {
-    const BinarySignal &samples = coll.samples();
+    auto samples = coll.samples();
 
     if (samples.size() == 0) {
       return true;
@@ -199,8 +200,7 @@ namespace {
   template <typename T>
   class PrioritizedDispatchData {
    public:
-    typedef typename TimedSampleCollection<T>::TimedVector TimedVector;
-    typedef typename TimedVector::const_iterator Iterator;
+    typedef typename TimedSampleCollection<T>::const_iterator Iterator;
 
     PrioritizedDispatchData(int priority, Iterator b, Iterator e) :
       _priority(priority), _begin(b), _end(e) {
@@ -219,7 +219,7 @@ namespace {
       return _priority > other._priority;
     }
 
-    const TimedValue<T> &front() const {
+    TimedValue<T> front() const {
       assert(!empty());
       return *_begin;
     }
@@ -238,8 +238,8 @@ namespace {
   };
 
   template <DataCode Code>
-  const typename TimedSampleCollection<typename TypeForCode<Code>::type>::TimedVector
-      &getSamples(DispatchData *d) {
+  typename TimedSampleCollection<typename TypeForCode<Code>::type>::Columns
+      getSamples(DispatchData *d) {
     return toTypedDispatchData<Code>(d)->dispatcher()->values().samples();
   }
 
@@ -769,7 +769,7 @@ class DispatcherStream : public SortedStream<TimeStamp> {
 
  private:
   TypedDispatchData<T> *_dispatchData;
-  typename TimedSampleCollection<T>::TimedVector::const_iterator _it;
+  typename TimedSampleCollection<T>::const_iterator _it;
   ReplayDispatcher *_destination;
 };
 
@@ -813,6 +813,15 @@ class DispatchDataMerger : public DispatchDataVisitor {
 
 }  // namespace 
 
+namespace {
+  // Makes the standard heap functions, which put the
+  // largest element first, put the earliest timeout first.
+  bool expiresLater(const ReplayDispatcher::Timeout& a,
+                    const ReplayDispatcher::Timeout& b) {
+    return b < a;
+  }
+}
+
 ReplayDispatcher::ReplayDispatcher() : _counter(0) {}
 
 void ReplayDispatcher::replay(const Dispatcher *src) {
@@ -849,7 +858,8 @@ void ReplayDispatcher::setTimeout(std::function<void()> cb, double delayMS) {
   if (_currentTime.defined()) {
     _counter++;
     auto next = _currentTime + Duration<double>::milliseconds(delayMS);
-    _timeouts.insert(Timeout{_counter, next, cb});
+    _timeouts.push_back(Timeout{_counter, next, cb});
+    std::push_heap(_timeouts.begin(), _timeouts.end(), expiresLater);
   }
 }
 
@@ -861,7 +871,7 @@ DispatchData* ReplayDispatcher::createNewCustomDispatchData(
   // ... and provide our own, short-term size.
   // For all LazyReplayDispatchData, once we call
   // finalize, the size will be arbitrarily large.
-  int shortSize = 30;
+  int shortSize = lazyBufferLength;
 
   if (_replayingFrom) {
     auto fCode = _replayingFrom->allSources().find(code);
@@ -879,25 +889,24 @@ DispatchData* ReplayDispatcher::createNewCustomDispatchData(
 
 
 void ReplayDispatcher::finishTimeouts() {
-  for (auto to: _timeouts) {
-    to.cb();
+  while (!_timeouts.empty()) {
+    popTimeout().cb();
   }
-  _timeouts = std::set<Timeout>();
 }
 
 void ReplayDispatcher::visitTimeouts() {
-  std::vector<Timeout> toRemove;
   if (_currentTime.defined()) {
-    for (auto to: _timeouts) {
-      if (to.time <= _currentTime) {
-        to.cb();
-        toRemove.push_back(to);
-      }
+    while (!_timeouts.empty() && _timeouts.front().time <= _currentTime) {
+      popTimeout().cb();
     }
   }
-  for (auto to: toRemove) {
-    _timeouts.erase(to);
-  }
+}
+
+ReplayDispatcher::Timeout ReplayDispatcher::popTimeout() {
+  std::pop_heap(_timeouts.begin(), _timeouts.end(), expiresLater);
+  Timeout to = std::move(_timeouts.back());
+  _timeouts.pop_back();
+  return to;
 }
 
 bool saveDispatcher(const std::string& filename, const Dispatcher& nav) {
@@ -906,10 +915,7 @@ bool saveDispatcher(const std::string& filename, const Dispatcher& nav) {
 
   replay.replay(&nav);
 
-  LogFile logged;
-  logger.flushTo(&logged);
-
-  return Logger::save(filename, logged);
+  return Logger::save(filename, logger.swapBuffer()->data());
 }
 
 
@@ -6,7 +6,9 @@
 #ifndef DEVICE_ANEMOBOX_DISPATCHERUTILS_H_
 #define DEVICE_ANEMOBOX_DISPATCHERUTILS_H_
 
+#include <functional>
 #include <memory>
+#include <vector>
 #include <device/anemobox/Dispatcher.h>
 #include <server/common/logging.h>
 
@@ -179,11 +181,16 @@ class ReplayDispatcher : public Dispatcher {
     TimeStamp time;
     std::function<void()> cb;
 
+    // Order of expiry: by time, then in the order they were set.
     bool operator<(const Timeout &other) const {
-      return id < other.id;
+      return time < other.time || (time == other.time && id < other.id);
     }
   };
 
+  // While replaying, a replayed channel only keeps its most recent
+  // samples. Listeners see that many samples at most.
+  static const int lazyBufferLength = 30;
+
   ReplayDispatcher();
 
    TimeStamp currentTime() override {
@@ -199,7 +206,9 @@ class ReplayDispatcher : public Dispatcher {
  
      // This is the only way to advance time of this dispatcher.
      // Consequently, we only need to visit the timeouts here.
-     visitTimeouts();
+     if (!_timeouts.empty() && _timeouts.front().time <= t) {
+       visitTimeouts();
+     }
    }
 
    void advanceTime(Duration<> delta) {
@@ -223,7 +232,9 @@ class ReplayDispatcher : public Dispatcher {
 
    void finishTimeouts();
 
-   const std::set<Timeout> &getTimeouts() const {
+   // The pending timeouts, as a heap: the first one
+   // expires first, the others are in no particular order.
+   const std::vector<Timeout> &getTimeouts() const {
      return _timeouts;
    }
  protected:
@@ -235,8 +246,11 @@ class ReplayDispatcher : public Dispatcher {
 
    std::vector<DispatchData*> _toFinalize;
    void visitTimeouts();
+   Timeout popTimeout();
    int64_t _counter;
-   std::set<Timeout> _timeouts;
+
+   // Min-heap, so that advancing time only touches expired timeouts.
+   std::vector<Timeout> _timeouts;
    TimeStamp _currentTime;
  };
  
@@ -272,3 +272,31 @@ TEST(DispatcherUtilsTest, Replay2) {
   EXPECT_CALL(listener, onNewValue(testing::_));
   replay.publishValue(TWA, "test source", Angle<>::degrees(44));
 }
+
+TEST(DispatcherUtilsTest, ReplayTimeouts) {
+  ReplayDispatcher replay;
+  replay.setCurrentTime(offset);
+
+  std::vector<int> fired;
+  replay.setTimeout([&]() { fired.push_back(30); }, 30);
+  replay.setTimeout([&]() { fired.push_back(10); }, 10);
+  replay.setTimeout([&]() {
+    fired.push_back(20);
+    replay.setTimeout([&]() { fired.push_back(25); }, 5);
+  }, 20);
+  replay.setTimeout([&]() { fired.push_back(11); }, 10);
+  replay.setTimeout([&]() { fired.push_back(100); }, 100);
+
+  replay.advanceTime(Duration<>::milliseconds(15));
+  EXPECT_EQ((std::vector<int>{10, 11}), fired);
+
+  // The delay of a timeout set by a callback counts
+  // from the current time, so it does not fire yet.
+  replay.advanceTime(Duration<>::milliseconds(25));
+  EXPECT_EQ((std::vector<int>{10, 11, 20, 30}), fired);
+  EXPECT_EQ(2, replay.getTimeouts().size());
+
+  replay.finishTimeouts();
+  EXPECT_EQ((std::vector<int>{10, 11, 20, 30, 25, 100}), fired);
+  EXPECT_TRUE(replay.getTimeouts().empty());
+}
@@ -0,0 +1,217 @@
+#ifndef DEVICE_ANEMOBOX_INCREMENTAL_WINDOW_FILTER_H
+#define DEVICE_ANEMOBOX_INCREMENTAL_WINDOW_FILTER_H
+
+// Triangular-weighted mean over a sliding time window: a sample of age d
+// has the weight 1 - d/window, and samples older than the window are
+// ignored. Because the weight is affine in the sample time, the weighted
+// sums follow from four running sums (of 1, t, x and t*x) over the samples
+// in the window. Those sums are updated as samples are appended to the
+// TimedSampleCollection and expire from the window, so that an estimate
+// costs amortized O(1), independently of the sample rate.
+//
+// Traits maps a sample to a vector of doubles to average:
+//
+//   struct Traits {
+//     static const int dim = ...;
+//     static void toVector(const T& x, double* dst);
+//   };
+
+#include <array>
+#include <cstdint>
+#include <device/anemobox/TimedSampleCollection.h>
+#include <server/common/TimeStamp.h>
+
+namespace sail {
+
+template <typename T, typename Traits>
+class IncrementalWindowFilter {
+ public:
+  static const int dim = Traits::dim;
+  typedef std::array<double, dim> Vec;
+
+  // The sums are recomputed from the samples after this many updates,
+  // so that rounding errors do not accumulate...
+  static const int maxUpdatesBetweenRebuilds = 4096;
+
+  // ... and when the reference time is this old, so that t*x
+  // stays small.
+  static const int64_t maxReferenceAgeMillis = 10*60*1000;
+
+  IncrementalWindowFilter() : _values(nullptr) {}
+
+  // Computes the weighted mean of the samples that are not older than
+  // 'window' at time 'now'. Returns false if the weights sum to zero.
+  // Calls are cheap as long as 'values' is only appended to and 'now'
+  // does not go backward; otherwise the sums are recomputed.
+  bool mean(const TimedSampleCollection<T>& values,
+            TimeStamp now, Duration<> window, Vec* dst);
+
+ private:
+  bool expired(int64_t time, int64_t now) const {
+    return Duration<>::milliseconds(now - time) > _window;
+  }
+
+  bool canUpdate(const TimedSampleCollection<T>& values,
+                 int64_t now, Duration<> window) const;
+  void rebuild(const TimedSampleCollection<T>& values, int64_t now);
+  void clearSums(int64_t referenceTime);
+  void accumulate(int64_t time, const T& value, double sign);
+
+  const TimedSampleCollection<T>* _values;
+  uint64_t _revision;
+  Duration<> _window;
+  int64_t _lastNow;
+  int _updates;
+
+  // Serial numbers of the samples in the sums: [_begin, _end)
+  uint64_t _begin, _end;
+
+  // Times are in seconds relative to _referenceTime.
+  int64_t _referenceTime;
+  double _count;
+  double _timeSum;
+  Vec _valueSum;
+  Vec _timeValueSum;
+};
+
+// The same weighted mean, computed directly from the samples
+// times[0..n), values[0..n), for one-off evaluations.
+template <typename T, typename Traits>
+bool triangularWindowMean(const int64_t* times, const T* values, size_t n,
+                          TimeStamp now, Duration<> window,
+                          std::array<double, Traits::dim>* dst) {
+  const int dim = Traits::dim;
+  double sum[dim] = {0};
+  double weightSum = 0;
+  int64_t t = now.toMilliSecondsSince1970();
+  for (size_t i = n; 0 < i; i--) {
+    Duration<> delta = Duration<>::milliseconds(t - times[i - 1]);
+    if (delta > window) {
+      break;
+    }
+    double weight = 1 - delta.seconds()/window.seconds();
+    double x[dim];
+    Traits::toVector(values[i - 1], x);
+    for (int j = 0; j < dim; j++) {
+      sum[j] += weight*x[j];
+    }
+    weightSum += weight;
+  }
+  if (weightSum == 0) {
+    return false;
+  }
+  for (int j = 0; j < dim; j++) {
+    (*dst)[j] = sum[j]/weightSum;
+  }
+  return true;
+}
+
+template <typename T, typename Traits>
+bool IncrementalWindowFilter<T, Traits>::canUpdate(
+    const TimedSampleCollection<T>& values,
+    int64_t now, Duration<> window) const {
+  uint64_t first = values.firstSerial();
+  return _values == &values
+    && _revision == values.revision()
+    && _window == window
+    && _lastNow <= now
+    && _updates < maxUpdatesBetweenRebuilds
+    && now - _referenceTime < maxReferenceAgeMillis
+
+    // We need the values of the samples to remove them from the sums.
+    && first <= _begin
+    && _end <= first + values.size();
+}
+
+template <typename T, typename Traits>
+bool IncrementalWindowFilter<T, Traits>::mean(
+    const TimedSampleCollection<T>& values,
+    TimeStamp now, Duration<> window, Vec* dst) {
+  int64_t t = now.toMilliSecondsSince1970();
+  if (canUpdate(values, t, window)) {
+    auto samples = values.samples();
+    uint64_t first = values.firstSerial();
+    uint64_t last = first + samples.size();
+    for (; _end < last; _end++, _updates++) {
+      size_t i = _end - first;
+      accumulate(samples.times()[i], samples.values()[i], 1.0);
+    }
+    for (; _begin < _end; _begin++, _updates++) {
+      size_t i = _begin - first;
+      if (!expired(samples.times()[i], t)) {
+        break;
+      }
+      accumulate(samples.times()[i], samples.values()[i], -1.0);
+    }
+    if (_begin == _end) {
+      clearSums(t);
+    }
+  } else {
+    _values = &values;
+    _revision = values.revision();
+    _window = window;
+    rebuild(values, t);
+  }
+  _lastNow = t;
+
+  // The weight of a sample at time u is 1 - (tau - u)/W
+  double tau = 1.0e-3*(t - _referenceTime);
+  double w = window.seconds();
+  double weightSum = _count - (tau*_count - _timeSum)/w;
+
+  // Rounding errors can make up for a weight that should be 0,
+  // but a true weight is at least 1 ms/window.
+  if (_count == 0 || weightSum <= 1.0e-9*_count) {
+    return false;
+  }
+  for (int i = 0; i < dim; i++) {
+    (*dst)[i] = (_valueSum[i] - (tau*_valueSum[i] - _timeValueSum[i])/w)
+      / weightSum;
+  }
+  return true;
+}
+
+template <typename T, typename Traits>
+void IncrementalWindowFilter<T, Traits>::rebuild(
+    const TimedSampleCollection<T>& values, int64_t now) {
+  clearSums(now);
+  _updates = 0;
+  auto samples = values.samples();
+  size_t n = samples.size();
+  size_t from = n;
+  while (0 < from && !expired(samples.times()[from - 1], now)) {
+    from--;
+  }
+  for (size_t i = from; i < n; i++) {
+    accumulate(samples.times()[i], samples.values()[i], 1.0);
+  }
+  _begin = values.firstSerial() + from;
+  _end = values.firstSerial() + n;
+}
+
+template <typename T, typename Traits>
+void IncrementalWindowFilter<T, Traits>::clearSums(int64_t referenceTime) {
+  _referenceTime = referenceTime;
+  _count = 0;
+  _timeSum = 0;
+  _valueSum.fill(0);
+  _timeValueSum.fill(0);
+}
+
+template <typename T, typename Traits>
+void IncrementalWindowFilter<T, Traits>::accumulate(
+    int64_t time, const T& value, double sign) {
+  double u = 1.0e-3*(time - _referenceTime);
+  double x[dim];
+  Traits::toVector(value, x);
+  _count += sign;
+  _timeSum += sign*u;
+  for (int i = 0; i < dim; i++) {
+    _valueSum[i] += sign*x[i];
+    _timeValueSum[i] += sign*u*x[i];
+  }
+}
+
+}  // namespace sail
+
+#endif  // DEVICE_ANEMOBOX_INCREMENTAL_WINDOW_FILTER_H
@@ -0,0 +1,174 @@
+#include <device/anemobox/IngestionQueue.h>
+
+#include <chrono>
+#include <iostream>
+#include <server/common/logging.h>
+
+namespace sail {
+
+namespace {
+  int latencyBucket(int64_t nanos) {
+    int64_t micros = nanos / 1000;
+    int bucket = 0;
+    while (0 < micros && bucket < IngestionQueue::latencyBucketCount - 1) {
+      micros >>= 1;
+      bucket++;
+    }
+    return bucket;
+  }
+}
+
+int64_t IngestionQueue::Stats::latencyPercentileMicros(double fraction) const {
+  uint64_t total = 0;
+  for (auto n: latencyHistogram) {
+    total += n;
+  }
+  uint64_t target = uint64_t(fraction*total);
+  uint64_t acc = 0;
+  for (int i = 0; i < latencyBucketCount; i++) {
+    acc += latencyHistogram[i];
+    if (target <= acc) {
+      return int64_t(1) << i;
+    }
+  }
+  return int64_t(1) << (latencyBucketCount - 1);
+}
+
+IngestionQueue::IngestionQueue(IngestionDispatcher* dispatcher,
+                               const Settings& settings)
+  : _dispatcher(dispatcher), _settings(settings),
+    _queue(settings.capacity), _batch(settings.maxBatchSize),
+    _stopRequested(false), _enqueued(0), _dispatched(0), _batches(0) {
+  for (auto& n: _latencyHistogram) {
+    n.store(0);
+  }
+}
+
+IngestionQueue::~IngestionQueue() {
+  stop();
+}
+
+SourceId IngestionQueue::registerSource(const std::string& source) {
+  std::lock_guard<std::mutex> lock(_dispatcherMutex);
+  return _dispatcher->registerSource(source);
+}
+
+std::string IngestionQueue::sourceName(SourceId source) {
+  std::lock_guard<std::mutex> lock(_dispatcherMutex);
+  return _dispatcher->sourceName(source);
+}
+
+int64_t IngestionQueue::steadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void IngestionQueue::logDropped() {
+  // The first drop and then every time the count doubles, so that a
+  // queue that stays full does not flood the log.
+  uint64_t dropped = _queue.dropped();
+  if ((dropped & (dropped - 1)) == 0) {
+    LOG(WARNING) << "IngestionQueue full, " << dropped
+      << " samples dropped so far";
+  }
+}
+
+void IngestionQueue::start() {
+  if (!running()) {
+    _stopRequested = false;
+    _thread = std::thread([this]() { run(); });
+  }
+}
+
+void IngestionQueue::stop() {
+  if (running()) {
+    _stopRequested = true;
+    _thread.join();
+  }
+}
+
+void IngestionQueue::run() {
+  auto idleSleep = std::chrono::microseconds(
+      int64_t(_settings.idleSleep.seconds()*1.0e6));
+  while (!_stopRequested) {
+    if (dispatchBatch() == 0) {
+      std::this_thread::sleep_for(idleSleep);
+    }
+  }
+  while (0 < dispatchBatch()) {
+  }
+}
+
+size_t IngestionQueue::drain() {
+  assert(!running());
+  size_t total = 0;
+  while (true) {
+    size_t n = dispatchBatch();
+    if (n == 0) {
+      return total;
+    }
+    total += n;
+  }
+}
+
+size_t IngestionQueue::dispatchBatch() {
+  size_t n = _queue.popBatch(_batch.data(), _batch.size());
+  if (n == 0) {
+    return 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_dispatcherMutex);
+    for (size_t i = 0; i < n; i++) {
+      dispatch(_batch[i]);
+    }
+    _dispatcher->_sampleTime = TimeStamp();
+  }
+  int64_t now = steadyNanos();
+  for (size_t i = 0; i < n; i++) {
+    _latencyHistogram[latencyBucket(now - _batch[i].enqueuedNanos)]
+      .fetch_add(1, std::memory_order_relaxed);
+  }
+  _dispatched.fetch_add(n, std::memory_order_relaxed);
+  _batches.fetch_add(1, std::memory_order_relaxed);
+  return n;
+}
+
+void IngestionQueue::dispatch(const QueuedSample& sample) {
+  _dispatcher->_sampleTime = sample.time;
+  switch (sample.code) {
+#define DISPATCH_SAMPLE(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    case HANDLE: \
+      _dispatcher->publishValue<TYPE>( \
+          HANDLE, sample.source, sample.value<TYPE>()); \
+      break;
+    FOREACH_CHANNEL(DISPATCH_SAMPLE)
+#undef DISPATCH_SAMPLE
+  }
+}
+
+IngestionQueue::Stats IngestionQueue::stats() const {
+  Stats dst;
+  dst.enqueued = _enqueued.load(std::memory_order_relaxed);
+  dst.dropped = _queue.dropped();
+  dst.dispatched = _dispatched.load(std::memory_order_relaxed);
+  dst.batches = _batches.load(std::memory_order_relaxed);
+  for (int i = 0; i < latencyBucketCount; i++) {
+    dst.latencyHistogram[i] =
+      _latencyHistogram[i].load(std::memory_order_relaxed);
+  }
+  return dst;
+}
+
+std::ostream& operator<<(std::ostream& s, const IngestionQueue::Stats& stats) {
+  s << "enqueued: " << stats.enqueued
+    << ", dropped: " << stats.dropped
+    << ", dispatched: " << stats.dispatched
+    << ", batches: " << stats.batches;
+  if (0 < stats.dispatched) {
+    s << ", latency p50 < " << stats.latencyPercentileMicros(0.5) << " us"
+      << ", p99 < " << stats.latencyPercentileMicros(0.99) << " us";
+  }
+  return s;
+}
+
+}  // namespace sail
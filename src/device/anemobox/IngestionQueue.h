@@ -0,0 +1,237 @@
+#ifndef ANEMOBOX_INGESTION_QUEUE_H
+#define ANEMOBOX_INGESTION_QUEUE_H
+
+// IngestionQueue decouples the threads that decode sensor data from the
+// Dispatcher. Reader threads enqueue samples without locking, and a
+// dispatch thread drains them in batches into the Dispatcher, where
+// listeners are fired. Typical usage:
+//
+//   IngestionDispatcher dispatcher;
+//   IngestionQueue queue(&dispatcher);
+//   SourceId src = queue.registerSource("NMEA2000/c0788c00e7e04312");
+//   queue.start();
+//   // on any thread:
+//   queue.publishValue(AWA, src, Angle<>::degrees(30));
+//
+// While the dispatch thread runs, other threads must hold
+// dispatcherMutex() when they access the dispatcher.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/MpscRingBuffer.h>
+
+namespace sail {
+
+// A Dispatcher whose clock reports the time at which the sample being
+// dispatched was enqueued, so that queueing does not shift time stamps.
+// Outside of dispatching, it reports the wall clock.
+class IngestionDispatcher : public Dispatcher {
+ public:
+  TimeStamp currentTime() override {
+    return _sampleTime.defined()? _sampleTime : clockTime();
+  }
+
+  // The clock with which samples are stamped when they are enqueued.
+  // Called from the producer threads, so it must be thread safe.
+  virtual TimeStamp clockTime() { return TimeStamp::now(); }
+ private:
+  friend class IngestionQueue;
+  TimeStamp _sampleTime;
+};
+
+namespace IngestionQueueInternal {
+  template <typename... T> struct MaxSize;
+
+  template <typename T>
+  struct MaxSize<T> {
+    static const size_t value = sizeof(T);
+  };
+
+  template <typename T, typename... Rest>
+  struct MaxSize<T, Rest...> {
+    static const size_t value = sizeof(T) > MaxSize<Rest...>::value?
+      sizeof(T) : MaxSize<Rest...>::value;
+  };
+
+#define INGESTION_CHANNEL_TYPE(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+  , TYPE
+  const size_t payloadSize =
+    MaxSize<char FOREACH_CHANNEL(INGESTION_CHANNEL_TYPE)>::value;
+#undef INGESTION_CHANNEL_TYPE
+}
+
+// A sample waiting in the queue. The value is stored in place, with
+// the type given by the DataCode.
+struct QueuedSample {
+  DataCode code;
+  SourceId source;
+  TimeStamp time;
+  int64_t enqueuedNanos;
+  alignas(8) unsigned char payload[IngestionQueueInternal::payloadSize];
+
+  template <typename T>
+  void setValue(const T& value) {
+    static_assert(sizeof(T) <= sizeof(payload), "Payload too small");
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Queued samples are copied as raw bytes");
+    new (payload) T(value);
+  }
+
+  template <typename T>
+  const T& value() const {
+    return *reinterpret_cast<const T*>(payload);
+  }
+};
+
+class IngestionQueue {
+ public:
+  struct Settings {
+    Settings() {}
+
+    // Rounded up to a power of two.
+    int capacity = 4096;
+
+    // The dispatcher mutex is held while dispatching one batch.
+    int maxBatchSize = 256;
+
+    // How long the dispatch thread sleeps when the queue is empty.
+    Duration<> idleSleep = Duration<>::milliseconds(1);
+  };
+
+  // Bucket i counts samples that waited in the queue for
+  // [2^(i-1), 2^i) microseconds. Bucket 0 is for less than 1 µs.
+  static const int latencyBucketCount = 32;
+
+  struct Stats {
+    uint64_t enqueued = 0;
+    uint64_t dropped = 0;
+    uint64_t dispatched = 0;
+    uint64_t batches = 0;
+    std::array<uint64_t, latencyBucketCount> latencyHistogram;
+
+    Stats() { latencyHistogram.fill(0); }
+
+    // Upper bound, in microseconds, of the latency of
+    // the given fraction of all dispatched samples.
+    int64_t latencyPercentileMicros(double fraction) const;
+  };
+
+  IngestionQueue(IngestionDispatcher* dispatcher,
+                 const Settings& settings = Settings());
+  ~IngestionQueue();
+
+  IngestionQueue(const IngestionQueue&) = delete;
+  IngestionQueue& operator=(const IngestionQueue&) = delete;
+
+  IngestionDispatcher* dispatcher() const { return _dispatcher; }
+
+  // Thread safe.
+  SourceId registerSource(const std::string& source);
+  std::string sourceName(SourceId source);
+
+  // Lock free, can be called from any thread. Returns false if the
+  // queue is full, in which case the sample is dropped, counted in the
+  // stats and logged. T must be the type of the channel, as with
+  // Dispatcher::publishValue.
+  template <typename T>
+  bool publishValue(DataCode code, SourceId source, const T& value) {
+    QueuedSample sample;
+    sample.code = code;
+    sample.source = source;
+    sample.time = _dispatcher->clockTime();
+    sample.enqueuedNanos = steadyNanos();
+    sample.setValue<T>(value);
+    if (_queue.tryPush(sample)) {
+      _enqueued.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    logDropped();
+    return false;
+  }
+
+  // Starts the dispatch thread.
+  void start();
+
+  // Stops the dispatch thread after dispatching what is left in the queue.
+  void stop();
+
+  bool running() const { return _thread.joinable(); }
+
+  // Dispatches the queued samples on the calling thread. Only for use
+  // when the dispatch thread is not running. Returns the number of
+  // samples dispatched.
+  size_t drain();
+
+  std::mutex& dispatcherMutex() { return _dispatcherMutex; }
+
+  Stats stats() const;
+
+  static int64_t steadyNanos();
+ private:
+  void logDropped();
+  size_t dispatchBatch();
+  void dispatch(const QueuedSample& sample);
+  void run();
+
+  IngestionDispatcher* _dispatcher;
+  Settings _settings;
+  MpscRingBuffer<QueuedSample> _queue;
+  std::vector<QueuedSample> _batch;
+
+  std::mutex _dispatcherMutex;
+  std::thread _thread;
+  std::atomic<bool> _stopRequested;
+
+  std::atomic<uint64_t> _enqueued;
+  std::atomic<uint64_t> _dispatched;
+  std::atomic<uint64_t> _batches;
+  std::array<std::atomic<uint64_t>, latencyBucketCount> _latencyHistogram;
+};
+
+std::ostream& operator<<(std::ostream& s, const IngestionQueue::Stats& stats);
+
+// Where a sensor source publishes its samples: either directly into a
+// Dispatcher, on the calling thread, or into an IngestionQueue.
+class SampleSink {
+ public:
+  SampleSink(Dispatcher* dispatcher)
+    : _dispatcher(dispatcher), _queue(nullptr) {}
+  SampleSink(IngestionQueue* queue)
+    : _dispatcher(queue->dispatcher()), _queue(queue) {}
+
+  SourceId registerSource(const std::string& source) {
+    return _queue? _queue->registerSource(source)
+      : _dispatcher->registerSource(source);
+  }
+
+  std::string sourceName(SourceId source) {
+    return _queue? _queue->sourceName(source)
+      : _dispatcher->sourceName(source);
+  }
+
+  // A full queue drops the sample, and counts and logs it.
+  template <typename T>
+  void publishValue(DataCode code, SourceId source, const T& value) {
+    if (_queue) {
+      _queue->publishValue<T>(code, source, value);
+    } else {
+      _dispatcher->publishValue<T>(code, source, value);
+    }
+  }
+ private:
+  Dispatcher* _dispatcher;
+  IngestionQueue* _queue;
+};
+
+}  // namespace sail
+
+#endif  // ANEMOBOX_INGESTION_QUEUE_H
@@ -0,0 +1,102 @@
+#include <device/anemobox/IngestionQueue.h>
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace sail;
+
+TEST(IngestionQueueTest, DrainInOrder) {
+  IngestionDispatcher dispatcher;
+  IngestionQueue::Settings settings;
+  settings.capacity = 8;
+  IngestionQueue queue(&dispatcher, settings);
+  SourceId src = queue.registerSource("test");
+
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(i < 8, queue.publishValue(AWA, src, Angle<>::degrees(i)));
+  }
+  EXPECT_TRUE(queue.publishValue(GPS_POS, src, GeographicPosition<double>(
+      Angle<>::degrees(12), Angle<>::degrees(57))) == false);
+
+  EXPECT_EQ(8, queue.drain());
+
+  const auto& awa = dispatcher.values<AWA>("test");
+  EXPECT_EQ(8, awa.size());
+  for (int i = 0; i < 8; i++) {
+    EXPECT_NEAR(i, awa[i].value.degrees(), 1.0e-9);
+  }
+
+  EXPECT_TRUE(queue.publishValue(GPS_POS, src, GeographicPosition<double>(
+      Angle<>::degrees(12), Angle<>::degrees(57))));
+  EXPECT_EQ(1, queue.drain());
+  EXPECT_NEAR(57, dispatcher.val<GPS_POS>().lat().degrees(), 1.0e-9);
+
+  auto stats = queue.stats();
+  EXPECT_EQ(9, stats.enqueued);
+  EXPECT_EQ(13, stats.dropped);
+  EXPECT_EQ(9, stats.dispatched);
+  uint64_t histogramTotal = 0;
+  for (auto n: stats.latencyHistogram) {
+    histogramTotal += n;
+  }
+  EXPECT_EQ(9, histogramTotal);
+}
+
+TEST(IngestionQueueTest, DispatchThread) {
+  const int producerCount = 4;
+  const int perProducer = 1000;
+
+  IngestionDispatcher dispatcher;
+  IngestionQueue queue(&dispatcher);
+  std::vector<SourceId> sources;
+  for (int p = 0; p < producerCount; p++) {
+    sources.push_back(queue.registerSource("src" + std::to_string(p)));
+  }
+  queue.start();
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producerCount; p++) {
+    producers.push_back(std::thread([&queue, &sources, p]() {
+      for (int i = 0; i < perProducer; i++) {
+        while (!queue.publishValue(AWS, sources[p], Velocity<>::knots(i))) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+  for (auto& t: producers) {
+    t.join();
+  }
+  queue.stop();
+
+  auto stats = queue.stats();
+  EXPECT_EQ(producerCount*perProducer, stats.dispatched);
+  EXPECT_EQ(stats.enqueued, stats.dispatched);
+
+  std::lock_guard<std::mutex> lock(queue.dispatcherMutex());
+  for (int p = 0; p < producerCount; p++) {
+    const auto& aws = dispatcher.values<AWS>("src" + std::to_string(p));
+    EXPECT_EQ(perProducer, aws.size());
+    EXPECT_NEAR(perProducer - 1, aws.lastValue().knots(), 1.0e-9);
+  }
+}
+
+TEST(IngestionQueueTest, SampleSink) {
+  IngestionDispatcher direct;
+  IngestionDispatcher queued;
+  IngestionQueue queue(&queued);
+
+  for (SampleSink sink: {SampleSink(&direct), SampleSink(&queue)}) {
+    SourceId src = sink.registerSource("NMEA0183");
+    EXPECT_EQ("NMEA0183", sink.sourceName(src));
+    sink.publishValue(AWA, src, Angle<>::degrees(30));
+    sink.publishValue(AWS, src, Velocity<>::knots(9));
+  }
+  EXPECT_EQ(2, queue.drain());
+
+  for (IngestionDispatcher* d: {&direct, &queued}) {
+    EXPECT_NEAR(30, d->val<AWA>().degrees(), 1.0e-9);
+    EXPECT_NEAR(9, d->val<AWS>().knots(), 1.0e-9);
+  }
+}
@@ -14,7 +14,7 @@
 namespace sail {
 
 template <typename T>
-const typename TimedSampleCollection<T>::TimedVector& samplesOf(
+typename TimedSampleCollection<T>::Columns samplesOf(
     const std::shared_ptr<TypedDispatchData<T>>& src) {
   return src->dispatcher()->values().samples();
 }
@@ -78,7 +78,7 @@ public:
   int _counter = 0;
   bool _finalized = false;
   ValueDispatcher<T> _dispatcher;
-  typename TimedSampleCollection<T>::TimedVector::const_iterator _sameUpTo;
+  typename TimedSampleCollection<T>::const_iterator _sameUpTo;
   std::shared_ptr<TypedDispatchData<T>> _prototype;
 
   void stepIterator() {
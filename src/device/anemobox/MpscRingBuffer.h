@@ -0,0 +1,127 @@
+#ifndef ANEMOBOX_MPSC_RING_BUFFER_H
+#define ANEMOBOX_MPSC_RING_BUFFER_H
+
+// A bounded lock-free queue with many producers and a single consumer.
+//
+// Every cell carries a sequence number telling whether it is free for
+// the producer claiming position 'pos' (sequence == pos) or holds a value
+// for the consumer reading position 'pos' (sequence == pos + 1).
+// Producers claim positions with a compare-and-swap on _head. Only the
+// consumer writes _tail, so popping needs no read-modify-write.
+//
+// When the buffer is full, tryPush fails immediately and the
+// element is counted as dropped: producers never block.
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sail {
+
+template <typename T>
+class MpscRingBuffer {
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit MpscRingBuffer(size_t capacity)
+    : _cells(roundUpToPowerOfTwo(capacity)),
+      _mask(_cells.size() - 1), _head(0), _tail(0), _dropped(0) {
+    for (size_t i = 0; i < _cells.size(); i++) {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscRingBuffer(const MpscRingBuffer&) = delete;
+  MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+  size_t capacity() const { return _cells.size(); }
+
+  // Can be called from any thread.
+  bool tryPush(const T& x) {
+    size_t pos = _head.load(std::memory_order_relaxed);
+    Cell* cell = nullptr;
+    while (true) {
+      cell = &_cells[pos & _mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t dif = intptr_t(seq) - intptr_t(pos);
+      if (dif == 0) {
+        if (_head.compare_exchange_weak(
+            pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = x;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Must only be called from the consumer thread.
+  bool tryPop(T* dst) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    Cell& cell = _cells[tail & _mask];
+    size_t seq = cell.sequence.load(std::memory_order_acquire);
+    if (seq != tail + 1) {
+      return false;
+    }
+    *dst = cell.value;
+    cell.sequence.store(tail + _cells.size(), std::memory_order_release);
+    _tail.store(tail + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Pops at most maxCount elements into dst. Returns the number popped.
+  // Must only be called from the consumer thread.
+  size_t popBatch(T* dst, size_t maxCount) {
+    size_t n = 0;
+    while (n < maxCount && tryPop(dst + n)) {
+      n++;
+    }
+    return n;
+  }
+
+  // Number of elements rejected because the buffer was full.
+  uint64_t dropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+  // Approximate when producers are active.
+  size_t size() const {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    return head < tail? 0 : head - tail;
+  }
+ private:
+  static const size_t cacheLineSize = 64;
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t roundUpToPowerOfTwo(size_t n) {
+    size_t p = 2;
+    while (p < n) {
+      p *= 2;
+    }
+    return p;
+  }
+
+  std::vector<Cell> _cells;
+  const size_t _mask;
+
+  // Producers and the consumer write to different cache lines.
+  alignas(cacheLineSize) std::atomic<size_t> _head;
+  alignas(cacheLineSize) std::atomic<size_t> _tail;
+  alignas(cacheLineSize) std::atomic<uint64_t> _dropped;
+};
+
+}  // namespace sail
+
+#endif  // ANEMOBOX_MPSC_RING_BUFFER_H
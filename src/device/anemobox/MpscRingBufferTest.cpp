@@ -0,0 +1,66 @@
+#include <device/anemobox/MpscRingBuffer.h>
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace sail;
+
+TEST(MpscRingBufferTest, FifoAndOverflow) {
+  MpscRingBuffer<int> buffer(3);
+  EXPECT_EQ(4, buffer.capacity());
+
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(i < 4, buffer.tryPush(i));
+  }
+  EXPECT_EQ(2, buffer.dropped());
+  EXPECT_EQ(4, buffer.size());
+
+  int x = -1;
+  EXPECT_TRUE(buffer.tryPop(&x));
+  EXPECT_EQ(0, x);
+  EXPECT_TRUE(buffer.tryPush(4));
+
+  int batch[8];
+  EXPECT_EQ(4, buffer.popBatch(batch, 8));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(i + 1, batch[i]);
+  }
+  EXPECT_FALSE(buffer.tryPop(&x));
+}
+
+TEST(MpscRingBufferTest, ManyProducers) {
+  const int producerCount = 4;
+  const int perProducer = 100000;
+  MpscRingBuffer<int> buffer(64);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producerCount; p++) {
+    producers.push_back(std::thread([&buffer, p]() {
+      for (int i = 0; i < perProducer; i++) {
+        while (!buffer.tryPush(p*perProducer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+
+  // Values of every producer must arrive in order, and all of them.
+  std::vector<int> next(producerCount, 0);
+  int received = 0;
+  while (received < producerCount*perProducer) {
+    int x = 0;
+    if (buffer.tryPop(&x)) {
+      int p = x/perProducer;
+      EXPECT_EQ(next[p], x % perProducer);
+      next[p] = x % perProducer + 1;
+      received++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (auto& t: producers) {
+    t.join();
+  }
+  EXPECT_FALSE(buffer.tryPop(nullptr));
+}
@@ -29,10 +29,10 @@ inline GeographicPosition<double> getPos(const NmeaParser& parser) {
 }
 
 template <typename Handler>
-void Nmea0183ProcessByte(const std::string &sourceName,
-    unsigned char b, NmeaParser *parser, Handler *handler) {
+void Nmea0183HandleSentence(const std::string &sourceName,
+    NmeaParser::NmeaSentence sentence, NmeaParser *parser, Handler *handler) {
 
-  switch (parser->processByte(b)) {
+  switch (sentence) {
     // Nothing
     case NmeaParser::NMEA_NONE: break;
 
@@ -101,6 +101,25 @@ void Nmea0183ProcessByte(const std::string &sourceName,
   }
 }
 
+template <typename Handler>
+void Nmea0183ProcessByte(const std::string &sourceName,
+    unsigned char b, NmeaParser *parser, Handler *handler) {
+  Nmea0183HandleSentence(sourceName, parser->processByte(b), parser, handler);
+}
+
+// Much faster than calling Nmea0183ProcessByte on every byte.
+template <typename Handler>
+void Nmea0183ProcessBuffer(const std::string &sourceName,
+    const char *data, size_t n, NmeaParser *parser, Handler *handler) {
+  while (0 < n) {
+    NmeaParser::NmeaSentence sentence;
+    size_t consumed = parser->processBuffer(data, n, &sentence);
+    Nmea0183HandleSentence(sourceName, sentence, parser, handler);
+    data += consumed;
+    n -= consumed;
+  }
+}
+
 }
 
 
@@ -12,33 +12,39 @@ namespace {
 
   class DispatcherAdaptor {
    public:
-    DispatcherAdaptor(Dispatcher *d) : _dispatcher(d) {}
+    DispatcherAdaptor(SampleSink *sink, SourceId source)
+      : _sink(sink), _source(source) {}
 
+    // The source name passed by Nmea0183ProcessBuffer is always the one
+    // of the Nmea0183Source, so we publish with its id.
     template <DataCode Code>
-    void add(const std::string &sourceName, const typename TypeForCode<Code>::type &value) {
-      _dispatcher->publishValue(Code, sourceName, value);
+    void add(const std::string &, const typename TypeForCode<Code>::type &value) {
+      _sink->publishValue(Code, _source, value);
     }
 
     void setTimeOfDay(int, int, int) {}
    private:
-    Dispatcher *_dispatcher;
+    SampleSink *_sink;
+    SourceId _source;
   };
 
 }
 
 void Nmea0183Source::process(const unsigned char* buffer, int length) {
-  DispatcherAdaptor adaptor(_dispatcher);
-  for (ssize_t i = 0; i < length; ++i) {
-    Nmea0183ProcessByte<DispatcherAdaptor>(_sourceName, buffer[i],
-        this, &adaptor);
+  if (length <= 0) {
+    return;
   }
+  DispatcherAdaptor adaptor(&_sink, _sourceId);
+  Nmea0183ProcessBuffer<DispatcherAdaptor>(
+      _sourceName, reinterpret_cast<const char*>(buffer), length,
+      this, &adaptor);
 } 
 
 void Nmea0183Source::onRSA(const char *senderAndSentence,
                      Optional<sail::Angle<>> rudderAngle0,
                      Optional<sail::Angle<>> rudderAngle1) {
   if (rudderAngle0.defined()) {
-    _dispatcher->publishValue(RUDDER_ANGLE, _sourceName, rudderAngle0.get());
+    _sink.publishValue(RUDDER_ANGLE, _sourceId, rudderAngle0.get());
   }
 }
 
@@ -46,18 +52,18 @@ void Nmea0183Source::onXDRPitch(const char *senderAndSentence,
                                 bool valid,
                                 sail::Angle<double> angle) {
   if (valid) {
-    _dispatcher->publishValue(PITCH, _sourceName, angle);
+    _sink.publishValue(PITCH, _sourceId, angle);
   }
 }
 void Nmea0183Source::onXDRRoll(const char *senderAndSentence,
                                bool valid,
                                sail::Angle<double> angle) {
   if (valid) {
-    _dispatcher->publishValue(ROLL, _sourceName, angle);
+    _sink.publishValue(ROLL, _sourceId, angle);
   }
 }
 void Nmea0183Source::onHDM(const char *senderAndSentence, Angle<> angle) {
-  _dispatcher->publishValue(MAG_HEADING, _sourceName, angle);
+  _sink.publishValue(MAG_HEADING, _sourceId, angle);
 }
 
 }  // namespace sail
@@ -5,13 +5,16 @@
 
 #include <device/Arduino/libraries/NmeaParser/NmeaParser.h>
 #include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/IngestionQueue.h>
 
 namespace sail {
 
 class Nmea0183Source: public NmeaParser {
  public:
-  Nmea0183Source(Dispatcher *dispatcher, const std::string& sourceName)
-    : _dispatcher(dispatcher), _sourceName(sourceName) { }
+  // 'sink' is a Dispatcher or an IngestionQueue.
+  Nmea0183Source(SampleSink sink, const std::string& sourceName)
+    : _sink(sink), _sourceName(sourceName),
+      _sourceId(_sink.registerSource(sourceName)) { }
 
   const std::string& sourceName() const { return _sourceName; }
 
@@ -32,8 +35,9 @@ class Nmea0183Source: public NmeaParser {
   virtual void onHDM(const char *senderAndSentence,
                      Angle<double> angle);
  private:
-  Dispatcher *_dispatcher;
+  SampleSink _sink;
   std::string _sourceName;
+  SourceId _sourceId;
 };
 
 }  // namespace
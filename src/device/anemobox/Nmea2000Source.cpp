@@ -6,6 +6,10 @@ namespace sail {
 using namespace PgnClasses;
 
 namespace {
+  // Key of the derived starboard engine source, distinct from
+  // rudder instances that are in [0, 255].
+  const int starboardKey = -1;
+
   std::string makeDispatcherSourceName(uint64_t x) {
     // Here, we could do something much more user friendly than
     // printing an hex "name". The current implementation is compatible with
@@ -18,11 +22,11 @@ namespace {
 
 Nmea2000Source::Nmea2000Source(
     tNMEA2000* source,
-    Dispatcher *dispatcher)
+    SampleSink sink)
   : 
     tNMEA2000::tMsgHandler(0, source),
     _deviceList(source? new tN2kDeviceList(source) : nullptr),
-    _dispatcher(dispatcher) {
+    _sink(sink) {
   if (source == nullptr) {
     LOG(WARNING)
         << "You may have forgotten to "
@@ -69,9 +73,34 @@ std::string deviceNameToString(const Optional<uint64_t>& dn) {
 }
 
 
+SourceId Nmea2000Source::sourceIdFor(uint8_t shortName) {
+  uint64_t deviceName = getSourceName(shortName).get(
+      0 /* we dont know the nmea2000 name yet */);
+  CachedSourceId& cached = _sourceIds[shortName];
+  if (!cached.defined || cached.deviceName != deviceName) {
+    cached.defined = true;
+    cached.deviceName = deviceName;
+    cached.id = _sink.registerSource(
+        makeDispatcherSourceName(deviceName));
+  }
+  return cached.id;
+}
+
+template <typename Suffix>
+SourceId Nmea2000Source::derivedSourceId(
+    SourceId source, int key, Suffix suffix) {
+  auto found = _derivedSourceIds.find({source, key});
+  if (found == _derivedSourceIds.end()) {
+    SourceId id = _sink.registerSource(
+        _sink.sourceName(source) + suffix());
+    found = _derivedSourceIds.insert({{source, key}, id}).first;
+  }
+  return found->second;
+}
+
 void Nmea2000Source::HandleMsg(
     const tN2kMsg& msg) {
-  _lastSourceName = deviceNameToString(getSourceName(msg.Source));
+  _lastSourceId = sourceIdFor(msg.Source);
   visit(msg);
 }
 
@@ -80,10 +109,10 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::VesselHeading& pa
       || !packet.reference.defined()
       || !packet.heading.defined()) { return false; }
 
-  _dispatcher->publishValue(
+  _sink.publishValue(
       (packet.reference.get() == VesselHeading::Reference::Magnetic ?
         MAG_HEADING : GPS_BEARING),
-      _lastSourceName, packet.heading.get());
+      _lastSourceId, packet.heading.get());
 
   return true;
 }
@@ -93,8 +122,8 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::Speed& packet) {
 
 
   if (packet.speedWaterReferenced.defined()) {
-    _dispatcher->publishValue(WAT_SPEED, _lastSourceName,
-                              packet.speedWaterReferenced.get());
+    _sink.publishValue(WAT_SPEED, _lastSourceId,
+                       packet.speedWaterReferenced.get());
   }
   return true;
 }
@@ -103,13 +132,13 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::GnssPositionData&
   if (packet.hasSomeData()) {
     auto t = packet.timeStamp();
     if (t.defined()) {
-      _dispatcher->publishValue(DATE_TIME, _lastSourceName, t);
+      _sink.publishValue(DATE_TIME, _lastSourceId, t);
     }
 
     if (packet.longitude.defined() && packet.latitude.defined()
         && packet.altitude.defined()) {
-      _dispatcher->publishValue(GPS_POS,
-        _lastSourceName,
+      _sink.publishValue(GPS_POS,
+        _lastSourceId,
         GeographicPosition<double>(
             packet.longitude.get(), packet.latitude.get(),
           packet.altitude.get()));
@@ -143,12 +172,12 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::WindData& packet)
   }
 
   if (packet.windAngle.defined()) {
-    _dispatcher->publishValue(angleChannel, _lastSourceName,
-                              packet.windAngle.get());
+    _sink.publishValue(angleChannel, _lastSourceId,
+                       packet.windAngle.get());
   }
   if (packet.windSpeed.defined()) {
-    _dispatcher->publishValue(speedChannel, _lastSourceName,
-                              packet.windSpeed.get());
+    _sink.publishValue(speedChannel, _lastSourceId,
+                       packet.windSpeed.get());
   }
   return true;
 }
@@ -156,8 +185,8 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::WindData& packet)
 bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::PositionRapidUpdate& packet) {
   if (packet.hasSomeData()) {
     if (packet.longitude.defined() && packet.latitude.defined()) {
-      _dispatcher->publishValue(
-          GPS_POS, _lastSourceName,
+      _sink.publishValue(
+          GPS_POS, _lastSourceId,
           GeographicPosition<double>(
               packet.longitude.get(),
               packet.latitude.get()));
@@ -170,11 +199,11 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::PositionRapidUpda
 bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::CogSogRapidUpdate& packet) {
   if (packet.hasSomeData()) {
     if (packet.sog.defined()) {
-      _dispatcher->publishValue(GPS_SPEED, _lastSourceName, packet.sog.get());
+      _sink.publishValue(GPS_SPEED, _lastSourceId, packet.sog.get());
     }
     if (packet.cog.defined() && packet.cogReference.defined()
         && packet.cogReference.get() == CogSogRapidUpdate::CogReference::True) {
-      _dispatcher->publishValue(GPS_BEARING, _lastSourceName, packet.cog.get());
+      _sink.publishValue(GPS_BEARING, _lastSourceId, packet.cog.get());
     }
     return true;
   }
@@ -185,7 +214,7 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::TimeDate& packet)
   if (packet.hasSomeData()) {
     auto t = packet.timeStamp();
     if (t.defined()) {
-      _dispatcher->publishValue(DATE_TIME, _lastSourceName, t);
+      _sink.publishValue(DATE_TIME, _lastSourceId, t);
       return true;
     }
   }
@@ -196,7 +225,7 @@ bool Nmea2000Source::apply(const tN2kMsg& src, const SystemTime& packet) {
   if (packet.hasSomeData()) {
     auto t = packet.timeStamp();
     if (t.defined()) {
-      _dispatcher->publishValue(DATE_TIME, _lastSourceName, t);
+      _sink.publishValue(DATE_TIME, _lastSourceId, t);
       return true;
     }
   }
@@ -208,20 +237,20 @@ bool Nmea2000Source::apply(const tN2kMsg &c, const PgnClasses::DirectionData& pa
     if (packet.cog.defined() && packet.cogReference.defined()) {
       auto cog = packet.cog.get();
       if (packet.cogReference.get() == PgnClasses::DirectionData::CogReference::True) {
-        _dispatcher->publishValue(GPS_BEARING, _lastSourceName, cog);
+        _sink.publishValue(GPS_BEARING, _lastSourceId, cog);
       }
     }
 
     if (packet.speedThroughWater.defined()) {
-      _dispatcher->publishValue(WAT_SPEED, _lastSourceName, packet.speedThroughWater.get());
+      _sink.publishValue(WAT_SPEED, _lastSourceId, packet.speedThroughWater.get());
     }
 
     if (packet.sog.defined()) {
-      _dispatcher->publishValue(GPS_SPEED, _lastSourceName, packet.sog.get());
+      _sink.publishValue(GPS_SPEED, _lastSourceId, packet.sog.get());
     }
 
     if (packet.heading.defined()) {
-      _dispatcher->publishValue(MAG_HEADING/*?*/, _lastSourceName, packet.heading.get());
+      _sink.publishValue(MAG_HEADING/*?*/, _lastSourceId, packet.heading.get());
     }
 
     return true;
@@ -233,8 +262,11 @@ bool Nmea2000Source::apply(const tN2kMsg &c,
                            const PgnClasses::Rudder& packet) {
   if (packet.hasSomeData() && packet.instance.defined()) {
     if (packet.position.defined()) {
-      std::string source = _lastSourceName + " i" + std::to_string(packet.instance.get());
-      _dispatcher->publishValue(
+      int instance = packet.instance.get();
+      SourceId source = derivedSourceId(_lastSourceId, instance, [=]() {
+        return " i" + std::to_string(instance);
+      });
+      _sink.publishValue(
           RUDDER_ANGLE, source, packet.position.get());
     }
     return true;
@@ -252,16 +284,16 @@ bool Nmea2000Source::apply(const tN2kMsg &c,
     orient.roll = packet.roll.get();
     orient.pitch = packet.pitch.get();
 
-    _dispatcher->publishValue(ORIENT, _lastSourceName, orient);
+    _sink.publishValue(ORIENT, _lastSourceId, orient);
   } else {
     if (packet.yaw.defined()) {
-      _dispatcher->publishValue(YAW, _lastSourceName, packet.yaw.get());
+      _sink.publishValue(YAW, _lastSourceId, packet.yaw.get());
     }
     if (packet.pitch.defined()) {
-      _dispatcher->publishValue(PITCH, _lastSourceName, packet.pitch.get());
+      _sink.publishValue(PITCH, _lastSourceId, packet.pitch.get());
     }
     if (packet.roll.defined()) {
-      _dispatcher->publishValue(ROLL, _lastSourceName, packet.roll.get());
+      _sink.publishValue(ROLL, _lastSourceId, packet.roll.get());
     }
   }
   return true;
@@ -270,7 +302,7 @@ bool Nmea2000Source::apply(const tN2kMsg &c,
 bool Nmea2000Source::apply(const tN2kMsg &c,
                            const PgnClasses::RateOfTurn& packet) {
   if (packet.rate.defined()) {
-    _dispatcher->publishValue(RATE_OF_TURN, _lastSourceName, packet.rate.get());
+    _sink.publishValue(RATE_OF_TURN, _lastSourceId, packet.rate.get());
     return true;
   }
   return false;
@@ -279,12 +311,14 @@ bool Nmea2000Source::apply(const tN2kMsg &c,
 bool Nmea2000Source::apply(
     const tN2kMsg &c, const PgnClasses::EngineParametersRapidUpdate& packet) {
   if (packet.engineSpeed.defined()) {
-    std::string source = _lastSourceName;
+    SourceId source = _lastSourceId;
     if (packet.engineInstance.defined() && packet.engineInstance.get() ==
         EngineParametersRapidUpdate::EngineInstance::Dual_Engine_Starboard) {
-      source += " starboard";
+      source = derivedSourceId(source, starboardKey, []() {
+        return std::string(" starboard");
+      });
     }
-    _dispatcher->publishValue(ENGINE_RPM, source, packet.engineSpeed.get());
+    _sink.publishValue(ENGINE_RPM, source, packet.engineSpeed.get());
     return true;
   }
   return false;
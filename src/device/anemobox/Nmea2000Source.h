@@ -1,8 +1,11 @@
 #ifndef ANEMOBOX_NMEA2000_SOURCE_H
 #define ANEMOBOX_NMEA2000_SOURCE_H
 
+#include <map>
 #include <string>
+#include <utility>
 #include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/IngestionQueue.h>
 #include <device/anemobox/n2k/PgnClasses.h>
 #include <NMEA2000.h>
 #include <N2kDeviceList.h>
@@ -15,9 +18,10 @@ class Nmea2000Source :
     public PgnClasses::PgnVisitor,
     public tNMEA2000::tMsgHandler {
  public:
+  // 'sink' is a Dispatcher or an IngestionQueue.
   Nmea2000Source(
       tNMEA2000* source,
-      Dispatcher *dispatcher);
+      SampleSink sink);
 
   void HandleMsg(const tN2kMsg &N2kMsg) override;
 
@@ -51,9 +55,27 @@ class Nmea2000Source :
   bool apply(const tN2kMsg &c,
              const PgnClasses::EngineParametersRapidUpdate& packet) override; 
  private:
+  // Dispatcher source ids, cached per NMEA2000 source address. An entry
+  // is refreshed when the device name behind the address changes.
+  struct CachedSourceId {
+    bool defined = false;
+    uint64_t deviceName = 0;
+    SourceId id = 0;
+  };
+
+  SourceId sourceIdFor(uint8_t shortName);
+
+  // Id of a source named after a device source, e.g. one per rudder
+  // instance. 'key' identifies it among the sources derived from the
+  // same device, and 'suffix' is only called the first time.
+  template <typename Suffix>
+  SourceId derivedSourceId(SourceId source, int key, Suffix suffix);
+
   std::unique_ptr<tN2kDeviceList> _deviceList;
-  std::string _lastSourceName;
-  Dispatcher *_dispatcher;
+  CachedSourceId _sourceIds[256];
+  std::map<std::pair<SourceId, int>, SourceId> _derivedSourceIds;
+  SourceId _lastSourceId = 0;
+  SampleSink _sink;
 };
 
 }  // namespace
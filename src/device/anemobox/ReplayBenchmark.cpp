@@ -0,0 +1,72 @@
+// Measures how fast ReplayDispatcher replays samples while timeouts are
+// pending, as when SimulateBox runs the true wind estimator.
+//
+// Usage: anemobox_replayBenchmark [sampleCount] [timerCount]
+
+#include <device/anemobox/DispatcherUtils.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace sail;
+
+namespace {
+
+// A timer that sets itself again every time it fires.
+class PeriodicTimer {
+ public:
+  PeriodicTimer(ReplayDispatcher* dispatcher, double periodMS)
+    : _dispatcher(dispatcher), _periodMS(periodMS), _fired(0) {
+    _callback = [this]() {
+      _fired++;
+      _dispatcher->setTimeout(_callback, _periodMS);
+    };
+    _dispatcher->setTimeout(_callback, _periodMS);
+  }
+
+  int64_t fired() const { return _fired; }
+ private:
+  ReplayDispatcher* _dispatcher;
+  double _periodMS;
+  int64_t _fired;
+  std::function<void()> _callback;
+};
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+  int sampleCount = 1 < argc? atoi(argv[1]) : 1000000;
+  int timerCount = 2 < argc? atoi(argv[2]) : 1;
+
+  ReplayDispatcher dispatcher;
+  TimeStamp start = TimeStamp::UTC(2016, 5, 1, 12, 0, 0);
+  dispatcher.setCurrentTime(start);
+
+  // Estimator-like timers of 20 ms, and slower ones.
+  std::vector<std::unique_ptr<PeriodicTimer>> timers;
+  for (int i = 0; i < timerCount; i++) {
+    timers.push_back(std::unique_ptr<PeriodicTimer>(
+        new PeriodicTimer(&dispatcher, 20.0 + 10.0*i)));
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < sampleCount; i++) {
+    // 10 Hz
+    TimeStamp time = start + Duration<>::milliseconds(100*(i + 1));
+    dispatcher.publishTimedValue(AWA, "benchmark", TimedValue<Angle<double>>(
+        time, Angle<double>::degrees(i % 360)));
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  int64_t fired = 0;
+  for (const auto& timer: timers) {
+    fired += timer->fired();
+  }
+  double seconds = std::chrono::duration<double>(end - begin).count();
+  std::cout << sampleCount << " samples, " << timerCount << " timers, "
+    << fired << " timeouts fired in " << seconds << " s: "
+    << sampleCount/seconds << " samples/s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,181 @@
+#ifndef DEVICE_ANEMOBOX_TIMEDCOLUMNS_H_
+#define DEVICE_ANEMOBOX_TIMEDCOLUMNS_H_
+
+// Read-only views on a pair of dense columns: one column of times,
+// stored as int64 milliseconds since 1970, and one column of values.
+// This is the storage layout of TimedSampleCollection. Time searches
+// run on the time column alone, so they only touch a contiguous array
+// of integers.
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <server/common/TimedValue.h>
+
+namespace sail {
+
+// Index of the first element of times[0..n) that is not less than t.
+// The loop body has no data dependent branch: the compiler turns the
+// conditional into a cmov.
+inline size_t lowerBoundTime(const int64_t* times, size_t n, int64_t t) {
+  if (n == 0) {
+    return 0;
+  }
+  const int64_t* base = times;
+  while (n > 1) {
+    size_t half = n / 2;
+    base = (base[half] < t) ? base + half : base;
+    n -= half;
+  }
+  return (base - times) + (*base < t);
+}
+
+// Index of the first element of times[0..n) that is greater than t.
+inline size_t upperBoundTime(const int64_t* times, size_t n, int64_t t) {
+  if (n == 0) {
+    return 0;
+  }
+  const int64_t* base = times;
+  while (n > 1) {
+    size_t half = n / 2;
+    base = (base[half] <= t) ? base + half : base;
+    n -= half;
+  }
+  return (base - times) + (*base <= t);
+}
+
+// Random access iterator over a time column and a value column.
+// Dereferencing assembles a TimedValue<T> on the fly, so it returns
+// by value.
+template <typename T>
+class TimedColumnIterator {
+ public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef TimedValue<T> value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const TimedValue<T>* pointer;
+  typedef TimedValue<T> reference;
+  typedef TimedColumnIterator<T> ThisType;
+
+  // Makes it possible to write it->time
+  class Arrow {
+   public:
+    Arrow(const TimedValue<T>& x) : _x(x) {}
+    const TimedValue<T>* operator->() const { return &_x; }
+   private:
+    TimedValue<T> _x;
+  };
+
+  TimedColumnIterator() : _time(nullptr), _value(nullptr) {}
+  TimedColumnIterator(const int64_t* time, const T* value)
+    : _time(time), _value(value) {}
+
+  TimeStamp time() const {
+    return TimeStamp::fromMilliSecondsSince1970(*_time);
+  }
+  const T& value() const { return *_value; }
+
+  const int64_t* timePtr() const { return _time; }
+  const T* valuePtr() const { return _value; }
+
+  TimedValue<T> operator*() const { return TimedValue<T>(time(), *_value); }
+  Arrow operator->() const { return Arrow(**this); }
+  TimedValue<T> operator[](difference_type i) const { return *(*this + i); }
+
+  ThisType& operator++() { ++_time; ++_value; return *this; }
+  ThisType& operator--() { --_time; --_value; return *this; }
+  ThisType operator++(int) { ThisType x = *this; ++(*this); return x; }
+  ThisType operator--(int) { ThisType x = *this; --(*this); return x; }
+  ThisType& operator+=(difference_type i) {
+    _time += i;
+    _value += i;
+    return *this;
+  }
+  ThisType& operator-=(difference_type i) { return (*this) += -i; }
+  ThisType operator+(difference_type i) const { return ThisType(*this) += i; }
+  ThisType operator-(difference_type i) const { return ThisType(*this) -= i; }
+  difference_type operator-(const ThisType& other) const {
+    return _time - other._time;
+  }
+
+  bool operator==(const ThisType& other) const { return _time == other._time; }
+  bool operator!=(const ThisType& other) const { return _time != other._time; }
+  bool operator<(const ThisType& other) const { return _time < other._time; }
+  bool operator>(const ThisType& other) const { return _time > other._time; }
+  bool operator<=(const ThisType& other) const { return _time <= other._time; }
+  bool operator>=(const ThisType& other) const { return _time >= other._time; }
+ private:
+  const int64_t* _time;
+  const T* _value;
+};
+
+template <typename T>
+TimedColumnIterator<T> operator+(std::ptrdiff_t i,
+                                 const TimedColumnIterator<T>& it) {
+  return it + i;
+}
+
+// Index-free binary searches on a range of column iterators.
+template <typename T>
+TimedColumnIterator<T> lowerBound(TimedColumnIterator<T> begin,
+                                  TimedColumnIterator<T> end, TimeStamp t) {
+  return begin + lowerBoundTime(
+      begin.timePtr(), end - begin, t.toMilliSecondsSince1970());
+}
+
+template <typename T>
+TimedColumnIterator<T> upperBound(TimedColumnIterator<T> begin,
+                                  TimedColumnIterator<T> end, TimeStamp t) {
+  return begin + upperBoundTime(
+      begin.timePtr(), end - begin, t.toMilliSecondsSince1970());
+}
+
+// A non-owning view of n consecutive samples.
+template <typename T>
+class TimedColumns {
+ public:
+  typedef TimedColumnIterator<T> const_iterator;
+  typedef TimedValue<T> value_type;
+
+  TimedColumns() : _times(nullptr), _values(nullptr), _size(0) {}
+  TimedColumns(const int64_t* times, const T* values, size_t n)
+    : _times(times), _values(values), _size(n) {}
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  const_iterator begin() const { return const_iterator(_times, _values); }
+  const_iterator end() const { return begin() + _size; }
+
+  TimedValue<T> operator[](size_t i) const {
+    assert(i < _size);
+    return TimedValue<T>(time(i), _values[i]);
+  }
+  TimedValue<T> front() const { return (*this)[0]; }
+  TimedValue<T> back() const { return (*this)[_size - 1]; }
+
+  TimeStamp time(size_t i) const {
+    return TimeStamp::fromMilliSecondsSince1970(_times[i]);
+  }
+  const T& value(size_t i) const { return _values[i]; }
+
+  // Raw columns, for tight loops.
+  const int64_t* times() const { return _times; }
+  const T* values() const { return _values; }
+
+  const_iterator lowerBound(TimeStamp t) const {
+    return begin() + lowerBoundTime(_times, _size, t.toMilliSecondsSince1970());
+  }
+  const_iterator upperBound(TimeStamp t) const {
+    return begin() + upperBoundTime(_times, _size, t.toMilliSecondsSince1970());
+  }
+ private:
+  const int64_t* _times;
+  const T* _values;
+  size_t _size;
+};
+
+}  // namespace sail
+
+#endif  // DEVICE_ANEMOBOX_TIMEDCOLUMNS_H_
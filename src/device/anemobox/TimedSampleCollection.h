@@ -2,24 +2,44 @@
 #define NAUTICAL_TIMEDSAMPLECOLLECTION_H
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <deque>
+#include <device/anemobox/TimedColumns.h>
+#include <limits>
 #include <server/common/Optional.h>
 #include <server/common/TimeStamp.h>
 #include <server/common/TimedValue.h>
 #include <server/nautical/types/SampledSignal.h>
 #include <iostream>
+#include <vector>
 
 namespace sail {
 
+// Source of TimedSampleCollection::revision() numbers, unique over all
+// collections.
+inline uint64_t nextTimedSampleRevision() {
+  static std::atomic<uint64_t> counter(0);
+  return ++counter;
+}
+
+// Samples are stored column-wise: a dense column of int64 times in
+// milliseconds since 1970 and a parallel column of values. The first
+// _offset entries of the columns are dropped samples that have not been
+// compacted away yet (see append).
 template<typename T>
 class TimedSampleCollection : public SampledSignal<T> {
  public:
    typedef std::deque<TimedValue<T>> TimedVector;
+   typedef TimedColumns<T> Columns;
+   typedef typename Columns::const_iterator const_iterator;
 
    TimedSampleCollection(int maxBufferLength = 0)
-     : _maxBufferLength(maxBufferLength) { }
+     : _offset(0), _firstSerial(0), _revision(nextTimedSampleRevision()),
+       _maxBufferLength(maxBufferLength) { }
 
    TimedSampleCollection(const TimedVector& entries) :
+     _offset(0), _firstSerial(0), _revision(nextTimedSampleRevision()),
 
    /*
     *  This limit is chosen so that the BatchInsert test passes. But a natural
@@ -37,20 +57,33 @@ class TimedSampleCollection : public SampledSignal<T> {
    // to ensure that (i) no element inserted is older than any
    // element already in the collection and (ii) the elements
    // being inserted are chronologically ordered.
-   void insertAtFront(
-       typename TimedVector::const_iterator begin,
-       typename TimedVector::const_iterator end);
+   template <typename Iterator>
+   void insertAtFront(Iterator begin, Iterator end);
 
    // If inserting in chronological order, use append instead of insert.
    // Crashes or undefined behavior if x.time > lastTimeStamp
    void append(const TimedValue<T>& x);
    void append(TimeStamp t, T value) { append(TimedValue<T>(t, value)); }
 
-   const TimedVector& samples() const { return _samples; }
+   // Appends n samples given as columns, with times in milliseconds
+   // since 1970. As for append, the times must be sorted and not
+   // before lastTimeStamp().
+   void appendColumns(const int64_t* times, const T* values, size_t n);
+
+   // A view on the samples. It is invalidated by any
+   // call that modifies the collection.
+   Columns samples() const {
+     return Columns(_times.data() + _offset, _values.data() + _offset, size());
+   }
+
+   TimedVector toTimedVector() const {
+     auto s = samples();
+     return TimedVector(s.begin(), s.end());
+   }
 
-   const TimedValue<T>& back(int backIndex) const {
-     assert(backIndex >= 0 && size_t(backIndex) < _samples.size());
-     return _samples[_samples.size() - 1 - backIndex];
+   TimedValue<T> back(int backIndex) const {
+     assert(backIndex >= 0 && size_t(backIndex) < size());
+     return (*this)[size() - 1 - backIndex];
    }
 
    Optional<TimedValue<T> > nearestTimedValue(TimeStamp t) const;
@@ -64,58 +97,127 @@ class TimedSampleCollection : public SampledSignal<T> {
      trim();
    }
 
-   size_t size() const override { return _samples.size(); }
+   size_t size() const override { return _times.size() - _offset; }
 
    TimedValue<T> operator[](int i) const override {
-     return _samples[i];
+     return TimedValue<T>(
+         TimeStamp::fromMilliSecondsSince1970(_times[_offset + i]),
+         _values[_offset + i]);
    }
 
-   bool empty() const { return _samples.empty(); }
-   T lastValue() const { return _samples.back().value; }
-   TimeStamp lastTimeStamp() const { return _samples.back().time; }
+   bool empty() const { return size() == 0; }
+
+   // Samples can be tracked across appends and drops at the front by
+   // their serial numbers: samples()[i] has the serial number
+   // firstSerial() + i. Serial numbers stay valid as long as revision()
+   // is unchanged, which holds unless samples are inserted out of order,
+   // inserted at the front or cleared.
+   uint64_t firstSerial() const { return _firstSerial; }
+   uint64_t revision() const { return _revision; }
 
-   void clear() { _samples.clear(); }
+   T lastValue() const { return _values.back(); }
+   TimeStamp lastTimeStamp() const {
+     return TimeStamp::fromMilliSecondsSince1970(_times.back());
+   }
+
+   void clear() {
+     _times.clear();
+     _values.clear();
+     _offset = 0;
+     _revision = nextTimedSampleRevision();
+   }
 
  private:
   void trim();
-  TimedVector _samples;
+  void dropFront(size_t n);
+  void compact();
+  void assign(const std::vector<TimedValue<T>>& sorted);
+
+  std::vector<int64_t> _times;
+  std::vector<T> _values;
+  size_t _offset;
+  uint64_t _firstSerial;
+  uint64_t _revision;
 
   int _maxBufferLength;
 };
 
 template <typename T>
 void TimedSampleCollection<T>::append(const TimedValue<T>& x) {
-  if (_samples.size() > 0 && _samples.back().time > x.time) {
+  if (!empty() && lastTimeStamp() > x.time) {
     // TODO: Including <server/common/logging.h> causes
     // compilation error when this header is included together
     // with Ceres.
     std::cerr << "WARNING: "
       << "appending sample "
-      << (_samples.back().time - x.time).milliseconds()
+      << (lastTimeStamp() - x.time).milliseconds()
       << " ms in the future";
   }
-  if (_maxBufferLength > 0 && _samples.size() >= size_t(_maxBufferLength)) {
-    _samples.pop_front();
+  if (_maxBufferLength > 0 && size() >= size_t(_maxBufferLength)) {
+    dropFront(1);
   }
-  _samples.push_back(x);
+  _times.push_back(x.time.toMilliSecondsSince1970());
+  _values.push_back(x.value);
+}
+
+template <typename T>
+void TimedSampleCollection<T>::appendColumns(
+    const int64_t* times, const T* values, size_t n) {
+  assert(std::is_sorted(times, times + n));
+  assert(empty() || n == 0 || _times.back() <= times[0]);
+  compact();
+  _times.insert(_times.end(), times, times + n);
+  _values.insert(_values.end(), values, values + n);
+  trim();
 }
 
 template <typename T>
 void TimedSampleCollection<T>::insert(const TimedVector& entries) {
-  _samples.insert(_samples.end(), entries.begin(), entries.end());
-  sort(_samples.begin(), _samples.end());
+  bool inOrder = std::is_sorted(entries.begin(), entries.end())
+    && (empty() || entries.empty()
+        || !(entries.front().time < lastTimeStamp()));
+  if (inOrder) {
+    compact();
+    _times.reserve(_times.size() + entries.size());
+    _values.reserve(_values.size() + entries.size());
+    for (const auto& x: entries) {
+      _times.push_back(x.time.toMilliSecondsSince1970());
+      _values.push_back(x.value);
+    }
+  } else {
+    auto current = samples();
+    std::vector<TimedValue<T>> merged;
+    merged.reserve(current.size() + entries.size());
+    merged.insert(merged.end(), current.begin(), current.end());
+    merged.insert(merged.end(), entries.begin(), entries.end());
+    std::stable_sort(merged.begin(), merged.end());
+    assign(merged);
+  }
   trim();
 }
 
 template <typename T>
-void TimedSampleCollection<T>::insertAtFront(
-    typename TimedVector::const_iterator begin,
-    typename TimedVector::const_iterator end) {
+template <typename Iterator>
+void TimedSampleCollection<T>::insertAtFront(Iterator begin, Iterator end) {
   assert(std::is_sorted(begin, end));
   assert(implies(
-    0 < _samples.size() && begin < end,
-    *(end - 1) < *_samples.begin()));
-  _samples.insert(_samples.begin(), begin, end);
+    0 < size() && begin < end,
+    (*(end - 1)).time < (*this)[0].time));
+  compact();
+  std::vector<int64_t> times;
+  std::vector<T> values;
+  times.reserve(_times.size() + (end - begin));
+  values.reserve(_values.size() + (end - begin));
+  for (auto it = begin; it != end; ++it) {
+    auto x = *it;
+    times.push_back(x.time.toMilliSecondsSince1970());
+    values.push_back(x.value);
+  }
+  times.insert(times.end(), _times.begin(), _times.end());
+  values.insert(values.end(), _values.begin(), _values.end());
+  _times.swap(times);
+  _values.swap(values);
+  _revision = nextTimedSampleRevision();
 }
 
 
@@ -140,10 +242,30 @@ Optional<TimedValue<T> > findNearestTimedValue(Iterator begin, Iterator end, Tim
   return Optional<TimedValue<T> >(*it);
 }
 
+// Same as above, but searching only the time column.
+template <typename T>
+Optional<TimedValue<T> > findNearestTimedValue(
+    TimedColumnIterator<T> begin, TimedColumnIterator<T> end, TimeStamp t) {
+  size_t n = end - begin;
+  if (n == 0) {
+    return Optional<TimedValue<T> >();
+  }
+  const int64_t* times = begin.timePtr();
+  int64_t x = t.toMilliSecondsSince1970();
+  if (x < times[0] || times[n - 1] < x) {
+    return Optional<TimedValue<T> >();
+  }
+  size_t i = lowerBoundTime(times, n, x);
+  if (0 < i && x - times[i - 1] < times[i] - x) {
+    i--;
+  }
+  return Optional<TimedValue<T> >(begin[i]);
+}
+
 template <typename T>
 Optional<TimedValue<T> > TimedSampleCollection<T>::nearestTimedValue(TimeStamp t) const {
-  typedef typename TimedVector::const_iterator Iterator;
-  return findNearestTimedValue<T, Iterator>(_samples.begin(), _samples.end(), t);
+  auto s = samples();
+  return findNearestTimedValue<T>(s.begin(), s.end(), t);
 }
 
 
@@ -158,9 +280,44 @@ Optional<T> TimedSampleCollection<T>::nearest(TimeStamp t) const {
 
 template <typename T>
 void TimedSampleCollection<T>::trim() {
-  int toRemove = _samples.size() - _maxBufferLength;
+  int toRemove = size() - _maxBufferLength;
   if (toRemove > 0) {
-    _samples.erase(_samples.begin(), _samples.begin() + toRemove);
+    dropFront(toRemove);
+  }
+}
+
+// Dropping samples at the front only moves _offset. The columns are
+// compacted once the dropped prefix is as long as the live part, so that
+// a bounded collection that is appended to costs amortized O(1) per sample.
+template <typename T>
+void TimedSampleCollection<T>::dropFront(size_t n) {
+  assert(n <= size());
+  _offset += n;
+  _firstSerial += n;
+  if (size() <= _offset) {
+    compact();
+  }
+}
+
+template <typename T>
+void TimedSampleCollection<T>::compact() {
+  if (0 < _offset) {
+    _times.erase(_times.begin(), _times.begin() + _offset);
+    _values.erase(_values.begin(), _values.begin() + _offset);
+    _offset = 0;
+  }
+}
+
+template <typename T>
+void TimedSampleCollection<T>::assign(
+    const std::vector<TimedValue<T>>& sorted) {
+  _offset = 0;
+  _revision = nextTimedSampleRevision();
+  _times.resize(sorted.size());
+  _values.resize(sorted.size());
+  for (size_t i = 0; i < sorted.size(); i++) {
+    _times[i] = sorted[i].time.toMilliSecondsSince1970();
+    _values[i] = sorted[i].value;
   }
 }
 
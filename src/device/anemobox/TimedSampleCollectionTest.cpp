@@ -80,3 +80,53 @@ TEST(TimedSampleCollection, MaxBufferLength) {
   for (int i = 0; i < 20; ++i) { EXPECT_EQ(81 + i, samples.samples()[i].value); }
 }
 
+
+TEST(TimedSampleCollection, ColumnSearch) {
+  static auto rng = default_random_engine(3);
+  uniform_int_distribution<int64_t> dist(0, 100);
+  for (int n = 0; n < 40; n++) {
+    vector<int64_t> times(n);
+    for (auto &t: times) {
+      t = dist(rng);
+    }
+    sort(times.begin(), times.end());
+    for (int64_t t = -2; t < 103; t++) {
+      EXPECT_EQ(lower_bound(times.begin(), times.end(), t) - times.begin(),
+                lowerBoundTime(times.data(), n, t));
+      EXPECT_EQ(upper_bound(times.begin(), times.end(), t) - times.begin(),
+                upperBoundTime(times.data(), n, t));
+    }
+  }
+}
+
+TEST(TimedSampleCollection, BoundedAppend) {
+  TimedSampleCollection<int> samples(3);
+  TimeStamp base = TimeStamp::UTC(2016, 5, 1, 12, 0, 0);
+  for (int i = 0; i < 100; i++) {
+    samples.append(base + Duration<>::seconds(i), i);
+    EXPECT_EQ(std::min(i + 1, 3), samples.size());
+    EXPECT_EQ(i, samples.lastValue());
+  }
+  auto s = samples.samples();
+  EXPECT_EQ(97, s.front().value);
+  EXPECT_EQ(base + Duration<>::seconds(97), s.front().time);
+  EXPECT_EQ(99, s.back().value);
+  EXPECT_EQ(98, samples.nearest(base + Duration<>::seconds(98.3))());
+  EXPECT_EQ(s.begin() + 1, s.lowerBound(base + Duration<>::seconds(97.5)));
+}
+
+TEST(TimedSampleCollection, Serials) {
+  TimedSampleCollection<int> samples(3);
+  TimeStamp base = TimeStamp::UTC(2016, 5, 1, 12, 0, 0);
+  uint64_t revision = samples.revision();
+  for (int i = 0; i < 10; i++) {
+    samples.append(base + Duration<>::seconds(i), i);
+  }
+  EXPECT_EQ(7, samples.firstSerial());
+  EXPECT_EQ(revision, samples.revision());
+
+  TimedSampleCollection<int>::TimedVector late;
+  late.push_back(TimedValue<int>(base + Duration<>::seconds(8.5), 100));
+  samples.insert(late);
+  EXPECT_NE(revision, samples.revision());
+}
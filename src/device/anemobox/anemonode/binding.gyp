@@ -48,9 +48,14 @@
         "../Nmea0183Source.h",
         "../Nmea2000Source.cpp",
         "../Nmea2000Source.h",
+        "../IngestionQueue.cpp",
+        "../IngestionQueue.h",
+        "../MpscRingBuffer.h",
         "../ValueDispatcher.h",
         "../logger/Logger.h",
         "../logger/Logger.cpp",
+        "../logger/LogBlockFile.h",
+        "../logger/LogBlockFile.cpp",
         "../n2k/BitStream.cpp",
         "../n2k/BitStream.h",
         "../n2k/N2kField.cpp",
@@ -10,15 +10,23 @@ namespace {
 
 class FlushWorker : public Nan::AsyncWorker {
  public:
-  FlushWorker(Nan::Callback *callback, std::string filename)
+  // With 'blocks', the buffer is appended to a block-indexed file, see
+  // LogBlockFile.h. Otherwise it is saved as a gzipped LogFile.
+  FlushWorker(Nan::Callback *callback, std::string filename, LogBufferPtr data,
+              bool blocks)
     : Nan::AsyncWorker(callback),
+      _data(std::move(data)),
+      _blocks(blocks),
       _result(false),
       _filename(filename) { }
 
-  LogFile* dataContainer() { return &_data; }
-
+  // Serializing, compressing and releasing the buffer all happen
+  // here, outside of the main thread.
   void Execute () {
-    _result = Logger::save(_filename, _data);
+    _result = _blocks?
+      Logger::appendBlocks(_filename, _data->data())
+      : Logger::save(_filename, _data->data());
+    _data.reset();
   }
 
   void HandleOKCallback() {
@@ -27,8 +35,9 @@ class FlushWorker : public Nan::AsyncWorker {
 
     argv[0] = Nan::New(_filename).ToLocalChecked();
     if (!_result) {
-      argv[1] = Nan::New("Logger::save failed to write " 
-			 + _filename).ToLocalChecked();
+      argv[1] = Nan::New(std::string(_blocks?
+            "Logger::appendBlocks" : "Logger::save")
+          + " failed to write " + _filename).ToLocalChecked();
     } else {
       argv[1] = Nan::Undefined();
     }
@@ -37,7 +46,8 @@ class FlushWorker : public Nan::AsyncWorker {
   }
 
  private:
-  LogFile _data;
+  LogBufferPtr _data;
+  bool _blocks;
   bool _result;
   std::string _filename;
 };
@@ -59,6 +69,7 @@ void JsLogger::Init(v8::Handle<v8::Object> target) {
   // Prototype
   Local<ObjectTemplate> proto = tpl->PrototypeTemplate();
   Nan::SetMethod(proto, "flush", JsLogger::flush);
+  Nan::SetMethod(proto, "appendBlocks", JsLogger::appendBlocks);
   Nan::SetMethod(proto, "logText", JsLogger::logText);
   Nan::SetMethod(proto, "logRawNmea2000", 
 		  JsLogger::logRawNmea2000);
@@ -95,8 +106,30 @@ NAN_METHOD(JsLogger::flush) {
 
   v8::String::Utf8Value filename(info[0]->ToString());
   Nan::Callback *callback = new Nan::Callback(info[1].As<Function>());
-  FlushWorker* worker = new FlushWorker(callback, *filename);
-  obj->_logger.flushTo(worker->dataContainer());
+  FlushWorker* worker = new FlushWorker(
+      callback, *filename, obj->_logger.swapBuffer(), false);
+
+  Nan::AsyncQueueWorker(worker);
+  return;
+}
+
+// Like flush, but appends to a block-indexed log file instead of
+// writing a new gzipped one. Only for readers that know that format.
+NAN_METHOD(JsLogger::appendBlocks) {
+  Nan::HandleScope scope;
+  GET_TYPED_THIS(JsLogger, obj);
+
+  if (info.Length() < 2 || !info[0]->IsString() || !info[1]->IsFunction()) {
+    Nan::ThrowTypeError(
+        "Bad arguments. "
+        "Usage: appendBlocks('path', function(writtenFilename, error) {})");
+    return;
+  }
+
+  v8::String::Utf8Value filename(info[0]->ToString());
+  Nan::Callback *callback = new Nan::Callback(info[1].As<Function>());
+  FlushWorker* worker = new FlushWorker(
+      callback, *filename, obj->_logger.swapBuffer(), true);
 
   Nan::AsyncQueueWorker(worker);
   return;
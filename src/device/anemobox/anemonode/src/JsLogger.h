@@ -17,6 +17,7 @@ class JsLogger : public Nan::ObjectWrap {
  protected:
   static NAN_METHOD(New);
   static NAN_METHOD(flush);
+  static NAN_METHOD(appendBlocks);
   static NAN_METHOD(logText);
   static NAN_METHOD(logRawNmea2000);
 
@@ -0,0 +1,436 @@
+#include <device/anemobox/logger/LogBlockFile.h>
+#include <device/anemobox/logger/Logger.h>
+#include <server/common/logging.h>
+
+#include <algorithm>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace boost::iostreams;
+
+namespace sail {
+
+namespace {
+
+  const char kFileMagic[] = "ANMLOG02";
+  const char kIndexMagic[] = "ANMIDX02";
+  const int kMagicSize = 8;
+
+  // Index size and magic
+  const int kTrailerSize = 8 + kMagicSize;
+
+  struct TimeRange {
+    bool defined = false;
+    int64_t minTime = 0;
+    int64_t maxTime = 0;
+
+    void extend(const std::vector<TimeStamp>& times) {
+      for (auto t: times) {
+        int64_t x = t.toMilliSecondsSince1970();
+        minTime = defined? std::min(minTime, x) : x;
+        maxTime = defined? std::max(maxTime, x) : x;
+        defined = true;
+      }
+    }
+  };
+
+  TimeRange timeRange(const ValueSet& stream) {
+    std::vector<TimeStamp> times;
+    Logger::unpackTime(stream, &times);
+    TimeRange range;
+    range.extend(times);
+    return range;
+  }
+
+  bool overlaps(const LogBlockSelection& selection, int64_t minTime,
+                int64_t maxTime) {
+    return (!selection.from.defined()
+            || selection.from.toMilliSecondsSince1970() <= maxTime)
+      && (!selection.to.defined()
+          || minTime <= selection.to.toMilliSecondsSince1970());
+  }
+
+  bool anyIn(const google::protobuf::RepeatedPtrField<std::string>& names,
+             const std::set<std::string>& wanted) {
+    if (wanted.empty()) {
+      return true;
+    }
+    for (const auto& name: names) {
+      if (wanted.count(name) > 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void writeUint64(uint64_t x, std::ostream* dst) {
+    char bytes[8];
+    for (int i = 0; i < 8; i++) {
+      bytes[i] = char((x >> (8*i)) & 0xff);
+    }
+    dst->write(bytes, 8);
+  }
+
+  uint64_t readUint64(const char* bytes) {
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++) {
+      x |= uint64_t(uint8_t(bytes[i])) << (8*i);
+    }
+    return x;
+  }
+
+  std::string compress(const std::string& data) {
+    std::string dst;
+    {
+      filtering_ostream out;
+      out.push(gzip_compressor(9));
+      out.push(boost::iostreams::back_inserter(dst));
+      out.write(data.data(), data.size());
+    }
+    return dst;
+  }
+
+  bool decompress(const std::string& data, std::string* dst) {
+    try {
+      filtering_istream in;
+      in.push(gzip_decompressor());
+      in.push(array_source(data.data(), data.size()));
+      dst->clear();
+      boost::iostreams::copy(in, boost::iostreams::back_inserter(*dst));
+      return true;
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Failed to decompress log block: " << e.what();
+      return false;
+    }
+  }
+
+  // A LogFile with the metadata of another one, to hold a single block.
+  LogFile emptyBlock(const LogFile& data) {
+    LogFile block(data);
+    block.clear_stream();
+    block.clear_text();
+    block.clear_rawnmea2000();
+    return block;
+  }
+
+  void setTimeRange(const TimeRange& range, LogBlockInfo* info) {
+    if (range.defined) {
+      info->set_mintime(range.minTime);
+      info->set_maxtime(range.maxTime);
+    }
+  }
+
+  // Reads the index of the segment ending at 'end', without the
+  // indices of the previous segments.
+  bool readSegmentIndex(std::istream* file, int64_t end,
+                        LogBlockIndex* dst) {
+    if (end < kMagicSize + kTrailerSize) {
+      return false;
+    }
+    char trailer[kTrailerSize];
+    file->clear();
+    file->seekg(end - kTrailerSize, std::ios::beg);
+    if (!file->read(trailer, kTrailerSize)
+        || memcmp(trailer + 8, kIndexMagic, kMagicSize) != 0) {
+      return false;
+    }
+    int64_t indexSize = readUint64(trailer);
+    int64_t indexOffset = end - kTrailerSize - indexSize;
+    if (indexSize < 0 || indexOffset < kMagicSize) {
+      return false;
+    }
+
+    std::string bytes(indexSize, '\0');
+    file->seekg(indexOffset, std::ios::beg);
+    if (!file->read(&bytes[0], indexSize) || !dst->ParseFromString(bytes)) {
+      return false;
+    }
+
+    // The blocks and the previous segment are all before the index.
+    int64_t segmentBegin = dst->has_previousend()?
+      dst->previousend() : kMagicSize;
+    if (segmentBegin < kMagicSize || indexOffset < segmentBegin) {
+      return false;
+    }
+    for (const auto& info: dst->block()) {
+      if (info.offset() < segmentBegin || info.size() < 0
+          || indexOffset < info.offset() + info.size()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Reads the indices of the segment ending at 'end' and of all
+  // segments before it, with the blocks in file order.
+  bool readSegments(std::istream* file, int64_t end, LogBlockIndex* dst) {
+    std::vector<LogBlockIndex> segments;
+    while (true) {
+      segments.push_back(LogBlockIndex());
+      if (!readSegmentIndex(file, end, &segments.back())) {
+        return false;
+      }
+      if (!segments.back().has_previousend()) {
+        break;
+      }
+      end = segments.back().previousend();
+    }
+    dst->Clear();
+    for (auto segment = segments.rbegin(); segment != segments.rend();
+         ++segment) {
+      for (auto& info: *segment->mutable_block()) {
+        dst->add_block()->Swap(&info);
+      }
+    }
+    return true;
+  }
+
+  // Reads the index of all blocks, and where the last complete segment
+  // ends. If the file ends with an incomplete segment, because an append
+  // was interrupted, the segments before it are recovered.
+  bool readIndex(std::istream* file, LogBlockIndex* dst, int64_t* end) {
+    char magic[kMagicSize];
+    file->clear();
+    file->seekg(0, std::ios::end);
+    int64_t fileSize = file->tellg();
+    file->seekg(0, std::ios::beg);
+    if (fileSize < kMagicSize
+        || !file->read(magic, kMagicSize)
+        || memcmp(magic, kFileMagic, kMagicSize) != 0) {
+      return false;
+    }
+    if (readSegments(file, fileSize, dst)) {
+      *end = fileSize;
+      return true;
+    }
+
+    LOG(WARNING) << "The log block file ends with an incomplete append, "
+      "recovering the blocks written before it";
+    std::string bytes(fileSize, '\0');
+    file->clear();
+    file->seekg(0, std::ios::beg);
+    if (!file->read(&bytes[0], fileSize)) {
+      return false;
+    }
+    size_t pos = bytes.size();
+    while (kMagicSize < pos) {
+      pos = bytes.rfind(kIndexMagic, pos - 1, kMagicSize);
+      if (pos == std::string::npos) {
+        break;
+      }
+      if (readSegments(file, pos + kMagicSize, dst)) {
+        *end = pos + kMagicSize;
+        return true;
+      }
+    }
+    LOG(WARNING) << "No complete segment in the log block file";
+    dst->Clear();
+    *end = kMagicSize;
+    return true;
+  }
+
+  bool writeAll(int fd, const std::string& bytes) {
+    size_t written = 0;
+    while (written < bytes.size()) {
+      ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      written += n;
+    }
+    return true;
+  }
+
+}  // namespace
+
+bool LogBlockSelection::includes(const LogBlockInfo& block) const {
+  if (block.rawnmea2000()) {
+    if (!includeRawNmea2000) {
+      return false;
+    }
+  } else if (!anyIn(block.shortname(), shortNames)
+             || !anyIn(block.source(), sources)) {
+    return false;
+  }
+  if (!block.has_mintime()) {
+    return !from.defined() && !to.defined();
+  }
+  return overlaps(*this, block.mintime(), block.maxtime());
+}
+
+bool LogBlockSelection::includes(const ValueSet& stream) const {
+  LogBlockInfo info;
+  info.add_shortname(stream.shortname());
+  info.add_source(stream.source());
+  setTimeRange(timeRange(stream), &info);
+  return includes(info);
+}
+
+bool isLogBlockFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  return isLogBlockFile(&file);
+}
+
+bool isLogBlockFile(std::istream* file) {
+  char magic[kMagicSize];
+  bool result = file->read(magic, kMagicSize)
+    && memcmp(magic, kFileMagic, kMagicSize) == 0;
+  file->clear();
+  file->seekg(0, std::ios::beg);
+  return result;
+}
+
+bool mayBeLogBlockFile(int firstByte) {
+  return firstByte == kFileMagic[0];
+}
+
+bool appendLogBlocks(const std::string& filename, const LogFile& data) {
+  LogBlockIndex previous;
+  int64_t previousEnd = 0;
+  {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    // An empty file is what an append interrupted right after creating
+    // the file leaves behind.
+    bool empty = file.peek() == std::ifstream::traits_type::eof();
+    if (file.is_open() && !empty
+        && !readIndex(&file, &previous, &previousEnd)) {
+      LOG(ERROR) << filename << " is not a block-indexed log file";
+      return false;
+    }
+  }
+
+  // Opened for appending, so that nothing already in the file is
+  // overwritten, whatever happens during this call.
+  int fd = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open " << filename << ": " << strerror(errno);
+    return false;
+  }
+  int64_t fileSize = ::lseek(fd, 0, SEEK_END);
+
+  std::string blocks;
+  int64_t offset = fileSize;
+  if (fileSize == 0) {
+    blocks.append(kFileMagic, kMagicSize);
+    offset = kMagicSize;
+  }
+
+  LogBlockIndex index;
+  if (0 < previousEnd) {
+    index.set_previousend(previousEnd);
+  }
+  auto writeBlock = [&](const LogFile& block, LogBlockInfo* info) {
+    std::string bytes = compress(block.SerializeAsString());
+    info->set_offset(offset);
+    info->set_size(bytes.size());
+    blocks.append(bytes);
+    offset += bytes.size();
+  };
+
+  for (const auto& stream: data.stream()) {
+    LogFile block = emptyBlock(data);
+    *block.add_stream() = stream;
+    LogBlockInfo* info = index.add_block();
+    info->add_shortname(stream.shortname());
+    info->add_source(stream.source());
+    setTimeRange(timeRange(stream), info);
+    writeBlock(block, info);
+  }
+  for (const auto& text: data.text()) {
+    LogFile block = emptyBlock(data);
+    *block.add_text() = text;
+    LogBlockInfo* info = index.add_block();
+    info->add_shortname(text.shortname());
+    info->add_source(text.source());
+    setTimeRange(timeRange(text), info);
+    writeBlock(block, info);
+  }
+  if (data.rawnmea2000_size() > 0) {
+    LogFile block = emptyBlock(data);
+    *block.mutable_rawnmea2000() = data.rawnmea2000();
+    LogBlockInfo* info = index.add_block();
+    info->set_rawnmea2000(true);
+    TimeRange range;
+    for (const auto& sentences: data.rawnmea2000()) {
+      std::vector<TimeStamp> times;
+      Logger::unpackTime(sentences, &times);
+      range.extend(times);
+    }
+    setTimeRange(range, info);
+    writeBlock(block, info);
+  }
+
+  std::stringstream trailer;
+  std::string indexBytes = index.SerializeAsString();
+  trailer.write(indexBytes.data(), indexBytes.size());
+  writeUint64(indexBytes.size(), &trailer);
+  trailer.write(kIndexMagic, kMagicSize);
+
+  // The blocks reach the disk before the index that refers to them.
+  bool success = writeAll(fd, blocks) && ::fsync(fd) == 0
+    && writeAll(fd, trailer.str()) && ::fsync(fd) == 0;
+  if (!success) {
+    LOG(ERROR) << "Failed to append log blocks to " << filename << ": "
+      << strerror(errno);
+  }
+  return ::close(fd) == 0 && success;
+}
+
+bool readLogBlockIndex(const std::string& filename, LogBlockIndex* dst) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  int64_t end = 0;
+  return readIndex(&file, dst, &end);
+}
+
+bool readLogBlocks(const std::string& filename,
+                   const LogBlockSelection& selection,
+                   LogFile* dst) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!readLogBlocks(&file, selection, dst)) {
+    LOG(ERROR) << filename << ": failed to read log blocks";
+    return false;
+  }
+  return true;
+}
+
+bool readLogBlocks(std::istream* file,
+                   const LogBlockSelection& selection,
+                   LogFile* dst) {
+  LogBlockIndex index;
+  int64_t end = 0;
+  if (!readIndex(file, &index, &end)) {
+    return false;
+  }
+
+  std::string compressed, bytes;
+  for (const auto& info: index.block()) {
+    if (!selection.includes(info)) {
+      continue;
+    }
+    compressed.resize(info.size());
+    file->seekg(info.offset(), std::ios::beg);
+    LogFile block;
+    if (!file->read(&compressed[0], info.size())
+        || !decompress(compressed, &bytes)
+        || !block.ParseFromString(bytes)) {
+      LOG(ERROR) << "Failed to read the log block at " << info.offset();
+      return false;
+    }
+    dst->MergeFrom(block);
+  }
+  return true;
+}
+
+}  // namespace sail
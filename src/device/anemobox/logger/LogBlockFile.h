@@ -0,0 +1,72 @@
+#ifndef ANEMOBOX_LOGBLOCKFILE_H
+#define ANEMOBOX_LOGBLOCKFILE_H
+
+// Block-indexed log files (version 2).
+//
+// Instead of a single gzipped LogFile, the data is stored as a sequence
+// of independently gzipped blocks, each holding one stream, one text
+// stream or the raw NMEA 2000 sentences of a flushed LogFile. Every
+// append ends with an index that tells the time range, shortNames and
+// sources of its blocks, so that a reader only needs to inflate the
+// blocks it is interested in. See LogBlockIndex in logger.proto for
+// the layout.
+
+#include <device/anemobox/logger/logger.pb.h>
+#include <server/common/TimeStamp.h>
+#include <iosfwd>
+#include <set>
+#include <string>
+
+namespace sail {
+
+// Which blocks to read. The default selects everything.
+struct LogBlockSelection {
+  // Blocks with no values in [from, to] are skipped. The times are the
+  // stored timestampssinceboot, before any correction from external time.
+  // An undefined bound is open.
+  TimeStamp from, to;
+
+  // If not empty, only streams with one of these shortNames or sources
+  // are read.
+  std::set<std::string> shortNames;
+  std::set<std::string> sources;
+
+  bool includeRawNmea2000 = true;
+
+  bool includes(const LogBlockInfo& block) const;
+  bool includes(const ValueSet& stream) const;
+};
+
+// True if the file starts like a block-indexed log file.
+bool isLogBlockFile(const std::string& filename);
+
+// The same for a seekable stream, which is left at its beginning.
+bool isLogBlockFile(std::istream* file);
+
+// False if a file starting with this byte, or EOF, cannot be a
+// block-indexed log file. Gzipped log files always start with 0x1f, so
+// this tells the formats apart with one byte of lookahead.
+bool mayBeLogBlockFile(int firstByte);
+
+// Appends the content of a LogFile as new blocks, creating the file
+// if it does not exist. The file is only ever appended to, and the
+// blocks are synced to disk before their index, so an interrupted
+// append loses at most the data of that append.
+bool appendLogBlocks(const std::string& filename, const LogFile& data);
+
+bool readLogBlockIndex(const std::string& filename, LogBlockIndex* dst);
+
+// Reads the selected blocks and merges them into dst. Streams are
+// selected as a whole, so they can contain values outside [from, to].
+bool readLogBlocks(const std::string& filename,
+                   const LogBlockSelection& selection,
+                   LogFile* dst);
+
+// The same for a seekable stream, holding the file from its beginning.
+bool readLogBlocks(std::istream* file,
+                   const LogBlockSelection& selection,
+                   LogFile* dst);
+
+}  // namespace sail
+
+#endif  // ANEMOBOX_LOGBLOCKFILE_H
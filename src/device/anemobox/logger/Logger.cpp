@@ -5,6 +5,8 @@
 #include <server/common/logging.h>
 
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <boost/iostreams/device/file.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -67,31 +69,43 @@ void addTimeStampToRepeatedFields(
 }
 
 
+LogBuffer::LogBuffer(std::int64_t generation)
+  : _data(google::protobuf::Arena::CreateMessage<LogFile>(&_arena)),
+    _generation(generation) {
+  auto bc = getBootCount();
+  if (bc.defined()) {
+    _data->set_bootcount(bc.get());
+  }
+}
+
 void Nmea2000SentenceAccumulator::add(
     const TimeStamp& time,
     int64_t id, size_t count, const char* data) {
   auto sc = getNmea2000SizeClass(count);
-  if (_data.has_sentence_id()) {
-    CHECK(_data.sentence_id() == id);
-    CHECK(_sizeClass == sc);
-  } else {
-    _data.set_sentence_id(id);
+  LogBuffer* buffer = _buffer->get();
+  if (_data == nullptr || _generation != buffer->generation()) {
+    _data = buffer->mutableData()->add_rawnmea2000();
+    _data->set_sentence_id(id);
     _sizeClass = sc;
+    _generation = buffer->generation();
+  } else {
+    CHECK(_data->sentence_id() == id);
+    CHECK(_sizeClass == sc);
   }
   addTimeStampToRepeatedFields(
-        &timestampBase, _data.mutable_timestampssinceboot(),
+        &timestampBase, _data->mutable_timestampssinceboot(),
         time);
   if (sc == Nmea2000SizeClass::Odd) {
-    _data.add_oddsizesentences(std::string(data, count));
+    _data->add_oddsizesentences(std::string(data, count));
   } else {
-    _data.add_regularsizesentences(
+    _data->add_regularsizesentences(
         *reinterpret_cast<const ::google::protobuf::uint64*>(data));
   }
 
 }
 
 Logger::Logger(Dispatcher* dispatcher) :
-    _dispatcher(dispatcher) {
+    _dispatcher(dispatcher), _buffer(new LogBuffer(1)) {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
   _newDispatchDataListener = dispatcher->newDispatchData.connect(
       [=](DispatchData* ptr) { this->subscribeToDispatcher(ptr); });
@@ -106,10 +120,6 @@ namespace {
       x.timestamps()
       : x.timestampssinceboot();
   }
-
-  bool hasTimeStamps(const ValueSet &x) {
-    return getBestKnownTimeStamps(x).size() > 0;
-  }
 }
 
 
@@ -120,45 +130,31 @@ bool empty(const LogFile& container) {
         && container.rawnmea2000_size() == 0;
 }
 
-void Logger::flushTo(LogFile* container) {
-  // Clear content.
-  *container = LogFile();
-
-  {
-    auto bc = getBootCount();
-    if (bc.defined()) {
-      container->set_bootcount(bc.get());
-    }
-  }
- 
-  for (auto ptr : _listeners) {
-    if (hasTimeStamps(ptr->valueSet())) {
-      // the priority is set every time flushTo is called, since the 
-      // priority in the dispatcher can change.
-      // We do not log exactly when the priority changed, though.
-      // Thus, it is wise to flush right before changing a priority.
-      ptr->setPriority(_dispatcher);
-      container->add_stream()->Swap(ptr->mutable_valueSet());
-    }
-    ptr->clear();
-  }
-  for (auto it = _textLoggers.begin();  it != _textLoggers.end(); ++it) {
-    if (hasTimeStamps(it->second.valueSet())) {
-      container->add_text()->Swap(it->second.mutable_valueSet());
+LogBufferPtr Logger::swapBuffer() {
+  LogBufferPtr full(new LogBuffer(_buffer->generation() + 1));
+  full.swap(_buffer);
+
+  // the priority is set every time the buffer is swapped, since the
+  // priority in the dispatcher can change.
+  // We do not log exactly when the priority changed, though.
+  // Thus, it is wise to flush right before changing a priority.
+  for (auto& stream: *full->mutableData()->mutable_stream()) {
+    int priority = _dispatcher->sourcePriority(stream.source());
+    if (priority != 0) {
+      stream.set_priority(priority);
     }
-    it->second.clear();
   }
-  for (auto& kv: _rawNmea2000Sentences) {
-    container->add_rawnmea2000()->Swap(kv.second.mutableData());
-  }
-  _rawNmea2000Sentences.clear();
+  return full;
+}
+
+void Logger::flushTo(LogFile* container) {
+  container->Swap(swapBuffer()->mutableData());
 }
 
 
 bool Logger::flushAndSaveToFile(const std::string& filename) {
-  LogFile container;
-
-  flushTo(&container);
+  LogBufferPtr buffer = swapBuffer();
+  const LogFile& container = buffer->data();
 
   if (empty(container)) {
     return false;
@@ -183,7 +179,7 @@ void Logger::subscribe() {
 
 void Logger::subscribeToDispatcher(DispatchData *d) {
   LoggerValueListener* listener =
-    new LoggerValueListener(d->wordIdentifier(), d->source());
+    new LoggerValueListener(d->wordIdentifier(), d->source(), &_buffer);
   SubscribeVisitor<LoggerValueListener> subscriber(listener);
   d->visit(&subscriber);
 
@@ -196,7 +192,8 @@ void Logger::logText(
   auto it = _textLoggers.find(streamName);
   if (it == _textLoggers.end()) {
     it = _textLoggers.insert(
-        make_pair(streamName, LoggerValueListener("text", streamName))).first;
+        make_pair(streamName,
+                  LoggerValueListener("text", streamName, &_buffer, true))).first;
   }
   it->second.addText(
       _dispatcher->currentTime(), content);
@@ -209,11 +206,27 @@ bool Logger::save(const std::string& filename, const LogFile& data) {
   return data.SerializeToOstream(&out);
 }
 
-bool Logger::read(const std::string& filename, LogFile *dst) {
-    ifstream file(filename, ios_base::in | ios_base::binary);
+bool Logger::appendBlocks(const std::string& filename, const LogFile& data) {
+  return appendLogBlocks(filename, data);
+}
+
+namespace {
+  void keepSelected(const LogBlockSelection& selection,
+                    google::protobuf::RepeatedPtrField<ValueSet>* streams) {
+    google::protobuf::RepeatedPtrField<ValueSet> kept;
+    for (auto& stream: *streams) {
+      if (selection.includes(stream)) {
+        kept.Add()->Swap(&stream);
+      }
+    }
+    streams->Swap(&kept);
+  }
+
+  // Reads a whole LogFile in the old, gzipped format.
+  bool readGzipped(std::istream* file, LogFile *dst) {
     filtering_istream in;
     in.push(gzip_decompressor());
-    in.push(file);
+    in.push(*file);
     google::protobuf::io::IstreamInputStream zero_copy_input(&in);
     google::protobuf::io::CodedInputStream decoder(&zero_copy_input);
     // By default, google protobufs have a limit of about 60MB.
@@ -223,6 +236,52 @@ bool Logger::read(const std::string& filename, LogFile *dst) {
     // to 500MB, with a warning at 400.
     decoder.SetTotalBytesLimit(500 * 1024 * 1024, 400 * 1024 * 1024);
     return dst->ParseFromCodedStream(&decoder) && dst->stream_size() > 0;
+  }
+}
+
+bool Logger::read(const std::string& filename,
+                  const LogBlockSelection& selection, LogFile *dst) {
+  if (isLogBlockFile(filename)) {
+    *dst = LogFile();
+    return readLogBlocks(filename, selection, dst) && !empty(*dst);
+  }
+
+  // The old format has to be read as a whole.
+  if (!read(filename, dst)) {
+    return false;
+  }
+  keepSelected(selection, dst->mutable_stream());
+  keepSelected(selection, dst->mutable_text());
+  if (!selection.includeRawNmea2000) {
+    dst->clear_rawnmea2000();
+  }
+  return dst->stream_size() > 0;
+}
+
+bool Logger::read(const std::string& filename, LogFile *dst) {
+    if (isLogBlockFile(filename)) {
+      return read(filename, LogBlockSelection(), dst);
+    }
+    ifstream file(filename, ios_base::in | ios_base::binary);
+    return readGzipped(&file, dst);
+}
+
+bool Logger::read(std::istream* stream, LogFile *dst) {
+  // The old format is decoded straight from the stream.
+  if (!mayBeLogBlockFile(stream->peek())) {
+    return readGzipped(stream, dst);
+  }
+
+  // Block-indexed files have to be seeked in, which the stream
+  // may not support.
+  std::string bytes{istreambuf_iterator<char>(*stream),
+                    istreambuf_iterator<char>()};
+  istringstream in(bytes);
+  if (!isLogBlockFile(&in)) {
+    return false;
+  }
+  *dst = LogFile();
+  return readLogBlocks(&in, LogBlockSelection(), dst) && !empty(*dst);
 }
 
 void Logger::unpack(const AngleValueSet& values, std::vector<Angle<double>>* angles) {
@@ -353,8 +412,13 @@ void Logger::logRawNmea2000(
   auto t = TimeStamp::fromMilliSecondsSince1970(
       timestampMillisecondsSinceBoot);
 
-  _rawNmea2000Sentences[{id, getNmea2000SizeClass(count)}]
-    .add(t, id, count, data);
+  auto key = std::make_pair(id, getNmea2000SizeClass(count));
+  auto it = _rawNmea2000Sentences.find(key);
+  if (it == _rawNmea2000Sentences.end()) {
+    it = _rawNmea2000Sentences.insert(
+        make_pair(key, Nmea2000SentenceAccumulator(&_buffer))).first;
+  }
+  it->second.add(t, id, count, data);
 }
 
 }  // namespace sail
@@ -3,8 +3,10 @@
 
 #include <cstdint>
 #include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/logger/LogBlockFile.h>
 #include <device/anemobox/logger/logger.pb.h>
 #include <boost/signals2/connection.hpp>
+#include <google/protobuf/arena.h>
 #include <map>
 #include <memory>
 #include <string>
@@ -26,7 +28,35 @@ void unpackTimeStamps(
     std::vector<TimeStamp>* result);
 
 
+// The LogFile that a Logger is currently writing to. Its messages are
+// allocated on an arena of their own, so that the buffer can be handed
+// over to another thread when full, and released there at once.
+class LogBuffer {
+ public:
+  explicit LogBuffer(std::int64_t generation);
+
+  // Distinguishes the buffers of a Logger.
+  std::int64_t generation() const { return _generation; }
+
+  const LogFile& data() const { return *_data; }
+  LogFile* mutableData() { return _data; }
+
+ private:
+  LogBuffer(const LogBuffer&) = delete;
+  LogBuffer& operator=(const LogBuffer&) = delete;
+
+  google::protobuf::Arena _arena;
+  LogFile* _data;
+  std::int64_t _generation;
+};
+
+typedef std::unique_ptr<LogBuffer> LogBufferPtr;
+
 // Listen and save a single stream of values.
+//
+// The values go to a ValueSet of the current buffer, that is added on
+// the first value after a buffer swap. Buffers thus never contain
+// empty streams, and swapping them does not involve the listeners.
 class LoggerValueListener:
   public Listener<Angle<double>>,
   public Listener<Velocity<double>>,
@@ -37,32 +67,20 @@ class LoggerValueListener:
   public Listener<BinaryEdge>,
   public Listener<AngularVelocity<double>> {
 public:
+  // 'buffer' points at the current buffer of the Logger. Text listeners
+  // write to LogFile::text instead of LogFile::stream.
   LoggerValueListener(const std::string& shortName,
-                      const std::string& sourceName)
-    : _sourceName(sourceName), _shortName(shortName) {
-    clear();
-  }
+                      const std::string& sourceName,
+                      const LogBufferPtr* buffer,
+                      bool text = false)
+    : _buffer(buffer), _text(text),
+      _sourceName(sourceName), _shortName(shortName) { }
   LoggerValueListener(const LoggerValueListener& other) = default;
 
-  const ValueSet& valueSet() const { return _valueSet; }
-  ValueSet* mutable_valueSet() { return &_valueSet; }
-
-  void clear() {
-    _valueSet = ValueSet();
-    _valueSet.set_shortname(_shortName);
-    _valueSet.set_source(_sourceName);
-  }
-
-  void setPriority(Dispatcher* dispatcher) {
-    int priority = dispatcher->sourcePriority(_sourceName);
-    if (priority != 0) {
-      _valueSet.set_priority(priority);
-    }
-  }
-
   void addTimestamp(const TimeStamp& timestamp) {
+    attach();
     addTimeStampToRepeatedFields(&timestampBase,
-        _valueSet.mutable_timestampssinceboot(), timestamp);
+        _valueSet->mutable_timestampssinceboot(), timestamp);
   }
 
   static void accumulateAngle(const Angle<> &angle, int *base, AngleValueSet* set) {
@@ -78,7 +96,7 @@ public:
   virtual void onNewValue(const ValueDispatcher<Angle<double>> &angle) {
     addTimestamp(angle.lastTimeStamp());
 
-    accumulateAngle(angle.lastValue(), &intBase, _valueSet.mutable_angles());
+    accumulateAngle(angle.lastValue(), &intBase, _valueSet->mutable_angles());
   }
 
   virtual void onNewValue(const ValueDispatcher<Velocity<double>> &v) {
@@ -86,10 +104,10 @@ public:
 
     int value = int(v.lastValue().knots() * 100.0);
     int delta = value;
-    if (_valueSet.velocity().deltavelocity_size() > 0) {
+    if (_valueSet->velocity().deltavelocity_size() > 0) {
       delta -= intBase;
     }
-    _valueSet.mutable_velocity()->add_deltavelocity(delta);
+    _valueSet->mutable_velocity()->add_deltavelocity(delta);
     intBase = value;
   }
 
@@ -98,16 +116,16 @@ public:
 
     int value = int(v.lastValue().meters());
     int delta = value;
-    if (_valueSet.length().deltalength_size() > 0) {
+    if (_valueSet->length().deltalength_size() > 0) {
       delta -= intBase;
     }
-    _valueSet.mutable_length()->add_deltalength(delta);
+    _valueSet->mutable_length()->add_deltalength(delta);
     intBase = value;
   }
 
   virtual void onNewValue(const ValueDispatcher<GeographicPosition<double>> &v) {
     addTimestamp(v.lastTimeStamp());
-    GeoPosValueSet_Pos* pos = _valueSet.mutable_pos()->add_pos();
+    GeoPosValueSet_Pos* pos = _valueSet->mutable_pos()->add_pos();
     pos->set_lat(v.lastValue().lat().degrees());
     pos->set_lon(v.lastValue().lon().degrees());
   }
@@ -115,25 +133,25 @@ public:
   virtual void onNewValue(const ValueDispatcher<TimeStamp> &v) {
     addTimestamp(v.lastTimeStamp());
     TimeStamp t = v.lastValue();
-    addTimeStampToRepeatedFields(&extTimesBase, _valueSet.mutable_exttimes(), t);
+    addTimeStampToRepeatedFields(&extTimesBase, _valueSet->mutable_exttimes(), t);
   }
 
   virtual void onNewValue(const ValueDispatcher<AbsoluteOrientation> &v) {
     addTimestamp(v.lastTimeStamp());
 
     accumulateAngle(v.lastValue().heading, &intBase, 
-                    _valueSet.mutable_orient()->mutable_heading());
+                    _valueSet->mutable_orient()->mutable_heading());
 
     accumulateAngle(v.lastValue().roll, &intBaseRoll, 
-                    _valueSet.mutable_orient()->mutable_roll());
+                    _valueSet->mutable_orient()->mutable_roll());
 
     accumulateAngle(v.lastValue().pitch, &intBasePitch, 
-                    _valueSet.mutable_orient()->mutable_pitch());
+                    _valueSet->mutable_orient()->mutable_pitch());
   }
 
   virtual void onNewValue(const ValueDispatcher<BinaryEdge> &v) {
     addTimestamp(v.lastTimeStamp());
-    _valueSet.mutable_binary()->add_edges(v.lastValue() == BinaryEdge::ToOn);
+    _valueSet->mutable_binary()->add_edges(v.lastValue() == BinaryEdge::ToOn);
   }
 
   virtual void onNewValue(const ValueDispatcher<AngularVelocity<double>> &v) {
@@ -141,21 +159,35 @@ public:
 
     int value = int(v.lastValue().radiansPerSecond() * 1000.0);
     int delta = value;
-    if (_valueSet.angularvelocity().delta_size() > 0) {
+    if (_valueSet->angularvelocity().delta_size() > 0) {
       delta -= intBase;
     }
-    _valueSet.mutable_angularvelocity()->add_delta(delta);
+    _valueSet->mutable_angularvelocity()->add_delta(delta);
     intBase = value;
   }
 
   void addText(TimeStamp t, const std::string& text) {
     addTimestamp(t);
-    _valueSet.add_text(text);
+    _valueSet->add_text(text);
   }
 
   const std::string& source() const { return _sourceName; }
 private:
-  ValueSet _valueSet;
+  void attach() {
+    LogBuffer* buffer = _buffer->get();
+    if (_valueSet == nullptr || _generation != buffer->generation()) {
+      LogFile* data = buffer->mutableData();
+      _valueSet = _text? data->add_text() : data->add_stream();
+      _valueSet->set_shortname(_shortName);
+      _valueSet->set_source(_sourceName);
+      _generation = buffer->generation();
+    }
+  }
+
+  const LogBufferPtr* _buffer;
+  bool _text;
+  ValueSet* _valueSet = nullptr;
+  std::int64_t _generation = 0;
   int intBase = 0;
   int intBaseRoll = 0;
   int intBasePitch = 0;
@@ -173,23 +205,36 @@ inline Nmea2000SizeClass getNmea2000SizeClass(size_t byteCount) {
       : Nmea2000SizeClass::Odd;
 }
 
+// Like LoggerValueListener, adds its sentences to the current buffer.
 class Nmea2000SentenceAccumulator {
 public:
+  Nmea2000SentenceAccumulator(const LogBufferPtr* buffer)
+    : _buffer(buffer) {}
+
   void add(const TimeStamp& time,
 	   int64_t id, size_t count, const char* data);
-  Nmea2000Sentences* mutableData() {return &_data;}
 private:
+  const LogBufferPtr* _buffer;
+  Nmea2000Sentences* _data = nullptr;
+  std::int64_t _generation = 0;
   Nmea2000SizeClass _sizeClass = Nmea2000SizeClass::Regular;
   std::int64_t timestampBase = 0;
-  Nmea2000Sentences _data;
 };
 
 class Logger {
  public:
   Logger(Dispatcher* dispatcher);
 
+  // Replaces the current buffer by an empty one, and returns the
+  // former. No value is copied, so this is cheap enough for the
+  // dispatcher thread, which it should be called in. The returned
+  // buffer can be saved and released in any thread.
+  LogBufferPtr swapBuffer();
+
   // Move all stored data into <container>. This method should
-  // be called in the dispatcher thread.
+  // be called in the dispatcher thread. Protobuf can only swap
+  // without copying if <container> is on the arena of the buffer,
+  // so code that just serializes the data should use swapBuffer.
   void flushTo(LogFile* container);
 
   // Convenience function to call flushTo, nextFilename and save.
@@ -207,6 +252,18 @@ class Logger {
   static bool save(const std::string& filename, const LogFile& data);
   static bool read(const std::string& filename, LogFile *dst);
 
+  // Reads a log of either format from a stream that need not be
+  // seekable, such as a decompressing one.
+  static bool read(std::istream* stream, LogFile *dst);
+
+  // Only reads the selected streams. For block-indexed files, the
+  // other blocks are not even decompressed.
+  static bool read(const std::string& filename,
+                   const LogBlockSelection& selection, LogFile *dst);
+
+  // Appends to a block-indexed log file, see LogBlockFile.h.
+  static bool appendBlocks(const std::string& filename, const LogFile& data);
+
   static void unpack(const AngleValueSet& values,
                      std::vector<Angle<double>>* angles);
 
@@ -245,6 +302,7 @@ class Logger {
   void subscribeToDispatcher(DispatchData *d);
 
   Dispatcher* _dispatcher;
+  LogBufferPtr _buffer;
   std::vector<std::shared_ptr<LoggerValueListener>> _listeners;
   std::map<std::string, LoggerValueListener> _textLoggers;
   std::map<std::pair<int64_t, Nmea2000SizeClass>, Nmea2000SentenceAccumulator> _rawNmea2000Sentences;
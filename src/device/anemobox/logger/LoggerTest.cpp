@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <fstream>
 #include <random>
+#include <sstream>
 #include <fstream>
 
 using namespace sail;
@@ -365,3 +366,206 @@ TEST(LoggerTest, LogNmea) {
 
   EXPECT_EQ(saved1.rawnmea2000_size(), 3);
 }
+
+TEST(LoggerTest, BlockFile) {
+  FakeClockDispatcher dispatcher;
+  Logger logger(&dispatcher);
+  const char filename[] = "./logger_block_file_test.log";
+  boost::filesystem::remove(filename);
+
+  auto start = TimeStamp::UTC(2016, 5, 27, 8, 0, 0);
+  auto publish = [&](int minute) {
+    dispatcher.setTime(start + Duration<>::minutes(minute));
+    dispatcher.publishValue(AWA, "wind", Angle<double>::degrees(minute));
+    dispatcher.publishValue(AWS, "wind", Velocity<double>::knots(minute));
+    dispatcher.publishValue(GPS_SPEED, "gps", Velocity<double>::knots(1));
+  };
+
+  // Two flushes, appended to the same file.
+  for (int flush = 0; flush < 2; flush++) {
+    for (int minute = 0; minute < 10; minute++) {
+      publish(10*flush + minute);
+    }
+    logger.logText("NMEA0183 input", "$IIVHW,,,,,7.0,N,,*1F");
+    LogFile data;
+    logger.flushTo(&data);
+    EXPECT_TRUE(Logger::appendBlocks(filename, data));
+  }
+  EXPECT_TRUE(isLogBlockFile(filename));
+
+  LogBlockIndex index;
+  EXPECT_TRUE(readLogBlockIndex(filename, &index));
+  EXPECT_EQ(8, index.block_size());
+
+  LogFile all;
+  EXPECT_TRUE(Logger::read(filename, &all));
+  EXPECT_EQ(6, all.stream_size());
+  EXPECT_EQ(2, all.text_size());
+  std::vector<Angle<double>> angles;
+  Logger::unpack(all.stream(0).angles(), &angles);
+  EXPECT_EQ(10, angles.size());
+
+  LogBlockSelection selection;
+  selection.from = start + Duration<>::minutes(12);
+  selection.to = start + Duration<>::minutes(15);
+  selection.shortNames = {"awa"};
+  LogFile selected;
+  EXPECT_TRUE(Logger::read(filename, selection, &selected));
+  EXPECT_EQ(1, selected.stream_size());
+  EXPECT_EQ(0, selected.text_size());
+  EXPECT_EQ("awa", selected.stream(0).shortname());
+  Logger::unpack(selected.stream(0).angles(), &angles);
+  EXPECT_EQ(10, angles.size());
+  EXPECT_NEAR(10, angles[0].degrees(), 1.0e-6);
+
+  selection.shortNames.clear();
+  selection.sources = {"gps"};
+  EXPECT_TRUE(Logger::read(filename, selection, &selected));
+  EXPECT_EQ(1, selected.stream_size());
+  EXPECT_EQ("gpsSpeed", selected.stream(0).shortname());
+
+  // The old format gives the same selection.
+  const char oldFilename[] = "./logger_block_file_test_v1.log";
+  EXPECT_TRUE(Logger::save(oldFilename, all));
+  EXPECT_FALSE(isLogBlockFile(oldFilename));
+  EXPECT_TRUE(Logger::read(oldFilename, selection, &selected));
+  EXPECT_EQ(1, selected.stream_size());
+  EXPECT_EQ("gpsSpeed", selected.stream(0).shortname());
+
+  // We do not append to files of the old format.
+  EXPECT_FALSE(Logger::appendBlocks(oldFilename, all));
+
+  boost::filesystem::remove(filename);
+  boost::filesystem::remove(oldFilename);
+}
+
+TEST(LoggerTest, BlockFileInterruptedAppend) {
+  FakeClockDispatcher dispatcher;
+  Logger logger(&dispatcher);
+  const char filename[] = "./logger_block_file_interrupted_test.log";
+  boost::filesystem::remove(filename);
+
+  auto start = TimeStamp::UTC(2016, 5, 27, 8, 0, 0);
+  auto append = [&](int minute) {
+    dispatcher.setTime(start + Duration<>::minutes(minute));
+    dispatcher.publishValue(AWA, "wind", Angle<double>::degrees(minute));
+    LogFile data;
+    logger.flushTo(&data);
+    EXPECT_TRUE(Logger::appendBlocks(filename, data));
+  };
+
+  append(0);
+  auto firstSize = boost::filesystem::file_size(filename);
+  append(1);
+
+  // Cut the second append in the middle, like a power loss would.
+  auto secondSize = boost::filesystem::file_size(filename);
+  boost::filesystem::resize_file(filename, (firstSize + secondSize)/2);
+
+  LogBlockIndex index;
+  EXPECT_TRUE(readLogBlockIndex(filename, &index));
+  EXPECT_EQ(1, index.block_size());
+  LogFile recovered;
+  EXPECT_TRUE(Logger::read(filename, &recovered));
+  EXPECT_EQ(1, recovered.stream_size());
+
+  // Appending after the torn segment keeps the blocks before it.
+  append(2);
+  EXPECT_TRUE(readLogBlockIndex(filename, &index));
+  EXPECT_EQ(2, index.block_size());
+  std::vector<Angle<double>> angles;
+  LogFile all;
+  EXPECT_TRUE(Logger::read(filename, &all));
+  EXPECT_EQ(2, all.stream_size());
+  Logger::unpack(all.stream(1).angles(), &angles);
+  EXPECT_EQ(1, angles.size());
+  EXPECT_NEAR(2, angles[0].degrees(), 1.0e-6);
+
+  boost::filesystem::remove(filename);
+}
+
+TEST(LoggerTest, BlockFileWithOnlyText) {
+  FakeClockDispatcher dispatcher;
+  Logger logger(&dispatcher);
+  const char filename[] = "./logger_block_file_text_test.log";
+  boost::filesystem::remove(filename);
+
+  logger.logText("NMEA0183 input", "$IIVHW,,,,,7.0,N,,*1F");
+  LogFile data;
+  logger.flushTo(&data);
+  EXPECT_TRUE(Logger::appendBlocks(filename, data));
+
+  LogFile read;
+  EXPECT_TRUE(Logger::read(filename, &read));
+  EXPECT_EQ(0, read.stream_size());
+  EXPECT_EQ(1, read.text_size());
+
+  boost::filesystem::remove(filename);
+}
+
+TEST(LoggerTest, ReadStream) {
+  FakeClockDispatcher dispatcher;
+  Logger logger(&dispatcher);
+  const char oldFilename[] = "./logger_read_stream_test_v1.log";
+  const char blockFilename[] = "./logger_read_stream_test_v2.log";
+
+  dispatcher.publishValue(AWA, "wind", Angle<double>::degrees(3));
+  logger.logText("NMEA0183 input", "$IIVHW,,,,,7.0,N,,*1F");
+  LogFile data;
+  logger.flushTo(&data);
+  boost::filesystem::remove(blockFilename);
+  EXPECT_TRUE(Logger::save(oldFilename, data));
+  EXPECT_TRUE(Logger::appendBlocks(blockFilename, data));
+
+  for (auto filename: {oldFilename, blockFilename}) {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    LogFile read;
+    EXPECT_TRUE(Logger::read(&file, &read));
+    EXPECT_EQ(1, read.stream_size());
+    EXPECT_EQ(1, read.text_size());
+  }
+
+  std::istringstream garbage("not a log file");
+  LogFile read;
+  EXPECT_FALSE(Logger::read(&garbage, &read));
+
+  boost::filesystem::remove(oldFilename);
+  boost::filesystem::remove(blockFilename);
+}
+
+TEST(LoggerTest, SwapBuffer) {
+  Dispatcher dispatcher;
+  Logger logger(&dispatcher);
+
+  dispatcher.publishValue(AWA, "source1", Angle<double>::degrees(1));
+  dispatcher.publishValue(AWA, "source2", Angle<double>::degrees(2));
+  logger.logText("source A", "sentence A1");
+  logger.logRawNmea2000(1000, 17, 8, "abcdefgh");
+
+  LogBufferPtr first = logger.swapBuffer();
+
+  // Only source2 has values in the second buffer.
+  dispatcher.publishValue(AWA, "source2", Angle<double>::degrees(3));
+  dispatcher.publishValue(AWA, "source2", Angle<double>::degrees(4));
+  LogBufferPtr second = logger.swapBuffer();
+
+  EXPECT_EQ(2, first->data().stream_size());
+  EXPECT_EQ(1, first->data().text_size());
+  EXPECT_EQ(1, first->data().rawnmea2000_size());
+
+  ASSERT_EQ(1, second->data().stream_size());
+  EXPECT_EQ(0, second->data().text_size());
+  EXPECT_EQ(0, second->data().rawnmea2000_size());
+  EXPECT_EQ("source2", second->data().stream(0).source());
+  std::vector<Angle<double>> angles;
+  Logger::unpack(second->data().stream(0).angles(), &angles);
+  ASSERT_EQ(2, angles.size());
+  EXPECT_NEAR(3, angles[0].degrees(), 1.0e-6);
+  EXPECT_NEAR(4, angles[1].degrees(), 1.0e-6);
+
+  // The frozen buffers do not depend on the logger.
+  first.reset();
+  LogFile empty;
+  logger.flushTo(&empty);
+  EXPECT_EQ(0, empty.stream_size());
+}
@@ -2,8 +2,11 @@
 
 #include <device/Arduino/libraries/TrueWindEstimator/TrueWindEstimator.h>
 #include <device/anemobox/DispatcherTrueWindEstimator.h>
+#include <device/anemobox/DispatcherUtils.h>
+#include <algorithm>
 #include <fstream>
 #include <server/common/Functional.h>
+#include <server/common/ParallelFor.h>
 #include <server/common/Span.h>
 #include <server/common/logging.h>
 
@@ -132,12 +135,385 @@ void generateComputeCallbacks(Dispatcher *src,
 }
 */
 
-NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds) {
-  std::ifstream file(boatDat);
-  return SimulateBox(file, ds);
+namespace {
+
+// Batch simulation. It computes the same estimates as the replay above,
+// directly from the channels of the dataset: it works out when the
+// timeouts of EstimateOnNewValue fire during the replay, and what the
+// estimator sees through the ReplayDispatcher at those times.
+
+const int64_t estimateDelayMillis = 20;
+
+// The default maxAge of DispatchData::isFresh. Once the active source
+// of a channel is that old, any other source that publishes takes over.
+const int64_t sourceFreshnessMillis = 15000;
+
+// A channel of the dataset, as the ReplayDispatcher presents it while
+// replaying: the active source changes as sources publish, and a source
+// only shows its last ReplayDispatcher::lazyBufferLength samples.
+template <DataCode Code>
+class ReplayedChannel {
+ public:
+  typedef typename TypeForCode<Code>::type T;
+
+  ReplayedChannel(Dispatcher* src);
+
+  // The times at which the active source publishes, notifying listeners.
+  const std::vector<int64_t>& notifications() const {
+    return _notifications;
+  }
+
+  // The samples of the active source once all samples before 'time' are
+  // published, or up to and including 'time' if 'inclusive'.
+  TimedColumns<T> visibleSamples(int64_t time, bool inclusive) const;
+ private:
+  std::vector<TimedColumns<T>> _sources;
+
+  // The active source becomes _switchSources[i] at _switchTimes[i].
+  std::vector<int64_t> _switchTimes;
+  std::vector<int> _switchSources;
+
+  std::vector<int64_t> _notifications;
+};
+
+template <DataCode Code>
+ReplayedChannel<Code>::ReplayedChannel(Dispatcher* src) {
+  auto found = src->allSources().find(Code);
+  if (found == src->allSources().end()) {
+    return;
+  }
+  std::vector<int> priorities;
+  for (const auto& kv: found->second) {
+    _sources.push_back(
+        toTypedDispatchData<Code>(kv.second.get())->dispatcher()
+        ->values().samples());
+    priorities.push_back(src->sourcePriority(kv.first));
+  }
+
+  // Samples of different sources with the same time are
+  // published in the order of the sources.
+  std::vector<std::pair<int64_t, int>> published;
+  for (int s = 0; s < _sources.size(); s++) {
+    for (size_t i = 0; i < _sources[s].size(); i++) {
+      published.push_back(std::make_pair(_sources[s].times()[i], s));
+    }
+  }
+  std::stable_sort(published.begin(), published.end(),
+      [](const std::pair<int64_t, int>& a, const std::pair<int64_t, int>& b) {
+    return a.first < b.first;
+  });
+
+  // See Dispatcher::prefers
+  std::vector<int64_t> lastTime(_sources.size());
+  int active = -1;
+  for (const auto& p: published) {
+    int64_t time = p.first;
+    int s = p.second;
+    if (active != s) {
+      bool fresh = active != -1
+        && time - lastTime[active] < sourceFreshnessMillis;
+      if (!fresh || priorities[active] < priorities[s]) {
+        active = s;
+        _switchTimes.push_back(time);
+        _switchSources.push_back(s);
+      }
+    }
+    lastTime[s] = time;
+    if (active == s) {
+      _notifications.push_back(time);
+    }
+  }
+}
+
+template <DataCode Code>
+TimedColumns<typename TypeForCode<Code>::type>
+  ReplayedChannel<Code>::visibleSamples(int64_t time, bool inclusive) const {
+  size_t switches = inclusive?
+    upperBoundTime(_switchTimes.data(), _switchTimes.size(), time)
+    : lowerBoundTime(_switchTimes.data(), _switchTimes.size(), time);
+  if (switches == 0) {
+    return TimedColumns<T>();
+  }
+  const TimedColumns<T>& source = _sources[_switchSources[switches - 1]];
+  size_t n = inclusive?
+    upperBoundTime(source.times(), source.size(), time)
+    : lowerBoundTime(source.times(), source.size(), time);
+  size_t k = std::min(n, size_t(ReplayDispatcher::lazyBufferLength));
+  return TimedColumns<T>(source.times() + n - k, source.values() + n - k, k);
+}
+
+// The channels that the estimator reads.
+class EstimatorChannels : ReplayedChannel<AWA>, ReplayedChannel<AWS>,
+  ReplayedChannel<GPS_SPEED>, ReplayedChannel<GPS_BEARING>,
+  ReplayedChannel<WAT_SPEED>, ReplayedChannel<MAG_HEADING>,
+  ReplayedChannel<TWA>, ReplayedChannel<TWS> {
+ public:
+  EstimatorChannels(Dispatcher* src)
+    : ReplayedChannel<AWA>(src), ReplayedChannel<AWS>(src),
+      ReplayedChannel<GPS_SPEED>(src), ReplayedChannel<GPS_BEARING>(src),
+      ReplayedChannel<WAT_SPEED>(src), ReplayedChannel<MAG_HEADING>(src),
+      ReplayedChannel<TWA>(src), ReplayedChannel<TWS>(src) { }
+
+  template <DataCode Code>
+  const ReplayedChannel<Code>& get() const { return *this; }
+
+  // The notification times of the channels that EstimateOnNewValue
+  // listens to.
+  std::vector<int64_t> triggers() const {
+    std::vector<int64_t> dst;
+    for (const auto* times: {
+        &get<AWA>().notifications(), &get<AWS>().notifications(),
+        &get<GPS_SPEED>().notifications(), &get<GPS_BEARING>().notifications(),
+        &get<WAT_SPEED>().notifications(), &get<MAG_HEADING>().notifications()}) {
+      dst.insert(dst.end(), times->begin(), times->end());
+    }
+    std::sort(dst.begin(), dst.end());
+    return dst;
+  }
+};
+
+// What DispatcherTrueWindEstimator sees when it computes.
+class ReplayedInput {
+ public:
+  ReplayedInput(const EstimatorChannels& channels,
+                int64_t time, bool inclusive)
+    : _channels(channels), _time(time), _inclusive(inclusive) { }
+
+  TimeStamp currentTime() const {
+    return TimeStamp::fromMilliSecondsSince1970(_time);
+  }
+
+  template <DataCode Code>
+  TimedColumns<typename TypeForCode<Code>::type> samples() const {
+    return _channels.get<Code>().visibleSamples(_time, _inclusive);
+  }
+
+  template <DataCode Code>
+  bool hasFreshValue(TimeStamp limit) const {
+    auto s = samples<Code>();
+    return !s.empty() && s.back().time >= limit;
+  }
+
+  template <DataCode Code>
+  typename TypeForCode<Code>::type lastValue() const {
+    return samples<Code>().back().value;
+  }
+ private:
+  const EstimatorChannels& _channels;
+  int64_t _time;
+  bool _inclusive;
+};
+
+// DispatcherFilter, on a ReplayedInput.
+class ReplayedFilter {
+ public:
+  typedef double type;
+
+  ReplayedFilter(const ReplayedInput& input) : _input(input) { }
+
+  Angle<> awa() const {
+    return filterAngle(_input.samples<AWA>(), _params.apparentWindWindow);
+  }
+
+  Velocity<> aws() const {
+    return filterVelocity(_input.samples<AWS>(), _params.apparentWindWindow);
+  }
+
+  Angle<> magHdg() const {
+    return filterAngle(_input.samples<MAG_HEADING>(),
+                       _params.waterMotionWindow);
+  }
+
+  Velocity<> watSpeed() const {
+    return filterVelocity(_input.samples<WAT_SPEED>(),
+                          _params.waterMotionWindow);
+  }
+
+  Velocity<> gpsSpeed() const {
+    return filterVelocity(_input.samples<GPS_SPEED>(),
+                          _params.gpsMotionWindow);
+  }
+
+  Angle<> gpsBearing() const {
+    return filterAngle(_input.samples<GPS_BEARING>(),
+                       _params.gpsMotionWindow);
+  }
+
+  HorizontalMotion<double> gpsMotion() const {
+    return HorizontalMotion<double>::polar(gpsSpeed(), gpsBearing());
+  }
+ private:
+  Angle<double> filterAngle(const TimedColumns<Angle<double>>& samples,
+                            Duration<> window) const {
+    AngleWindowFilter::Vec sinCos;
+    if (!triangularWindowMean<Angle<double>, AngleFilterTraits>(
+        samples.times(), samples.values(), samples.size(),
+        _input.currentTime(), window, &sinCos)) {
+      return Angle<>::degrees(0);
+    }
+    return Angle<double>::radians(atan2(sinCos[0], sinCos[1]));
+  }
+
+  Velocity<double> filterVelocity(
+      const TimedColumns<Velocity<double>>& samples,
+      Duration<> window) const {
+    VelocityWindowFilter::Vec knots;
+    if (!triangularWindowMean<Velocity<double>, VelocityFilterTraits>(
+        samples.times(), samples.values(), samples.size(),
+        _input.currentTime(), window, &knots)) {
+      return Velocity<>::knots(0);
+    }
+    return Velocity<double>::knots(knots[0]);
+  }
+
+  const ReplayedInput& _input;
+
+  // As in DispatcherTrueWindEstimator
+  DispatcherFilterParams _params;
+};
+
+// Collects what the estimator publishes.
+struct Estimates {
+  TimeStamp time;
+  TimedSampleCollection<Angle<double>>::TimedVector twdir, twa;
+  TimedSampleCollection<Velocity<double>>::TimedVector tws, targetVmg, vmg;
+
+  void publishValue(DataCode code, const std::string&, Angle<double> x) {
+    switch (code) {
+      case TWDIR: twdir.push_back(TimedValue<Angle<double>>(time, x)); break;
+      case TWA: twa.push_back(TimedValue<Angle<double>>(time, x)); break;
+      default: LOG(FATAL) << "Unexpected estimate " << wordIdentifierForCode(code);
+    }
+  }
+
+  void publishValue(DataCode code, const std::string&, Velocity<double> x) {
+    switch (code) {
+      case TWS: tws.push_back(TimedValue<Velocity<double>>(time, x)); break;
+      case TARGET_VMG:
+        targetVmg.push_back(TimedValue<Velocity<double>>(time, x));
+        break;
+      case VMG: vmg.push_back(TimedValue<Velocity<double>>(time, x)); break;
+      default: LOG(FATAL) << "Unexpected estimate " << wordIdentifierForCode(code);
+    }
+  }
+
+  void append(const Estimates& other) {
+    twdir.insert(twdir.end(), other.twdir.begin(), other.twdir.end());
+    twa.insert(twa.end(), other.twa.begin(), other.twa.end());
+    tws.insert(tws.end(), other.tws.begin(), other.tws.end());
+    targetVmg.insert(targetVmg.end(),
+                     other.targetVmg.begin(), other.targetVmg.end());
+    vmg.insert(vmg.end(), other.vmg.begin(), other.vmg.end());
+  }
+};
+
+struct EstimateTime {
+  int64_t time;
+
+  // Whether the samples at 'time' are published before the estimate.
+  bool inclusive;
+};
+
+class CollectSampleTimes {
+ public:
+  template <DataCode Code, typename T>
+  void visit(const char *, const std::string &,
+             const std::shared_ptr<DispatchData> &,
+             const TimedSampleCollection<T> &values) {
+    auto samples = values.samples();
+    times.insert(times.end(), samples.times(),
+                 samples.times() + samples.size());
+  }
+
+  std::vector<int64_t> times;
+};
+
+// The times at which the timeouts of EstimateOnNewValue fire.
+std::vector<EstimateTime> listEstimateTimes(
+    Dispatcher* src, const EstimatorChannels& channels) {
+  // Every sample advances the time of the ReplayDispatcher, so
+  // a timeout fires just before the first sample past it is published.
+  CollectSampleTimes collect;
+  visitDispatcherChannels(src, &collect);
+  std::vector<int64_t>& sampleTimes = collect.times;
+  std::sort(sampleTimes.begin(), sampleTimes.end());
+
+  std::vector<int64_t> triggers = channels.triggers();
+  std::vector<EstimateTime> dst;
+  size_t next = 0;
+  while (next < triggers.size()) {
+    int64_t deadline = triggers[next] + estimateDelayMillis;
+    size_t fire = lowerBoundTime(
+        sampleTimes.data(), sampleTimes.size(), deadline);
+    if (fire == sampleTimes.size()) {
+      // ReplayDispatcher::finishTimeouts, after the last sample.
+      dst.push_back(EstimateTime{sampleTimes.back(), true});
+      break;
+    }
+    int64_t time = sampleTimes[fire];
+    dst.push_back(EstimateTime{time, false});
+
+    // No timeout is set until the next notification.
+    next = lowerBoundTime(triggers.data(), triggers.size(), time);
+  }
+  return dst;
 }
 
-NavDataset SimulateBox(std::istream &boatDat, const NavDataset &src) {
+NavDataset simulateBoxBatch(std::istream &boatDat, const NavDataset &src,
+                            int threadCount) {
+  // Only used for its calibration.
+  DispatcherTrueWindEstimator estimator(nullptr);
+  if (!estimator.loadCalibration(boatDat)) {
+    return NavDataset();
+  }
+  auto srcName = std::string("Simulated ") + estimator.sourceName();
+
+  Dispatcher* srcDispatcher = src.dispatcher().get();
+  EstimatorChannels channels(srcDispatcher);
+  std::vector<EstimateTime> times = listEstimateTimes(srcDispatcher, channels);
+
+  int chunkCount = 0 < threadCount? threadCount : hardwareThreadCount();
+  std::vector<Estimates> chunks(chunkCount);
+  parallelFor(chunkCount, chunkCount, [&](size_t chunk) {
+    size_t begin = chunk*times.size()/chunkCount;
+    size_t end = (chunk + 1)*times.size()/chunkCount;
+    Estimates* estimates = &chunks[chunk];
+    for (size_t i = begin; i < end; i++) {
+      ReplayedInput input(channels, times[i].time, times[i].inclusive);
+      estimates->time = input.currentTime();
+      estimator.compute(input, ReplayedFilter(input), srcName, estimates);
+    }
+  });
+  Estimates estimates;
+  for (const auto& chunk: chunks) {
+    estimates.append(chunk);
+  }
+
+  auto dst = filterChannels(srcDispatcher,
+      [&](DataCode, const std::string& source) {
+    return source != srcName;
+  }, true);
+  dst->insertValues<Angle<double>>(TWDIR, srcName, estimates.twdir);
+  dst->insertValues<Angle<double>>(TWA, srcName, estimates.twa);
+  dst->insertValues<Velocity<double>>(TWS, srcName, estimates.tws);
+  dst->insertValues<Velocity<double>>(TARGET_VMG, srcName,
+                                      estimates.targetVmg);
+  dst->insertValues<Velocity<double>>(VMG, srcName, estimates.vmg);
+  dst->setSourcePriority(srcName,
+                         dst->sourcePriority(estimator.sourceName()) + 1);
+  return NavDataset(dst);
+}
+
+void preferActiveSources(const NavDataset &src, NavDataset *dst) {
+  for (DataCode code : allDataCodes()) {
+    std::shared_ptr<DispatchData> active(src.activeChannelOrNull(code));
+    if (active) {
+      dst->preferSource(code, active->source());
+    }
+  }
+}
+
+NavDataset simulateBoxReplay(std::istream &boatDat, const NavDataset &src) {
   auto replay = std::make_shared<ReplayDispatcher>();
   DispatcherTrueWindEstimator estimator(replay.get());
   if (!estimator.loadCalibration(boatDat)) {
@@ -153,15 +529,25 @@ NavDataset SimulateBox(std::istream &boatDat, const NavDataset &src) {
 
   replay->setSourcePriority(srcName, replay->sourcePriority(estimator.sourceName()) + 1);
 
-  NavDataset result(std::static_pointer_cast<Dispatcher>(replay));
+  return NavDataset(std::static_pointer_cast<Dispatcher>(replay));
+}
 
-  for (DataCode code : allDataCodes()) {
-    std::shared_ptr<DispatchData> active(src.activeChannelOrNull(code));
-    if (active) {
-      result.preferSource(code, active->source());
-    }
-  }
+}  // namespace
+
+NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds,
+                       SimulationMode mode, int threadCount) {
+  std::ifstream file(boatDat);
+  return SimulateBox(file, ds, mode, threadCount);
+}
 
+NavDataset SimulateBox(std::istream &boatDat, const NavDataset &src,
+                       SimulationMode mode, int threadCount) {
+  NavDataset result = mode == SimulationMode::Batch?
+    simulateBoxBatch(boatDat, src, threadCount)
+    : simulateBoxReplay(boatDat, src);
+  if (result.dispatcher()) {
+    preferActiveSources(src, &result);
+  }
   return result;
 }
 
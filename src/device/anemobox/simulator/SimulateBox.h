@@ -9,8 +9,26 @@
 
 namespace sail {
 
-NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds);
-NavDataset SimulateBox(std::istream& boatDat, const NavDataset &ds);
+enum class SimulationMode {
+  // Replays the dataset sample by sample through a ReplayDispatcher,
+  // with the listeners and timeouts that trigger the estimator on the box.
+  Replay,
+
+  // Computes the same estimates directly from the channels, in parallel.
+  // Estimates from an earlier simulation in the dataset are replaced,
+  // whereas Replay merges them with the new ones.
+  Batch
+};
+
+// Recomputes true wind as the box would, with the calibration in boatDat.
+// In Batch mode, threadCount threads are used, or one per hardware
+// thread if it is 0.
+NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds,
+                       SimulationMode mode = SimulationMode::Replay,
+                       int threadCount = 0);
+NavDataset SimulateBox(std::istream& boatDat, const NavDataset &ds,
+                       SimulationMode mode = SimulationMode::Replay,
+                       int threadCount = 0);
 
 }  // namespace sail
 
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <device/anemobox/simulator/SimulateBox.h>
+#include <functional>
+#include <sstream>
 #include <server/nautical/calib/Calibrator.h>
 
 using namespace sail;
@@ -74,3 +76,105 @@ TEST(SimulateBox, Replay) {
   EXPECT_EQ(0, original.samples<TWDIR>().size());
   EXPECT_EQ(2, simulated.samples<TWDIR>().size());
 }
+
+namespace {
+
+  template <typename T>
+  typename TimedSampleCollection<T>::TimedVector makeSeries(
+      TimeStamp start, Duration<> period, int count,
+      std::function<T(int)> value) {
+    typename TimedSampleCollection<T>::TimedVector values;
+    for (int i = 0; i < count; i++) {
+      values.push_back(TimedValue<T>(start + period.scaled(i), value(i)));
+    }
+    return values;
+  }
+
+  void expectSameAngles(DataCode code,
+                        const TimedSampleRange<Angle<double>>& x,
+                        const TimedSampleRange<Angle<double>>& y) {
+    EXPECT_LT(0, x.size()) << wordIdentifierForCode(code);
+    ASSERT_EQ(x.size(), y.size()) << wordIdentifierForCode(code);
+    for (int i = 0; i < x.size(); i++) {
+      EXPECT_EQ(x[i].time, y[i].time);
+      EXPECT_NEAR(0, (x[i].value - y[i].value).normalizedAt0().degrees(),
+                  1.0e-6);
+    }
+  }
+
+  void expectSameVelocities(DataCode code,
+                            const TimedSampleRange<Velocity<double>>& x,
+                            const TimedSampleRange<Velocity<double>>& y) {
+    EXPECT_LT(0, x.size()) << wordIdentifierForCode(code);
+    ASSERT_EQ(x.size(), y.size()) << wordIdentifierForCode(code);
+    for (int i = 0; i < x.size(); i++) {
+      EXPECT_EQ(x[i].time, y[i].time);
+      EXPECT_NEAR(x[i].value.knots(), y[i].value.knots(), 1.0e-6);
+    }
+  }
+}
+
+// The batch mode must publish the same estimates as the replay, including
+// when the instruments have different rates, pause, and when a channel
+// switches between sources.
+TEST(SimulateBox, BatchMatchesReplay) {
+  auto d = std::make_shared<Dispatcher>();
+  auto start = TimeStamp::UTC(2016, 3, 24, 18, 10, 0);
+  auto ms = Duration<double>::milliseconds(1.0);
+
+  typedef Angle<double> A;
+  typedef Velocity<double> V;
+
+  // The wind instrument pauses between 100 s and 130 s. Meanwhile, a
+  // second wind source of lower priority takes over once the first one
+  // has been silent for 15 s.
+  auto awa = [](int i) { return A::degrees(40 + 20*sin(0.01*i)); };
+  auto wind = makeSeries<A>(start, 100.0*ms, 1000, awa);
+  auto windAfterPause =
+    makeSeries<A>(start + 130000.0*ms, 100.0*ms, 1700, awa);
+  wind.insert(wind.end(), windAfterPause.begin(), windAfterPause.end());
+  d->insertValues<A>(AWA, "NMEA2000/wind", wind);
+  d->insertValues<V>(AWS, "NMEA2000/wind", makeSeries<V>(
+      start + 7.0*ms, 100.0*ms, 3000,
+      [](int i) { return V::knots(12 + cos(0.02*i)); }));
+  d->insertValues<A>(AWA, "NMEA0183: wind", makeSeries<A>(
+      start + 50000.0*ms, 230.0*ms, 1000,
+      [](int i) { return A::degrees(-30 + 0.05*i); }));
+
+  d->insertValues<V>(GPS_SPEED, "Internal GPS", makeSeries<V>(
+      start + 3.0*ms, 1000.0*ms, 300,
+      [](int i) { return V::knots(5 + 0.01*i); }));
+  d->insertValues<A>(GPS_BEARING, "Internal GPS", makeSeries<A>(
+      start + 3.0*ms, 1000.0*ms, 300,
+      [](int i) { return A::degrees(i % 360); }));
+  d->insertValues<V>(WAT_SPEED, "NMEA2000/speed", makeSeries<V>(
+      start + 11.0*ms, 500.0*ms, 600,
+      [](int i) { return V::knots(4.5); }));
+  d->insertValues<A>(MAG_HEADING, "NMEA2000/compass", makeSeries<A>(
+      start, 40.0*ms, 7500,
+      [](int i) { return A::degrees(0.1*i); }));
+
+  NavDataset original(d);
+
+  std::stringstream calibFile;
+  Calibrator calibrator;
+  calibrator.saveCalibration(&calibFile);
+  std::string calib = calibFile.str();
+
+  std::stringstream replayCalib(calib);
+  NavDataset replayed = SimulateBox(replayCalib, original,
+                                    SimulationMode::Replay);
+
+  // The chunks of the batch must not change the result.
+  for (int threadCount : {1, 3}) {
+    std::stringstream batchCalib(calib);
+    NavDataset batch = SimulateBox(batchCalib, original,
+                                   SimulationMode::Batch, threadCount);
+
+    expectSameAngles(TWA, replayed.samples<TWA>(), batch.samples<TWA>());
+    expectSameAngles(TWDIR, replayed.samples<TWDIR>(),
+                     batch.samples<TWDIR>());
+    expectSameVelocities(TWS, replayed.samples<TWS>(), batch.samples<TWS>());
+    expectSameVelocities(VMG, replayed.samples<VMG>(), batch.samples<VMG>());
+  }
+}
@@ -8,12 +8,74 @@
 
 #include <server/common/MDArray.h>
 #include <server/common/string.h>
+#include <cstring>
+#include <string>
+#include <vector>
 
 namespace sail {
 
 MDArray<std::string, 2> parseCsv(std::istream *s);
 MDArray<std::string, 2> parseCsv(std::string filename);
 
+// A cell of a CSV line, pointing into the text that was split.
+struct CsvCell {
+  const char *begin;
+  const char *end;
+
+  size_t size() const { return end - begin; }
+  std::string str() const { return std::string(begin, end); }
+};
+
+// Splits lines into cells the way parseCsv does, but without copying
+// them, so that large files can be parsed in chunks.
+class CsvLineSplitter {
+ public:
+  // Calls f with the cells of every nonempty line in data[0..n), and
+  // returns the number of bytes consumed. Unless 'last' is set, an
+  // incomplete line at the end is not consumed, so that it can be
+  // passed again with the next chunk.
+  template <typename F>
+  size_t split(const char *data, size_t n, bool last, F f);
+ private:
+  std::vector<CsvCell> _cells;
+};
+
+template <typename F>
+size_t CsvLineSplitter::split(const char *data, size_t n, bool last, F f) {
+  const char *end = data + n;
+  const char *line = data;
+  while (line < end) {
+    const char *lineEnd = static_cast<const char*>(
+        memchr(line, '\n', end - line));
+    if (lineEnd == nullptr) {
+      if (!last) {
+        break;
+      }
+      lineEnd = end;
+    }
+    if (line < lineEnd) {
+      _cells.clear();
+      const char *cell = line;
+      while (true) {
+        const char *cellEnd = static_cast<const char*>(
+            memchr(cell, ',', lineEnd - cell));
+        if (cellEnd == nullptr) {
+          // Like std::getline, split does not produce an empty last cell.
+          if (cell < lineEnd) {
+            _cells.push_back(CsvCell{cell, lineEnd});
+          }
+          break;
+        }
+        _cells.push_back(CsvCell{cell, cellEnd});
+        cell = cellEnd + 1;
+      }
+      f(_cells);
+    }
+    line = lineEnd + (lineEnd < end? 1 : 0);
+  }
+  return line - data;
+}
+
 };
 
 #endif /* SERVER_COMMON_CSVPARSER_H_ */
@@ -24,3 +24,43 @@ TEST(CsvParserTest, NumbersAndStrings) {
 }
 
 
+
+namespace {
+  std::vector<std::vector<std::string>> splitInChunks(
+      const std::string& text, size_t chunkSize) {
+    std::vector<std::vector<std::string>> lines;
+    auto addLine = [&](const std::vector<CsvCell>& cells) {
+      std::vector<std::string> line;
+      for (auto cell: cells) {
+        line.push_back(cell.str());
+      }
+      lines.push_back(line);
+    };
+    CsvLineSplitter splitter;
+    std::string pending;
+    for (size_t i = 0; i < text.size(); i += chunkSize) {
+      pending += text.substr(i, chunkSize);
+      bool last = text.size() <= i + chunkSize;
+      pending.erase(0, splitter.split(
+          pending.data(), pending.size(), last, addLine));
+    }
+    EXPECT_TRUE(pending.empty());
+    return lines;
+  }
+}
+
+TEST(CsvParserTest, LineSplitter) {
+  std::string text = "a,b,c\n\n\n1,,3,\r\n,\nlast,line";
+  std::vector<std::vector<std::string>> expected{
+    {"a", "b", "c"}, {"1", "", "3", "\r"}, {""}, {"last", "line"}};
+
+  // The same cells as parseCsv
+  std::stringstream ss(text);
+  auto table = parseCsv(&ss);
+  EXPECT_EQ(4, table.rows());
+  EXPECT_EQ("\r", table(1, 3));
+
+  for (size_t chunkSize: {1, 2, 5, 100}) {
+    EXPECT_EQ(expected, splitInChunks(text, chunkSize));
+  }
+}
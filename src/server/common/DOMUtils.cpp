@@ -39,6 +39,7 @@ std::string PageWriter::fullFilename() const {
 }
 
 std::string PageWriter::generateName() {
+  std::lock_guard<std::mutex> lock(_counterMutex);
   std::stringstream ss;
   ss << _name << "_" << _counter;
   _counter++;
@@ -193,6 +194,25 @@ Node linkToSubPage(Node *parent, const std::string title) {
   return subPage;
 }
 
+Node makeDetachedNode(const Node &parent, const std::string &name) {
+  if (!parent.defined()) {
+    return Node();
+  }
+  Node dst = makeRootNode(name);
+  dst.writer = parent.writer;
+  return dst;
+}
+
+void appendDetachedNode(Node *parent, const Node &detached) {
+  CHECK(parent != nullptr);
+  if (!parent->defined() || !detached.defined()) {
+    return;
+  }
+  AutoPtr<Poco::XML::Node> copy =
+    parent->document->importNode(detached.element, true);
+  parent->element->appendChild(copy);
+}
+
 Poco::Path makeGeneratedImageNode(Node *node,
     const std::string &filenameSuffix) {
   CHECK(node != nullptr);
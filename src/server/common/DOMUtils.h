@@ -14,6 +14,7 @@
 #include <Poco/Path.h>
 #include <server/common/Array.h>
 #include <memory>
+#include <mutex>
 #include <sstream>
 
 namespace sail {
@@ -38,12 +39,14 @@ public:
       Poco::XML::AutoPtr<Poco::XML::Document> doc);
   ~PageWriter();
 
+  // Can be called from several threads.
   std::string generateName();
   Poco::Path generatePath(const std::string &suffix);
 private:
   PageWriter(const PageWriter &other) = delete;
   PageWriter &operator=(const PageWriter &other) = delete;
 
+  std::mutex _counterMutex;
   int _counter = 0;
   std::string _basePath;
   std::string _name;
@@ -95,6 +98,14 @@ void writeHtmlFile(
     Poco::XML::AutoPtr<Poco::XML::Document> document);
 
 Node linkToSubPage(Node *parent, const std::string title);
+
+// A document may only be modified by one thread at a time. To log from
+// several threads, make a detached node for every thread: it has a
+// document of its own, but the page writer of 'parent'. Append it to
+// 'parent' when the thread is done.
+Node makeDetachedNode(const Node &parent, const std::string &name);
+void appendDetachedNode(Node *parent, const Node &detached);
+
 Poco::Path makeGeneratedImageNode(
     Node *node, const std::string &filenameSuffix);
 template <typename T> std::string objectToString(const T &x) {
@@ -0,0 +1,56 @@
+#include <server/common/MappedFile.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sail {
+
+MappedFile::MappedFile(MappedFile&& other)
+  : _data(other._data), _size(other._size) {
+  other._data = nullptr;
+  other._size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+  if (this != &other) {
+    close();
+    _data = other._data;
+    _size = other._size;
+    other._data = nullptr;
+    other._size = 0;
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && 0 < info.st_size) {
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      // The file is mostly read from the beginning to the end.
+      madvise(data, info.st_size, MADV_SEQUENTIAL);
+      _data = static_cast<const char*>(data);
+      _size = info.st_size;
+    }
+  }
+  // The mapping stays valid without the descriptor.
+  ::close(fd);
+  return isOpen();
+}
+
+void MappedFile::close() {
+  if (_data != nullptr) {
+    munmap(const_cast<char*>(_data), _size);
+    _data = nullptr;
+    _size = 0;
+  }
+}
+
+}
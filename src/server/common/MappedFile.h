@@ -0,0 +1,38 @@
+/*
+ *  A read-only memory mapping of a whole file.
+ */
+
+#ifndef SERVER_COMMON_MAPPEDFILE_H_
+#define SERVER_COMMON_MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace sail {
+
+class MappedFile {
+ public:
+  MappedFile() {}
+  ~MappedFile() { close(); }
+
+  MappedFile(MappedFile&& other);
+  MappedFile& operator=(MappedFile&& other);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Maps the file, replacing any previous mapping. Returns false if it
+  // can't be opened or is empty, as empty files can't be mapped.
+  bool open(const std::string& filename);
+  void close();
+
+  bool isOpen() const { return _data != nullptr; }
+  const char* data() const { return _data; }
+  size_t size() const { return _size; }
+ private:
+  const char* _data = nullptr;
+  size_t _size = 0;
+};
+
+}
+
+#endif /* SERVER_COMMON_MAPPEDFILE_H_ */
@@ -0,0 +1,83 @@
+/*
+ *  Data-parallel loops over index ranges, on plain std::threads.
+ *
+ *  Typical usage:
+ *
+ *    parallelForChunks(items.size(), hardwareThreadCount(),
+ *        [&](size_t begin, size_t end) {
+ *      for (size_t i = begin; i < end; i++) {
+ *        results[i] = process(items[i]);
+ *      }
+ *    });
+ */
+
+#ifndef SERVER_COMMON_PARALLELFOR_H_
+#define SERVER_COMMON_PARALLELFOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sail {
+
+// The number of threads that can run concurrently, at least 1.
+inline int hardwareThreadCount() {
+  return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+// Splits [0, n) into at most threadCount contiguous chunks of about
+// equal size, and calls f(begin, end) for every chunk, each on its own
+// thread. The calling thread takes the first chunk. Returns when all
+// chunks are done. If calls to f throw, the first exception is rethrown.
+template <typename F>
+void parallelForChunks(size_t n, int threadCount, F f) {
+  size_t chunkCount = std::min(n, size_t(std::max(1, threadCount)));
+  if (chunkCount <= 1) {
+    if (0 < n) {
+      f(size_t(0), n);
+    }
+    return;
+  }
+
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto run = [&](size_t chunk) {
+    try {
+      f(chunk*n/chunkCount, (chunk + 1)*n/chunkCount);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t chunk = 1; chunk < chunkCount; chunk++) {
+    threads.push_back(std::thread(run, chunk));
+  }
+  run(0);
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// Calls f(i) for every i in [0, n), spread over threadCount threads.
+template <typename F>
+void parallelFor(size_t n, int threadCount, F f) {
+  parallelForChunks(n, threadCount, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      f(i);
+    }
+  });
+}
+
+}  // namespace sail
+
+#endif  // SERVER_COMMON_PARALLELFOR_H_
@@ -0,0 +1,39 @@
+#include <server/common/ParallelFor.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+using namespace sail;
+
+TEST(ParallelForTest, CoversRangeOnce) {
+  for (int threadCount: {1, 3, 8}) {
+    for (size_t n: {0, 1, 2, 7, 1000}) {
+      std::vector<int> visits(n, 0);
+      parallelFor(n, threadCount, [&](size_t i) { visits[i]++; });
+      for (size_t i = 0; i < n; i++) {
+        EXPECT_EQ(1, visits[i]);
+      }
+    }
+  }
+}
+
+TEST(ParallelForTest, Chunks) {
+  std::atomic<int> chunks(0);
+  std::atomic<size_t> total(0);
+  parallelForChunks(10, 4, [&](size_t begin, size_t end) {
+    EXPECT_LT(begin, end);
+    chunks++;
+    total += end - begin;
+  });
+  EXPECT_EQ(4, chunks);
+  EXPECT_EQ(10, total);
+}
+
+TEST(ParallelForTest, RethrowsException) {
+  EXPECT_THROW(parallelFor(100, 4, [](size_t i) {
+    if (i == 60) {
+      throw std::runtime_error("failure");
+    }
+  }), std::runtime_error);
+}
@@ -204,6 +204,10 @@ public:
     return mat;
   }
 
+  void setAll(T value) {
+    _A.setAll(value);
+  }
+
   // Always the lower-left part of the matrix.
   T &atUnsafe(int i, int j) {
     assert(i >= j);
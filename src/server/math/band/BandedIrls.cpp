@@ -17,22 +17,32 @@ namespace BandedIrls {
 BandProblem::BandProblem(int lhsDims,
     int rhsDims, int maxDiagWidth,
     double initialDiagElement) {
-  _lhs = SymmetricBandMatrixL<double>::zero(lhsDims, maxDiagWidth);
+  // A width of n means n-1 subdiagonals.
+  _lhs = SymmetricBandMatrixL<double>(
+      lhsDims, std::max(0, maxDiagWidth - 1));
   _rhs = MDArray2d(lhsDims, rhsDims);
+  reset(initialDiagElement);
+}
+
+void BandProblem::reset(double initialDiagElement) {
+  _lhs.setAll(0.0);
   _rhs.setAll(0.0);
-  for (int i = 0; i < lhsDims; i++) {
+  for (int i = 0; i < _lhs.size(); i++) {
     _lhs.atUnsafe(i, i) = initialDiagElement;
   }
 }
 
-
-MDArray2d BandProblem::solveAndInvalidate() {
+bool BandProblem::solve(MDArray2d* dst) {
   CHECK(!empty());
-  auto success = Pbsv<double>::apply(&_lhs, &_rhs);
-  auto result = success? _rhs : MDArray2d();
-  _lhs = SymmetricBandMatrixL<double>();
-  _rhs = MDArray2d();
-  return result;
+  CHECK(dst != nullptr);
+  if (!Pbsv<double>::apply(&_lhs, &_rhs)) {
+    return false;
+  }
+  if (dst->rows() != _rhs.rows() || dst->cols() != _rhs.cols()) {
+    *dst = MDArray2d(_rhs.rows(), _rhs.cols());
+  }
+  std::swap(*dst, _rhs);
+  return true;
 }
 
 struct ProblemSummary {
@@ -59,29 +69,6 @@ BandProblem makeProblem(
       settings.defaultDiagReg);
 }
 
-MDArray2d initialize(
-    const Settings& settings,
-    const ProblemSummary& summary,
-    const Array<Cost::Ptr>& costs) {
-  auto dst = makeProblem(settings, summary);
-  for (auto cost: costs) {
-    cost->initialize(&dst);
-  }
-  return dst.solveAndInvalidate();
-}
-
-MDArray2d iterate(
-    const Settings& settings,
-    const ProblemSummary& summary,
-    const Array<Cost::Ptr>& costs,
-    int i, const MDArray2d& X) {
-  auto problem = makeProblem(settings, summary);
-  for (auto c: costs) {
-    c->apply(i, X, &problem);
-  }
-  return problem.solveAndInvalidate();
-}
-
 Results solve(
     const Settings& settings,
     const Array<Cost::Ptr>& costs,
@@ -90,17 +77,31 @@ Results solve(
   CHECK(Xinit.empty() || (
       Xinit.rows() == summary.dimension
       && Xinit.cols() == summary.rightHandSideDimension));
-  auto X = Xinit.empty()?
-      initialize(settings, summary, costs) : Xinit;
-  if (X.empty()) {
-    LOG(ERROR) << "Failed to initialize BandedIrls";
-    return Results{X};
+
+  // The problem is allocated once and reset for every iteration. The
+  // solutions are swapped with its right-hand-side, so 'X' is never
+  // reallocated either. It is a copy of 'Xinit', that is not ours.
+  auto problem = makeProblem(settings, summary);
+  MDArray2d X;
+  if (Xinit.empty()) {
+    for (auto cost: costs) {
+      cost->initialize(&problem);
+    }
+    if (!problem.solve(&X)) {
+      LOG(ERROR) << "Failed to initialize BandedIrls";
+      return Results();
+    }
+  } else {
+    X = Xinit.dup();
   }
   for (int i = 0; i < settings.iterations; i++) {
-    X = iterate(settings, summary, costs, i, X);
-    if (X.empty()) {
+    problem.reset(settings.defaultDiagReg);
+    for (auto c: costs) {
+      c->apply(i, X, &problem);
+    }
+    if (!problem.solve(&X)) {
       LOG(ERROR) << "Failed to iterate BandedIrls at " << i << " iterations";
-      return Results{X};
+      return Results();
     }
   }
   return Results{X};
@@ -114,7 +115,8 @@ Results constantSolve(
   for (auto c: costs) {
     c->constantApply(&problem);
   }
-  return Results{problem.solveAndInvalidate()};
+  MDArray2d X;
+  return problem.solve(&X)? Results{X} : Results();
 }
 
 }
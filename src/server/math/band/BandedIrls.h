@@ -71,10 +71,19 @@ public:
   }
 
   BandProblem(int lhsDims,
-      int rhsDims, int maxBlockSize,
+      int rhsDims, int maxDiagWidth,
       double initialDiagElement);
 
-  MDArray2d solveAndInvalidate();
+  // Solves the normal equations by a banded Cholesky factorization,
+  // in place. On success, the solution is swapped into 'dst', whose
+  // previous storage is kept for the right-hand-side. Either way, the
+  // problem must be reset before it is built again.
+  bool solve(MDArray2d* dst);
+
+  // Clears the problem without reallocating it, so that the same
+  // storage can be used for every iteration.
+  void reset(double initialDiagElement);
+
   bool empty() const {return _rhs.empty();}
 private:
   SymmetricBandMatrixL<double> _lhs;
@@ -106,3 +106,27 @@ TEST(BandedIrlsTest, LineFit) {
     EXPECT_NEAR(solution.X(i, 0), gt(i), 0.2);
   }
 }
+
+TEST(BandedIrlsTest, WarmStartWithoutModifyingInput) {
+  Eigen::Matrix2d A;
+  A << 2, 0,
+       0, 4;
+  Array<Cost::Ptr> costs{
+    Cost::Ptr(new BasicCost(0, A, Eigen::Vector2d(4, 8))),
+    Cost::Ptr(new BasicCost(1, A, Eigen::Vector2d(4, 12)))
+  };
+
+  MDArray2d Xinit(3, 1);
+  Xinit.setAll(7.0);
+
+  Settings options;
+  options.iterations = 3;
+  auto solution = solve(options, costs, Xinit);
+  EXPECT_TRUE(solution.OK());
+  EXPECT_NEAR(solution.X(0, 0), 2.0, 1.0e-5);
+  EXPECT_NEAR(solution.X(1, 0), 2.0, 1.0e-5);
+  EXPECT_NEAR(solution.X(2, 0), 3.0, 1.0e-5);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(7.0, Xinit(i, 0));
+  }
+}
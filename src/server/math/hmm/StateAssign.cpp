@@ -8,13 +8,26 @@
 #include "StateAssign.h"
 #include <server/common/ArrayIO.h>
 #include <server/common/ArrayBuilder.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <limits>
+#include <vector>
 #include <server/common/logging.h>
 #include <server/common/string.h>
 
 namespace sail {
 
+namespace {
+  // Above this number of states times length, solve() uses checkpoints.
+  // The full matrices would then take more than 200 MB.
+  const int64_t maxFullMatrixSize = 16*1024*1024;
+}
+
 Arrayi StateAssign::solve() {
+  if (maxFullMatrixSize < int64_t(getStateCount())*getLength()) {
+    return solveWithCheckpoints();
+  }
   MDArray2d costs;
   MDArray2i ptrs;
   accumulateCosts(&costs, &ptrs);
@@ -51,64 +64,117 @@ Arrayi StateAssign::listStateInds() {
   return makeRange(getStateCount());
 }
 
-void StateAssign::accumulateCosts(MDArray2d *costsOut, MDArray2i *ptrsOut) {
-  int length = getLength();
+void StateAssign::getStateCosts(int timeIndex, double *dst) {
   int stateCount = getStateCount();
-  MDArray2d costs(stateCount, length);
-  MDArray2i ptrs(stateCount, length);
-  costs.setAll(0.0);
-  ptrs.setAll(-1);
   for (int state = 0; state < stateCount; state++) {
-    costs(state, 0) = getStateCost(state, 0);
+    dst[state] = getStateCost(state, timeIndex);
   }
+}
 
-  for (int time = 1; time < length; time++) { // For every time index >= 1
-    for (int state = 0; state < stateCount; state++) { // For every state at that time index
-      int bestPredIndex = -1;
-      Arrayi preds = getPrecedingStates(state, time);
-      costs(state, time) = getStateCost(state, time) + calcBestPred(costs, preds, state, time-1, &bestPredIndex);
-      if (bestPredIndex == -1) {
-        costs(state, time) = std::numeric_limits<double>::infinity();
-      }
-      ptrs(state, time) = bestPredIndex;
+void StateAssign::getTransitionCosts(int fromTimeIndex, int count,
+    const int *fromStateIndices, const int *toStateIndices, double *dst) {
+  for (int k = 0; k < count; k++) {
+    dst[k] = getTransitionCost(fromStateIndices[k], toStateIndices[k],
+        fromTimeIndex);
+  }
+}
+
+namespace {
+
+// The transitions to every state at some time, in flat arrays: the
+// predecessors of state 'to' are from[offsets[to]]..from[offsets[to+1]-1].
+class Transitions {
+ public:
+  // Lists the transitions to the states at 'time'. The predecessors are
+  // copied as they are returned, because implementations may build new
+  // arrays at every call or refill the same one. The rest only needs
+  // to be rebuilt if they differ from those of the previous time, which
+  // is not the common case.
+  void update(StateAssign *sa, int stateCount, int time) {
+    _nextOffsets.assign(1, 0);
+    _nextFrom.clear();
+    for (int state = 0; state < stateCount; state++) {
+      Arrayi preds = sa->getPrecedingStates(state, time);
+      _nextFrom.insert(_nextFrom.end(), preds.begin(), preds.end());
+      _nextOffsets.push_back(_nextFrom.size());
+    }
+    if (_nextOffsets == offsets && _nextFrom == from) {
+      return;
+    }
+    offsets.swap(_nextOffsets);
+    from.swap(_nextFrom);
+    to.clear();
+    for (int state = 0; state < stateCount; state++) {
+      to.insert(to.end(), offsets[state + 1] - offsets[state], state);
     }
   }
 
-  // Output the results
-  *costsOut = costs;
-  *ptrsOut = ptrs;
-}
+  int size() const {return from.size();}
+
+  std::vector<int> offsets, from, to;
+ private:
+  std::vector<int> _nextOffsets, _nextFrom;
+};
 
-double StateAssign::calcBestPred(MDArray2d costs, Arrayi preds, int toState, int fromTime,
-                                 int *bestPredIndexOut) {
-  if (preds.empty()) {
-    *bestPredIndexOut = -1;
-    return 1.0e9;
-  } else {
-    int bestIndex = preds[0];
+// The min-plus recurrence of the Viterbi algorithm, over one time step:
+// the cost of reaching every state at the next time, given the accumulated
+// costs 'prev' at the current time and the cost of every transition in 'tr'.
+template <typename Ptr>
+void minPlusStep(const Transitions &tr, int stateCount,
+    const double *prev, const double *transitionCosts,
+    const double *stateCosts, double *costsOut, Ptr *ptrsOut) {
+  const int *from = tr.from.data();
+  for (int to = 0; to < stateCount; to++) {
+    int begin = tr.offsets[to];
+    int end = tr.offsets[to+1];
+    if (begin == end) {
+      costsOut[to] = std::numeric_limits<double>::infinity();
+      ptrsOut[to] = -1;
+      continue;
+    }
+    int bestIndex = from[begin];
     double bestCost = std::numeric_limits<double>::infinity();
-    int count = preds.size();
-    for (int state = 0; state < count; state++) {
-      int stateIndex = preds[state];
-      double cost = costs(stateIndex, fromTime) + getTransitionCost(stateIndex, toState, fromTime);
+    for (int k = begin; k < end; k++) {
+      double cost = prev[from[k]] + transitionCosts[k];
       if (cost < bestCost) {
         bestCost = cost;
-        bestIndex = stateIndex;
+        bestIndex = from[k];
       }
     }
-    *bestPredIndexOut = bestIndex;
-    return bestCost;
+    costsOut[to] = stateCosts[to] + bestCost;
+    ptrsOut[to] = bestIndex;
   }
 }
 
-namespace {
-int getLastBestState(MDArray2d costs) {
-  int last = costs.cols()-1;
-  int count = costs.rows();
+// Computes the accumulated costs one time index after the other,
+// reusing its buffers.
+class ForwardPass {
+ public:
+  ForwardPass(StateAssign *sa, int stateCount) :
+    _sa(sa), _stateCount(stateCount), _stateCosts(stateCount) {}
+
+  template <typename Ptr>
+  void step(int time, const double *prev, double *costsOut, Ptr *ptrsOut) {
+    _tr.update(_sa, _stateCount, time);
+    _transitionCosts.resize(_tr.size());
+    _sa->getStateCosts(time, _stateCosts.data());
+    _sa->getTransitionCosts(time-1, _tr.size(),
+        _tr.from.data(), _tr.to.data(), _transitionCosts.data());
+    minPlusStep(_tr, _stateCount, prev, _transitionCosts.data(),
+        _stateCosts.data(), costsOut, ptrsOut);
+  }
+ private:
+  StateAssign *_sa;
+  int _stateCount;
+  Transitions _tr;
+  std::vector<double> _stateCosts, _transitionCosts;
+};
+
+int getLastBestState(const double *costs, int count) {
   int bestIndex = 0;
-  double bestCost = costs(0, last);
+  double bestCost = costs[0];
   for (int state = 1; state < count; state++) {
-    double cost = costs(state, last);
+    double cost = costs[state];
     if (cost < bestCost) {
       bestCost = cost; // <-- THE ABSENCE OF THIS LINE IS A SERIOUS BUG!!!
       bestIndex = state;
@@ -117,6 +183,98 @@ int getLastBestState(MDArray2d costs) {
   return bestIndex;
 }
 
+template <typename Ptr>
+Arrayi solveUsingCheckpoints(StateAssign *sa, int stateCount, int length,
+    int step) {
+  ForwardPass pass(sa, stateCount);
+
+  // Keep the accumulated costs at times 0, step, 2*step, etc.
+  int checkpointCount = (length - 1)/step + 1;
+  std::vector<double> checkpoints(int64_t(checkpointCount)*stateCount);
+  std::vector<double> prev(stateCount), next(stateCount);
+  std::vector<Ptr> ptrs(int64_t(step)*stateCount);
+  sa->getStateCosts(0, prev.data());
+  std::copy(prev.begin(), prev.end(), checkpoints.begin());
+  for (int time = 1; time < length; time++) {
+    pass.step(time, prev.data(), next.data(), ptrs.data());
+    prev.swap(next);
+    if (time % step == 0) {
+      std::copy(prev.begin(), prev.end(),
+          checkpoints.begin() + int64_t(time/step)*stateCount);
+    }
+  }
+
+  Arrayi states(length);
+  states.setTo(-1);
+  int last = length - 1;
+  states[last] = getLastBestState(prev.data(), stateCount);
+
+  // Going backward, recompute the pointers between two checkpoints
+  // and follow them.
+  for (int i = checkpointCount - 1; i >= 0; i--) {
+    int from = i*step;
+    int to = std::min(last, from + step);
+    std::copy(checkpoints.begin() + int64_t(i)*stateCount,
+        checkpoints.begin() + int64_t(i + 1)*stateCount, prev.begin());
+    for (int time = from + 1; time <= to; time++) {
+      pass.step(time, prev.data(), next.data(),
+          ptrs.data() + int64_t(time - from - 1)*stateCount);
+      prev.swap(next);
+    }
+    for (int time = to; time > from; time--) {
+      int index = ptrs[int64_t(time - from - 1)*stateCount + states[time]];
+      assert(index != -1);
+      states[time-1] = index;
+    }
+  }
+  return states;
+}
+
+}
+
+void StateAssign::accumulateCosts(MDArray2d *costsOut, MDArray2i *ptrsOut) {
+  int length = getLength();
+  int stateCount = getStateCount();
+
+  // Every column holds the states of one time index, contiguously.
+  MDArray2d costs(stateCount, length);
+  MDArray2i ptrs(stateCount, length);
+  costs.setAll(0.0);
+  ptrs.setAll(-1);
+  if (length == 0 || stateCount == 0) {
+    *costsOut = costs;
+    *ptrsOut = ptrs;
+    return;
+  }
+  getStateCosts(0, costs.getPtrAt(0, 0));
+
+  ForwardPass pass(this, stateCount);
+  for (int time = 1; time < length; time++) { // For every time index >= 1
+    pass.step(time, costs.getPtrAt(0, time-1),
+        costs.getPtrAt(0, time), ptrs.getPtrAt(0, time));
+  }
+
+  // Output the results
+  *costsOut = costs;
+  *ptrsOut = ptrs;
+}
+
+Arrayi StateAssign::solveWithCheckpoints(int step) {
+  int length = getLength();
+  int stateCount = getStateCount();
+  CHECK_LT(0, length);
+  CHECK_LT(0, stateCount);
+  if (step <= 0) {
+    step = std::max(1, int(ceil(sqrt(double(length)))));
+  }
+
+  // The pointers take values in -1..(stateCount-1)
+  if (stateCount <= std::numeric_limits<int8_t>::max()) {
+    return solveUsingCheckpoints<int8_t>(this, stateCount, length, step);
+  } else if (stateCount <= std::numeric_limits<int16_t>::max()) {
+    return solveUsingCheckpoints<int16_t>(this, stateCount, length, step);
+  }
+  return solveUsingCheckpoints<int32_t>(this, stateCount, length, step);
 }
 
 Arrayi StateAssign::unwind(MDArray2d costs, MDArray2i ptrs) {
@@ -128,7 +286,7 @@ Arrayi StateAssign::unwind(MDArray2d costs, MDArray2i ptrs) {
   Arrayi states(length);
   states.setTo(-1);
   int last = length - 1;
-  states[last] = getLastBestState(costs);
+  states[last] = getLastBestState(costs.getPtrAt(0, last), stateCount);
 
   for (int time = last-1; time >= 0; time--) {
     int next = time + 1;
@@ -43,10 +43,32 @@ class StateAssign {
   // of a state 'stateIndex' at a time 'timeIndex'.
   virtual Arrayi getPrecedingStates(int stateIndex, int timeIndex) = 0;
 
+  // The costs of all states at a time, and of a batch of transitions
+  // between two times, as used by solve(). By default, these methods call
+  // getStateCost and getTransitionCost, but they can be overridden to
+  // compute what the states at a time have in common only once.
+  //
+  // Fills 'dst' with the cost of every state at 'timeIndex'.
+  virtual void getStateCosts(int timeIndex, double *dst);
+
+  // Fills dst[k] with the cost of going from state 'fromStateIndices[k]'
+  // at 'fromTimeIndex' to state 'toStateIndices[k]' at 'fromTimeIndex+1',
+  // for k in 0..(count - 1).
+  virtual void getTransitionCosts(int fromTimeIndex, int count,
+      const int *fromStateIndices, const int *toStateIndices, double *dst);
+
   // Computes an optimal state assignment with this
   // for the problem specified by this object.
   Arrayi solve();
 
+  // Computes the same assignment as solve(), without keeping the
+  // accumulated costs and pointers of all time indices: only the costs of
+  // every 'step' time index are kept, and the pointers are recomputed
+  // from them between two such checkpoints. That takes twice the time, but
+  // only O(stateCount*sqrt(length)) memory with the default step of
+  // sqrt(length). solve() calls it for large problems.
+  Arrayi solveWithCheckpoints(int step = 0);
+
   // Lists all state indices, 0..(getStateCount() - 1). This list is suitable to return from
   // the method getPrecedingStates.
   Arrayi listStateInds();
@@ -62,8 +84,6 @@ class StateAssign {
   double calcCost(Arrayi stateSeq);
  private:
   void accumulateCosts(MDArray2d *costsOut, MDArray2i *ptrsOut);
-  double calcBestPred(MDArray2d costs, Arrayi preds, int toState, int fromTime,
-                      int *bestPredIndexOut);
   Arrayi unwind(MDArray2d costs, MDArray2i ptrs);
 };
 
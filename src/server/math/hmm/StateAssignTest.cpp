@@ -6,7 +6,9 @@
  */
 
 #include "StateAssign.h"
+#include <cmath>
 #include <gtest/gtest.h>
+#include <limits>
 
 using namespace sail;
 
@@ -150,3 +152,116 @@ TEST(StateAssignTest, NoisyStepGrammar) {
 }
 
 
+
+namespace {
+// Every other time, state 2 can only be reached from itself.
+class AlternatingPreds : public StateAssign {
+ public:
+  AlternatingPreds() : _all(listStateInds()), _self{2} {}
+
+  double getStateCost(int stateIndex, int timeIndex) {
+    return std::abs(sin(3.0*stateIndex + 7.0*timeIndex));
+  }
+
+  double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+    return fromStateIndex == toStateIndex? 0.0 : 0.25*(1 + fromTimeIndex % 3);
+  }
+
+  int getStateCount() {return 3;}
+  int getLength() {return 7;}
+
+  Arrayi getPrecedingStates(int stateIndex, int timeIndex) {
+    return stateIndex == 2 && timeIndex % 2 == 1? _self : _all;
+  }
+
+  bool isValid(const Arrayi &seq) {
+    for (int i = 1; i < seq.size(); i++) {
+      if (getPrecedingStates(seq[i], i).find(seq[i-1]) == -1) {
+        return false;
+      }
+    }
+    return true;
+  }
+ private:
+  Arrayi _all, _self;
+};
+}
+
+namespace {
+// The same problem, but the predecessors are refilled in place in one
+// array that is returned at every call.
+class InPlacePreds : public AlternatingPreds {
+ public:
+  InPlacePreds() : _buffer(3) {}
+
+  Arrayi getPrecedingStates(int stateIndex, int timeIndex) {
+    Arrayi src = AlternatingPreds::getPrecedingStates(stateIndex, timeIndex);
+    for (int i = 0; i < src.size(); i++) {
+      _buffer[i] = src[i];
+    }
+    return _buffer.sliceTo(src.size());
+  }
+ private:
+  Arrayi _buffer;
+};
+
+void expectBestOfAllValid(AlternatingPreds *problem) {
+  AlternatingPreds &test = *problem;
+  int n = test.getLength();
+
+  // Compare with the best of all valid sequences
+  double bestCost = std::numeric_limits<double>::infinity();
+  Arrayi seq(n);
+  int total = 1;
+  for (int i = 0; i < n; i++) {
+    total *= 3;
+  }
+  for (int code = 0; code < total; code++) {
+    for (int i = 0, c = code; i < n; i++, c /= 3) {
+      seq[i] = c % 3;
+    }
+    if (test.isValid(seq)) {
+      bestCost = std::min(bestCost, test.calcCost(seq));
+    }
+  }
+
+  Arrayi result = test.solve();
+  EXPECT_TRUE(test.isValid(result));
+  EXPECT_NEAR(bestCost, test.calcCost(result), 1.0e-9);
+}
+}
+
+TEST(StateAssignTest, TimeDependentPredecessors) {
+  AlternatingPreds test;
+  expectBestOfAllValid(&test);
+
+  InPlacePreds inPlace;
+  expectBestOfAllValid(&inPlace);
+  MDArray2d expected = test.makeCostMatrix();
+  MDArray2d actual = inPlace.makeCostMatrix();
+  ASSERT_EQ(expected.rows(), actual.rows());
+  ASSERT_EQ(expected.cols(), actual.cols());
+  for (int i = 0; i < expected.rows(); i++) {
+    for (int j = 0; j < expected.cols(); j++) {
+      EXPECT_EQ(expected(i, j), actual(i, j));
+    }
+  }
+}
+
+TEST(StateAssignTest, Checkpoints) {
+  NoisyStep noisy("000010010100011111110111001111");
+  noisy.useGrammar();
+  AlternatingPreds alternating;
+  StateAssign *problems[2] = {&noisy, &alternating};
+  for (auto problem: problems) {
+    Arrayi expected = problem->solve();
+    int n = problem->getLength();
+    for (int step: {0, 1, 2, 3, 5, n - 1, n, n + 4}) {
+      Arrayi result = problem->solveWithCheckpoints(step);
+      ASSERT_EQ(expected.size(), result.size());
+      for (int i = 0; i < n; i++) {
+        EXPECT_EQ(expected[i], result[i]) << "step " << step << " at " << i;
+      }
+    }
+  }
+}
@@ -10,6 +10,8 @@
 #include <Poco/JSON/Stringifier.h>
 #include <device/Arduino/libraries/NmeaParser/NmeaParser.h>
 #include <device/Arduino/libraries/TargetSpeed/TargetSpeed.h>
+#include <device/anemobox/DispatcherSnapshot.h>
+#include <device/anemobox/DispatcherUtils.h>
 #include <device/anemobox/simulator/SimulateBox.h>
 #include <fstream>
 #include <iostream>
@@ -25,6 +27,7 @@
 #include <server/nautical/filters/SmoothGpsFilter.h>
 #include <server/nautical/grammars/TreeExplorer.h>
 #include <server/nautical/logimport/LogLoader.h>
+#include <server/nautical/logimport/LogManifest.h>
 #include <server/nautical/tiles/ChartTiles.h>
 #include <server/nautical/tiles/TileUtils.h>
 #include <server/plot/extra.h>
@@ -246,8 +249,30 @@ std::string grammarNodeInfo(const NavDataset& navs, std::shared_ptr<HTree> tree)
 
 }  // namespace
 
-NavDataset loadNavs(ArgMap &amap, std::string boatId) {
+std::vector<std::string> listLogFiles(ArgMap &amap) {
+  std::vector<std::string> filenames;
+  for (auto dirNameObj: amap.optionArgs("--dir")) {
+    for (auto filename: LogLoader::listFiles(dirNameObj->value())) {
+      filenames.push_back(filename);
+    }
+  }
+  for (auto fileNameObj: amap.optionArgs("--file")) {
+    filenames.push_back(fileNameObj->value());
+  }
+  return filenames;
+}
+
+std::vector<std::string> logFilePaths(const std::vector<LogFileEntry>& files) {
+  std::vector<std::string> paths;
+  for (const auto& entry: files) {
+    paths.push_back(entry.path);
+  }
+  return paths;
+}
+
+NavDataset loadNavs(ArgMap &amap, std::string boatId, int jobs) {
   LogLoader loader;
+  loader.setJobs(jobs);
   for (auto dirNameObj: amap.optionArgs("--dir")) {
     loader.load(dirNameObj->value());
   }
@@ -332,34 +357,175 @@ bool BoatLogProcessor::process(ArgMap* amap) {
 
   hack::ConfigureForBoat(_boatid);
 
+  bool success = _incremental? processIncrementally(amap) : processAll(amap);
+  if (!success) {
+    return false;
+  }
+
+  // Logging to cout and not LOG(INFO) because LOG(INFO) is disabled in
+  // production and we want to keep track of processing time.
+  std::cout << "Processing time for " << _boatid << ": "
+    << (TimeStamp::now() - start).seconds() << " seconds." << std::endl;
+  return true;
+}
+
+bool BoatLogProcessor::processAll(ArgMap* amap) {
   NavDataset current;
 
   if (_resumeAfterPrepare.size() > 0) {
-    current = LogLoader::loadNavDataset(_resumeAfterPrepare);
-  } else {
-    NavDataset loaded = loadNavs(*amap, _boatid);
-    hack::SelectSources(&loaded);
-    loaded.dispatcher()->setSourcePriority(" reparsed", -1);
-
-    current = removeStrangeGpsPositions(loaded);
-    infoNavDataset("After loading", current);
-
-    auto minGpsSamplingPeriod = 0.01_s; // Should be enough, right?
-    current = current.createMergedChannels(
-        std::set<DataCode>{GPS_POS, GPS_SPEED, GPS_BEARING},
-        minGpsSamplingPeriod);
-    infoNavDataset("After resampling GPS", current);
-
-    if (_gpsFilter) {
-      current = filterNavs(current, &_htmlReport, _gpsFilterSettings);
-      infoNavDataset("After filtering", current);
+    if (isDispatcherSnapshot(_resumeAfterPrepare)) {
+      auto dispatcher = loadDispatcherSnapshot(_resumeAfterPrepare);
+      if (!dispatcher) {
+        return false;
+      }
+      current = NavDataset(dispatcher);
+    } else {
+      // Saved with saveDispatcher, before snapshots
+      current = LogLoader::loadNavDataset(_resumeAfterPrepare);
     }
+  } else {
+    current = prepareNavs(loadNavs(*amap, _boatid, _jobs));
   }
 
   if (_savePreparedData.size() != 0) {
-    saveDispatcher(_savePreparedData.c_str(), *(current.dispatcher()));
+    saveDispatcherSnapshot(_savePreparedData, *(current.dispatcher()));
+  }
+
+  return processPrepared(current, Span<TimeStamp>());
+}
+
+bool BoatLogProcessor::processIncrementally(ArgMap* amap) {
+  std::string manifestPath = _dstPath.toString() + "/logmanifest.tsv";
+  std::vector<LogFileEntry> files;
+  for (const auto& filename: listLogFiles(*amap)) {
+    files.push_back(statLogFile(filename));
+  }
+
+  LogManifest manifest;
+  if (!manifest.load(manifestPath) || !Poco::File(boatDatPath()).exists()) {
+    LOG(INFO) << "No log manifest or boat.dat for " << _boatid
+      << ", processing all files";
+    _tileParams.fullClean = true;
+    LogLoader loader;
+    loader.setJobs(_jobs);
+    std::vector<Span<TimeStamp>> spans;
+    std::vector<bool> loaded;
+    loader.loadFiles(logFilePaths(files), &spans, &loaded);
+    if (!processPrepared(prepareNavs(loader.makeNavDataset()),
+                         Span<TimeStamp>())) {
+      return false;
+    }
+    LogManifest processed;
+    processed.update(files, loaded, spans, {});
+    return processed.save(manifestPath);
   }
 
+  std::vector<LogFileEntry> changed, removed;
+  manifest.diff(files, &changed, &removed);
+  if (changed.empty() && removed.empty()) {
+    LOG(INFO) << "No new log files for " << _boatid;
+    return true;
+  }
+
+  // The data of the changed files, and what they held before, if
+  // anything, need to be reprocessed. Files that fail to load are
+  // left out of the manifest, so that they are tried again next run.
+  std::vector<Span<TimeStamp>> spans;
+  {
+    std::vector<Span<TimeStamp>> loadedSpans;
+    std::vector<bool> loaded;
+    LogLoader loader;
+    loader.setJobs(_jobs);
+    loader.loadFiles(logFilePaths(changed), &loadedSpans, &loaded);
+    spans = manifest.update(changed, loaded, loadedSpans, removed);
+  }
+
+  // Aligned for uploadChartTilesInRange, and extended so that
+  // sessions are never cut.
+  Duration<> alignment = _chartTileSettings.coarsestSampleSpan();
+  auto ranges = extendToStoredSessions(
+      affectedTimeRanges(spans,
+          Duration<>::hours(_incrementalMarginHours), alignment),
+      alignment);
+
+  _tileParams.fullClean = false;
+  for (const auto& range: ranges) {
+    LOG(INFO) << "Reprocessing " << _boatid << " from "
+      << range.minv().toString() << " to " << range.maxv().toString();
+    LogLoader loader;
+    loader.setJobs(_jobs);
+    loader.loadFiles(manifest.filesOverlapping(range.minv(), range.maxv()));
+    loader.keepOnly(range.minv(), range.maxv());
+    NavDataset loaded = loader.makeNavDataset();
+    if (countValues(loaded.dispatcher().get()) == 0) {
+      removeRange(range);
+    } else if (!processPrepared(prepareNavs(loaded), range)) {
+      return false;
+    }
+  }
+  return manifest.save(manifestPath);
+}
+
+std::vector<Span<TimeStamp>> BoatLogProcessor::extendToStoredSessions(
+    std::vector<Span<TimeStamp>> ranges, Duration<> alignment) {
+  if (!_generateTiles) {
+    return ranges;
+  }
+  while (true) {
+    std::vector<Span<TimeStamp>> extended;
+    for (auto range: ranges) {
+      range.extend(storedSessionSpan(
+          _boatid, range.minv(), range.maxv(), db.db, _tileParams));
+      extended.push_back(range);
+    }
+    extended = affectedTimeRanges(extended, Duration<>::seconds(0),
+                                  alignment);
+    if (extended == ranges) {
+      return ranges;
+    }
+    ranges = extended;
+  }
+}
+
+void BoatLogProcessor::removeRange(const Span<TimeStamp>& range) {
+  LOG(INFO) << "No data left from " << range.minv().toString()
+    << " to " << range.maxv().toString();
+  if (_generateTiles) {
+    removeTilesAndSessionsInRange(
+        _boatid, range.minv(), range.maxv(), db.db, _tileParams);
+  }
+  if (_generateChartTiles) {
+    uploadChartTilesInRange(NavDataset(std::make_shared<Dispatcher>()),
+        _boatid, _chartTileSettings, db.db, range.minv(), range.maxv());
+  }
+}
+
+NavDataset BoatLogProcessor::prepareNavs(NavDataset loaded) {
+  hack::SelectSources(&loaded);
+  loaded.dispatcher()->setSourcePriority(" reparsed", -1);
+
+  NavDataset current = removeStrangeGpsPositions(loaded);
+  infoNavDataset("After loading", current);
+
+  auto minGpsSamplingPeriod = 0.01_s; // Should be enough, right?
+  current = current.createMergedChannels(
+      std::set<DataCode>{GPS_POS, GPS_SPEED, GPS_BEARING},
+      minGpsSamplingPeriod);
+  infoNavDataset("After resampling GPS", current);
+
+  if (_gpsFilter) {
+    current = filterNavs(current, &_htmlReport, _gpsFilterSettings);
+    infoNavDataset("After filtering", current);
+  }
+  return current;
+}
+
+std::string BoatLogProcessor::boatDatPath() const {
+  return _dstPath.toString() + "/boat.dat";
+}
+
+bool BoatLogProcessor::processPrepared(NavDataset current,
+                                       const Span<TimeStamp>& range) {
   // Note: the grammar does not have access to proper true wind.
   // It has to do its own estimate.
   hack::SelectSources(&current);
@@ -373,54 +539,74 @@ bool BoatLogProcessor::process(ArgMap* amap) {
 
   if (!fulltree) {
     LOG(WARNING) << "grammar parsing failed. No data? boat: " << _boatid;
+    if (range.initialized()) {
+      removeRange(range);
+      return true;
+    }
     return false;
   }
 
   grammarDebug(fulltree, current);
 
-  Calibrator calibrator(_grammar.grammar);
-  if (_verboseCalibrator) { calibrator.setVerbose(); }
-  std::string boatDatPath = _dstPath.toString() + "/boat.dat";
-  std::ofstream boatDatFile(boatDatPath);
-  CHECK(boatDatFile.is_open()) << "Error opening " << boatDatPath;
-
-  // Calibrate. TODO: use filtered data instead of resampled.
-  if (calibrator.calibrate(current, fulltree, _boatid)) {
-      calibrator.saveCalibration(&boatDatFile);
+  std::string boatDatPath = this->boatDatPath();
+  if (range.initialized()) {
+    // Calibration and target speeds are estimated from all the data,
+    // so keep those of the last full run.
+    current = SimulateBox(boatDatPath,
+                          current.stripSource("Anemomind estimator"),
+                          SimulationMode::Batch, _jobs);
+    current = current.preferSourceOrCreateMergedChannels(
+        std::set<DataCode>{TWS, TWDIR, TWA, VMG},
+        "Simulated Anemomind estimator");
+
+    if (_saveSimulated.size() > 0) {
+      saveDispatcher(_saveSimulated.c_str(), *(current.dispatcher()));
+    }
   } else {
-    LOG(WARNING) << "Calibration failed. Using default calib values.";
-    calibrator.clear();
-    if (_saveDefaultCalib) {
-      calibrator.saveCalibration(&boatDatFile);
+    Calibrator calibrator(_grammar.grammar);
+    if (_verboseCalibrator) { calibrator.setVerbose(); }
+    std::ofstream boatDatFile(boatDatPath);
+    CHECK(boatDatFile.is_open()) << "Error opening " << boatDatPath;
+
+    // Calibrate. TODO: use filtered data instead of resampled.
+    if (calibrator.calibrate(current, fulltree, _boatid)) {
+        calibrator.saveCalibration(&boatDatFile);
+    } else {
+      LOG(WARNING) << "Calibration failed. Using default calib values.";
+      calibrator.clear();
+      if (_saveDefaultCalib) {
+        calibrator.saveCalibration(&boatDatFile);
+      }
     }
-  }
 
-  // First simulation pass: adds true wind
-  current = calibrator.simulate(current.stripSource("Anemomind estimator"));
+    // First simulation pass: adds true wind
+    current = calibrator.simulate(current.stripSource("Anemomind estimator"));
 
-  // This choice should be left to the user.
-  // TODO: add a per-boat configuration system
-  current = current.preferSourceOrCreateMergedChannels(
-      std::set<DataCode>{TWS, TWDIR, TWA, VMG},
-      "Simulated Anemomind estimator");
+    // This choice should be left to the user.
+    // TODO: add a per-boat configuration system
+    current = current.preferSourceOrCreateMergedChannels(
+        std::set<DataCode>{TWS, TWDIR, TWA, VMG},
+        "Simulated Anemomind estimator");
 
-  if (_saveSimulated.size() > 0) {
-    saveDispatcher(_saveSimulated.c_str(), *(current.dispatcher()));
-  }
+    if (_saveSimulated.size() > 0) {
+      saveDispatcher(_saveSimulated.c_str(), *(current.dispatcher()));
+    }
 
-  outputTargetSpeedTable(_debug, 
-                         fulltree,
-                         _grammar.grammar.nodeInfo(),
-                         current,
-                         _vmgSampleSelection,
-                         &boatDatFile);
+    outputTargetSpeedTable(_debug, 
+                           fulltree,
+                           _grammar.grammar.nodeInfo(),
+                           current,
+                           _vmgSampleSelection,
+                           &boatDatFile);
 
-  // write calibration and target speed to disk
-  boatDatFile.close();
+    // write calibration and target speed to disk
+    boatDatFile.close();
 
-  // Second simulation path to apply target speed.
-  // Todo: simply lookup the target speed instead of recomputing true wind.
-  current = SimulateBox(boatDatPath, current);
+    // Second simulation path to apply target speed.
+    // Todo: simply lookup the target speed instead of recomputing true wind.
+    current = SimulateBox(boatDatPath, current, SimulationMode::Batch,
+                          _jobs);
+  }
 
   if (_debug) {
     visualizeBoatDat(_dstPath);
@@ -437,6 +623,11 @@ bool BoatLogProcessor::process(ArgMap* amap) {
 
   HTML_DISPLAY(_generateTiles, &_htmlReport);
   if (_generateTiles) {
+    if (range.initialized()) {
+      removeTilesAndSessionsInRange(
+          _boatid, range.minv(), range.maxv(), db.db, _tileParams);
+    }
+
     // Make sure the GPS_POS source is the one used to create fulltree
     // otherwise, the indices it contains will be invalid.
     current.selectSource(GPS_POS, treeBaseChannel->source());
@@ -451,16 +642,15 @@ bool BoatLogProcessor::process(ArgMap* amap) {
 
   HTML_DISPLAY(_generateChartTiles, &_htmlReport);
   if (_generateChartTiles) {
-    if (!uploadChartTiles(
-        current, _boatid, _chartTileSettings, db.db)) {
+    bool uploaded = range.initialized()?
+      uploadChartTilesInRange(current, _boatid, _chartTileSettings, db.db,
+                              range.minv(), range.maxv())
+      : uploadChartTiles(current, _boatid, _chartTileSettings, db.db);
+    if (!uploaded) {
       LOG(ERROR) << "Failed to upload chart tiles!";
       return false;
     }
   }
-  // Logging to cout and not LOG(INFO) because LOG(INFO) is disabled in
-  // production and we want to keep track of processing time.
-  std::cout << "Processing time for " << _boatid << ": "
-    << (TimeStamp::now() - start).seconds() << " seconds." << std::endl;
   return true;
 }
 
@@ -506,6 +696,7 @@ void BoatLogProcessor::readArgs(ArgMap* amap) {
   _gpsFilter = !amap->optionProvided("--no-gps-filter");
 
   _tileParams.fullClean = amap->optionProvided("--clean");
+  _incremental = amap->optionProvided("--incremental");
 
   _exploreGrammar = amap->optionProvided("--explore");
   _logGrammar = amap->optionProvided("--log-grammar");
@@ -521,11 +712,23 @@ void BoatLogProcessor::readArgs(ArgMap* amap) {
   }
 
   _tileParams.curveCutThreshold = _gpsFilterSettings.subProblemThreshold;
+  _gpsFilterSettings.threadCount = _jobs;
+  _grammar.grammar.setThreadCount(_jobs);
+  _tileParams.threadCount = _jobs;
 }
 
 bool BoatLogProcessor::prepare(ArgMap* amap) {
   readArgs(amap);
 
+  // Prepared data covers all files, while an incremental run only
+  // loads the files of the ranges it reprocesses.
+  if (_incremental && (!_savePreparedData.empty()
+                       || !_resumeAfterPrepare.empty())) {
+    LOG(ERROR) << "--incremental can't be combined with --save-prepared "
+      "or --continue-prepared";
+    return false;
+  }
+
   if (!_htmlReportName.empty()) {
     _htmlReport = DOM::makeBasicHtmlPage("Boat log processor",
           _dstPath.toString(), _htmlReportName);
@@ -579,6 +782,11 @@ int mainProcessBoatLogs(int argc, const char **argv) {
 
   amap.registerOption("--no-gps-filter", "skip gps filtering").setArgCount(0);
 
+  amap.registerOption("--jobs",
+      "Number of threads loading log files, filtering GPS data, "
+      "parsing sessions and computing tiles, 0 for one per core (default)")
+    .store(&processor._jobs);
+
   amap.disableFreeArgs();
 
   TileGeneratorParameters* params = &processor._tileParams;
@@ -599,6 +807,17 @@ int mainProcessBoatLogs(int argc, const char **argv) {
 
   amap.registerOption("--clean", "Clean all tiles for this boat before starting");
 
+  amap.registerOption("--incremental",
+      "Only reprocess the time ranges of new, modified or removed log files, "
+      "keeping a list of processed files in the destination directory. "
+      "Processes everything if that list or boat.dat is missing. "
+      "Calibration and target speeds are only updated by full runs. "
+      "Can't be combined with --save-prepared or --continue-prepared.");
+
+  amap.registerOption("--incremental-margin",
+      "Hours of data to reprocess around changed log files (default 1)")
+    .store(&processor._incrementalMarginHours);
+
   amap.registerOption(
       "--debug-vmg",
       "Print detailed information about samples used for VMG target speed tables")
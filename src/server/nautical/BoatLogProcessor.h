@@ -9,6 +9,7 @@
 #include <Poco/Path.h>
 #include <server/common/ArgMap.h>
 #include <server/common/DOMUtils.h>
+#include <server/common/Span.h>
 #include <server/nautical/Nav.h>
 #include <server/nautical/filters/SmoothGpsFilter.h>
 #include <server/nautical/grammars/WindOrientedGrammar.h>
@@ -38,6 +39,25 @@ struct BoatLogProcessor {
   bool process(ArgMap* amap);
   void readArgs(ArgMap* amap);
   bool prepare(ArgMap* amap);
+
+  // Load, calibrate and upload everything.
+  bool processAll(ArgMap* amap);
+
+  // Only reprocess the time ranges of the log files that have been
+  // added, modified or removed since the last run. See LogManifest.
+  bool processIncrementally(ArgMap* amap);
+
+  // Early filtering of loaded data
+  NavDataset prepareNavs(NavDataset loaded);
+
+  // Grammar, calibration, simulation and upload of prepared data. If
+  // 'range' is initialized, only that time range is reprocessed, with
+  // the calibration and target speeds of the existing boat.dat.
+  bool processPrepared(NavDataset current, const Span<TimeStamp>& range);
+
+  // Removes what has been uploaded for a range without any data left.
+  void removeRange(const Span<TimeStamp>& range);
+
   void infoNavDataset(
       const std::string& info, const NavDataset& ds);
 
@@ -60,12 +80,18 @@ struct BoatLogProcessor {
   bool _exploreGrammar = false;
   bool _logGrammar = false;
   bool _saveDefaultCalib = false;
+  int _jobs = 0;
+  bool _incremental = false;
+  double _incrementalMarginHours = 1.0;
 
   MongoDBConnection db;
 
   DOM::Node _htmlReport;
 
 private:
+  std::string boatDatPath() const;
+  std::vector<Span<TimeStamp>> extendToStoredSessions(
+      std::vector<Span<TimeStamp>> ranges, Duration<> alignment);
   void grammarDebug(
       const std::shared_ptr<HTree> &fulltree,
       const NavDataset &resampled) const;
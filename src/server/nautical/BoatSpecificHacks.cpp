@@ -20,7 +20,7 @@ const char kDentuso4[] = "57b18c02613e181e220a78ef";
 }
 
 bool forceDateForGLL = false;
-int bootCount = 0;
+thread_local int bootCount = 0;
 
 
 void ConfigureForBoat(const std::string& boatId) {
@@ -25,7 +25,8 @@ namespace hack {
 extern bool forceDateForGLL;
 
 // Used to generate dates when the above is true.
-extern int bootCount;
+// Set while loading a log file, in the thread that loads it.
+extern thread_local int bootCount;
 
 void ConfigureForBoat(const std::string& boatId);
 
@@ -62,7 +62,7 @@ NavDataset downSampleGpsTo1Hz(const NavDataset& navs) {
   return navs.replaceChannel<GeographicPosition<double> >(
       GPS_POS,
       navs.dispatcher()->get<GPS_POS>()->source() + " resampled to 1Hz",
-      downSamplePosTo1Hz(navs.samples<GPS_POS>()).samples());
+      downSamplePosTo1Hz(navs.samples<GPS_POS>()).toTimedVector());
 }
 
 }  // namespace sail
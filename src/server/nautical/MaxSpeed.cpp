@@ -2,6 +2,7 @@
 
 #include <server/nautical/MaxSpeed.h>
 
+#include <algorithm>
 #include <server/nautical/WGS84.h>
 
 namespace sail {
@@ -46,6 +47,46 @@ Optional<TimedValue<Velocity<double>>> computeMaxSpeedOverPeriod(
   }
 }
 
+Optional<TimedValue<Velocity<double>>> computeMaxSpeedOverPeriod(
+    const Array<TimeStamp>& times,
+    const Array<GeographicPosition<double>>& positions,
+    Duration<> delta) {
+  int n = times.size();
+  Optional<Velocity<>> bestSpeed;
+  TimeStamp bestTime, bestEnd;
+  for (int i = 0; i < n; i++) {
+    // The position nearest to times[i] + delta, like
+    // TimedSampleCollection::nearest.
+    TimeStamp t = times[i] + delta;
+    if (t < times[0] || times[n - 1] < t) {
+      continue;
+    }
+    int j = std::lower_bound(times.begin(), times.end(), t) - times.begin();
+    if (0 < j && (times[j - 1] - t).fabs() < (times[j] - t).fabs()) {
+      j--;
+    }
+    if (times[j] <= times[i]) {
+      continue;
+    }
+
+    Velocity<> speed =
+      distance(positions[i], positions[j]) / (times[j] - times[i]);
+
+    if (bestSpeed.undefined() || bestSpeed.get() < speed) {
+      bestSpeed = speed;
+      bestTime = times[i];
+      bestEnd = times[j];
+    }
+  }
+  if (bestSpeed.defined()) {
+    return makeOptional(TimedValue<Velocity<double>>(
+            (bestTime + (bestEnd - bestTime) * .5),
+            bestSpeed.get()));
+  } else {
+    return Optional<TimedValue<Velocity<double>>>();
+  }
+}
+
 Optional<TimedValue<Velocity<double>>> computeInstantMaxSpeed(
     const NavDataset& data) {
   auto speeds = data.samples<GPS_SPEED>();
@@ -1,6 +1,8 @@
 #ifndef NAUTICAL_MAX_SPEED_H
 #define NAUTICAL_MAX_SPEED_H
 
+#include <server/common/Array.h>
+#include <server/nautical/GeographicPosition.h>
 #include <server/nautical/NavDataset.h>
 
 namespace sail {
@@ -10,6 +12,12 @@ Optional<TimedValue<Velocity<double>>> computeInstantMaxSpeed(const NavDataset&
 Optional<TimedValue<Velocity<double>>> computeMaxSpeedOverPeriod(
     const NavDataset& data, Duration<> delta = Duration<>::seconds(30));
 
+// The same, for positions sorted by time, such as those of a NavFrame.
+Optional<TimedValue<Velocity<double>>> computeMaxSpeedOverPeriod(
+    const Array<TimeStamp>& times,
+    const Array<GeographicPosition<double>>& positions,
+    Duration<> delta = Duration<>::seconds(30));
+
 }  // namespace sail
 
 #endif  // NAUTICAL_MAX_SPEED_H
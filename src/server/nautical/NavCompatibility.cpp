@@ -15,6 +15,7 @@
 #include <server/nautical/NavCompatibility.h>
 #include <server/nautical/WGS84.h>
 #include <server/plot/extra.h>
+#include <vector>
 
 namespace sail {
 
@@ -203,6 +204,110 @@ namespace {
     }
   }
 
+  // Same lookup as getValue, but for query times that don't decrease:
+  // the position in the time column only moves forward, so looking up
+  // all the GPS times of a dataset is linear in the number of samples.
+  // Ties are resolved like in findNearestTimedValue.
+  template <typename T>
+  class NearestValueCursor {
+   public:
+    NearestValueCursor() : _times(nullptr), _values(nullptr), _size(0), _pos(0) {}
+    NearestValueCursor(const int64_t *times, const T *values, size_t size) :
+      _times(times), _values(values), _size(size), _pos(0) {}
+
+    Optional<T> at(TimeStamp time) {
+      int64_t x = time.toMilliSecondsSince1970();
+      if (_size == 0 || x < _times[0] || _times[_size - 1] < x) {
+        return Optional<T>();
+      }
+      if (0 < _pos && x <= _times[_pos - 1]) {
+        _pos = lowerBoundTime(_times, _size, x);
+      }
+      while (_times[_pos] < x) {
+        _pos++;
+      }
+      size_t i = _pos;
+      if (0 < i && x - _times[i - 1] < _times[i] - x) {
+        i--;
+      }
+      if (fabs(TimeStamp::fromMilliSecondsSince1970(_times[i]) - time)
+          < maxMergeDif) {
+        return Optional<T>(_values[i]);
+      }
+      return Optional<T>();
+    }
+   private:
+    const int64_t *_times;
+    const T *_values;
+    size_t _size, _pos;
+  };
+
+  template <DataCode Code>
+  NearestValueCursor<typename TypeForCode<Code>::type> makeChannelCursor(
+      const NavDataset &ds) {
+    typedef typename TypeForCode<Code>::type T;
+    if (ds.hasActiveChannel(Code)) {
+      auto samples = ds.samples<Code>();
+      if (!samples.empty()) {
+        return NearestValueCursor<T>(
+            samples.times(), samples.values(), samples.size());
+      }
+    }
+    return NearestValueCursor<T>();
+  }
+
+  // Same lookup as lookUpFilteredSources, with one cursor per source.
+  template <DataCode Code>
+  class FilteredSourcesCursor {
+   public:
+    typedef typename TypeForCode<Code>::type T;
+
+    FilteredSourcesCursor(const Dispatcher &dispatcher,
+        bool (*sourceFilter)(const std::string&)) {
+      const auto &all = dispatcher.allSources();
+      auto found = all.find(Code);
+      if (found != all.end()) {
+        for (auto srcName: found->second) {
+          if (sourceFilter(srcName.first)) {
+            Source src;
+            src.priority = dispatcher.sourcePriority(srcName.first);
+            TypedDispatchData<T>* tdd =
+              toTypedDispatchData<Code>(srcName.second.get());
+            if (tdd != nullptr) {
+              auto samples = tdd->dispatcher()->values().samples();
+              src.cursor = NearestValueCursor<T>(
+                  samples.times(), samples.values(), samples.size());
+            }
+            _sources.push_back(src);
+          }
+        }
+      }
+    }
+
+    Optional<T> at(TimeStamp time) {
+      Optional<T> result;
+      int bestPrio = std::numeric_limits<int>::min();
+      for (auto &src: _sources) {
+        if (result.undefined() || src.priority > bestPrio) {
+          bestPrio = src.priority;
+          result = src.cursor.at(time);
+        }
+      }
+      return result;
+    }
+   private:
+    struct Source {
+      int priority = 0;
+      NearestValueCursor<T> cursor;
+    };
+    std::vector<Source> _sources;
+  };
+
+  template <typename T, typename Arg>
+  void setIfDefined(const Optional<T> &x, Nav *dst, void (Nav::* set)(Arg)) {
+    if (x.defined()) { ((*dst).*set)(x.get()); }
+  }
+
 }
 
 
@@ -304,12 +409,71 @@ bool isEmpty(const NavDataset &ds) {
 }
 
 Array<Nav> makeArray(const NavDataset &ds) {
-  int n = getNavSize(ds);
-  Array<Nav> dst(n);
+  Array<Nav> dst(getNavSize(ds));
+  forEachNav(ds, [&](int i, const Nav &x) { dst[i] = x; });
+  return dst;
+}
+
+void forEachNav(const NavDataset &ds,
+                const std::function<void(int, const Nav&)> &f) {
+  const auto &samples = getGpsPositions(ds);
+  int n = samples.size();
+  if (n == 0) {
+    return;
+  }
+
+  // Fills the navs like getNav does, but walks every channel forward
+  // together with the GPS positions instead of searching them.
+  auto awa = makeChannelCursor<AWA>(ds);
+  auto aws = makeChannelCursor<AWS>(ds);
+  auto twdir = makeChannelCursor<TWDIR>(ds);
+  auto tws = makeChannelCursor<TWS>(ds);
+  FilteredSourcesCursor<TWA> deviceTwa(*ds.dispatcher(), sourceIsInternal);
+  FilteredSourcesCursor<TWA> externalTwa(*ds.dispatcher(), sourceIsExternal);
+  FilteredSourcesCursor<TWS> deviceTws(*ds.dispatcher(), sourceIsInternal);
+  FilteredSourcesCursor<TWS> externalTws(*ds.dispatcher(), sourceIsExternal);
+  auto gpsSpeed = makeChannelCursor<GPS_SPEED>(ds);
+  auto gpsBearing = makeChannelCursor<GPS_BEARING>(ds);
+  auto magHdg = makeChannelCursor<MAG_HEADING>(ds);
+  auto watSpeed = makeChannelCursor<WAT_SPEED>(ds);
+  auto vmg = makeChannelCursor<VMG>(ds);
+  auto targetVmg = makeChannelCursor<TARGET_VMG>(ds);
+  auto rudderAngle = makeChannelCursor<RUDDER_ANGLE>(ds);
+
   for (int i = 0; i < n; i++) {
-    dst[i] = getNav(ds, i);
+    auto timeAndPos = samples[i];
+    auto time = timeAndPos.time;
+
+    Nav nav;
+    nav.setBoatId(Nav::debuggingBoatId());
+    nav.setTime(time);
+    nav.setGeographicPosition(timeAndPos.value);
+
+    setIfDefined(awa.at(time), &nav, &Nav::setAwa);
+    setIfDefined(aws.at(time), &nav, &Nav::setAws);
+
+    auto twdirValue = twdir.at(time);
+    auto twsValue = tws.at(time);
+    if (twdirValue.defined() && twsValue.defined()) {
+      nav.setTrueWindOverGround(
+          windMotionFromTwdirAndTws(twdirValue.get(), twsValue.get()));
+    }
+
+    setIfDefined(deviceTwa.at(time), &nav, &Nav::setDeviceTwa);
+    setIfDefined(externalTwa.at(time), &nav, &Nav::setExternalTwa);
+    setIfDefined(deviceTws.at(time), &nav, &Nav::setDeviceTws);
+    setIfDefined(externalTws.at(time), &nav, &Nav::setExternalTws);
+
+    setIfDefined(gpsSpeed.at(time), &nav, &Nav::setGpsSpeed);
+    setIfDefined(gpsBearing.at(time), &nav, &Nav::setGpsBearing);
+    setIfDefined(magHdg.at(time), &nav, &Nav::setMagHdg);
+    setIfDefined(watSpeed.at(time), &nav, &Nav::setWatSpeed);
+    setIfDefined(vmg.at(time), &nav, &Nav::setDeviceVmg);
+    setIfDefined(targetVmg.at(time), &nav, &Nav::setDeviceTargetVmg);
+    setIfDefined(twdirValue, &nav, &Nav::setDeviceTwdir);
+    setIfDefined(rudderAngle.at(time), &nav, &Nav::setRudderAngle);
+    f(i, nav);
   }
-  return dst;
 }
 
 NavDataset fromNavs(const Array<Nav> &navs) {
@@ -499,6 +663,16 @@ Length<double> computeTrajectoryLength(NavDataset navs) {
   return dist;
 }
 
+Length<double> computeTrajectoryLength(
+    const Array<GeographicPosition<double>>& positions) {
+  Length<double> dist = Length<double>::meters(0.0);
+  int n = positions.size() - 1;
+  for (int i = 0; i < n; i++) {
+    dist = dist + distance(positions[i], positions[i+1]);
+  }
+  return dist;
+}
+
 // TODO: Return a timestamp instead, it makes more sense with our
 // Dispatcher-based representation.
 int findMaxSpeedOverGround(const Array<Nav>& navs) {
@@ -6,6 +6,7 @@
 #ifndef SERVER_NAUTICAL_NAVCOMPATIBILITY_H_
 #define SERVER_NAUTICAL_NAVCOMPATIBILITY_H_
 
+#include <functional>
 #include <server/nautical/Nav.h>
 #include <server/nautical/NavDataset.h>
 
@@ -27,6 +28,11 @@ int getMiddleIndex(const NavDataset &ds);
 int getLastIndex(const NavDataset &ds);
 bool isEmpty(const NavDataset &ds);
 Array<Nav> makeArray(const NavDataset &ds);
+
+// Calls f(i, getNav(ds, i)) for every i in order, in a single pass
+// over the channels of 'ds'.
+void forEachNav(const NavDataset &ds,
+                const std::function<void(int, const Nav&)> &f);
 NavDataset fromNavs(const Array<Nav> &navs);
 TimeStamp timeAt(const NavDataset& navs, int i);
 
@@ -99,6 +105,8 @@ void plotNavsEcefTrajectory(NavDataset navs);
 void plotNavsEcefTrajectories(Array<NavDataset> navs);
 int countNavs(Array<NavDataset> navs);
 Length<double> computeTrajectoryLength(NavDataset navs);
+Length<double> computeTrajectoryLength(
+    const Array<GeographicPosition<double>>& positions);
 int findMaxSpeedOverGround(const Array<Nav>& navs);
 
 }
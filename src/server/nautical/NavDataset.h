@@ -30,20 +30,15 @@ namespace sail {
 const std::set<DataCode>& AllDataCodes();
 
 // In order to view a slice
-// of a TimedSampleCollection<T>::TimedVector
+// of a TimedSampleCollection<T>
 template <typename T>
 class TimedSampleRange : public SampledSignal<T> {
  public:
   typedef typename sail::TimedSampleCollection<T>::TimedVector TimedVector;
-  typedef typename TimedVector::const_iterator Iterator;
+  typedef typename sail::TimedSampleCollection<T>::const_iterator Iterator;
   typedef TimedSampleRange<T> ThisType;
 
-  static const TimedVector& emptyVector() { static TimedVector e; return e; }
-
-  TimedSampleRange() :
-      _defined(false),
-      _begin(emptyVector().begin()),
-      _end(emptyVector().end()) {}
+  TimedSampleRange() : _defined(false) {}
 
   TimedSampleRange(const Iterator &b, const Iterator &e) :
     _defined(b <= e), _begin(b), _end(e) {}
@@ -56,12 +51,12 @@ class TimedSampleRange : public SampledSignal<T> {
 
   bool empty() const {return (_defined? _begin == _end : true);}
 
-  const TimedValue<T> &first() const {
+  TimedValue<T> first() const {
     assert(!empty());
     return *_begin;
   }
 
-  const TimedValue<T> &last() const {
+  TimedValue<T> last() const {
     assert(!empty());
     return *(_end - 1);
   }
@@ -84,11 +79,24 @@ class TimedSampleRange : public SampledSignal<T> {
     return *(_begin + i);
   }
 
+  // Direct access to the time column (milliseconds since 1970)
+  // and the value column of this range.
+  const int64_t *times() const {return _begin.timePtr();}
+  const T *values() const {return _begin.valuePtr();}
+
+  Iterator lowerBound(TimeStamp t) const {
+    return sail::lowerBound(_begin, _end, t);
+  }
+
+  Iterator upperBound(TimeStamp t) const {
+    return sail::upperBound(_begin, _end, t);
+  }
+
   Optional<TimedValue<T> > nearest(TimeStamp t) const {
     if (empty()) {
       return Optional<TimedValue<T> >();
     }
-    return findNearestTimedValue<T, Iterator>(_begin, _end, t);
+    return findNearestTimedValue<T>(_begin, _end, t);
   }
 
   bool operator== (const ThisType &other) const {
@@ -252,11 +260,10 @@ public:
       return TimedSampleRange<typename TypeForCode<Code>::type>();
     }
 
-    const typename TimedSampleCollection<typename TypeForCode<Code>::type>::TimedVector&
-      v = toTypedDispatchData<Code>(ptr.get())->dispatcher()->values().samples();
+    auto v = toTypedDispatchData<Code>(ptr.get())->dispatcher()->values().samples();
 
-    auto lower = (_lowerBound.defined()? std::lower_bound(v.begin(), v.end(), _lowerBound) : v.begin());
-    auto upper = (_upperBound.defined()? std::upper_bound(v.begin(), v.end(), _upperBound) : v.end());
+    auto lower = (_lowerBound.defined()? v.lowerBound(_lowerBound) : v.begin());
+    auto upper = (_upperBound.defined()? v.upperBound(_upperBound) : v.end());
     return TimedSampleRange<typename TypeForCode<Code>::type>(lower, upper);
   }
 
@@ -130,7 +130,7 @@ TEST(NavDatasetTest, TestReplaceChannel) {
   NavDataset navs(dispatcher);
 
   NavDataset modified = navs.replaceChannel<Velocity<>>(
-      AWS, "NMEA0183: replaced", aws.samples());
+      AWS, "NMEA0183: replaced", aws.toTimedVector());
 
   EXPECT_EQ("NMEA0183: test", navs.dispatcher()->dispatchData(AWS)->source());
   EXPECT_EQ("NMEA0183: replaced", modified.dispatcher()->dispatchData(AWS)->source());
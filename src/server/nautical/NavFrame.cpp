@@ -0,0 +1,128 @@
+#include <server/nautical/NavFrame.h>
+
+#include <algorithm>
+#include <server/nautical/NavCompatibility.h>
+
+namespace sail {
+
+NavFrame::NavFrame(const NavDataset &ds) {
+  allocate(NavCompat::getNavSize(ds));
+  NavCompat::forEachNav(ds, [&](int i, const Nav &x) {
+    setRow(i, x);
+  });
+}
+
+NavFrame::NavFrame(const Array<Nav> &navs) {
+  allocate(navs.size());
+  for (int i = 0; i < navs.size(); i++) {
+    setRow(i, navs[i]);
+  }
+}
+
+void NavFrame::allocate(int n) {
+  _time = Array<TimeStamp>(n);
+  _position = Array<GeographicPosition<double>>(n);
+  _awa = Array<Angle<double>>(n);
+  _aws = Array<Velocity<double>>(n);
+  _trueWindOverGround = Array<HorizontalMotion<double>>(n);
+  _deviceTwa = Array<Angle<double>>(n);
+  _externalTwa = Array<Angle<double>>(n);
+  _deviceTws = Array<Velocity<double>>(n);
+  _externalTws = Array<Velocity<double>>(n);
+  _deviceTwdir = Array<Angle<double>>(n);
+  _gpsSpeed = Array<Velocity<double>>(n);
+  _gpsBearing = Array<Angle<double>>(n);
+  _magHdg = Array<Angle<double>>(n);
+  _watSpeed = Array<Velocity<double>>(n);
+  _deviceVmg = Array<Velocity<double>>(n);
+  _deviceTargetVmg = Array<Velocity<double>>(n);
+  _rudderAngle = Array<Angle<double>>(n);
+}
+
+void NavFrame::setRow(int i, const Nav &x) {
+  _time[i] = x.time();
+  _position[i] = x.geographicPosition();
+  _awa[i] = x.awa();
+  _aws[i] = x.aws();
+  _trueWindOverGround[i] = x.trueWindOverGround();
+  _deviceTwa[i] = x.deviceTwa();
+  _externalTwa[i] = x.externalTwa();
+  _deviceTws[i] = x.deviceTws();
+  _externalTws[i] = x.externalTws();
+  _deviceTwdir[i] = x.deviceTwdir();
+  _gpsSpeed[i] = x.gpsSpeed();
+  _gpsBearing[i] = x.gpsBearing();
+  _magHdg[i] = x.magHdg();
+  _watSpeed[i] = x.watSpeed();
+  _deviceVmg[i] = x.deviceVmg();
+  _deviceTargetVmg[i] = x.deviceTargetVmg();
+  _rudderAngle[i] = x.rudderAngle();
+}
+
+NavFrame NavFrame::slice(int from, int to) const {
+  NavFrame dst;
+  dst._time = _time.slice(from, to);
+  dst._position = _position.slice(from, to);
+  dst._awa = _awa.slice(from, to);
+  dst._aws = _aws.slice(from, to);
+  dst._trueWindOverGround = _trueWindOverGround.slice(from, to);
+  dst._deviceTwa = _deviceTwa.slice(from, to);
+  dst._externalTwa = _externalTwa.slice(from, to);
+  dst._deviceTws = _deviceTws.slice(from, to);
+  dst._externalTws = _externalTws.slice(from, to);
+  dst._deviceTwdir = _deviceTwdir.slice(from, to);
+  dst._gpsSpeed = _gpsSpeed.slice(from, to);
+  dst._gpsBearing = _gpsBearing.slice(from, to);
+  dst._magHdg = _magHdg.slice(from, to);
+  dst._watSpeed = _watSpeed.slice(from, to);
+  dst._deviceVmg = _deviceVmg.slice(from, to);
+  dst._deviceTargetVmg = _deviceTargetVmg.slice(from, to);
+  dst._rudderAngle = _rudderAngle.slice(from, to);
+  return dst;
+}
+
+NavFrame NavFrame::slice(TimeStamp from, TimeStamp to) const {
+  auto begin = _time.begin();
+  auto end = _time.end();
+  int a = from.defined()? std::lower_bound(begin, end, from) - begin : 0;
+  int b = to.defined()? std::upper_bound(begin, end, to) - begin : size();
+  return slice(a, std::max(a, b));
+}
+
+Nav NavFrame::nav(int i) const {
+  Nav dst;
+  dst.setBoatId(Nav::debuggingBoatId());
+  dst.setTime(_time[i]);
+  dst.setGeographicPosition(_position[i]);
+  dst.setAwa(_awa[i]);
+  dst.setAws(_aws[i]);
+  dst.setTrueWindOverGround(_trueWindOverGround[i]);
+  dst.setExternalTwa(_externalTwa[i]);
+  dst.setExternalTws(_externalTws[i]);
+  dst.setGpsSpeed(_gpsSpeed[i]);
+  dst.setGpsBearing(_gpsBearing[i]);
+  dst.setMagHdg(_magHdg[i]);
+  dst.setWatSpeed(_watSpeed[i]);
+  dst.setRudderAngle(_rudderAngle[i]);
+
+  // These setters also flag the value as present.
+  if (!isNaN(_deviceTwa[i])) { dst.setDeviceTwa(_deviceTwa[i]); }
+  if (!isNaN(_deviceTws[i])) { dst.setDeviceTws(_deviceTws[i]); }
+  if (!isNaN(_deviceTwdir[i])) { dst.setDeviceTwdir(_deviceTwdir[i]); }
+  if (!isNaN(_deviceVmg[i])) { dst.setDeviceVmg(_deviceVmg[i]); }
+  if (!isNaN(_deviceTargetVmg[i])) {
+    dst.setDeviceTargetVmg(_deviceTargetVmg[i]);
+  }
+  return dst;
+}
+
+Array<Nav> NavFrame::navs() const {
+  int n = size();
+  Array<Nav> dst(n);
+  for (int i = 0; i < n; i++) {
+    dst[i] = nav(i);
+  }
+  return dst;
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ *  The navs of a NavDataset, one row per GPS position, stored as
+ *  aligned columns: one array per field, all on the time base of the
+ *  GPS positions. Building a frame resamples the dataset once. The
+ *  columns are ref-counted arrays, so a slice of a frame shares the
+ *  data of the frame it was taken from instead of copying it.
+ *
+ *  Missing values are NaN, just like in a default constructed Nav.
+ */
+
+#ifndef SERVER_NAUTICAL_NAVFRAME_H_
+#define SERVER_NAUTICAL_NAVFRAME_H_
+
+#include <server/common/Array.h>
+#include <server/nautical/Nav.h>
+#include <server/nautical/NavDataset.h>
+
+namespace sail {
+
+class NavFrame {
+ public:
+  NavFrame() {}
+
+  // The rows have the same values as NavCompat::getNav.
+  explicit NavFrame(const NavDataset &ds);
+
+  // One row per nav.
+  explicit NavFrame(const Array<Nav> &navs);
+
+  int size() const {return _time.size();}
+  bool empty() const {return _time.empty();}
+
+  // The rows [from, to[.
+  NavFrame slice(int from, int to) const;
+
+  // The rows with a time in [from, to], like NavDataset::slice.
+  // An undefined bound does not limit the rows.
+  NavFrame slice(TimeStamp from, TimeStamp to) const;
+
+  // The rows of the GPS positions of 'ds', which must have been
+  // taken from the dataset of this frame.
+  NavFrame slice(const NavDataset &ds) const {
+    return slice(ds.lowerBound(), ds.upperBound());
+  }
+
+  const Array<TimeStamp> &time() const {return _time;}
+  const Array<GeographicPosition<double>> &geographicPosition() const {
+    return _position;
+  }
+  const Array<Angle<double>> &awa() const {return _awa;}
+  const Array<Velocity<double>> &aws() const {return _aws;}
+  const Array<HorizontalMotion<double>> &trueWindOverGround() const {
+    return _trueWindOverGround;
+  }
+  const Array<Angle<double>> &deviceTwa() const {return _deviceTwa;}
+  const Array<Angle<double>> &externalTwa() const {return _externalTwa;}
+  const Array<Velocity<double>> &deviceTws() const {return _deviceTws;}
+  const Array<Velocity<double>> &externalTws() const {return _externalTws;}
+  const Array<Angle<double>> &deviceTwdir() const {return _deviceTwdir;}
+  const Array<Velocity<double>> &gpsSpeed() const {return _gpsSpeed;}
+  const Array<Angle<double>> &gpsBearing() const {return _gpsBearing;}
+  const Array<Angle<double>> &magHdg() const {return _magHdg;}
+  const Array<Velocity<double>> &watSpeed() const {return _watSpeed;}
+  const Array<Velocity<double>> &deviceVmg() const {return _deviceVmg;}
+  const Array<Velocity<double>> &deviceTargetVmg() const {
+    return _deviceTargetVmg;
+  }
+  const Array<Angle<double>> &rudderAngle() const {return _rudderAngle;}
+
+  // A row as a Nav, for code that works on navs.
+  Nav nav(int i) const;
+  Array<Nav> navs() const;
+ private:
+  void allocate(int n);
+  void setRow(int i, const Nav &x);
+
+  Array<TimeStamp> _time;
+  Array<GeographicPosition<double>> _position;
+  Array<Angle<double>> _awa;
+  Array<Velocity<double>> _aws;
+  Array<HorizontalMotion<double>> _trueWindOverGround;
+  Array<Angle<double>> _deviceTwa, _externalTwa;
+  Array<Velocity<double>> _deviceTws, _externalTws;
+  Array<Angle<double>> _deviceTwdir;
+  Array<Velocity<double>> _gpsSpeed;
+  Array<Angle<double>> _gpsBearing, _magHdg;
+  Array<Velocity<double>> _watSpeed, _deviceVmg, _deviceTargetVmg;
+  Array<Angle<double>> _rudderAngle;
+};
+
+}
+
+#endif /* SERVER_NAUTICAL_NAVFRAME_H_ */
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <server/common/Duration.h>
 #include <server/nautical/NavCompatibility.h>
+#include <server/nautical/MaxSpeed.h>
+#include <server/nautical/NavFrame.h>
 #include <server/common/Env.h>
 #include <server/common/PathBuilder.h>
 
@@ -32,3 +34,151 @@ TEST(NavTest, MaxSpeed) {
   Array<Nav> navs = {a, b, c};
   EXPECT_EQ(1, findMaxSpeedOverGround(navs));
 }
+
+namespace {
+  auto offset = TimeStamp::UTC(2016, 5, 3, 12, 0, 0);
+  auto s = Duration<double>::seconds(1.0);
+
+  // Samples every 'step' seconds in [from, to), except in the gap
+  // (gapFrom, gapTo).
+  template <typename T>
+  typename TimedSampleCollection<T>::TimedVector makeSamples(
+      double from, double to, double step, std::function<T(double)> f,
+      double gapFrom = 0.0, double gapTo = 0.0) {
+    typename TimedSampleCollection<T>::TimedVector dst;
+    for (int i = 0; from + i*step < to; i++) {
+      double t = from + i*step;
+      if (!(gapFrom < t && t < gapTo)) {
+        dst.push_back(TimedValue<T>(offset + t*s, f(t)));
+      }
+    }
+    return dst;
+  }
+
+  Angle<double> angle(double t) {
+    return Angle<double>::degrees(100.0*sin(0.03*t));
+  }
+
+  Velocity<double> velocity(double t) {
+    return Velocity<double>::knots(8.0 + 3.0*cos(0.02*t));
+  }
+
+  NavDataset makeTestDataset() {
+    auto d = std::make_shared<Dispatcher>();
+    d->setSourcePriority("Anemomind estimator", 10);
+    d->insertValues<GeographicPosition<double>>(GPS_POS, "Internal GPS",
+      makeSamples<GeographicPosition<double>>(0.0, 600.0, 1.0, [](double t) {
+        return GeographicPosition<double>(
+            Angle<double>::degrees(11.9 + 1.0e-5*t),
+            Angle<double>::degrees(57.7));
+      }));
+    d->insertValues<Velocity<double>>(GPS_SPEED, "Internal GPS",
+        makeSamples<Velocity<double>>(0.25, 600.0, 1.0, &velocity));
+    d->insertValues<Angle<double>>(GPS_BEARING, "Internal GPS",
+        makeSamples<Angle<double>>(0.25, 600.0, 1.0, &angle));
+
+    // Exactly between two GPS samples, to check how ties are resolved.
+    d->insertValues<Angle<double>>(AWA, "NMEA2000/wind",
+        makeSamples<Angle<double>>(0.5, 600.0, 1.0, &angle));
+    d->insertValues<Velocity<double>>(AWS, "NMEA2000/wind",
+        makeSamples<Velocity<double>>(0.0, 600.0, 2.0, &velocity));
+    d->insertValues<Angle<double>>(TWDIR, "NMEA2000/wind",
+        makeSamples<Angle<double>>(0.0, 600.0, 3.0, &angle, 100.0, 200.0));
+    d->insertValues<Velocity<double>>(TWS, "NMEA2000/wind",
+        makeSamples<Velocity<double>>(0.0, 600.0, 3.0, &velocity, 150.0, 250.0));
+
+    d->insertValues<Angle<double>>(TWA, "Anemomind estimator",
+        makeSamples<Angle<double>>(50.0, 400.0, 1.7, &angle));
+    d->insertValues<Angle<double>>(TWA, "Internal TWA",
+        makeSamples<Angle<double>>(0.0, 600.0, 0.9, &angle, 300.0, 350.0));
+    d->insertValues<Angle<double>>(TWA, "NMEA2000/twa",
+        makeSamples<Angle<double>>(20.0, 580.0, 1.3, &angle, 60.0, 90.0));
+    d->insertValues<Angle<double>>(TWA, "NMEA0183 twa",
+        makeSamples<Angle<double>>(0.0, 600.0, 5.0, &angle));
+    d->insertValues<Velocity<double>>(TWS, "Anemomind estimator",
+        makeSamples<Velocity<double>>(50.0, 400.0, 1.7, &velocity));
+
+    d->insertValues<Angle<double>>(MAG_HEADING, "NMEA2000/compass",
+        makeSamples<Angle<double>>(0.0, 600.0, 0.1, &angle));
+    d->insertValues<Velocity<double>>(WAT_SPEED, "NMEA2000/log",
+        makeSamples<Velocity<double>>(-30.0, 400.0, 0.6, &velocity));
+    d->insertValues<Velocity<double>>(VMG, "Anemomind estimator",
+        makeSamples<Velocity<double>>(0.0, 600.0, 2.0, &velocity));
+    d->insertValues<Velocity<double>>(TARGET_VMG, "Anemomind estimator",
+        makeSamples<Velocity<double>>(0.0, 600.0, 2.0, &velocity));
+    return NavDataset(d);
+  }
+
+  void expectSameAsGetNav(const NavDataset &ds) {
+    auto navs = makeArray(ds);
+    ASSERT_EQ(getNavSize(ds), navs.size());
+    for (int i = 0; i < navs.size(); i++) {
+      auto expected = getNav(ds, i);
+      const auto &actual = navs[i];
+      EXPECT_EQ(expected.time(), actual.time());
+      EXPECT_TRUE(expected == actual);
+      EXPECT_TRUE(expected.deviceTwa().nearWithNan(actual.deviceTwa(), 0.0));
+      EXPECT_TRUE(expected.deviceTws().nearWithNan(actual.deviceTws(), 0.0));
+      EXPECT_TRUE(expected.deviceTwdir().nearWithNan(
+          actual.deviceTwdir(), 0.0));
+      EXPECT_TRUE(expected.deviceVmg().nearWithNan(actual.deviceVmg(), 0.0));
+      EXPECT_TRUE(expected.deviceTargetVmg().nearWithNan(
+          actual.deviceTargetVmg(), 0.0));
+    }
+  }
+}
+
+TEST(NavTest, MakeArraySameAsGetNav) {
+  auto ds = makeTestDataset();
+  EXPECT_EQ(600, getNavSize(ds));
+  expectSameAsGetNav(ds);
+  expectSameAsGetNav(ds.slice(offset + 30.5*s, offset + 500.0*s));
+  EXPECT_EQ(0, makeArray(NavDataset()).size());
+}
+
+TEST(NavTest, NavFrame) {
+  auto ds = makeTestDataset();
+  NavFrame frame(ds);
+  EXPECT_EQ(600, frame.size());
+  for (int i = 0; i < frame.size(); i++) {
+    auto expected = getNav(ds, i);
+    auto actual = frame.nav(i);
+    EXPECT_EQ(expected.time(), actual.time());
+    EXPECT_TRUE(expected == actual);
+    EXPECT_EQ(expected.hasDeviceTwa(), actual.hasDeviceTwa());
+    EXPECT_EQ(expected.hasDeviceVmg(), actual.hasDeviceVmg());
+    EXPECT_TRUE(expected.deviceTwa().nearWithNan(actual.deviceTwa(), 0.0));
+    EXPECT_TRUE(expected.deviceTws().nearWithNan(actual.deviceTws(), 0.0));
+  }
+
+  // Slices share the columns of the frame.
+  auto sliced = ds.slice(offset + 30.5*s, offset + 500.0*s);
+  auto rows = frame.slice(sliced);
+  EXPECT_EQ(getNavSize(sliced), rows.size());
+  EXPECT_EQ(offset + 31.0*s, rows.time().first());
+  EXPECT_EQ(offset + 500.0*s, rows.time().last());
+  EXPECT_EQ(frame.awa().ptr(31), rows.awa().ptr(0));
+  EXPECT_EQ(frame.time()[40], rows.nav(9).time());
+
+  EXPECT_TRUE(frame.slice(TimeStamp(), TimeStamp()).size() == 600);
+  EXPECT_TRUE(NavFrame(NavDataset()).empty());
+
+  // From navs, as in the tests of the tile generator.
+  NavFrame fromNavs(rows.navs());
+  ASSERT_EQ(rows.size(), fromNavs.size());
+  for (int i = 0; i < rows.size(); i++) {
+    EXPECT_TRUE(rows.nav(i) == fromNavs.nav(i));
+  }
+
+  // Session statistics read from the columns.
+  EXPECT_NEAR(computeTrajectoryLength(sliced).meters(),
+      computeTrajectoryLength(rows.geographicPosition()).meters(), 1.0e-9);
+  auto expectedMax = computeMaxSpeedOverPeriod(sliced);
+  auto actualMax = computeMaxSpeedOverPeriod(
+      rows.time(), rows.geographicPosition());
+  ASSERT_TRUE(expectedMax.defined());
+  ASSERT_TRUE(actualMax.defined());
+  EXPECT_EQ(expectedMax.get().time, actualMax.get().time);
+  EXPECT_NEAR(expectedMax.get().value.knots(),
+              actualMax.get().value.knots(), 1.0e-9);
+}
@@ -507,7 +507,7 @@ NavDataset Calibrator::simulate(const NavDataset &src) const {
   saveCalibration(&calibFile);
   calibFile.seekg(0, std::ios::beg);
 
-  return SimulateBox(calibFile, src);
+  return SimulateBox(calibFile, src, SimulationMode::Batch);
 }
 
 namespace {
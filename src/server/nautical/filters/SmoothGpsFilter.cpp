@@ -5,7 +5,9 @@
  *      Author: jonas
  */
 
+#include <atomic>
 #include <server/common/ArrayBuilder.h>
+#include <server/common/ParallelFor.h>
 #include <server/transducers/Transducer.h>
 #include <server/common/logging.h>
 #include <server/math/SampleUtils.h>
@@ -1014,59 +1016,77 @@ GpsFilterResults filterGpsData(
   auto positionSlices = applySplits(cleanData.positions, time.splits);
   auto motionSlices = applySplits(cleanData.motions, time.splits);
 
-  std::vector<LocalGpsFilterResults> subResults;
-  subResults.reserve(time.spans.size());
-
   DOM::addSubTextNode(log, "h2", "Producing GPS filter sub results");
   auto ol = DOM::makeSubNode(log, "ol");
 
-
+  // The sub problems are independent. Every one of them is solved by
+  // whichever thread is free, and logs to a node of its own that is
+  // appended in order once all are done.
   int n = time.spans.size();
   int last = n-1;
+  std::vector<LocalGpsFilterResults> solved(n);
+  std::vector<DOM::Node> items(n);
   for (int i = 0; i < n; i++) {
-    LOG(INFO) << "Running GPS filter for span "
-        << i+1 << "/" << time.spans.size();
-    auto positionSlice = positionSlices[i];
-    auto motionSlice = motionSlices[i];
-    auto li = DOM::makeSubNode(&ol, "li");
-
-    auto span = time.spans[i];
-    auto from = span.minv() - 0.5_s;
-    auto to = span.maxv() + 0.5_s;
-    DOM::addSubTextNode(&li, "p",
-        stringFormat("Input:  %d positions, %d motions, over a span of %s",
-        positionSlice.size(), motionSlice.size(), (to - from).str().c_str()));
-
-    int sampleCount = int(ceil((to - from)/settings.samplingPeriod));
-    TimeMapper mapper(from, settings.samplingPeriod,
-        sampleCount);
-
-    if (4 <= sampleCount && !positionSlice.empty()) {
-       auto subResult = solveGpsSubproblem(
-           mapper, positionSlice,
-           motionSlice, settings, &li);
-       if (!subResult.empty()) {
-         std::stringstream msg;
-         msg << "Optimized " << subResult
-             .filterResults.timeMapper.sampleCount()
-             << " samples in " << subResult.computationTime.str();
-         LOG(INFO) << msg.str();
-         DOM::addSubTextNode(&li, "p", msg.str());
-         subResults.push_back(subResult);
-       } else {
-         std::stringstream msg;
-         msg << "Failed to optimize";
-         LOG(ERROR) << msg.str();
-         DOM::addSubTextNode(&li, "p", msg.str()).warning();
-       }
-    } else {
-      DOM::addSubTextNode(&li, "p", "Too few positions or times")
-        .warning();
+    items[i] = DOM::makeDetachedNode(ol, "li");
+  }
+  std::atomic<int> next(0);
+  int threadCount = 0 < settings.threadCount?
+    settings.threadCount : hardwareThreadCount();
+  parallelFor(threadCount, threadCount, [&](size_t) {
+    for (int i = next++; i < n; i = next++) {
+      LOG(INFO) << "Running GPS filter for span "
+          << i+1 << "/" << time.spans.size();
+      auto positionSlice = positionSlices[i];
+      auto motionSlice = motionSlices[i];
+      auto li = &(items[i]);
+
+      auto span = time.spans[i];
+      auto from = span.minv() - 0.5_s;
+      auto to = span.maxv() + 0.5_s;
+      DOM::addSubTextNode(li, "p",
+          stringFormat("Input:  %d positions, %d motions, over a span of %s",
+          positionSlice.size(), motionSlice.size(), (to - from).str().c_str()));
+
+      int sampleCount = int(ceil((to - from)/settings.samplingPeriod));
+      TimeMapper mapper(from, settings.samplingPeriod,
+          sampleCount);
+
+      if (4 <= sampleCount && !positionSlice.empty()) {
+         auto subResult = solveGpsSubproblem(
+             mapper, positionSlice,
+             motionSlice, settings, li);
+         if (!subResult.empty()) {
+           std::stringstream msg;
+           msg << "Optimized " << subResult
+               .filterResults.timeMapper.sampleCount()
+               << " samples in " << subResult.computationTime.str();
+           LOG(INFO) << msg.str();
+           DOM::addSubTextNode(li, "p", msg.str());
+           solved[i] = subResult;
+         } else {
+           std::stringstream msg;
+           msg << "Failed to optimize";
+           LOG(ERROR) << msg.str();
+           DOM::addSubTextNode(li, "p", msg.str()).warning();
+         }
+      } else {
+        DOM::addSubTextNode(li, "p", "Too few positions or times")
+          .warning();
+      }
+      if (i < last) {
+        DOM::addSubTextNode(li, "p",
+            stringFormat("Gap to next session: %s",
+                (time.spans[i+1].minv() - span.maxv()).str().c_str()));
+      }
     }
-    if (i < last) {
-      DOM::addSubTextNode(&li, "p",
-          stringFormat("Gap to next session: %s",
-              (time.spans[i+1].minv() - span.maxv()).str().c_str()));
+  });
+
+  std::vector<LocalGpsFilterResults> subResults;
+  subResults.reserve(n);
+  for (int i = 0; i < n; i++) {
+    DOM::appendDetachedNode(&ol, items[i]);
+    if (!solved[i].empty()) {
+      subResults.push_back(solved[i]);
     }
   }
   return mergeSubResults(subResults,
@@ -26,6 +26,10 @@ struct GpsFilterSettings {
   Duration<double> subProblemLength = Duration<double>::hours(4.0);
   int medianWindowLength = 5;
   Length<double> positionSupportThreshold = 100.0_m;
+
+  // Number of threads solving sub problems, 0 for one per hardware
+  // thread. The results do not depend on it.
+  int threadCount = 1;
 };
 
 struct LocalGpsFilterResults {
@@ -152,6 +152,37 @@ TEST(SmoothGpsFilterTest, TestIt) {
   EXPECT_LT(60, corrCounter);
 }
 
+TEST(SmoothGpsFilterTest, SameResultsWithThreads) {
+  auto ds = getPsarosTestData();
+
+  // Several sub problems to share between the threads.
+  GpsFilterSettings settings;
+  settings.subProblemLength = Duration<double>::minutes(20.0);
+
+  DOM::Node out;
+  auto expected = filterGpsData(ds, &out, settings);
+  settings.threadCount = 3;
+  auto actual = filterGpsData(ds, &out, settings);
+
+  EXPECT_FALSE(expected.empty());
+  ASSERT_EQ(expected.positions.size(), actual.positions.size());
+  for (int i = 0; i < expected.positions.size(); i++) {
+    const auto &a = expected.positions[i];
+    const auto &b = actual.positions[i];
+    EXPECT_EQ(a.time, b.time);
+    EXPECT_EQ(a.value.lon().degrees(), b.value.lon().degrees());
+    EXPECT_EQ(a.value.lat().degrees(), b.value.lat().degrees());
+  }
+  ASSERT_EQ(expected.motions.size(), actual.motions.size());
+  for (int i = 0; i < expected.motions.size(); i++) {
+    const auto &a = expected.motions[i];
+    const auto &b = actual.motions[i];
+    EXPECT_EQ(a.time, b.time);
+    EXPECT_EQ(a.value[0].knots(), b.value[0].knots());
+    EXPECT_EQ(a.value[1].knots(), b.value[1].knots());
+  }
+}
+
 namespace {
   auto offset = TimeStamp::UTC(2016, 8, 12, 10, 17, 0);
   auto s = Duration<double>::seconds(1.0);
@@ -90,5 +90,39 @@ double HintedStateAssign::getTransitionCost(int fromStateIndex,
   return cost;
 }
 
+void HintedStateAssign::getStateCosts(int timeIndex, double *dst) {
+  _ref->getStateCosts(timeIndex, dst);
+  int i = _stateTable[timeIndex];
+  if (i == -1) {
+    return;
+  }
+
+  int stateCount = getStateCount();
+  const Array<LocalStateAssignPtr> &X = _stateOverlaps[i].objects();
+  for (auto x : X) {
+    for (int state = 0; state < stateCount; state++) {
+      dst[state] += x->getSafeStateCost(state, timeIndex);
+    }
+  }
+}
+
+void HintedStateAssign::getTransitionCosts(int fromTimeIndex, int count,
+    const int *fromStateIndices, const int *toStateIndices, double *dst) {
+  _ref->getTransitionCosts(fromTimeIndex, count,
+      fromStateIndices, toStateIndices, dst);
+  int i = _transitionTable[calcTIndex(fromTimeIndex)];
+  if (i == -1) {
+    return;
+  }
+
+  const Array<LocalStateAssignPtr> &X =
+      _transitionOverlaps[i].objects();
+  for (auto x : X) {
+    for (int k = 0; k < count; k++) {
+      dst[k] += x->getSafeTransitionCost(
+          fromStateIndices[k], toStateIndices[k], fromTimeIndex);
+    }
+  }
+}
 
 } /* namespace mmm */
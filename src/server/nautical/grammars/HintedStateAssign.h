@@ -84,6 +84,12 @@ class HintedStateAssign : public StateAssign {
   double getStateCost(int stateIndex, int timeIndex);
   double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex);
 
+  // The batches of 'ref', with the costs of the hints added.
+  void getStateCosts(int timeIndex, double *dst) override;
+  void getTransitionCosts(int fromTimeIndex, int count,
+      const int *fromStateIndices, const int *toStateIndices,
+      double *dst) override;
+
   int getStateCount() {
     return _ref->getStateCount();
   }
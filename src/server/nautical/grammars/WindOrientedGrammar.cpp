@@ -14,6 +14,12 @@
 #include <server/nautical/grammars/StaticCostFactory.h>
 #include <server/nautical/grammars/HintedStateAssignFactory.h>
 #include <server/common/SharedPtrUtils.h>
+#include <server/common/ArrayBuilder.h>
+#include <server/common/ParallelFor.h>
+#include <server/common/AbstractArray.h>
+#include <server/nautical/segment/SessionCut.h>
+#include <algorithm>
+#include <atomic>
 
 namespace sail {
 
@@ -30,6 +36,12 @@ WindOrientedGrammarSettings::WindOrientedGrammarSettings() {
   onOffCost = 2*majorTransitionCost;
   majorStateCost = 1.0;
   switchOnOffDuringRace = true;
+
+  // Staying on across a gap costs perSecondCost per second, so for gaps
+  // much longer than 2*onOffCost/perSecondCost (about 2 hours), switching
+  // off is always better.
+  sessionGap = Duration<double>::hours(6.0);
+  threadCount = 1;
 }
 
 
@@ -172,20 +184,40 @@ namespace {
   }
 
 
+  // The part of the transition cost that does not depend on time
+  double getG001StaticTransitionCost(const WindOrientedGrammarSettings &s,
+      int from, int to) {
+    if (isOff(from) || isOff(to)) {
+      return s.onOffCost*majorStateTransitionCost(from, to);
+    } else {
+      return s.minorTransitionCost*minorStateTransitionCost(from, to) +
+              s.majorTransitionCost*majorStateTransitionCost(from, to);
+    }
+  }
+
   double getG001StateTransitionCost(const WindOrientedGrammarSettings &s,
       int from, int to, int at, const Array<Nav> &navs) {
+    double cost = getG001StaticTransitionCost(s, from, to);
     if (isOff(from) || isOff(to)) {
-      return s.onOffCost*majorStateTransitionCost(from, to);
+      return cost;
     } else {
       Duration<double> dur = navs[at+1].time() - navs[at].time();
       double seconds = dur.seconds();
       assert(seconds >= 0.0);
-      return s.minorTransitionCost*minorStateTransitionCost(from, to) +
-              s.majorTransitionCost*majorStateTransitionCost(from, to) +
-              seconds*s.perSecondCost;
+      return cost + seconds*s.perSecondCost;
     }
   }
 
+  MDArray2d makeStaticTransitionCosts(const WindOrientedGrammarSettings &s) {
+    MDArray2d costs(stateCount, stateCount);
+    for (int i = 0; i < stateCount; i++) {
+      for (int j = 0; j < stateCount; j++) {
+        costs(i, j) = getG001StaticTransitionCost(s, i, j);
+      }
+    }
+    return costs;
+  }
+
 
   Arrayd makeCostFactors() {
     const int major = 4;
@@ -239,6 +271,14 @@ class G001SA : public StateAssign {
  public:
   G001SA(WindOrientedGrammarSettings s, Array<Nav> navs);
 
+  // For a session cut out of longer data: the transitions from the off
+  // state before the first nav, and to the off state after the last nav,
+  // are charged like in the whole problem.
+  void setOffAtEnds(bool before, bool after) {
+    _offBefore = before;
+    _offAfter = after;
+  }
+
   double getStateCost(int stateIndex, int timeIndex);
 
   double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex);
@@ -246,23 +286,36 @@ class G001SA : public StateAssign {
   int getLength() {return _navs.size();}
 
   Arrayi getPrecedingStates(int stateIndex, int timeIndex) {return _preds[stateIndex];}
+
+  // The nav is only looked at once for all states, and the transition
+  // costs that do not depend on time are precomputed.
+  void getStateCosts(int timeIndex, double *dst) override;
+  void getTransitionCosts(int fromTimeIndex, int count,
+      const int *fromStateIndices, const int *toStateIndices,
+      double *dst) override;
  private:
+  double computeStateCost(int stateIndex, bool slow, double twaDegrees) const;
+  double boundaryCost(int stateIndex, int timeIndex) const;
+
+  bool _offBefore = false;
+  bool _offAfter = false;
   Array<Arrayi> _preds;
   WindOrientedGrammarSettings _settings;
   Array<Nav> _navs;
   Arrayd _minorStateCostFactors;
+  MDArray2d _staticTransitionCosts;
 };
 
-double G001SA::getStateCost(int stateIndex, int timeIndex) {
-  Nav nav = _navs[timeIndex];
+double G001SA::computeStateCost(int stateIndex, bool slow,
+    double twaDegrees) const {
   if (isOff(stateIndex)) {
-    if (nav.gpsSpeed() < .5_kn) {
+    if (slow) {
       return 0;
     }
     return _settings.majorStateCost;
   } else {
     int iQueried = getMinorState(stateIndex);
-    double minorStateCost = computeMinorStateCost(nav, iQueried);
+    double minorStateCost = computeMinorStateCost(twaDegrees, iQueried);
 
     // Constant cost for being in this state
     double stateCost =
@@ -271,13 +324,40 @@ double G001SA::getStateCost(int stateIndex, int timeIndex) {
     // Penalty for this minor state index not matching the input
     double matchCost = minorStateCost;
 
-    if (nav.gpsSpeed() < .5_kn) {
+    if (slow) {
       matchCost += .5;
     }
     return stateCost + matchCost;
   }
 }
 
+double G001SA::boundaryCost(int stateIndex, int timeIndex) const {
+  double cost = 0.0;
+  if (_offBefore && timeIndex == 0) {
+    cost += _staticTransitionCosts(offState, stateIndex);
+  }
+  if (_offAfter && timeIndex == _navs.size() - 1) {
+    cost += _staticTransitionCosts(stateIndex, offState);
+  }
+  return cost;
+}
+
+double G001SA::getStateCost(int stateIndex, int timeIndex) {
+  const Nav &nav = _navs[timeIndex];
+  return computeStateCost(stateIndex, nav.gpsSpeed() < .5_kn,
+      nav.bestTwaEstimate().degrees())
+    + boundaryCost(stateIndex, timeIndex);
+}
+
+void G001SA::getStateCosts(int timeIndex, double *dst) {
+  const Nav &nav = _navs[timeIndex];
+  bool slow = nav.gpsSpeed() < .5_kn;
+  double twaDegrees = nav.bestTwaEstimate().degrees();
+  for (int i = 0; i < stateCount; i++) {
+    dst[i] = computeStateCost(i, slow, twaDegrees) + boundaryCost(i, timeIndex);
+  }
+}
+
 namespace {
   const int minorPerMajor[5] = {6, 6, 6, 6, 1};
 
@@ -335,13 +415,111 @@ namespace {
 
 G001SA::G001SA(WindOrientedGrammarSettings s, Array<Nav> navs) :
     _settings(s), _navs(navs), _minorStateCostFactors(makeCostFactors()),
-    _preds(makePredecessorsPerState(makeConnections(s.switchOnOffDuringRace))) {
+    _preds(makePredecessorsPerState(makeConnections(s.switchOnOffDuringRace))),
+    _staticTransitionCosts(makeStaticTransitionCosts(s)) {
 }
 
 double G001SA::getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
   return getG001StateTransitionCost(_settings, fromStateIndex, toStateIndex, fromTimeIndex, _navs);
 }
 
+void G001SA::getTransitionCosts(int fromTimeIndex, int count,
+    const int *fromStateIndices, const int *toStateIndices, double *dst) {
+  double seconds = (_navs[fromTimeIndex+1].time()
+      - _navs[fromTimeIndex].time()).seconds();
+  assert(seconds >= 0.0);
+  double timeCost = seconds*_settings.perSecondCost;
+  for (int k = 0; k < count; k++) {
+    int from = fromStateIndices[k];
+    int to = toStateIndices[k];
+    double cost = _staticTransitionCosts(from, to);
+    dst[k] = isOff(from) || isOff(to)? cost : cost + timeCost;
+  }
+}
+
+namespace {
+  bool hintInGap(const Array<UserHint> &hints, TimeStamp from, TimeStamp to) {
+    for (auto h: hints) {
+      if (from <= h.time() && h.time() <= to) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The first nav index of every session, followed by navs.size().
+  // Gaps with hints in them are not cut, because the hints are about
+  // transitions across them.
+  Arrayi listSessionBounds(const Array<Nav> &navs,
+      const Array<UserHint> &hints, Duration<double> gap) {
+    ArrayBuilder<int> bounds;
+    bounds.add(0);
+    if (2 <= navs.size()) {
+      Array<TimeStamp> times(navs.size());
+      for (int i = 0; i < navs.size(); i++) {
+        times[i] = navs[i].time();
+      }
+      SessionCut::Settings settings;
+      settings.cuttingThreshold = gap;
+      auto sessions = SessionCut::cutSessions(
+          wrapIndexable<TypeMode::ConstRef>(times), settings);
+      for (int i = 1; i < sessions.size(); i++) {
+        int start = std::lower_bound(times.begin(), times.end(),
+            sessions[i].minv()) - times.begin();
+        if (bounds.last() < start
+            && !hintInGap(hints, times[start-1], times[start])) {
+          bounds.add(start);
+        }
+      }
+    }
+    bounds.add(navs.size());
+    return bounds.get();
+  }
+
+  // The hints with a time before the next session, but not before
+  // the previous one.
+  Array<UserHint> hintsOfSession(const Array<UserHint> &hints,
+      const Array<Nav> &navs, const Arrayi &bounds, int session) {
+    int last = bounds.size() - 2;
+    ArrayBuilder<UserHint> dst;
+    for (auto h: hints) {
+      if ((session == 0 || navs[bounds[session]].time() <= h.time())
+          && (session == last || h.time() < navs[bounds[session+1]].time())) {
+        dst.add(h);
+      }
+    }
+    return dst.get();
+  }
+
+  // Cutting the data into sessions gives the same parse as solving it
+  // at once, if every session pays for switching off after its last nav
+  // and on before its first one (see G001SA::setOffAtEnds):
+  //
+  //  - A parse that is off on either side of every cut then costs the
+  //    same in both problems.
+  //  - A parse that stays on across a cut costs at least
+  //    sessionGap*perSecondCost more in the whole problem, instead of
+  //    2*onOffCost. That is not less if the condition below holds.
+  //
+  // So if the best parse of the sessions is off at every cut, it is also
+  // the best parse of the whole problem. That needs all states to be
+  // connected to the off state. Merging sessions keeps this true for
+  // the cuts that remain.
+  bool canCutSessions(const WindOrientedGrammarSettings &s) {
+    return s.switchOnOffDuringRace
+      && 2*s.onOffCost <= s.sessionGap.seconds()*s.perSecondCost;
+  }
+
+  Arrayi solveWindOriented(const WindOrientedGrammar &grammar,
+      const WindOrientedGrammarSettings &settings, Array<Nav> navs,
+      Array<UserHint> hints, bool offBefore, bool offAfter) {
+    G001SA sa(settings, navs);
+    sa.setOffAtEnds(offBefore, offAfter);
+    return makeHintedStateAssign(grammar, makeSharedPtrToStack(sa),
+        hints, navs).solve();
+  }
+}
+
 std::shared_ptr<HTree> WindOrientedGrammar::parse(NavDataset navs0,
     Array<UserHint> hints) {
   auto navs = NavCompat::makeArray(navs0);
@@ -349,8 +527,55 @@ std::shared_ptr<HTree> WindOrientedGrammar::parse(NavDataset navs0,
   if (navs.empty()) {
     return std::shared_ptr<HTree>();
   }
-  G001SA sa(_settings, navs);
-  Arrayi states = makeHintedStateAssign(*this, makeSharedPtrToStack(sa), hints, navs).solve();
+
+  // The sessions are parsed on their own, and their states put back
+  // together in order, so that the tree indexes all of 'navs'. Sessions
+  // whose parses are on across the cut between them are merged and
+  // parsed again, until the parse is off at every remaining cut.
+  Arrayi bounds = canCutSessions(_settings)?
+    listSessionBounds(navs, hints, _settings.sessionGap)
+    : Arrayi{0, navs.size()};
+  Arrayi sessions = makeRange(bounds.size() - 1);
+  Arrayi states(navs.size());
+  int threadCount = 0 < _settings.threadCount?
+    _settings.threadCount : hardwareThreadCount();
+  while (true) {
+    int sessionCount = bounds.size() - 1;
+    LOG(INFO) << "Parsing " << sessions.size() << " of "
+      << sessionCount << " sessions";
+    std::atomic<int> next(0);
+    parallelFor(std::min<int>(threadCount, sessions.size()), threadCount,
+        [&](size_t) {
+      for (int j = next++; j < sessions.size(); j = next++) {
+        int i = sessions[j];
+        solveWindOriented(*this, _settings,
+            navs.slice(bounds[i], bounds[i+1]),
+            hintsOfSession(hints, navs, bounds, i),
+            0 < i, i < sessionCount - 1)
+          .copyToSafe(states.slice(bounds[i], bounds[i+1]));
+      }
+    });
+
+    ArrayBuilder<int> merged;
+    ArrayBuilder<int> toParse;
+    merged.add(0);
+    for (int i = 1; i < sessionCount; i++) {
+      if (!isOff(states[bounds[i] - 1]) && !isOff(states[bounds[i]])) {
+        int session = merged.size() - 1;
+        if (toParse.empty() || toParse.last() != session) {
+          toParse.add(session);
+        }
+      } else {
+        merged.add(bounds[i]);
+      }
+    }
+    merged.add(navs.size());
+    if (merged.size() == bounds.size()) {
+      break;
+    }
+    bounds = merged.get();
+    sessions = toParse.get();
+  }
   return _hierarchy.parse(states);
 }
 
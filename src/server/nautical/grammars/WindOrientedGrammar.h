@@ -24,6 +24,14 @@ struct WindOrientedGrammarSettings {
   double onOffCost;           // cost for being in the off-state
   double majorStateCost;
   bool switchOnOffDuringRace;
+
+  // Gaps in the data longer than this cut it into sessions that are
+  // parsed independently, using up to 'threadCount' threads (0 for one
+  // per hardware thread). The parse is the same as without cutting.
+  // The data is not cut if switchOnOffDuringRace is false, or if
+  // sessionGap*perSecondCost is less than 2*onOffCost.
+  Duration<double> sessionGap;
+  int threadCount;
 };
 
 class WindOrientedGrammar : public Grammar {
@@ -35,6 +43,7 @@ class WindOrientedGrammar : public Grammar {
   MDArray2b startOfRaceTransitions() const {return _startOfRaceTransitions;}
   MDArray2b endOfRaceTransitions() const {return _endOfRaceTransitions;}
   const Hierarchy &hierarchy() const {return _hierarchy;}
+  void setThreadCount(int threadCount) {_settings.threadCount = threadCount;}
  private:
   MDArray2b _startOfRaceTransitions, _endOfRaceTransitions;
   Hierarchy _hierarchy;
@@ -126,3 +126,48 @@ TEST(WindOrientedGrammarTest, Hinting) {
 
   */
 }
+
+namespace {
+  void listStates(std::shared_ptr<HTree> tree, std::vector<int> *dst) {
+    if (tree->children().empty()) {
+      for (int i = tree->left(); i < tree->right(); i++) {
+        (*dst)[i] = tree->index();
+      }
+    }
+    for (auto c : tree->children()) {
+      listStates(c, dst);
+    }
+  }
+}
+
+TEST(WindOrientedGrammarTest, SessionsInParallel) {
+  Poco::Path path = PathBuilder::makeDirectory(Env::SOURCE_DIR)
+    .pushDirectory("datasets")
+    .pushDirectory("Irene")
+    .pushDirectory("2014")
+    .pushDirectory("Classique Rothschild").get();
+  LogLoader loader;
+  loader.load(path);
+  auto navs = loader.makeNavDataset();
+
+  // Three days, separated by nights.
+  WindOrientedGrammarSettings settings;
+  settings.sessionGap = Duration<double>::days(10000.0);
+  auto expected = WindOrientedGrammar(settings).parse(navs);
+  settings.sessionGap = Duration<double>::hours(6.0);
+  settings.threadCount = 3;
+  auto actual = WindOrientedGrammar(settings).parse(navs);
+
+  ASSERT_TRUE(bool(expected));
+  ASSERT_TRUE(bool(actual));
+  int n = expected->count();
+  ASSERT_EQ(n, actual->count());
+  std::vector<int> a(n, -1), b(n, -1);
+  listStates(expected, &a);
+  listStates(actual, &b);
+
+  for (int i = 0; i < n; i++) {
+    EXPECT_NE(-1, b[i]);
+    EXPECT_EQ(a[i], b[i]) << "at " << i;
+  }
+}
@@ -6,13 +6,20 @@
 #include <server/nautical/logimport/CsvLoader.h>
 #include <server/nautical/logimport/LogLoader.h>
 #include <server/common/logging.h>
-#include <Poco/String.h>
 #include <server/common/CsvParser.h>
+#include <server/common/MappedFile.h>
 #include <server/nautical/logimport/SourceGroup.h>
 #include <server/common/string.h>
 
 #include <third_party/pstream.h>
 
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+
 namespace sail {
 
 namespace {
@@ -20,39 +27,97 @@ namespace {
 Angle<double> degrees = Angle<double>::degrees(1.0);
 Velocity<double> knots = Velocity<double>::knots(1.0);
 Velocity<double> metersPerSecond = Velocity<double>::metersPerSecond(1.0);
+AngularVelocity<double> degreesPerSecond
+  = AngularVelocity<double>::degreesPerSecond(1.0);
+
+// Files are read in chunks of this size when they can't be mapped.
+const size_t chunkSize = 1 << 20;
+
+// What to do with the cells of a column. Numbers are parsed directly
+// from the text of the file and stored in a member of CsvRowProcessor.
+struct CsvColumn {
+  enum Type {
+    Ignored,
+    Number,
+    Time,
+    OleDate  // Microsoft DATE format, as a number of days
+  };
+
+  Type type = Ignored;
+
+  // For numbers: *dst = x*(*unit), where dst and unit point at
+  // values of the same type.
+  void (*set)(double x, const void *unit, void *dst) = nullptr;
+  const void *unit = nullptr;
+  void *dst = nullptr;
+};
 
 template <typename T>
-std::function<void(std::string)> makeSetter(T unit, T *dst) {
-  return [=](const std::string &s) {
-    double x = 0;
-    if (tryParseDouble(s, &x)) {
-      *dst = x*unit;
-    }
-  };
+void setNumber(double x, const void *unit, void *dst) {
+  *static_cast<T*>(dst) = x*(*static_cast<const T*>(unit));
 }
 
-std::function<void(std::string)> makeTimeSetter(TimeStamp *dst) {
-  return [=](const std::string &s) {
-    *dst = TimeStamp::parse(s);
-  };
+template <typename T>
+CsvColumn numberColumn(const T &unit, T *dst) {
+  CsvColumn column;
+  column.type = CsvColumn::Number;
+  column.set = &setNumber<T>;
+  column.unit = &unit;
+  column.dst = dst;
+  return column;
 }
 
-void doNothing(const std::string &s) {}
+CsvColumn timeColumn(CsvColumn::Type type, TimeStamp *dst) {
+  CsvColumn column;
+  column.type = type;
+  column.dst = dst;
+  return column;
+}
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n'
+    || c == '\v' || c == '\f';
+}
 
-std::string trimCsvString(const std::string& s) {
-  std::string h = Poco::trim(s);
-  if (h[0] == '"' && h.size() > 2 && h[h.size() - 1] == '"') {
-    h = h.substr(1, h.size() - 2);
+// The same as Poco::trim, and removing the quotes around a string.
+CsvCell trimCsvCell(CsvCell cell) {
+  while (cell.begin < cell.end && isSpace(*cell.begin)) {
+    cell.begin++;
   }
-  return h;
+  while (cell.begin < cell.end && isSpace(cell.end[-1])) {
+    cell.end--;
+  }
+  if (cell.size() > 2 && *cell.begin == '"' && cell.end[-1] == '"') {
+    cell.begin++;
+    cell.end--;
+  }
+  return cell;
+}
+
+// Like tryParseDouble, which accepts any prefix that is a number.
+bool tryParseCell(CsvCell cell, double *out) {
+  char text[64];
+  if (cell.size() >= sizeof(text)) {
+    return tryParseDouble(cell.str(), out);
+  }
+  memcpy(text, cell.begin, cell.size());
+  text[cell.size()] = '\0';
+  char *end = nullptr;
+  errno = 0;
+  double x = strtod(text, &end);
+  if (end == text || errno == ERANGE) {
+    return false;
+  }
+  *out = x;
+  return true;
 }
 
 }  // namespace
 
 class CsvRowProcessor {
  public:
-  CsvRowProcessor(const MDArray<std::string, 2> &header);
-  void process(const MDArray<std::string, 2> &row, SourceGroup *dst);
+  CsvRowProcessor(const std::vector<CsvCell> &header);
+  void process(const std::vector<CsvCell> &row, SourceGroup *dst);
 
   bool hasValidHeader() const { return _validHeader; }
  private:
@@ -60,7 +125,9 @@ class CsvRowProcessor {
   CsvRowProcessor &operator=(const CsvRowProcessor &other) = delete;
   CsvRowProcessor(const CsvRowProcessor &other) = delete;
 
-  std::vector<std::function<void(std::string)> > _setters;
+  void set(const CsvColumn &column, CsvCell cell);
+
+  std::vector<CsvColumn> _columns;
 
   Angle<double> _awa, _twa, _magHdg, _gpsBearing, _lon, _lat, _pitch, _roll;
   Angle<double> _twdir, _rudder;
@@ -69,6 +136,9 @@ class CsvRowProcessor {
   TimeStamp _time;
   bool _validHeader;
 
+  // Reused for the text of time cells
+  std::string _text;
+
   template <typename T>
   void _pushBack(const T &x, typename TimedSampleCollection<T>::TimedVector *dst) {
     pushBack(_time, x, dst);
@@ -76,77 +146,67 @@ class CsvRowProcessor {
 
 };
 
-CsvRowProcessor::CsvRowProcessor(const MDArray<std::string, 2> &header) {
-  std::map<std::string, std::function<void(std::string)> > m;
-  m["DATE/TIME(UTC)"] = makeTimeSetter(&_time);
-  m["Lat."] = makeSetter(degrees, &_lat);
-  m["Long."] = makeSetter(degrees, &_lon);
-  m["COG"] = makeSetter(degrees, &_gpsBearing);
-  m["SOG"] = makeSetter(knots, &_gpsSpeed);
-  m["Heading"] = makeSetter(degrees, &_magHdg);
-  m["HDG"] = makeSetter(degrees, &_magHdg);
-  m["Speed Through Water"] = makeSetter(knots, &_watSpeed);
-  m["STW"] = makeSetter(knots, &_watSpeed);
-  m["AWS"] = makeSetter(knots, &_aws);
-  m["TWS"] = makeSetter(knots, &_tws);
-  m["AWA"] = makeSetter(degrees, &_awa);
-  m["TWA"] = makeSetter(degrees, &_twa);
-
-  m["LAT"] = makeSetter(degrees, &_lat);
-  m["LON"] = makeSetter(degrees, &_lon);
+CsvRowProcessor::CsvRowProcessor(const std::vector<CsvCell> &header) {
+  std::map<std::string, CsvColumn> m;
+  m["DATE/TIME(UTC)"] = timeColumn(CsvColumn::Time, &_time);
+  m["Lat."] = numberColumn(degrees, &_lat);
+  m["Long."] = numberColumn(degrees, &_lon);
+  m["COG"] = numberColumn(degrees, &_gpsBearing);
+  m["SOG"] = numberColumn(knots, &_gpsSpeed);
+  m["Heading"] = numberColumn(degrees, &_magHdg);
+  m["HDG"] = numberColumn(degrees, &_magHdg);
+  m["Speed Through Water"] = numberColumn(knots, &_watSpeed);
+  m["STW"] = numberColumn(knots, &_watSpeed);
+  m["AWS"] = numberColumn(knots, &_aws);
+  m["TWS"] = numberColumn(knots, &_tws);
+  m["AWA"] = numberColumn(degrees, &_awa);
+  m["TWA"] = numberColumn(degrees, &_twa);
+
+  m["LAT"] = numberColumn(degrees, &_lat);
+  m["LON"] = numberColumn(degrees, &_lon);
 
   // Support for Calypso XLS recording
-  m["Id"] = doNothing;
-  m["Lat"] = makeSetter(degrees, &_lat);
-  m["Lon"] = makeSetter(degrees, &_lon);
-  m["Date"] = makeTimeSetter(&_time);
-  m["AppWindAngle"] = makeSetter(degrees, &_awa);
-  m["AppWindModulus"] = makeSetter(metersPerSecond, &_aws);
-  m["TrueWindAngle"] = makeSetter(degrees, &_twa);
-  m["TrueWindModulus"] = makeSetter(metersPerSecond, &_tws);
-  m["Bearing"] = makeSetter(degrees, &_gpsBearing);
-  m["Speed"] = makeSetter(metersPerSecond, &_gpsSpeed);
-  m["Roll"] = makeSetter(degrees, &_roll);
-  m["Pitch"] = makeSetter(degrees, &_pitch);
-  m["eCompass"] = makeSetter(degrees, &_magHdg);
+  m["Id"] = CsvColumn();
+  m["Lat"] = numberColumn(degrees, &_lat);
+  m["Lon"] = numberColumn(degrees, &_lon);
+  m["Date"] = timeColumn(CsvColumn::Time, &_time);
+  m["AppWindAngle"] = numberColumn(degrees, &_awa);
+  m["AppWindModulus"] = numberColumn(metersPerSecond, &_aws);
+  m["TrueWindAngle"] = numberColumn(degrees, &_twa);
+  m["TrueWindModulus"] = numberColumn(metersPerSecond, &_tws);
+  m["Bearing"] = numberColumn(degrees, &_gpsBearing);
+  m["Speed"] = numberColumn(metersPerSecond, &_gpsSpeed);
+  m["Roll"] = numberColumn(degrees, &_roll);
+  m["Pitch"] = numberColumn(degrees, &_pitch);
+  m["eCompass"] = numberColumn(degrees, &_magHdg);
 
   // Support for Expedition
-  m["Utc"] = [&](const std::string& s) {
-    double x = 0;
-    if (tryParseDouble(s, &x)) {
-      // Microsoft DATE format
-      // https://msdn.microsoft.com/en-us/library/82ab7w69.aspx
-      _time = TimeStamp::fromMilliSecondsSince1970(
-          (x - 25569) * 24 * 60 * 60 * 1000);
-    }
-  };
-  m["BSP"] = makeSetter(knots, &_watSpeed);
-  m["TWD"] = makeSetter(degrees, &_twdir);
-  m["Rudder"] = makeSetter(degrees, &_rudder);
-  m["Heel"] = makeSetter(degrees, &_roll);
-  m["ROT"] = makeSetter(AngularVelocity<double>::degreesPerSecond(1), &_rateOfTurn);
+  m["Utc"] = timeColumn(CsvColumn::OleDate, &_time);
+  m["BSP"] = numberColumn(knots, &_watSpeed);
+  m["TWD"] = numberColumn(degrees, &_twdir);
+  m["Rudder"] = numberColumn(degrees, &_rudder);
+  m["Heel"] = numberColumn(degrees, &_roll);
+  m["ROT"] = numberColumn(degreesPerSecond, &_rateOfTurn);
 
-  m["Cog"] = makeSetter(degrees, &_gpsBearing);
-  m["Sog"] = makeSetter(knots, &_gpsSpeed);
+  m["Cog"] = numberColumn(degrees, &_gpsBearing);
+  m["Sog"] = numberColumn(knots, &_gpsSpeed);
 
   // Support for Sailgrib txt files
-  m["time"] = makeTimeSetter(&_time);
-  m["lat"] = makeSetter(degrees, &_lat);
-  m["lon"] = makeSetter(degrees, &_lon);
-  m["bearing"] = makeSetter(degrees, &_gpsBearing);
-  m["speed"] = makeSetter(metersPerSecond, &_gpsSpeed);
-
-  assert(header.rows() == 1);
-  int cols = header.cols();
+  m["time"] = timeColumn(CsvColumn::Time, &_time);
+  m["lat"] = numberColumn(degrees, &_lat);
+  m["lon"] = numberColumn(degrees, &_lon);
+  m["bearing"] = numberColumn(degrees, &_gpsBearing);
+  m["speed"] = numberColumn(metersPerSecond, &_gpsSpeed);
+
   _validHeader = false;
 
   std::vector<std::string> ignoredHeaders;
 
-  for (int i = 0; i < cols; i++) {
-    auto h = trimCsvString(header(0, i));
+  for (auto cell: header) {
+    auto h = trimCsvCell(cell).str();
     auto found = m.find(h);
     bool wasFound = found != m.end();
-    _setters.push_back(wasFound? found->second : doNothing);
+    _columns.push_back(wasFound? found->second : CsvColumn());
     _validHeader |= wasFound;
 
     if (!wasFound) {
@@ -164,10 +224,39 @@ CsvRowProcessor::CsvRowProcessor(const MDArray<std::string, 2> &header) {
   }
 }
 
-void CsvRowProcessor::process(const MDArray<std::string, 2> &row, SourceGroup *dst) {
-  assert(_setters.size() == row.cols());
-  for (int i = 0; i < _setters.size(); i++) {
-    _setters[i](trimCsvString(row(0, i)));
+void CsvRowProcessor::set(const CsvColumn &column, CsvCell cell) {
+  double x = 0;
+  switch (column.type) {
+    case CsvColumn::Number:
+      if (tryParseCell(cell, &x)) {
+        column.set(x, column.unit, column.dst);
+      }
+      break;
+    case CsvColumn::Time:
+      _text.assign(cell.begin, cell.end);
+      *static_cast<TimeStamp*>(column.dst) = TimeStamp::parse(_text);
+      break;
+    case CsvColumn::OleDate:
+      if (tryParseCell(cell, &x)) {
+        // https://msdn.microsoft.com/en-us/library/82ab7w69.aspx
+        *static_cast<TimeStamp*>(column.dst) =
+          TimeStamp::fromMilliSecondsSince1970(
+              (x - 25569) * 24 * 60 * 60 * 1000);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void CsvRowProcessor::process(const std::vector<CsvCell> &row, SourceGroup *dst) {
+  // Missing cells are empty, and cells without a header are ignored.
+  const char *empty = "";
+  for (size_t i = 0; i < _columns.size(); i++) {
+    if (_columns[i].type != CsvColumn::Ignored) {
+      set(_columns[i], i < row.size()?
+          trimCsvCell(row[i]) : CsvCell{empty, empty});
+    }
   }
   _pushBack(_awa, dst->AWA);
   _pushBack(_aws, dst->AWS);
@@ -187,28 +276,75 @@ void CsvRowProcessor::process(const MDArray<std::string, 2> &row, SourceGroup *d
   _pushBack(pos, dst->GPS_POS);
 }
 
-bool loadCsv(const MDArray<std::string, 2> &table,
-             const std::string& source, LogAccumulator *dst) {
-  if (table.rows() == 0 || table.cols() == 0) {
-    return false;
+namespace {
+
+// Loads the lines of a CSV file as they are split, the first one being
+// the header, so that only the loaded values are kept in memory.
+class CsvTableLoader {
+ public:
+  CsvTableLoader(const std::string &source, LogAccumulator *dst)
+    : _source(source), _dst(dst) {}
+
+  void operator()(const std::vector<CsvCell> &cells) {
+    if (!_processor) {
+      _group = SourceGroup(_source, _dst);
+      _processor.reset(new CsvRowProcessor(cells));
+    } else if (_processor->hasValidHeader()) {
+      _processor->process(cells, &_group);
+    }
   }
-  SourceGroup toPopulate(source, dst);
-  CsvRowProcessor processor(table.sliceRow(0));
 
-  if (!processor.hasValidHeader()) {
-    return false;
+  bool loaded() const {
+    return _processor && _processor->hasValidHeader();
   }
+ private:
+  std::string _source;
+  LogAccumulator *_dst;
+  SourceGroup _group;
+  std::unique_ptr<CsvRowProcessor> _processor;
+};
 
-  int n = table.rows();
-  for (int i = 1; i < n; i++) {
-    processor.process(table.sliceRow(i), &toPopulate);
+bool loadCsv(std::istream *stream, const std::string &source,
+             LogAccumulator *dst) {
+  CsvTableLoader loader(source, dst);
+  CsvLineSplitter splitter;
+  std::vector<char> buffer;
+  size_t size = 0;
+  while (true) {
+    buffer.resize(size + chunkSize);
+    stream->read(buffer.data() + size, chunkSize);
+    size += stream->gcount();
+    bool last = stream->gcount() == 0;
+    size_t consumed = splitter.split(buffer.data(), size, last,
+                                     std::ref(loader));
+    if (last) {
+      break;
+    }
+    // Keep the incomplete line for the next chunk.
+    std::copy(buffer.begin() + consumed, buffer.begin() + size,
+              buffer.begin());
+    size -= consumed;
   }
-  return true;
+  return loader.loaded();
 }
 
+}  // namespace
+
 bool loadCsv(const std::string &filename, LogAccumulator *dst) {
   std::string sourceName("CSV imported");
-  return loadCsv(parseCsv(filename), sourceName, dst);
+  MappedFile file;
+  if (!file.open(filename)) {
+    std::ifstream stream(filename);
+    return loadCsv(&stream, sourceName, dst);
+  }
+  CsvTableLoader loader(sourceName, dst);
+  CsvLineSplitter().split(file.data(), file.size(), true, std::ref(loader));
+  return loader.loaded();
+}
+
+bool loadCsv(std::istream *stream, LogAccumulator *dst) {
+  std::string sourceName("CSV imported");
+  return loadCsv(stream, sourceName, dst);
 }
 
 bool loadCsvFromPipe(const std::string& cmd, const std::string& sourceName,
@@ -218,7 +354,7 @@ bool loadCsvFromPipe(const std::string& cmd, const std::string& sourceName,
     LOG(ERROR) << "Failed to run command: " << cmd;
     return false;
   }
-  return loadCsv(parseCsv(&pipe), sourceName, dst);
+  return loadCsv(&pipe, sourceName, dst);
 }
 
 } /* namespace sail */
@@ -6,6 +6,7 @@
 #ifndef SERVER_NAUTICAL_LOGIMPORT_CSVLOADER_H_
 #define SERVER_NAUTICAL_LOGIMPORT_CSVLOADER_H_
 
+#include <iosfwd>
 #include <string>
 
 namespace sail {
@@ -13,6 +14,7 @@ namespace sail {
 class LogAccumulator;
 
 bool loadCsv(const std::string &filename, LogAccumulator *dst);
+bool loadCsv(std::istream *stream, LogAccumulator *dst);
 
 bool loadCsvFromPipe(const std::string& cmd, const std::string& sourceName,
                      LogAccumulator *dst);
@@ -8,7 +8,9 @@
 #ifndef SERVER_NAUTICAL_LOGIMPORT_LOGACCUMULATOR_H_
 #define SERVER_NAUTICAL_LOGIMPORT_LOGACCUMULATOR_H_
 
+#include <algorithm>
 #include <device/anemobox/Dispatcher.h>
+#include <server/common/Span.h>
 
 namespace sail {
 
@@ -27,8 +29,88 @@ struct LogAccumulator {
   #undef  MAKE_SOURCE_MAP
 
   std::map<std::string, int> _sourcePriority;
+
+  // Moves the samples of 'other' after the samples of this accumulator,
+  // channel by channel and source by source, as if the data of 'other'
+  // had been loaded after the data of this one.
+  void append(LogAccumulator* other);
+
+  // From the first to the last sample of any channel, or uninitialized
+  // if nothing has been loaded.
+  Span<TimeStamp> timeSpan() const;
+
+  // Removes the samples outside [from, to[.
+  void keepOnly(TimeStamp from, TimeStamp to);
 };
 
+template <typename T>
+void appendLogSources(std::map<std::string, T>* src,
+                      std::map<std::string, T>* dst) {
+  for (auto& kv: *src) {
+    T& values = (*dst)[kv.first];
+    if (values.empty()) {
+      values.swap(kv.second);
+    } else {
+      values.insert(values.end(), kv.second.begin(), kv.second.end());
+    }
+  }
+  src->clear();
+}
+
+inline void LogAccumulator::append(LogAccumulator* other) {
+  #define APPEND_SOURCES(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    appendLogSources(&(other->_##HANDLE##sources), &_##HANDLE##sources);
+    FOREACH_CHANNEL(APPEND_SOURCES)
+  #undef APPEND_SOURCES
+
+  for (const auto& kv: other->_sourcePriority) {
+    _sourcePriority[kv.first] = kv.second;
+  }
+  other->_sourcePriority.clear();
+}
+
+template <typename T>
+void extendLogTimeSpan(const std::map<std::string, T>& src,
+                       Span<TimeStamp>* dst) {
+  for (const auto& kv: src) {
+    for (const auto& x: kv.second) {
+      dst->extend(x.time);
+    }
+  }
+}
+
+inline Span<TimeStamp> LogAccumulator::timeSpan() const {
+  Span<TimeStamp> span;
+  #define EXTEND_SPAN(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    extendLogTimeSpan(_##HANDLE##sources, &span);
+    FOREACH_CHANNEL(EXTEND_SPAN)
+  #undef EXTEND_SPAN
+  return span;
+}
+
+template <typename T>
+void keepLogSamples(TimeStamp from, TimeStamp to,
+                    std::map<std::string, T>* dst) {
+  typedef typename T::value_type Sample;
+  for (auto kv = dst->begin(); kv != dst->end();) {
+    T& values = kv->second;
+    values.erase(std::remove_if(values.begin(), values.end(),
+        [&](const Sample& x) { return x.time < from || to <= x.time; }),
+      values.end());
+    if (values.empty()) {
+      kv = dst->erase(kv);
+    } else {
+      kv++;
+    }
+  }
+}
+
+inline void LogAccumulator::keepOnly(TimeStamp from, TimeStamp to) {
+  #define KEEP_SAMPLES(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    keepLogSamples(from, to, &_##HANDLE##sources);
+    FOREACH_CHANNEL(KEEP_SAMPLES)
+  #undef KEEP_SAMPLES
+}
 
 template <DataCode Code>
 typename std::map<std::string, typename TimedSampleCollection<typename TypeForCode<Code>::type >::TimedVector>
@@ -0,0 +1,145 @@
+#include <server/nautical/logimport/LogFormat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace sail {
+
+const char* logFormatName(LogFormat format) {
+  switch (format) {
+    case LogFormat::Iwatch: return "iWatch";
+    case LogFormat::Protobuf: return "protobuf";
+    case LogFormat::Nmea0183: return "NMEA 0183";
+    case LogFormat::Csv: return "CSV";
+    case LogFormat::Astra: return "Astra";
+    default: return "unknown";
+  }
+}
+
+namespace {
+
+  bool startsWith(const std::string& s, const char* prefix, size_t n) {
+    return n <= s.size() && memcmp(s.data(), prefix, n) == 0;
+  }
+
+  // Calls f on the lines of 'head' until it returns false.
+  template <typename F>
+  void forEachLine(const std::string& head, F f) {
+    size_t begin = 0;
+    while (begin < head.size()) {
+      size_t end = std::min(head.find('\n', begin), head.size());
+      if (!f(head.substr(begin, end - begin))) {
+        return;
+      }
+      begin = end + 1;
+    }
+  }
+
+  std::string firstLine(const std::string& head) {
+    return head.substr(0, head.find('\n'));
+  }
+
+  // Such as "$IIVHW," or "!AIVDM,", also with a proprietary address.
+  bool isNmea0183Sentence(const std::string& s, size_t at) {
+    if (at >= s.size() || (s[at] != '$' && s[at] != '!')) {
+      return false;
+    }
+    size_t i = at + 1;
+    while (i < s.size() && (isupper(uint8_t(s[i])) || isdigit(uint8_t(s[i])))) {
+      i++;
+    }
+    size_t length = i - at - 1;
+    return 4 <= length && length <= 6 && i < s.size() && s[i] == ',';
+  }
+
+  bool hasNmea0183Line(const std::string& head) {
+    bool found = false;
+    forEachLine(head, [&](const std::string& line) {
+      size_t at = line.find_first_not_of(" \t\r");
+      found = at != std::string::npos && isNmea0183Sentence(line, at);
+      return !found;
+    });
+    return found;
+  }
+
+  // Astra logs start with a line like
+  // "------ log1Hz20170708_1239.log ------"
+  bool isAstraHeader(const std::string& line) {
+    return startsWith(line, "----", 4)
+      && line.find_first_not_of("- \r") != std::string::npos;
+  }
+
+  // A header line of named columns, such as
+  // "DATE/TIME(UTC),Lat. , Long.,COG,SOG"
+  bool isCsvHeader(const std::string& line) {
+    int columns = 1;
+    bool hasLetter = false;
+    for (char c: line) {
+      if (c == ',' || c == ';') {
+        columns++;
+      } else if (isalpha(uint8_t(c))) {
+        hasLetter = true;
+      } else if (c == '\0') {
+        return false;
+      }
+    }
+    return 2 <= columns && hasLetter;
+  }
+
+}  // namespace
+
+LogFormat sniffLogFormat(const std::string& head) {
+  if (startsWith(head, "{\"", 2)) {
+    return LogFormat::Iwatch;
+  }
+
+  // Gzipped LogFile, or a block-indexed log file.
+  if (startsWith(head, "\x1f\x8b", 2) || startsWith(head, "ANMLOG02", 8)) {
+    return LogFormat::Protobuf;
+  }
+
+  std::string line = firstLine(head);
+  if (isAstraHeader(line)) {
+    return LogFormat::Astra;
+  }
+  if (hasNmea0183Line(head)) {
+    return LogFormat::Nmea0183;
+  }
+  if (isCsvHeader(line)) {
+    return LogFormat::Csv;
+  }
+  return LogFormat::Unknown;
+}
+
+LogFormat sniffLogFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  return sniffLogStream(&file);
+}
+
+LogFormat sniffLogStream(std::istream* stream) {
+  std::string head(logFormatSniffSize, '\0');
+  stream->read(&head[0], head.size());
+  head.resize(stream->gcount());
+  return sniffLogFormat(head);
+}
+
+void LogFormatStats::add(const LogFormatStats& other) {
+  for (auto kv: other.sniffed) {
+    sniffed[kv.first] += kv.second;
+  }
+  misdetected += other.misdetected;
+}
+
+std::ostream& operator<<(std::ostream& s, const LogFormatStats& stats) {
+  for (auto kv: stats.sniffed) {
+    s << logFormatName(kv.first) << ": " << kv.second << " files, ";
+  }
+  s << "misdetected: " << stats.misdetected;
+  return s;
+}
+
+}
@@ -0,0 +1,54 @@
+/*
+ *  Guess the format of a log file from its first bytes, so that
+ *  LogLoader can hand it directly to the right parser.
+ */
+
+#ifndef SERVER_NAUTICAL_LOGIMPORT_LOGFORMAT_H_
+#define SERVER_NAUTICAL_LOGIMPORT_LOGFORMAT_H_
+
+#include <iosfwd>
+#include <map>
+#include <string>
+
+namespace sail {
+
+enum class LogFormat {
+  Unknown,
+  Iwatch,     // JSON from the iWatch app
+  Protobuf,   // Anemobox log, see device/anemobox/logger
+  Nmea0183,
+  Csv,
+  Astra
+};
+
+const char* logFormatName(LogFormat format);
+
+// Number of bytes that sniffLogFile looks at.
+const int logFormatSniffSize = 4096;
+
+// Guesses the format from the beginning of a file.
+LogFormat sniffLogFormat(const std::string& head);
+
+// Reads the beginning of a file and guesses its format.
+LogFormat sniffLogFile(const std::string& filename);
+
+// The same for a stream, which is consumed.
+LogFormat sniffLogStream(std::istream* stream);
+
+// How well the sniffing went, over a number of loaded files.
+struct LogFormatStats {
+  // Number of files per sniffed format.
+  std::map<LogFormat, int> sniffed;
+
+  // Files that failed to load with the sniffed format, but could be
+  // loaded with another one.
+  int misdetected = 0;
+
+  void add(const LogFormatStats& other);
+};
+
+std::ostream& operator<<(std::ostream& s, const LogFormatStats& stats);
+
+}
+
+#endif /* SERVER_NAUTICAL_LOGIMPORT_LOGFORMAT_H_ */
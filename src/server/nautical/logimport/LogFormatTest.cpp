@@ -0,0 +1,38 @@
+#include <server/nautical/logimport/LogFormat.h>
+
+#include <gtest/gtest.h>
+#include <server/common/Env.h>
+
+using namespace sail;
+
+TEST(LogFormatTest, SniffHeads) {
+  EXPECT_EQ(LogFormat::Iwatch, sniffLogFormat("{\"datalogs\": []}"));
+  EXPECT_EQ(LogFormat::Protobuf,
+            sniffLogFormat(std::string("\x1f\x8b\x08\x00\x00", 5)));
+  EXPECT_EQ(LogFormat::Protobuf, sniffLogFormat("ANMLOG02"));
+  EXPECT_EQ(LogFormat::Nmea0183,
+            sniffLogFormat("$IIVHW,,,266,M,,,,*36\r\n$IIVWR,099,R*6C\r\n"));
+  EXPECT_EQ(LogFormat::Nmea0183,
+            sniffLogFormat("garbage\n!AIVDM,1,1,,A,13aG?P0P00PD;88MD5MTDww@2<0L,0*23"));
+  EXPECT_EQ(LogFormat::Csv,
+            sniffLogFormat("DATE/TIME(UTC),Lat. , Long.,COG,SOG\n"
+                           "09/21/2015 01:13:21.80 pm,43.47,6.99,71.9,6.08\n"));
+  EXPECT_EQ(LogFormat::Astra,
+            sniffLogFormat("----- log1Hz20170708_1239.log -----\n"
+                           "Date\tTime\tTs\tBoatspeed\n"));
+  EXPECT_EQ(LogFormat::Unknown, sniffLogFormat(""));
+  EXPECT_EQ(LogFormat::Unknown, sniffLogFormat("1.0 2.0 3.0\n"));
+
+  // A dollar sign in text is not enough.
+  EXPECT_EQ(LogFormat::Unknown, sniffLogFormat("Total: $12.5\n$ 12\n"));
+}
+
+TEST(LogFormatTest, SniffFiles) {
+  std::string datasets = std::string(Env::SOURCE_DIR) + "/datasets/";
+  EXPECT_EQ(LogFormat::Nmea0183, sniffLogFile(datasets + "tinylog.txt"));
+  EXPECT_EQ(LogFormat::Csv, sniffLogFile(datasets + "csvlog/rowdy_part.csv"));
+  EXPECT_EQ(LogFormat::Iwatch, sniffLogFile(datasets + "iwatch_wind.json"));
+  EXPECT_EQ(LogFormat::Astra, sniffLogFile(
+      datasets + "astradata/Regata/log1Hz20170708_1239.log"));
+  EXPECT_EQ(LogFormat::Unknown, sniffLogFile(datasets + "no_such_file.log"));
+}
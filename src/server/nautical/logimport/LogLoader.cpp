@@ -3,12 +3,20 @@
  *      Author: Jonas Östlund <jonas@anemomind.com>
  */
 
+#include <atomic>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/lzma.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 #include <fstream>
 #include <regex>
 #include <Poco/File.h>
 #include <Poco/Path.h>
 #include <Poco/String.h>
 #include <server/common/CsvParser.h>
+#include <server/common/ParallelFor.h>
 #include <server/common/filesystem.h>
 #include <server/common/logging.h>
 #include <server/common/math.h>
@@ -19,6 +27,7 @@
 #include <server/nautical/logimport/SourceGroup.h>
 #include <device/anemobox/DispatcherUtils.h>
 #include <server/common/math.h>
+#include <server/nautical/BoatSpecificHacks.h>
 #include <server/nautical/GeographicPosition.h>
 #include <server/nautical/logimport/Nmea0183Loader.h>
 #include <server/nautical/logimport/ProtobufLogLoader.h>
@@ -39,59 +48,80 @@ std::string randomStr(int len) {
   return s;
 }
 
-std::string uncompressFile(const std::string& filename) {
-  Poco::Path path(filename);
-  std::string ext = path.getExtension();
-  std::string command;
-
-  if (ext == "gz") {
-    command = GUNZIP_EXE;
-  } else if (ext == "bz2") {
-    command = BUNZIP2_EXE;
-  } else if (ext == "xz") {
-    command = UNXZ_EXE;
-  } else {
-    return "";
+namespace {
+
+  bool isCompressed(const std::string& filename) {
+    return hasExtension(filename, "\\.gz") || hasExtension(filename, "\\.bz2")
+      || hasExtension(filename, "\\.xz");
   }
 
-  std::string newfile =
-    Poco::Path::temp() + "/" + randomStr(6) + '_' + path.getBaseName();
-  
-  command += " < '" + filename + "' > '" + newfile + "'";
+  // Opens a file for reading, decompressing it on the fly if it is
+  // compressed. The parsers read the decompressed bytes directly,
+  // without any temporary file.
+  std::shared_ptr<std::istream> openLogFile(const std::string& filename) {
+    if (!isCompressed(filename)) {
+      return std::make_shared<std::ifstream>(
+          filename, std::ios::in | std::ios::binary);
+    }
+    auto stream = std::make_shared<boost::iostreams::filtering_istream>();
+    if (hasExtension(filename, "\\.gz")) {
+      stream->push(boost::iostreams::gzip_decompressor());
+    } else if (hasExtension(filename, "\\.bz2")) {
+      stream->push(boost::iostreams::bzip2_decompressor());
+    } else {
+      stream->push(boost::iostreams::lzma_decompressor());
+    }
+    stream->push(boost::iostreams::file_source(
+        filename, std::ios::in | std::ios::binary));
+    return stream;
+  }
 
-  LOG(INFO) << "Running: " << command;
-  if (system(command.c_str()) == 0) {
-    return newfile;
+  // Files that are read by external programs need to be on disk.
+  std::string uncompressFile(const std::string& filename) {
+    Poco::Path path(filename);
+    std::string newfile =
+      Poco::Path::temp() + "/" + randomStr(6) + '_' + path.getBaseName();
+    try {
+      auto src = openLogFile(filename);
+      std::ofstream dst(newfile, std::ios::out | std::ios::binary);
+      boost::iostreams::copy(*src, dst);
+      if (dst) {
+        return newfile;
+      }
+    } catch (const std::exception& e) {
+      LOG(ERROR) << filename << ": " << e.what();
+    }
+    Poco::File(newfile).remove();
+    return "";
   }
-  return "";
-}
 
+}  // namespace
 
 bool LogLoader::loadFile(const std::string &filename) {
   bool r = false;
 
-  std::string newFilename = uncompressFile(filename);
-  if (!newFilename.empty()) {
-    r = loadFile(newFilename);
-    Poco::File(newFilename).remove();
-    return r;
-  }
-
-  if (hasExtension(filename, "xls")) {
-    r = loadCsvFromPipe(std::string("xls2csv -x '") + filename + "'",
-                        "Imported from XLS file", &_acc);
-  } else if (hasExtension(filename, "vdr")) {
-    r = loadCsvFromPipe(std::string("weather4d '") + filename + "'",
-                        "Imported from Weather4D VDR", &_acc);
-  } else if (hasExtension(filename, "db")) {
-    r = sailmonDbLoad(filename, &_acc);
+  std::string innerName = isCompressed(filename)?
+    Poco::Path(filename).getBaseName() : filename;
+  if (hasExtension(innerName, "xls") || hasExtension(innerName, "vdr")
+      || hasExtension(innerName, "db")) {
+    if (innerName != filename) {
+      std::string newFilename = uncompressFile(filename);
+      if (!newFilename.empty()) {
+        r = loadFile(newFilename);
+        Poco::File(newFilename).remove();
+        return r;
+      }
+    } else if (hasExtension(filename, "xls")) {
+      r = loadCsvFromPipe(std::string("xls2csv -x '") + filename + "'",
+                          "Imported from XLS file", &_acc);
+    } else if (hasExtension(filename, "vdr")) {
+      r = loadCsvFromPipe(std::string("weather4d '") + filename + "'",
+                          "Imported from Weather4D VDR", &_acc);
+    } else {
+      r = sailmonDbLoad(filename, &_acc);
+    }
   } else {
-    r =
-      parseIwatch(filename, &_acc)
-      || ProtobufLogLoader::load(filename, &_acc)
-      || Nmea0183Loader::loadNmea0183File(filename, &_acc)
-      || loadCsv(filename, &_acc)
-      || accumulateAstraLogs(filename, &_acc);
+    r = loadSniffedFile(filename);
   }
 
   if (!r) {
@@ -101,6 +131,59 @@ bool LogLoader::loadFile(const std::string &filename) {
   return r;
 }
 
+bool LogLoader::loadFileAs(LogFormat format, const std::string &filename) {
+  // Every attempt reads the file from the start, through a stream of
+  // its own, as a decompressing stream can not be rewound.
+  std::shared_ptr<std::istream> stream = openLogFile(filename);
+  if (!*stream) {
+    LOG(ERROR) << filename << ": can't read file";
+    return false;
+  }
+  try {
+    switch (format) {
+      case LogFormat::Iwatch:
+        return parseIwatch(stream.get(), &_acc);
+      case LogFormat::Protobuf:
+        return ProtobufLogLoader::load(stream.get(), &_acc);
+      case LogFormat::Nmea0183:
+        return Nmea0183Loader::loadNmea0183Stream(
+            stream.get(), &_acc, Nmea0183Loader::getDefaultSourceName());
+      case LogFormat::Csv:
+        return loadCsv(stream.get(), &_acc);
+      case LogFormat::Astra:
+        return accumulateAstraLogs(stream, &_acc);
+      default:
+        return false;
+    }
+  } catch (const std::exception& e) {
+    // Such as corrupt compressed data
+    LOG(ERROR) << filename << ": " << e.what();
+    return false;
+  }
+}
+
+bool LogLoader::loadSniffedFile(const std::string &filename) {
+  LogFormat sniffed = sniffLogStream(openLogFile(filename).get());
+  _formatStats.sniffed[sniffed]++;
+  if (sniffed != LogFormat::Unknown && loadFileAs(sniffed, filename)) {
+    return true;
+  }
+
+  // Try the other parsers, in the order we used before sniffing.
+  for (auto format: {LogFormat::Iwatch, LogFormat::Protobuf,
+                     LogFormat::Nmea0183, LogFormat::Csv, LogFormat::Astra}) {
+    if (format != sniffed && loadFileAs(format, filename)) {
+      if (sniffed != LogFormat::Unknown) {
+        LOG(WARNING) << filename << ": sniffed as " << logFormatName(sniffed)
+          << " but loaded as " << logFormatName(format);
+        _formatStats.misdetected++;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 void LogLoader::loadNmea0183(std::istream *s) {
   Nmea0183Loader::loadNmea0183Stream(s, &_acc,
       Nmea0183Loader::getDefaultSourceName());
@@ -125,34 +208,84 @@ bool LogLoader::acceptFile(const std::string& filename) {
         || ext == "json" || ext == "";
 }
 
-bool LogLoader::load(const Poco::Path &name) {
+std::vector<std::string> LogLoader::listFiles(const Poco::Path &name) {
   FileTraverseSettings settings;
   settings.visitDirectories = false;
   settings.visitFiles = true;
-  int failCount = 0;
+  std::vector<std::string> filenames;
   traverseDirectory(
       name,
       [&](const Poco::Path &path) {
     std::string filename = path.toString();
     if (acceptFile(filename)) {
-      if (!loadFile(path.toString())) {
-        if (failCount < 12) { // So that we don't flood the log file if there are many files.
-          LOG(ERROR) << "Failed to load log file " << path.toString();
-        }
-        failCount++;
-      }
+      filenames.push_back(filename);
     } else {
       // Silently ignore files with unknown extensions while scanning
       // the directory
     }
   }, settings);
+  return filenames;
+}
+
+bool LogLoader::load(const Poco::Path &name) {
+  bool success = loadFiles(listFiles(name));
+  LOG(INFO) << "Log formats in " << name.toString() << ": " << _formatStats;
+  return success;
+}
+
+bool LogLoader::loadFiles(const std::vector<std::string> &filenames,
+                          std::vector<Span<TimeStamp>> *spans,
+                          std::vector<bool> *loadedFiles) {
+  // Every file is loaded into a loader of its own, by whichever thread
+  // is free. Appending those in order gives the same data as loading
+  // all files here, one after the other.
+  std::vector<LogLoader> loaders(filenames.size());
+  std::vector<char> loaded(filenames.size(), 0);
+  std::atomic<size_t> next(0);
+  int threadCount = 0 < _jobs? _jobs : hardwareThreadCount();
+  parallelFor(threadCount, threadCount, [&](size_t) {
+    for (size_t i = next++; i < filenames.size(); i = next++) {
+      // Some loaders keep state from one file to the next, see
+      // hack::bootCount. Do not let that depend on the thread.
+      hack::bootCount = 0;
+      loaded[i] = loaders[i].loadFile(filenames[i]);
+    }
+  });
+  if (spans != nullptr) {
+    spans->clear();
+    for (const auto& loader: loaders) {
+      spans->push_back(loader._acc.timeSpan());
+    }
+  }
+  if (loadedFiles != nullptr) {
+    loadedFiles->assign(loaded.begin(), loaded.end());
+  }
+  for (auto& loader: loaders) {
+    _acc.append(&loader._acc);
+    _formatStats.add(loader._formatStats);
+  }
+
+  int failCount = 0;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    if (!loaded[i]) {
+      if (failCount < 12) { // So that we don't flood the log file if there are many files.
+        LOG(ERROR) << "Failed to load log file " << filenames[i];
+      }
+      failCount++;
+    }
+  }
   if (0 < failCount) {
-    LOG(ERROR) << "Failed to load " << failCount << " files when visiting " << name.toString();
+    LOG(ERROR) << "Failed to load " << failCount << " of "
+      << filenames.size() << " files";
   }
 
   return 0 == failCount;
 }
 
+void LogLoader::keepOnly(TimeStamp from, TimeStamp to) {
+  _acc.keepOnly(from, to);
+}
+
 NavDataset LogLoader::loadNavDataset(const std::string &name) {
   LogLoader loader;
   loader.load(name);
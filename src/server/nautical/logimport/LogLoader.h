@@ -8,6 +8,7 @@
 
 #include <server/nautical/NavDataset.h>
 #include <server/nautical/logimport/LogAccumulator.h>
+#include <server/nautical/logimport/LogFormat.h>
 
 namespace Poco {class Path;}
 
@@ -35,6 +36,23 @@ class LogLoader {
   bool load(const std::string &name);
   bool load(const Poco::Path &name);
 
+  // Load a list of files. If 'spans' is given, it receives the time span
+  // of the data of every file, uninitialized for files without data.
+  // If 'loaded' is given, it receives whether every file could be loaded.
+  bool loadFiles(const std::vector<std::string> &filenames,
+                 std::vector<Span<TimeStamp>> *spans = nullptr,
+                 std::vector<bool> *loaded = nullptr);
+
+  // The log files that load(name) would load, in the same order.
+  static std::vector<std::string> listFiles(const Poco::Path &name);
+
+  // Drop the loaded samples outside [from, to[.
+  void keepOnly(TimeStamp from, TimeStamp to);
+
+  // Number of threads that parse the files of a directory, or 0 for
+  // one per hardware thread. The loaded data does not depend on it.
+  void setJobs(int jobs) { _jobs = jobs; }
+
   // Conveniency functions when there is just one thing
   // to load.
   static NavDataset loadNavDataset(const std::string &name);
@@ -52,8 +70,18 @@ class LogLoader {
   // Check if extension is accepted. Only the filename is inspected.
   static bool acceptFile(const std::string& filename);
 
+  // Formats of the files loaded so far, as guessed from their content.
+  const LogFormatStats& formatStats() const { return _formatStats; }
+
  private:
   LogAccumulator _acc;
+  LogFormatStats _formatStats;
+  int _jobs = 1;
+
+  // Loads a file with the parser for its sniffed format, or, if that
+  // fails, with the first other parser that succeeds.
+  bool loadSniffedFile(const std::string &filename);
+  bool loadFileAs(LogFormat format, const std::string &filename);
   void loadValueSet(const ValueSet &set);
   void loadTextData(const ValueSet &stream);
 };
@@ -5,7 +5,17 @@
 #include <gtest/gtest.h>
 #include <server/nautical/logimport/LogLoader.h>
 
+#include <algorithm>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/lzma.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <fstream>
 #include <server/common/Env.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
 
 using namespace sail;
 using std::string;
@@ -20,17 +30,36 @@ void sendFakeValue(int val, FakeClockDispatcher *dispatcher) {
   dispatcher->publishValue(AWS, "test", Velocity<double>::knots(val));
 }
 
-void makeLogFile(LogFile *loggedData) {
+void makeLogFile(LogFile *loggedData, int offset = 0) {
   FakeClockDispatcher dispatcher;
   Logger logger(&dispatcher);
+  dispatcher.advance(Duration<>::seconds(offset));
 
   for (int i = 0 ; i < 10; ++i) {
-    sendFakeValue(i, &dispatcher);
+    sendFakeValue(offset + i, &dispatcher);
     dispatcher.advance(Duration<>::seconds(1));
   }
   logger.flushTo(loggedData);
 }
 
+// Compresses a file and returns the number of AWA values loaded from it.
+template <typename Compressor>
+int loadCompressed(const string& filename, const string& ext,
+                   Compressor compressor) {
+  string compressed = filename + ext;
+  {
+    std::ifstream src(filename, std::ios::binary);
+    boost::iostreams::filtering_ostream dst;
+    dst.push(compressor);
+    dst.push(boost::iostreams::file_sink(compressed, std::ios::binary));
+    boost::iostreams::copy(src, dst);
+  }
+  LogLoader loader;
+  EXPECT_TRUE(loader.loadFile(compressed));
+  Poco::File(compressed).remove();
+  return loader.makeNavDataset().dispatcher()->values<AWA>().size();
+}
+
 
 }  // namespace
 
@@ -57,3 +86,86 @@ TEST(LogLoaderTest, DecompressTest) {
   EXPECT_TRUE(loader.loadFile(std::string(Env::SOURCE_DIR) + "/datasets/tinylog.txt.gz"));
 }
 
+TEST(LogLoaderTest, DecompressFormats) {
+  LogFile data;
+  makeLogFile(&data);
+  string filename = Poco::Path::temp() + "/LogLoaderTest_DecompressFormats.log";
+  EXPECT_TRUE(Logger::save(filename, data));
+
+  EXPECT_EQ(10, loadCompressed(filename, ".gz",
+                                boost::iostreams::gzip_compressor()));
+  EXPECT_EQ(10, loadCompressed(filename, ".bz2",
+                                boost::iostreams::bzip2_compressor()));
+  EXPECT_EQ(10, loadCompressed(filename, ".xz",
+                                boost::iostreams::lzma_compressor()));
+  Poco::File(filename).remove();
+}
+
+
+TEST(LogLoaderTest, ParallelLoad) {
+  Poco::Path dir(Poco::Path::temp());
+  dir.pushDirectory("LogLoaderTest_ParallelLoad");
+  Poco::File(dir).createDirectories();
+  for (int i = 0; i < 7; i++) {
+    LogFile data;
+    makeLogFile(&data, 10*i);
+    Poco::Path file(dir);
+    file.setFileName("file" + std::to_string(i) + ".log");
+    EXPECT_TRUE(Logger::save(file.toString(), data));
+  }
+
+  auto loadWithJobs = [&](int jobs) {
+    LogLoader loader;
+    loader.setJobs(jobs);
+    EXPECT_TRUE(loader.load(dir));
+    return loader.makeNavDataset();
+  };
+  auto sequential = loadWithJobs(1);
+  auto parallel = loadWithJobs(3);
+  Poco::File(dir).remove(true);
+
+  auto x = sequential.dispatcher()->values<AWA>().samples();
+  auto y = parallel.dispatcher()->values<AWA>().samples();
+  EXPECT_EQ(70, x.size());
+  ASSERT_EQ(x.size(), y.size());
+  for (int i = 0; i < x.size(); i++) {
+    EXPECT_EQ(x[i].time, y[i].time);
+    EXPECT_EQ(x[i].value.degrees(), y[i].value.degrees());
+  }
+}
+
+TEST(LogLoaderTest, FileSpans) {
+  Poco::Path dir(Poco::Path::temp());
+  dir.pushDirectory("LogLoaderTest_FileSpans");
+  Poco::File(dir).createDirectories();
+  for (int i = 0; i < 3; i++) {
+    LogFile data;
+    makeLogFile(&data, 100*i);
+    Poco::Path file(dir);
+    file.setFileName("file" + std::to_string(i) + ".log");
+    EXPECT_TRUE(Logger::save(file.toString(), data));
+  }
+  auto filenames = LogLoader::listFiles(dir);
+  std::sort(filenames.begin(), filenames.end());
+  filenames.push_back(Poco::Path(dir, "missing.log").toString());
+
+  LogLoader loader;
+  std::vector<Span<TimeStamp>> spans;
+  std::vector<bool> loaded;
+  EXPECT_FALSE(loader.loadFiles(filenames, &spans, &loaded));
+  Poco::File(dir).remove(true);
+
+  EXPECT_EQ((std::vector<bool>{true, true, true, false}), loaded);
+
+  ASSERT_EQ(4, spans.size());
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(spans[i].initialized());
+    EXPECT_NEAR(9.0, (spans[i].maxv() - spans[i].minv()).seconds(), 0.1);
+    EXPECT_NEAR(100.0*i, (spans[i].minv() - spans[0].minv()).seconds(), 0.1);
+  }
+  EXPECT_FALSE(spans[3].initialized());
+
+  // Only the second file
+  loader.keepOnly(spans[1].minv(), spans[1].maxv() + Duration<>::seconds(1));
+  EXPECT_EQ(10, loader.makeNavDataset().dispatcher()->values<AWA>().size());
+}
@@ -0,0 +1,203 @@
+#include <server/nautical/logimport/LogManifest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <server/common/logging.h>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace sail {
+
+// One line per file, separated by tabs:
+//
+//   path  size  modified  first  last
+//
+// where first and last are milliseconds since 1970, or "-" if the
+// file has no data.
+
+namespace {
+
+  const char kHeader[] = "# log manifest 1";
+
+  bool parseEntry(const std::string& line, LogFileEntry* dst) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, '\t')) {
+      fields.push_back(field);
+    }
+    if (fields.size() != 5) {
+      return false;
+    }
+    try {
+      dst->path = fields[0];
+      dst->size = std::stoll(fields[1]);
+      dst->modified = std::stoll(fields[2]);
+      if (fields[3] == "-" || fields[4] == "-") {
+        dst->span = Span<TimeStamp>();
+      } else {
+        dst->span = Span<TimeStamp>(
+            TimeStamp::fromMilliSecondsSince1970(std::stoll(fields[3])),
+            TimeStamp::fromMilliSecondsSince1970(std::stoll(fields[4])));
+      }
+    } catch (const std::exception&) {
+      return false;
+    }
+    return true;
+  }
+
+  bool overlaps(const Span<TimeStamp>& span, TimeStamp from, TimeStamp to) {
+    return span.initialized() && span.minv() <= to && from <= span.maxv();
+  }
+
+  int64_t roundDown(int64_t x, int64_t step) {
+    int64_t r = x % step;
+    return r < 0? x - r - step : x - r;
+  }
+
+  int64_t roundUp(int64_t x, int64_t step) {
+    return -roundDown(-x, step);
+  }
+
+}  // namespace
+
+LogFileEntry statLogFile(const std::string& path) {
+  LogFileEntry entry;
+  entry.path = path;
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0) {
+    entry.size = st.st_size;
+    entry.modified = st.st_mtime;
+  }
+  return entry;
+}
+
+bool LogManifest::load(const std::string& filename) {
+  std::ifstream file(filename);
+  std::string line;
+  if (!std::getline(file, line) || line != kHeader) {
+    return false;
+  }
+  std::map<std::string, LogFileEntry> files;
+  while (std::getline(file, line)) {
+    LogFileEntry entry;
+    if (!parseEntry(line, &entry)) {
+      LOG(ERROR) << "Bad line in log manifest " << filename << ": " << line;
+      return false;
+    }
+    files[entry.path] = entry;
+  }
+  _files.swap(files);
+  return true;
+}
+
+bool LogManifest::save(const std::string& filename) const {
+  std::ofstream file(filename);
+  file << kHeader << "\n";
+  for (const auto& kv: _files) {
+    const LogFileEntry& e = kv.second;
+    file << e.path << "\t" << e.size << "\t" << e.modified << "\t";
+    if (e.span.initialized()) {
+      file << e.span.minv().toMilliSecondsSince1970() << "\t"
+        << e.span.maxv().toMilliSecondsSince1970() << "\n";
+    } else {
+      file << "-\t-\n";
+    }
+  }
+  if (!file.flush()) {
+    LOG(ERROR) << "Failed to write log manifest " << filename;
+    return false;
+  }
+  return true;
+}
+
+void LogManifest::diff(const std::vector<LogFileEntry>& current,
+                       std::vector<LogFileEntry>* changed,
+                       std::vector<LogFileEntry>* removed) const {
+  std::map<std::string, const LogFileEntry*> seen;
+  for (const auto& e: current) {
+    seen[e.path] = &e;
+    auto found = _files.find(e.path);
+    if (found == _files.end() || !found->second.sameFileAs(e)) {
+      changed->push_back(e);
+    }
+  }
+  for (const auto& kv: _files) {
+    if (seen.count(kv.first) == 0) {
+      removed->push_back(kv.second);
+    }
+  }
+}
+
+std::vector<Span<TimeStamp>> LogManifest::update(
+    const std::vector<LogFileEntry>& changed,
+    const std::vector<bool>& loaded,
+    const std::vector<Span<TimeStamp>>& spans,
+    const std::vector<LogFileEntry>& removed) {
+  CHECK_EQ(changed.size(), loaded.size());
+  CHECK_EQ(changed.size(), spans.size());
+  std::vector<Span<TimeStamp>> dst;
+  for (size_t i = 0; i < changed.size(); i++) {
+    auto previous = _files.find(changed[i].path);
+    if (previous != _files.end()) {
+      dst.push_back(previous->second.span);
+      _files.erase(previous);
+    }
+    if (loaded[i]) {
+      LogFileEntry entry = changed[i];
+      entry.span = spans[i];
+      dst.push_back(entry.span);
+      set(entry);
+    } else {
+      LOG(WARNING) << "Not adding " << changed[i].path
+        << " to the log manifest, it will be loaded again next time";
+    }
+  }
+  for (const auto& entry: removed) {
+    dst.push_back(entry.span);
+    remove(entry.path);
+  }
+  return dst;
+}
+
+std::vector<std::string> LogManifest::filesOverlapping(
+    TimeStamp from, TimeStamp to) const {
+  std::vector<std::string> dst;
+  for (const auto& kv: _files) {
+    if (overlaps(kv.second.span, from, to)) {
+      dst.push_back(kv.first);
+    }
+  }
+  return dst;
+}
+
+std::vector<Span<TimeStamp>> affectedTimeRanges(
+    const std::vector<Span<TimeStamp>>& spans,
+    Duration<double> margin, Duration<double> alignment) {
+  int64_t step = std::max(int64_t(1),
+      int64_t(std::round(alignment.milliseconds())));
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+  for (const auto& span: spans) {
+    if (span.initialized()) {
+      ranges.push_back({
+        roundDown((span.minv() - margin).toMilliSecondsSince1970(), step),
+        roundUp((span.maxv() + margin).toMilliSecondsSince1970(), step)});
+    }
+  }
+  std::sort(ranges.begin(), ranges.end());
+
+  std::vector<Span<TimeStamp>> dst;
+  for (size_t i = 0; i < ranges.size();) {
+    auto range = ranges[i];
+    for (i++; i < ranges.size() && ranges[i].first <= range.second; i++) {
+      range.second = std::max(range.second, ranges[i].second);
+    }
+    dst.push_back(Span<TimeStamp>(
+        TimeStamp::fromMilliSecondsSince1970(range.first),
+        TimeStamp::fromMilliSecondsSince1970(range.second)));
+  }
+  return dst;
+}
+
+}
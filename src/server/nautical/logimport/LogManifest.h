@@ -0,0 +1,84 @@
+/*
+ *  Keeps track of the log files of a boat that have already been
+ *  processed, and of the time span of their data, so that a new or
+ *  modified file only requires reprocessing the time it overlaps.
+ */
+
+#ifndef SERVER_NAUTICAL_LOGIMPORT_LOGMANIFEST_H_
+#define SERVER_NAUTICAL_LOGIMPORT_LOGMANIFEST_H_
+
+#include <map>
+#include <server/common/Span.h>
+#include <server/common/TimeStamp.h>
+#include <string>
+#include <vector>
+
+namespace sail {
+
+struct LogFileEntry {
+  std::string path;
+  int64_t size = -1;
+  int64_t modified = 0; // Seconds since 1970
+
+  // The time span of the data in the file, uninitialized if the
+  // file has no data.
+  Span<TimeStamp> span;
+
+  // Size and modification time match
+  bool sameFileAs(const LogFileEntry& other) const {
+    return size == other.size && modified == other.modified;
+  }
+};
+
+// Size and modification time of a file, without its span.
+// The size is -1 if the file does not exist.
+LogFileEntry statLogFile(const std::string& path);
+
+class LogManifest {
+ public:
+  // Returns false if the file does not exist or can't be parsed.
+  bool load(const std::string& filename);
+  bool save(const std::string& filename) const;
+
+  const std::map<std::string, LogFileEntry>& files() const {
+    return _files;
+  }
+
+  void set(const LogFileEntry& entry) { _files[entry.path] = entry; }
+  void remove(const std::string& path) { _files.erase(path); }
+
+  // The files of 'current' that are not in the manifest or have been
+  // modified, and the files of the manifest that are not in 'current'.
+  void diff(const std::vector<LogFileEntry>& current,
+            std::vector<LogFileEntry>* changed,
+            std::vector<LogFileEntry>* removed) const;
+
+  // Records the files of 'changed' that could be loaded, with the
+  // spans they were loaded with, and forgets the 'removed' files.
+  // A file that failed to load is left out, so that the next diff
+  // reports it again. Returns the spans to reprocess: the data of the
+  // loaded files, and whatever the changed and removed files held
+  // before.
+  std::vector<Span<TimeStamp>> update(
+      const std::vector<LogFileEntry>& changed,
+      const std::vector<bool>& loaded,
+      const std::vector<Span<TimeStamp>>& spans,
+      const std::vector<LogFileEntry>& removed);
+
+  // The files with data in [from, to], sorted by path.
+  std::vector<std::string> filesOverlapping(
+      TimeStamp from, TimeStamp to) const;
+ private:
+  std::map<std::string, LogFileEntry> _files;
+};
+
+// The time ranges to reprocess for data in 'spans': every span is
+// widened by 'margin', rounded outwards to a multiple of 'alignment'
+// since 1970, and overlapping ranges are merged. The result is sorted.
+std::vector<Span<TimeStamp>> affectedTimeRanges(
+    const std::vector<Span<TimeStamp>>& spans,
+    Duration<double> margin, Duration<double> alignment);
+
+}
+
+#endif /* SERVER_NAUTICAL_LOGIMPORT_LOGMANIFEST_H_ */
@@ -0,0 +1,124 @@
+#include <server/nautical/logimport/LogManifest.h>
+
+#include <gtest/gtest.h>
+
+using namespace sail;
+
+namespace {
+  auto offset = TimeStamp::UTC(2017, 7, 8, 12, 0, 0);
+  auto minute = Duration<double>::minutes(1.0);
+
+  LogFileEntry makeEntry(const std::string& path, int64_t size,
+                         double fromMinute, double toMinute) {
+    LogFileEntry e;
+    e.path = path;
+    e.size = size;
+    e.modified = 1500000000;
+    e.span = Span<TimeStamp>(offset + fromMinute*minute,
+                             offset + toMinute*minute);
+    return e;
+  }
+}
+
+TEST(LogManifestTest, SaveAndLoad) {
+  const char filename[] = "/tmp/log_manifest_test.tsv";
+  LogManifest src;
+  src.set(makeEntry("/boat/a.log", 100, 0, 10));
+  LogFileEntry empty;
+  empty.path = "/boat/empty.log";
+  empty.size = 0;
+  src.set(empty);
+  EXPECT_TRUE(src.save(filename));
+
+  LogManifest dst;
+  EXPECT_TRUE(dst.load(filename));
+  ASSERT_EQ(2, dst.files().size());
+  const LogFileEntry& a = dst.files().at("/boat/a.log");
+  EXPECT_EQ(100, a.size);
+  EXPECT_EQ(1500000000, a.modified);
+  EXPECT_EQ(offset, a.span.minv());
+  EXPECT_EQ(offset + 10.0*minute, a.span.maxv());
+  EXPECT_FALSE(dst.files().at("/boat/empty.log").span.initialized());
+
+  EXPECT_FALSE(dst.load("/tmp/this_file_should_not_exist.tsv"));
+}
+
+TEST(LogManifestTest, Diff) {
+  LogManifest manifest;
+  manifest.set(makeEntry("a", 100, 0, 10));
+  manifest.set(makeEntry("b", 100, 20, 30));
+  manifest.set(makeEntry("c", 100, 40, 50));
+
+  std::vector<LogFileEntry> changed, removed;
+  manifest.diff({makeEntry("a", 100, 0, 0), makeEntry("b", 120, 0, 0),
+                 makeEntry("d", 100, 0, 0)}, &changed, &removed);
+  ASSERT_EQ(2, changed.size());
+  EXPECT_EQ("b", changed[0].path);
+  EXPECT_EQ("d", changed[1].path);
+  ASSERT_EQ(1, removed.size());
+  EXPECT_EQ("c", removed[0].path);
+
+  auto files = manifest.filesOverlapping(offset + 5.0*minute,
+                                         offset + 20.0*minute);
+  EXPECT_EQ((std::vector<std::string>{"a", "b"}), files);
+}
+
+TEST(LogManifestTest, AffectedTimeRanges) {
+  auto ranges = affectedTimeRanges({
+      makeEntry("a", 0, 3, 4).span,
+      Span<TimeStamp>(),
+      makeEntry("b", 0, 31, 32).span,
+      makeEntry("c", 0, 14, 15).span}, minute, 10.0*minute);
+
+  // [2, 5] and [13, 16] are rounded to [0, 10] and [10, 20] and merged.
+  auto base = TimeStamp::UTC(2017, 7, 8, 12, 0, 0);
+  ASSERT_EQ(2, ranges.size());
+  EXPECT_EQ(base, ranges[0].minv());
+  EXPECT_EQ(base + 20.0*minute, ranges[0].maxv());
+  EXPECT_EQ(base + 30.0*minute, ranges[1].minv());
+  EXPECT_EQ(base + 40.0*minute, ranges[1].maxv());
+}
+
+TEST(LogManifestTest, Update) {
+  LogManifest manifest;
+  manifest.set(makeEntry("a", 100, 0, 10));
+  manifest.set(makeEntry("b", 100, 20, 30));
+  manifest.set(makeEntry("c", 100, 40, 50));
+
+  // 'a' grew and now ends later, 'b' was rewritten but can no longer
+  // be loaded, 'c' was deleted and 'd' is new but can't be loaded.
+  std::vector<LogFileEntry> changed, removed;
+  manifest.diff({makeEntry("a", 120, 0, 0), makeEntry("b", 90, 0, 0),
+                 makeEntry("d", 100, 0, 0)}, &changed, &removed);
+  auto spans = manifest.update(changed, {true, false, false},
+      {makeEntry("", 0, 0, 15).span, Span<TimeStamp>(),
+       makeEntry("", 0, 60, 61).span}, removed);
+
+  // The old and new data of 'a', and the old data of 'b' and 'c'
+  ASSERT_EQ(4, spans.size());
+  EXPECT_EQ(offset + 10.0*minute, spans[0].maxv());
+  EXPECT_EQ(offset + 15.0*minute, spans[1].maxv());
+  EXPECT_EQ(offset + 20.0*minute, spans[2].minv());
+  EXPECT_EQ(offset + 40.0*minute, spans[3].minv());
+
+  ASSERT_EQ(1, manifest.files().size());
+  const LogFileEntry& a = manifest.files().at("a");
+  EXPECT_EQ(120, a.size);
+  EXPECT_EQ(offset + 15.0*minute, a.span.maxv());
+  EXPECT_TRUE(manifest.filesOverlapping(
+      offset + 20.0*minute, offset + 50.0*minute).empty());
+
+  // The files that failed to load are reported again.
+  changed.clear();
+  removed.clear();
+  manifest.diff({makeEntry("a", 120, 0, 0), makeEntry("b", 90, 0, 0),
+                 makeEntry("d", 100, 0, 0)}, &changed, &removed);
+  ASSERT_EQ(2, changed.size());
+  EXPECT_EQ("b", changed[0].path);
+  EXPECT_EQ("d", changed[1].path);
+  EXPECT_TRUE(removed.empty());
+
+  // Still failing, there is nothing left to reprocess for them.
+  EXPECT_TRUE(manifest.update(changed, {false, false},
+      {Span<TimeStamp>(), Span<TimeStamp>()}, removed).empty());
+}
@@ -11,6 +11,7 @@
 #include <device/anemobox/Nmea0183Adaptor.h>
 #include <server/nautical/logimport/SourceGroup.h>
 #include <fstream>
+#include <vector>
 
 namespace sail {
 namespace Nmea0183Loader {
@@ -107,8 +108,10 @@ void streamToNmeaParser(TimeStamp endTime,
 
 void streamToNmeaParser(std::istream *src, NmeaParser *dstParser,
     Nmea0183LogLoaderAdaptor *adaptor) {
-  while (src->good()) {
-    Nmea0183ProcessByte(adaptor->sourceName(), src->get(), dstParser, adaptor);
+  std::vector<char> buffer(1 << 16);
+  while (src->read(buffer.data(), buffer.size()) || 0 < src->gcount()) {
+    Nmea0183ProcessBuffer(adaptor->sourceName(), buffer.data(),
+                          src->gcount(), dstParser, adaptor);
   }
 }
 
@@ -209,26 +209,30 @@ namespace {
 }
 
 
-void load(const LogFile &data, LogAccumulator *dst) {
-
-  hack::bootCount = data.bootcount() - 101;
+namespace {
+  void loadWithTimeOffset(const LogFile &data, Duration<double> timeOffset,
+                          LogAccumulator *dst) {
+    hack::bootCount = data.bootcount() - 101;
 
-  // TODO: Define a set of standard priorities in a file somewhere
-  auto rawStreamPriority = -16;
+    // TODO: Define a set of standard priorities in a file somewhere
+    auto rawStreamPriority = -16;
 
-  auto timeOffset = computeTimeOffset(data);
+    for (int i = 0; i < data.stream_size(); i++) {
+      const auto &stream = data.stream(i);
+      dst->_sourcePriority[stream.source()] = stream.priority();
+      loadValueSet(stream, dst, timeOffset);
+    }
 
-  for (int i = 0; i < data.stream_size(); i++) {
-    const auto &stream = data.stream(i);
-    dst->_sourcePriority[stream.source()] = stream.priority();
-    loadValueSet(stream, dst, timeOffset);
+    for (int i = 0; i < data.text_size(); i++) {
+      const auto &stream = data.text(i);
+      dst->_sourcePriority[stream.source()] = rawStreamPriority;
+      loadValueSet(stream, dst, timeOffset);
+    }
   }
+}
 
-  for (int i = 0; i < data.text_size(); i++) {
-    const auto &stream = data.text(i);
-    dst->_sourcePriority[stream.source()] = rawStreamPriority;
-    loadValueSet(stream, dst, timeOffset);
-  }
+void load(const LogFile &data, LogAccumulator *dst) {
+  loadWithTimeOffset(data, computeTimeOffset(data), dst);
 }
 
 bool load(const std::string &filename, LogAccumulator *dst) {
@@ -240,5 +244,38 @@ bool load(const std::string &filename, LogAccumulator *dst) {
   return false;
 }
 
+bool load(std::istream *stream, LogAccumulator *dst) {
+  LogFile file;
+  if (Logger::read(stream, &file)) {
+    load(file, dst);
+    return true;
+  }
+  return false;
+}
+
+bool load(const std::string &filename, const LogBlockSelection &selection,
+          LogAccumulator *dst) {
+  LogFile file;
+  if (!Logger::read(filename, selection, &file)) {
+    return false;
+  }
+  if (selection.shortNames.empty() && selection.sources.empty()) {
+    load(file, dst);
+    return true;
+  }
+
+  // The external times are in the "dateTime" streams, or in
+  // NMEA 0183 text.
+  LogBlockSelection timeSelection;
+  timeSelection.from = selection.from;
+  timeSelection.to = selection.to;
+  timeSelection.shortNames = {"dateTime", "text"};
+  timeSelection.includeRawNmea2000 = false;
+  LogFile timeReference;
+  Logger::read(filename, timeSelection, &timeReference);
+  loadWithTimeOffset(file, computeTimeOffset(timeReference), dst);
+  return true;
+}
+
 }
 } /* namespace sail */
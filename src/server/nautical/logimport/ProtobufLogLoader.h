@@ -18,6 +18,14 @@ namespace ProtobufLogLoader {
 void load(const LogFile &data, LogAccumulator *dst);
 bool load(const std::string &filename, LogAccumulator *dst);
 
+// Loads a log file from a stream, such as a decompressing one.
+bool load(std::istream *stream, LogAccumulator *dst);
+
+// Only loads the selected streams. Streams that carry external time
+// are still read to correct the time of the selected ones.
+bool load(const std::string &filename, const LogBlockSelection &selection,
+          LogAccumulator *dst);
+
 }
 } /* namespace sail */
 
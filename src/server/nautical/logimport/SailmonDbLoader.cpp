@@ -4,6 +4,9 @@
 #include <server/common/TimeStamp.h>
 #include <server/nautical/logimport/LogAccumulator.h>
 
+#include <algorithm>
+#include <string>
+
 namespace sail {
 
 namespace {
@@ -53,49 +56,145 @@ enum SailmonRawIds {
   SM_LOAD_CELL_ADC_VALUE = 41
 };
 
-}  // namespace
+const auto logTimeUnit = 0.001_s;
+
+// Rows are read in batches of this size.
+const int kBatchSize = 4096;
+
+// A prepared statement, stepped row by row.
+class SqlStatement {
+ public:
+  SqlStatement(const std::shared_ptr<sqlite3>& db, const char* sql)
+    : _db(db.get()), _stmt(nullptr), _done(false), _failed(false) {
+    if (sqlite3_prepare_v2(_db, sql, -1, &_stmt, nullptr) != SQLITE_OK) {
+      LOG(ERROR) << "SQL error: " << sqlite3_errmsg(_db)
+        << "\nIn query: " << sql;
+      sqlite3_finalize(_stmt);
+      _stmt = nullptr;
+      _failed = true;
+    }
+  }
 
-template <typename X>
-X stringToX(const char* arg) {
-  std::stringstream ss;
-  ss << arg;
-  X i = 0;
-  ss >> i;
-  return i;
-}
+  ~SqlStatement() {
+    sqlite3_finalize(_stmt);
+  }
+
+  SqlStatement(const SqlStatement&) = delete;
+  SqlStatement& operator=(const SqlStatement&) = delete;
+
+  bool bind(int index, int64_t value) {
+    return _stmt != nullptr
+      && sqlite3_bind_int64(_stmt, index, value) == SQLITE_OK;
+  }
+
+  // Moves to the next row. Returns false at the end or on an error,
+  // and from then on, instead of restarting the query.
+  bool step() {
+    if (_stmt == nullptr || _done) {
+      return false;
+    }
+    int rc = sqlite3_step(_stmt);
+    if (rc == SQLITE_ROW) {
+      return true;
+    }
+    _done = true;
+    if (rc != SQLITE_DONE) {
+      LOG(ERROR) << "SQL error: " << sqlite3_errmsg(_db)
+        << "\nIn query: " << sqlite3_sql(_stmt);
+      _failed = true;
+    }
+    return false;
+  }
 
+  int64_t int64At(int column) const {
+    return sqlite3_column_int64(_stmt, column);
+  }
+
+  double doubleAt(int column) const {
+    return sqlite3_column_double(_stmt, column);
+  }
 
-TimeStamp parseAbsoluteTime(char* arg) {
-  return TimeStamp::fromMilliSecondsSince1970(stringToX<int64_t>(arg)*1000);
+  bool failed() const {
+    return _failed;
+  }
+ private:
+  sqlite3* _db;
+  sqlite3_stmt* _stmt;
+  bool _done;
+  bool _failed;
+};
+
+// A batch of rows of the form (sensorId, log_time, value, value, ...),
+// stored column by column.
+struct SensorRows {
+  std::vector<int64_t> sensorIds;
+  std::vector<int> logTimes;
+  std::vector<std::vector<double>> values;
+
+  explicit SensorRows(int valueCount) : values(valueCount) {
+    sensorIds.reserve(kBatchSize);
+    logTimes.reserve(kBatchSize);
+    for (auto& column: values) {
+      column.reserve(kBatchSize);
+    }
+  }
+
+  size_t size() const {
+    return sensorIds.size();
+  }
+
+  // Replaces the content with the next rows of 'stmt'.
+  // Returns false if there were none.
+  bool read(SqlStatement* stmt) {
+    sensorIds.clear();
+    logTimes.clear();
+    for (auto& column: values) {
+      column.clear();
+    }
+    while (size() < kBatchSize && stmt->step()) {
+      sensorIds.push_back(stmt->int64At(0));
+      logTimes.push_back(int(stmt->int64At(1)));
+      for (size_t i = 0; i < values.size(); i++) {
+        values[i].push_back(stmt->doubleAt(2 + i));
+      }
+    }
+    return 0 < size();
+  }
+};
+
+TimeStamp estimateTime(const LocalAndAbsoluteTimePair& closest, int logTime) {
+  return closest.absoluteTime + double(logTime - closest.logTime)*logTimeUnit;
 }
 
-int64_t parseLogTime(char* arg) {
-  return stringToX<int64_t>(arg);
+}  // namespace
+
+SailmonTimeCorrection::SailmonTimeCorrection(
+    const std::vector<LocalAndAbsoluteTimePair>* pairs)
+  : _pairs(*pairs), _next(0) {
+  CHECK(!_pairs.empty());
 }
 
-int localAndAbsoluteTimeCallback(
-    void *data, int argc, char **argv,
-    char **azColName) {
-  CHECK(argc == 2);
-  LocalAndAbsoluteTimePair p;
-  p.logTime = parseLogTime(argv[0]);
-  p.absoluteTime = parseAbsoluteTime(argv[1]);
-  (reinterpret_cast<
-      std::vector<LocalAndAbsoluteTimePair>*>(data))->push_back(p);
-  return 0;
+TimeStamp SailmonTimeCorrection::operator()(int logTime) {
+  // Invariant: _next is the first pair that is not before logTime.
+  if (0 < _next && logTime <= _pairs[_next - 1].logTime) {
+    LocalAndAbsoluteTimePair p;
+    p.logTime = logTime;
+    _next = std::lower_bound(_pairs.begin(), _pairs.end(), p)
+      - _pairs.begin();
+  } else {
+    while (_next < _pairs.size() && _pairs[_next].logTime < logTime) {
+      _next++;
+    }
+  }
+  return estimateTime(_pairs[std::min(_next, _pairs.size() - 1)], logTime);
 }
 
-bool sqlQuery(std::shared_ptr<sqlite3> db, const std::string& sql,
-              int (*callback)(void*,int,char**,char**), void * ptr) {
-  char* errMsg = nullptr;
-  auto rc = sqlite3_exec(db.get(), sql.c_str(), callback, ptr, &errMsg);
-  if (rc != SQLITE_OK ) {
-    LOG(ERROR) << "SQL error: " << errMsg
-      << "\nIn query: " << sql;
-    sqlite3_free(errMsg);
-    return false;
+void SailmonTimeCorrection::resolve(const std::vector<int>& logTimes,
+                                    std::vector<TimeStamp>* dst) {
+  dst->resize(logTimes.size());
+  for (size_t i = 0; i < logTimes.size(); i++) {
+    (*dst)[i] = (*this)(logTimes[i]);
   }
-  return true;
 }
 
 std::vector<LocalAndAbsoluteTimePair> getSailmonTimeCorrectionTable(
@@ -106,56 +205,54 @@ std::vector<LocalAndAbsoluteTimePair> getSailmonTimeCorrectionTable(
       " = l2.log_time and l1.rawId=1 and l2.rawId=0 "
       "and l1.sensorId = l2.sensorId order by l1.log_time asc";
   std::vector<LocalAndAbsoluteTimePair> dst;
-  bool success = sqlQuery(db, sql, &localAndAbsoluteTimeCallback, &dst);
-  if (!success) {
+  SqlStatement stmt(db, sql);
+  while (stmt.step()) {
+    LocalAndAbsoluteTimePair p;
+    p.logTime = int(stmt.int64At(0));
+    p.absoluteTime = TimeStamp::fromMilliSecondsSince1970(
+        stmt.int64At(1)*1000);
+    dst.push_back(p);
+  }
+  if (stmt.failed()) {
     return std::vector<LocalAndAbsoluteTimePair>();
   }
   return dst;
 }
 
+namespace {
 
-std::string sensorIdToSourceString(char* c) {
-  return std::string("sailmonSensorId(") + c + ")";
+std::string sensorIdToSourceString(int64_t sensorId) {
+  return "sailmonSensorId(" + std::to_string(sensorId) + ")";
 }
 
+// The channels of a LogAccumulator, looked up by sensor id.
+template <typename T>
+class ChannelsBySensor {
+ public:
+  typedef typename TimedSampleCollection<T>::TimedVector TimedVector;
+
+  ChannelsBySensor(std::map<std::string, TimedVector>* channels)
+    : _channels(channels) {}
+
+  TimedVector* get(int64_t sensorId) {
+    auto found = _bySensor.find(sensorId);
+    if (found != _bySensor.end()) {
+      return found->second;
+    }
+    TimedVector* dst = &(*_channels)[sensorIdToSourceString(sensorId)];
+    _bySensor[sensorId] = dst;
+    return dst;
+  }
+ private:
+  std::map<std::string, TimedVector>* _channels;
+  std::map<int64_t, TimedVector*> _bySensor;
+};
 
 struct Acc {
   std::vector<LocalAndAbsoluteTimePair> timePairs;
   LogAccumulator* dst = nullptr;
-
-  TimeStamp toAbsoluteTime(int64_t i) const {
-    return estimateTime(timePairs, i);
-  }
-
-  template <DataCode code>
-  void accumulate(
-      const std::string& source,
-      TimeStamp time,
-      typename TypeForCode<code>::type value) {
-    (*getChannels<code>(dst))[source].push_back({time, value});
-  }
 };
 
-int gpsQueryCallback(
-    void *data, int argc, char **argv,
-    char **azColName) {
-  auto acc = reinterpret_cast<Acc*>(data);
-  CHECK(argc == 4);
-  auto sensorId = sensorIdToSourceString(argv[0]);
-  auto logTime = stringToX<int64_t>(argv[1]);
-  auto lat = stringToX<double>(argv[2]);
-  auto lon = stringToX<double>(argv[3]);
-
-  acc->dst->_GPS_POSsources[sensorId].push_back({
-    acc->toAbsoluteTime(logTime),
-    GeographicPosition<double>(
-        Angle<double>::degrees(lon),
-        Angle<double>::degrees(lat))
-  });
-
-  return 0;
-}
-
 bool accumulateGpsData(
     const std::shared_ptr<sqlite3>& db,
     Acc* dst) {
@@ -167,62 +264,66 @@ bool accumulateGpsData(
       "LogData as a, LogData as b WHERE "
       "a.sensorId = b.sensorId AND a.log_time = b.log_time "
       "AND a.rawId = 4 AND b.rawId = 5 order by a.log_time asc";
-  char* errMsg = nullptr;
-  auto rc = sqlite3_exec(db.get(), query, &gpsQueryCallback, dst, &errMsg);
-  if (rc != SQLITE_OK ) {
-    LOG(ERROR) << "Failed to select data\n";
-    LOG(ERROR) << "SQL error: %s\n", errMsg;
-    sqlite3_free(errMsg);
-    return false;
+  SqlStatement stmt(db, query);
+  SensorRows rows(2);
+  SailmonTimeCorrection correction(&dst->timePairs);
+  ChannelsBySensor<GeographicPosition<double>> channels(
+      &dst->dst->_GPS_POSsources);
+  std::vector<TimeStamp> times;
+  while (rows.read(&stmt)) {
+    correction.resolve(rows.logTimes, &times);
+    for (size_t i = 0; i < rows.size(); i++) {
+      channels.get(rows.sensorIds[i])->push_back({
+        times[i],
+        GeographicPosition<double>(
+            Angle<double>::degrees(rows.values[1][i]),
+            Angle<double>::degrees(rows.values[0][i]))
+      });
+    }
   }
-  return true;
-}
-
-template<DataCode Code, class Converter>
-int accumulateCallback(
-    void *data, int argc, char **argv,
-    char **azColName) {
-  auto acc = reinterpret_cast<Acc*>(data);
-  CHECK(argc == 3);
-  std::string source = sensorIdToSourceString(argv[0]);
-  auto logTime = stringToX<int64_t>(argv[2]);
-  Converter converter;
-  auto value = converter(argv[1]);
-
-  acc-> template accumulate<Code>(source,
-                                  acc->toAbsoluteTime(logTime),
-                                  value);
-  return 0;
+  return !stmt.failed();
 }
 
 template<DataCode Code, class Converter>
 bool accumulateValues(const std::shared_ptr<sqlite3>& db,
                       int rawId,
                       Acc* dst) {
-  std::string sql =
-    "SELECT sensorId, value, log_time "
-    "FROM LogData WHERE rawId = ";
-  sql += objectToString(rawId) + ";";
-
-  int (*callback)(void*,int,char**,char**) = accumulateCallback<Code, Converter>;
-  return sqlQuery(db, sql, callback, dst);
+  SqlStatement stmt(db,
+    "SELECT sensorId, log_time, value "
+    "FROM LogData WHERE rawId = ?;");
+  stmt.bind(1, rawId);
+  SensorRows rows(1);
+  SailmonTimeCorrection correction(&dst->timePairs);
+  ChannelsBySensor<typename TypeForCode<Code>::type> channels(
+      getChannels<Code>(dst->dst));
+  Converter converter;
+  std::vector<TimeStamp> times;
+  while (rows.read(&stmt)) {
+    correction.resolve(rows.logTimes, &times);
+    const auto& values = rows.values[0];
+    for (size_t i = 0; i < rows.size(); i++) {
+      channels.get(rows.sensorIds[i])->push_back({
+        times[i], converter(values[i])});
+    }
+  }
+  return !stmt.failed();
 }
 
 struct AngleConverter {
-  Angle<double> operator()(const char* str) {
-    return Angle<double>::degrees(stringToX<double>(str));
+  Angle<double> operator()(double x) {
+    return Angle<double>::degrees(x);
   }
 };
 
 struct LengthConverter {
-  Length<double> operator()(const char* str) {
-    return Length<double>::meters(stringToX<double>(str));
+  Length<double> operator()(double x) {
+    return Length<double>::meters(x);
   }
 };
 
 struct SpeedConverter {
-  Velocity<double> operator()(const char* str) {
-    return Velocity<double>::metersPerSecond(stringToX<double>(str));
+  Velocity<double> operator()(double x) {
+    return Velocity<double>::metersPerSecond(x);
   }
 };
 
@@ -239,13 +340,12 @@ LocalAndAbsoluteTimePair findClosest(
   return *y;
 }
 
-auto logTimeUnit = 0.001_s;
+}  // namespace
 
 TimeStamp estimateTime(
     const std::vector<LocalAndAbsoluteTimePair>& pairs,
     int logTime) {
-  auto closest = findClosest(pairs, logTime);
-  return closest.absoluteTime + double(logTime - closest.logTime)*logTimeUnit;
+  return estimateTime(findClosest(pairs, logTime), logTime);
 }
 
 
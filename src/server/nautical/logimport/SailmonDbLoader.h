@@ -29,6 +29,21 @@ TimeStamp estimateTime(
     int logTime);
 bool sailmonDbLoad(const std::string &filename, LogAccumulator *dst);
 
+// Computes the same times as estimateTime, but walks forward through
+// the table instead of searching it, as long as the log times increase.
+class SailmonTimeCorrection {
+ public:
+  SailmonTimeCorrection(const std::vector<LocalAndAbsoluteTimePair>* pairs);
+
+  TimeStamp operator()(int logTime);
+
+  void resolve(const std::vector<int>& logTimes,
+               std::vector<TimeStamp>* dst);
+ private:
+  const std::vector<LocalAndAbsoluteTimePair>& _pairs;
+  size_t _next;
+};
+
 }  // namespace sail
 
 #endif /* SERVER_NAUTICAL_LOGIMPORT_SAILMONDBLOADER_H_ */
@@ -53,6 +53,40 @@ TEST(SailmonDbLoaderTest, TimeTable) {
   }
 }
 
+TEST(SailmonDbLoaderTest, TimeCorrection) {
+  TimeStamp t0 = TimeStamp::UTC(2017, 9, 29, 12, 0, 0);
+  std::vector<LocalAndAbsoluteTimePair> pairs;
+  for (int i = 1; i <= 3; i++) {
+    LocalAndAbsoluteTimePair p;
+    p.logTime = 1000*i;
+    // Every correction point has its own offset, so that we
+    // can tell which one a time was estimated from.
+    p.absoluteTime = t0 + double(i)*1.0_s + double(100*i)*1.0_s;
+    pairs.push_back(p);
+  }
+
+  // Before, on, between and after the correction points,
+  // going forward and then backward.
+  std::vector<int> logTimes{
+    500, 1000, 1001, 1500, 2000, 2999, 3000, 4500, 1200, 999, 2500, 2500};
+  SailmonTimeCorrection correction(&pairs);
+  std::vector<TimeStamp> times;
+  correction.resolve(logTimes, &times);
+  EXPECT_EQ(logTimes.size(), times.size());
+  for (size_t i = 0; i < logTimes.size(); i++) {
+    EXPECT_EQ(estimateTime(pairs, logTimes[i]), times[i]);
+  }
+
+  // The point at or after the log time is used, or the last one.
+  auto seconds = [&](int i) { return (times[i] - t0).seconds(); };
+  EXPECT_NEAR(100.5, seconds(0), 1.0e-6);
+  EXPECT_NEAR(101.0, seconds(1), 1.0e-6);
+  EXPECT_NEAR(201.001, seconds(2), 1.0e-6);
+  EXPECT_NEAR(302.999, seconds(5), 1.0e-6);
+  EXPECT_NEAR(304.5, seconds(7), 1.0e-6);
+  EXPECT_NEAR(201.2, seconds(8), 1.0e-6);
+}
+
 TEST(SailmonDbLoaderTest, SmokeTest) {
   LogAccumulator accumulator;
   EXPECT_TRUE(sailmonDbLoad(path, &accumulator));
@@ -6,6 +6,7 @@
  */
 
 #include "AstraLoader.h"
+#include <atomic>
 #include <regex>
 #include <map>
 #include <iostream>
@@ -395,8 +396,12 @@ auto astraParser = trStreamLines() // All the lines of the file
         trMakeAstraData();
 
 Array<AstraData> loadAstraFile(const std::string& filename) {
+  return loadAstraFile(std::make_shared<std::ifstream>(filename));
+}
+
+Array<AstraData> loadAstraFile(const std::shared_ptr<std::istream>& stream) {
   return transduce(
-      makeOptional(std::make_shared<std::ifstream>(filename)),
+      makeOptional(stream),
       astraParser, // Produce structs from table rows.
       IntoArray<AstraData>());
 }
@@ -421,12 +426,12 @@ namespace {
       const Optional<T>& x, std::map<std::string,
         typename TimedSampleCollection<T>::TimedVector>* dst,
         const char* debug = "") {
-    static bool verbose = true;
+    // Files can be loaded in parallel.
+    static std::atomic<bool> verbose(true);
     if (!full.defined()) {
       LOG(WARNING) << "Missing timestamp for " << srcName;
     } else if (!x.defined()) {
-      if (verbose) {
-        verbose = false;
+      if (verbose.exchange(false)) {
         LOG(WARNING) << "Missing value for " << srcName << ": " << debug;
       }
     } else {
@@ -506,7 +511,12 @@ namespace {
  *
  */
 bool accumulateAstraLogs(const std::string& filename, LogAccumulator* dst) {
-  Array<AstraData> data = loadAstraFile(filename);
+  return accumulateAstraLogs(std::make_shared<std::ifstream>(filename), dst);
+}
+
+bool accumulateAstraLogs(const std::shared_ptr<std::istream>& stream,
+                         LogAccumulator* dst) {
+  Array<AstraData> data = loadAstraFile(stream);
   if (data.empty()) {
     return false;
   }
@@ -8,6 +8,8 @@
 #ifndef SERVER_NAUTICAL_LOGIMPORT_ASTRALOADER_H_
 #define SERVER_NAUTICAL_LOGIMPORT_ASTRALOADER_H_
 
+#include <iosfwd>
+#include <memory>
 #include <string>
 #include <server/transducers/Transducer.h>
 #include <server/common/Optional.h>
@@ -193,8 +195,11 @@ inline GenericTransducer<AstraDataStepper> trMakeAstraData() {
 }
 
 Array<AstraData> loadAstraFile(const std::string& filename);
+Array<AstraData> loadAstraFile(const std::shared_ptr<std::istream>& stream);
 
 bool accumulateAstraLogs(const std::string& filename, LogAccumulator* dst);
+bool accumulateAstraLogs(const std::shared_ptr<std::istream>& stream,
+                         LogAccumulator* dst);
 
 template <typename FieldAccess>
 AstraValueParser geographicAngle(
@@ -7,6 +7,7 @@
 #include <Poco/JSON/Parser.h>
 
 #include <fstream>
+#include <iterator>
 #include <server/common/logging.h>
 #include <server/nautical/logimport/LogAccumulator.h>
 #include <server/nautical/logimport/SourceGroup.h>
@@ -24,17 +25,23 @@ bool parseIwatch(const std::string& filename, LogAccumulator* dst) {
     LOG(ERROR) << filename << ": can't read file\n";
     return false;
   }
+  return parseIwatch(&stream, dst);
+}
 
-  // quickly fail if the filetype is wrong.
-  char header[2];
-  stream.read(header, 2);
-  if (!stream.good() || header[0] != '{' || header[1] != '"') {
+bool parseIwatch(std::istream* stream, LogAccumulator* dst) {
+  // quickly fail if the filetype is wrong. The stream may not be
+  // seekable, so the header is kept for the parser.
+  std::string header(2, '\0');
+  stream->read(&header[0], 2);
+  if (!stream->good() || header[0] != '{' || header[1] != '"') {
     return false;
   }
-  stream.seekg(0, stream.beg);
+  std::string text = header + std::string(
+      std::istreambuf_iterator<char>(*stream),
+      std::istreambuf_iterator<char>());
 
   Poco::JSON::Parser parser;
-  Var json = parser.parse(stream);
+  Var json = parser.parse(text);
   Object::Ptr object = json.extract<Object::Ptr>();
   if (!object) {
     return false;
@@ -5,6 +5,7 @@
 #include <server/nautical/NavDataset.h>
 #include <set>
 #include <string>
+#include <algorithm>
 #include <server/common/logging.h>
 
 using std::map;
@@ -31,6 +32,102 @@ TimeStamp tileEndTime(int64_t tile, int zoom) {
   return tileBeginTime(tile + 1, zoom);
 }
 
+bool ChartTileRange::containsTile(int zoom, int64_t tileno) const {
+  return _from <= tileBeginTime(tileno, zoom)
+    && tileEndTime(tileno, zoom) <= _to;
+}
+
+void ChartTileRange::tilesInside(
+    int zoom, int64_t* first, int64_t* end) const {
+  // The tiles that start at or after _from and end at or before _to.
+  *first = tileAt(_from - Duration<>::milliseconds(1), zoom) + 1;
+  *end = tileAt(_to, zoom);
+}
+
+std::vector<int64_t> ChartTileRange::straddlingTiles(int zoom) const {
+  std::vector<int64_t> dst;
+  if (_to <= _from) {
+    return dst;
+  }
+  for (int64_t tileno: {tileAt(_from, zoom),
+                        tileAt(_to - Duration<>::milliseconds(1), zoom)}) {
+    if (!containsTile(zoom, tileno)
+        && (dst.empty() || dst.back() != tileno)) {
+      dst.push_back(tileno);
+    }
+  }
+  return dst;
+}
+
+void ChartTileRange::samplesInside(
+    int zoom, int64_t tileno, int* first, int* end) const {
+  int64_t tileMillis = int64_t(1000) << zoom;
+  int64_t begin = tileBeginTime(tileno, zoom).toMilliSecondsSince1970();
+  auto index = [&](TimeStamp time) {
+    int64_t offset = time.toMilliSecondsSince1970() - begin;
+    return int(std::max(int64_t(0), std::min(
+        int64_t(_settings.samplesPerTile),
+        offset * _settings.samplesPerTile / tileMillis)));
+  };
+  *first = index(_from);
+  *end = index(_to);
+}
+
+namespace {
+
+template <typename T>
+void keepStored(const std::vector<T>& stored, int first, int end,
+                std::vector<T>* dst) {
+  for (int i = 0; i < int(dst->size()); i++) {
+    if (i < first || end <= i) {
+      (*dst)[i] = stored[i];
+    }
+  }
+}
+
+template <typename T>
+void clearSamples(int first, int end, std::vector<T>* dst) {
+  for (int i = first; i < std::min(end, int(dst->size())); i++) {
+    (*dst)[i] = T(0);
+  }
+}
+
+}  // namespace
+
+bool ChartTileRange::clearSamplesInside(
+    int zoom, int64_t tileno, StatArrays* stored) const {
+  int first = 0, end = 0;
+  samplesInside(zoom, tileno, &first, &end);
+  clearSamples(first, end, &stored->mean);
+  clearSamples(first, end, &stored->min);
+  clearSamples(first, end, &stored->max);
+  clearSamples(first, end, &stored->count);
+  for (int64_t count: stored->count) {
+    if (count > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ChartTileRange::keepSamplesOutside(
+    int zoom, int64_t tileno, const StatArrays& stored,
+    StatArrays* arrays) const {
+  if (stored.mean.size() != arrays->mean.size()
+      || stored.min.size() != arrays->min.size()
+      || stored.max.size() != arrays->max.size()
+      || stored.count.size() != arrays->count.size()) {
+    return false;
+  }
+  int first = 0, end = 0;
+  samplesInside(zoom, tileno, &first, &end);
+  keepStored(stored.mean, first, end, &arrays->mean);
+  keepStored(stored.min, first, end, &arrays->min);
+  keepStored(stored.max, first, end, &arrays->max);
+  keepStored(stored.count, first, end, &arrays->count);
+  return true;
+}
+
 
 namespace {
 
@@ -108,11 +205,9 @@ void downSampleData(int64_t tileno, int zoom,
     }
   } else {
     // build from data
-    const std::deque<TimedValue<T>>& values = data.samples();
-    auto firstOfTile = std::lower_bound(values.begin(), values.end(),
-                                        tileBeginTime(tileno, zoom));
-    auto firstAfterTile = std::lower_bound(values.begin(), values.end(),
-                                           tileEndTime(tileno, zoom));
+    auto values = data.samples();
+    auto firstOfTile = values.lowerBound(tileBeginTime(tileno, zoom));
+    auto firstAfterTile = values.lowerBound(tileEndTime(tileno, zoom));
     if (firstOfTile == firstAfterTile) {
       // nothing within the range of this tile.
       return;
@@ -122,8 +217,8 @@ void downSampleData(int64_t tileno, int zoom,
     for (TimeStamp time = tileBeginTime(tileno, zoom);
          time < end; time += samplingPeriod) {
       // Compute stats over all samples within [time, time + samplingPeriod[
-      auto first = std::lower_bound(values.begin(), values.end(), time);
-      auto last = std::lower_bound(values.begin(), values.end(), time + samplingPeriod);
+      auto first = values.lowerBound(time);
+      auto last = values.lowerBound(time + samplingPeriod);
       Statistics<T> stats;
       for (auto it = first; it != last; ++it) {
         assert(time <= it->time);
@@ -157,11 +252,22 @@ struct TileMetaData {
       source(x->source()) {}
 };
 
+struct ChartSourceInfo {
+  TimeStamp first, last;
+  int priority = 0;
+  int64_t tileCount = 0;
+};
+
 class ChartSourceIndexBuilder {
  public:
   ChartSourceIndexBuilder(const std::string& boatid,
                           std::shared_ptr<Dispatcher> dispatcher);
 
+  // Starts from the index stored for the boat, when only the tiles of
+  // a time range are uploaded.
+  void loadStored(const std::shared_ptr<mongoc_database_t>& db,
+                  const ChartTileSettings& settings);
+
   void add(const TileMetaData& metadata, TimeStamp first, TimeStamp last,
            int64_t tilecount);
 
@@ -170,14 +276,69 @@ class ChartSourceIndexBuilder {
 
  private:
   std::shared_ptr<Dispatcher> _dispatcher;
-  WrapBson _index;
-  BsonSubDocument _channels;
-  std::string _currentChannelType;
-  std::unique_ptr<BsonSubDocument> _currentChannelDoc;
+
+  // Sources by channel
+  std::map<std::string, std::map<std::string, ChartSourceInfo>> _channels;
 
   std::string _boatId;
 };
 
+// The fields of the key of a chart tile, see chartTileToBson
+std::string tileField(const char* name) {
+  return kChartTilesWithIdObject? std::string("_id.") + name : name;
+}
+
+const char* meanArrayKey(const std::string& what) {
+  return what != "latitude" && what != "longitude"? "mean_fbin" : "mean";
+}
+
+// Reads an array saved by appendBinaryFloatArray or bsonAppendCollection
+std::vector<double> readStoredArray(const bson_t* doc, const char* key) {
+  std::vector<double> dst;
+  bson_iter_t iter;
+  if (!bson_iter_init_find(&iter, doc, key)) {
+    return dst;
+  }
+  if (BSON_ITER_HOLDS_BINARY(&iter)) {
+    bson_subtype_t subtype;
+    uint32_t length = 0;
+    const uint8_t* data = nullptr;
+    bson_iter_binary(&iter, &subtype, &length, &data);
+    std::vector<float> values(length / sizeof(float));
+    memcpy(values.data(), data, values.size() * sizeof(float));
+    dst.assign(values.begin(), values.end());
+  } else if (BSON_ITER_HOLDS_ARRAY(&iter)) {
+    bson_iter_t element;
+    if (bson_iter_recurse(&iter, &element)) {
+      while (bson_iter_next(&element)) {
+        dst.push_back(bson_iter_as_double(&element));
+      }
+    }
+  }
+  return dst;
+}
+
+std::string readStoredString(const bson_t* doc, const std::string& key) {
+  bson_iter_t iter, found;
+  if (bson_iter_init(&iter, doc)
+      && bson_iter_find_descendant(&iter, key.c_str(), &found)
+      && BSON_ITER_HOLDS_UTF8(&found)) {
+    return bson_iter_utf8(&found, nullptr);
+  }
+  return "";
+}
+
+StatArrays readStoredArrays(const bson_t* doc, const std::string& what) {
+  StatArrays dst;
+  dst.mean = readStoredArray(doc, meanArrayKey(what));
+  dst.min = readStoredArray(doc, "min_fbin");
+  dst.max = readStoredArray(doc, "max_fbin");
+  for (double count: readStoredArray(doc, "count_fbin")) {
+    dst.count.push_back(int64_t(count));
+  }
+  return dst;
+}
+
 template <class T>
 void appendBinaryFloatArray(bson_t* builder, const char* key,
                             const T& array) {
@@ -196,10 +357,190 @@ void appendBinaryFloatArray(bson_t* builder, const char* key,
                      arr.size() * sizeof(float));
 }
 
+void appendStatArrays(bson_t* dst, const std::string& what,
+                      const StatArrays& arrays) {
+  if (what != "latitude" && what != "longitude") {
+    appendBinaryFloatArray(dst, meanArrayKey(what), arrays.mean);
+  } else {
+    bsonAppendCollection(dst, meanArrayKey(what), arrays.mean);
+  }
+  appendBinaryFloatArray(dst, "min_fbin", arrays.min);
+  appendBinaryFloatArray(dst, "max_fbin", arrays.max);
+  appendBinaryFloatArray(dst, "count_fbin", arrays.count);
+}
+
+// The stored tiles of a ChartTileRange, see uploadChartTilesInRange
+class StoredChartTiles {
+ public:
+  StoredChartTiles(const std::shared_ptr<mongoc_database_t>& db,
+                   const std::string& boatId,
+                   const ChartTileSettings& settings,
+                   TimeStamp from, TimeStamp to)
+    : _collection(SHARED_MONGO_PTR(
+          mongoc_collection,
+          mongoc_database_get_collection(
+              db.get(), settings.table().localName().c_str()))),
+      _boat(makeOid(boatId)), _settings(settings),
+      _range(settings, from, to) { }
+
+  // Removes the stored tiles that are entirely in the range.
+  void removeTilesInside();
+
+  // Empties the samples in the range of the stored tiles that extend
+  // outside of it, whether or not there is new data for them.
+  void clearTilesStraddling();
+
+  // Fills the samples outside of the range with those of the stored
+  // tile, which is removed.
+  void mergeWithStored(int zoom, int64_t tileno, const std::string& what,
+                       const std::string& source, StatArrays* arrays);
+
+  bool containsTile(int zoom, int64_t tileno) const {
+    return _range.containsTile(zoom, tileno);
+  }
+ private:
+  void appendTileSelector(int zoom, bson_t* query) const {
+    BSON_APPEND_OID(query, tileField("boat").c_str(), &_boat);
+    BSON_APPEND_INT32(query, tileField("zoom").c_str(), zoom);
+  }
+
+  void appendTileSelector(int zoom, int64_t tileno, const std::string& what,
+                          const std::string& source, bson_t* query) const {
+    appendTileSelector(zoom, query);
+    BSON_APPEND_INT64(query, tileField("tileno").c_str(), (long long) tileno);
+    bsonAppend(query, tileField("what").c_str(), what);
+    bsonAppend(query, tileField("source").c_str(), source);
+  }
+
+  std::shared_ptr<mongoc_collection_t> _collection;
+  bson_oid_t _boat;
+  const ChartTileSettings& _settings;
+  ChartTileRange _range;
+};
+
+void StoredChartTiles::removeTilesInside() {
+  for (int zoom = _settings.lowestZoomLevel;
+       zoom <= _settings.highestZoomLevel; zoom++) {
+    int64_t first = 0, end = 0;
+    _range.tilesInside(zoom, &first, &end);
+    if (end <= first) {
+      continue;
+    }
+    WrapBson query;
+    appendTileSelector(zoom, &query);
+    {
+      BsonSubDocument tileno(&query, tileField("tileno").c_str());
+      BSON_APPEND_INT64(&tileno, "$gte", (long long) first);
+      BSON_APPEND_INT64(&tileno, "$lt", (long long) end);
+      tileno.finalize();
+    }
+    auto concern = nullptr;
+    bson_error_t error;
+    if (!mongoc_collection_remove(
+        _collection.get(), MONGOC_REMOVE_NONE, &query, concern, &error)) {
+      LOG(ERROR) << "Failed to remove chart tiles at zoom " << zoom
+        << ": " << bsonErrorToString(error);
+    }
+  }
+}
+
+void StoredChartTiles::clearTilesStraddling() {
+  struct StoredTile {
+    std::string what, source;
+    StatArrays arrays;
+  };
+
+  for (int zoom = _settings.lowestZoomLevel;
+       zoom <= _settings.highestZoomLevel; zoom++) {
+    for (int64_t tileno: _range.straddlingTiles(zoom)) {
+      // Every channel and source of the tile, read before any is modified.
+      std::vector<StoredTile> tiles;
+      {
+        WrapBson query;
+        appendTileSelector(zoom, &query);
+        BSON_APPEND_INT64(&query, tileField("tileno").c_str(),
+                          (long long) tileno);
+        auto cursor = UNIQUE_MONGO_PTR(
+            mongoc_cursor,
+            mongoc_collection_find_with_opts(
+                _collection.get(), &query, nullptr, nullptr));
+        const bson_t* stored = nullptr;
+        while (mongoc_cursor_next(cursor.get(), &stored)) {
+          StoredTile tile;
+          tile.what = readStoredString(stored, tileField("what"));
+          tile.source = readStoredString(stored, tileField("source"));
+          tile.arrays = readStoredArrays(stored, tile.what);
+          tiles.push_back(tile);
+        }
+      }
+
+      for (auto& tile: tiles) {
+        WrapBson selector;
+        appendTileSelector(zoom, tileno, tile.what, tile.source, &selector);
+        auto concern = nullptr;
+        bson_error_t error;
+        if (!_range.clearSamplesInside(zoom, tileno, &tile.arrays)) {
+          if (!mongoc_collection_remove(
+              _collection.get(), MONGOC_REMOVE_SINGLE_REMOVE,
+              &selector, concern, &error)) {
+            LOG(ERROR) << "Failed to remove chart tile: "
+              << bsonErrorToString(error);
+          }
+          continue;
+        }
+        WrapBson update;
+        {
+          BsonSubDocument set(&update, "$set");
+          appendStatArrays(&set, tile.what, tile.arrays);
+          set.finalize();
+        }
+        if (!mongoc_collection_update(
+            _collection.get(), MONGOC_UPDATE_NONE,
+            &selector, &update, concern, &error)) {
+          LOG(ERROR) << "Failed to update chart tile: "
+            << bsonErrorToString(error);
+        }
+      }
+    }
+  }
+}
+
+void StoredChartTiles::mergeWithStored(
+    int zoom, int64_t tileno, const std::string& what,
+    const std::string& source, StatArrays* arrays) {
+  WrapBson query;
+  appendTileSelector(zoom, tileno, what, source, &query);
+  {
+    auto cursor = UNIQUE_MONGO_PTR(
+        mongoc_cursor,
+        mongoc_collection_find_with_opts(
+            _collection.get(), &query, nullptr, nullptr));
+    const bson_t* stored = nullptr;
+    if (!mongoc_cursor_next(cursor.get(), &stored)) {
+      return;
+    }
+    if (!_range.keepSamplesOutside(zoom, tileno,
+                                   readStoredArrays(stored, what), arrays)) {
+      LOG(ERROR) << "The stored chart tile " << what << " of " << source
+        << " at zoom " << zoom << ", tile " << tileno
+        << " does not have " << arrays->count.size()
+        << " samples. Dropping its samples outside of "
+        << _range.from().toString() << " - " << _range.to().toString();
+    }
+  }
+  auto concern = nullptr;
+  bson_error_t error;
+  if (!mongoc_collection_remove(
+      _collection.get(), MONGOC_REMOVE_NONE, &query, concern, &error)) {
+    LOG(ERROR) << "Failed to remove chart tile: " << bsonErrorToString(error);
+  }
+}
+
 template<class T>
 std::shared_ptr<bson_t> chartTileToBson(const ChartTile<T> tile,
                      const std::string& boatId,
-                     const TileMetaData& data) {
+                     const TileMetaData& data,
+                     StoredChartTiles* range) {
   CHECK(data.defined());
 
   if (tile.samples.size() == 0) {
@@ -240,15 +581,12 @@ std::shared_ptr<bson_t> chartTileToBson(const ChartTile<T> tile,
   for (const TimedValue<Statistics<T>>& stats : tile.samples) {
     stats.value.appendToArrays(data.what, &arrays);
   }
-
-  if (data.what != "latitude" && data.what != "longitude") {
-    appendBinaryFloatArray(result.get(), "mean_fbin", arrays.mean);
-  } else {
-    bsonAppendCollection(result.get(), "mean", arrays.mean);
+  if (range != nullptr && !range->containsTile(tile.zoom, tile.tileno)) {
+    range->mergeWithStored(tile.zoom, tile.tileno, data.what, data.source,
+                           &arrays);
   }
-  appendBinaryFloatArray(result.get(), "min_fbin", arrays.min);
-  appendBinaryFloatArray(result.get(), "max_fbin", arrays.max);
-  appendBinaryFloatArray(result.get(), "count_fbin", arrays.count);
+
+  appendStatArrays(result.get(), data.what, arrays);
 
   return result;
 }
@@ -258,9 +596,10 @@ bool uploadChartTile(const ChartTile<T> tile,
                      const TileMetaData& data,
                      const std::string& boatId,
                      const ChartTileSettings& settings,
-                     BulkInserter *inserter) {
+                     BulkInserter *inserter,
+                     StoredChartTiles* range) {
   std::shared_ptr<bson_t> obj = chartTileToBson(
-      tile, boatId, data);
+      tile, boatId, data, range);
   if (obj) {
     return inserter->insert(obj);
   } else {
@@ -298,9 +637,10 @@ class UploadChartTilesVisitor : public DispatchDataVisitor {
   UploadChartTilesVisitor(const std::string& boatId,
                           const ChartTileSettings& settings,
                           BulkInserter *inserter,
-                          ChartSourceIndexBuilder* index)
+                          ChartSourceIndexBuilder* index,
+                          StoredChartTiles* range)
     : _boatId(boatId), _settings(settings),
-    _inserter(inserter), _result(true), _index(index) { }
+    _inserter(inserter), _result(true), _index(index), _range(range) { }
 
   template<class T>
   void makeTiles(
@@ -340,7 +680,7 @@ class UploadChartTilesVisitor : public DispatchDataVisitor {
           tiles[tileno] = tile;
           if (!uploadChartTile(
               tiles[tileno], tileMetaData, _boatId,
-              _settings, _inserter)) {
+              _settings, _inserter, _range)) {
             _result = false;
             return;
           }
@@ -404,27 +744,64 @@ class UploadChartTilesVisitor : public DispatchDataVisitor {
   BulkInserter *_inserter;
   bool _result;
   ChartSourceIndexBuilder* _index;
+  StoredChartTiles* _range;
 };
 
 bool uploadChartTiles(DispatchData* data,
                       const std::string& boatId,
                       const ChartTileSettings& settings,
                       BulkInserter *db,
-                      ChartSourceIndexBuilder* index) {
-  UploadChartTilesVisitor visitor(boatId, settings, db, index);
+                      ChartSourceIndexBuilder* index,
+                      StoredChartTiles* range) {
+  UploadChartTilesVisitor visitor(boatId, settings, db, index, range);
   data->visit(&visitor);
   return visitor.result();
 }
 
+bool uploadSourcesAndIndex(const NavDataset& data,
+                           const std::string& boatId,
+                           const ChartTileSettings& settings,
+                           const std::shared_ptr<mongoc_database_t>& db,
+                           StoredChartTiles* range) {
+  const map<DataCode, map<string, shared_ptr<DispatchData>>> &allSources =
+    data.dispatcher()->allSources();
+
+  auto coll = SHARED_MONGO_PTR(
+      mongoc_collection,
+      mongoc_database_get_collection(
+          db.get(),
+          settings.table().localName().c_str()));
+  if (!coll) {
+    LOG(ERROR) << "Failed to collection";
+    return false;
+  }
+  BulkInserter inserter(coll, 1000);
+  ChartSourceIndexBuilder index(boatId, data.dispatcher());
+  if (range != nullptr) {
+    index.loadStored(db, settings);
+  }
+
+  for (auto channel : allSources) {
+    for (auto source : channel.second) {
+      if (!sourceShouldUploadChartTiles(source.first)) {
+        continue;
+      }
+
+      if (!uploadChartTiles(source.second.get(), boatId,
+                            settings, &inserter, &index, range)) {
+        return false;
+      }
+    }
+  }
+  return inserter.finish() && index.upload(db, settings);
+}
+
 }  // namespace
 
 bool uploadChartTiles(const NavDataset& data,
                       const std::string& boatId,
                       const ChartTileSettings& settings,
                       const std::shared_ptr<mongoc_database_t>& db) {
-  const map<DataCode, map<string, shared_ptr<DispatchData>>> &allSources =
-    data.dispatcher()->allSources();
-
   auto collection = UNIQUE_MONGO_PTR(
       mongoc_collection,
       mongoc_database_get_collection(
@@ -455,71 +832,122 @@ bool uploadChartTiles(const NavDataset& data,
     }
   }
 
-  auto coll = SHARED_MONGO_PTR(
-      mongoc_collection,
-      mongoc_database_get_collection(
-          db.get(),
-          settings.table().localName().c_str()));
-  if (!coll) {
-    LOG(ERROR) << "Failed to collection";
-    return false;
-  }
-  BulkInserter inserter(coll, 1000);
-  ChartSourceIndexBuilder index(boatId, data.dispatcher());
+  return uploadSourcesAndIndex(data, boatId, settings, db, nullptr);
+}
 
-  for (auto channel : allSources) {
-    for (auto source : channel.second) {
-      if (!sourceShouldUploadChartTiles(source.first)) {
+bool uploadChartTilesInRange(const NavDataset& data,
+                             const std::string& boatId,
+                             const ChartTileSettings& settings,
+                             const std::shared_ptr<mongoc_database_t>& db,
+                             TimeStamp from, TimeStamp to) {
+  StoredChartTiles range(db, boatId, settings, from, to);
+  range.removeTilesInside();
+  range.clearTilesStraddling();
+  return uploadSourcesAndIndex(data, boatId, settings, db, &range);
+}
+
+ChartSourceIndexBuilder::ChartSourceIndexBuilder(
+    const std::string& boatId, std::shared_ptr<Dispatcher> dispatcher)
+  : _dispatcher(dispatcher), _boatId(boatId) { }
+
+void ChartSourceIndexBuilder::loadStored(
+    const std::shared_ptr<mongoc_database_t>& db,
+    const ChartTileSettings& settings) {
+  auto collection = UNIQUE_MONGO_PTR(
+        mongoc_collection,
+        mongoc_database_get_collection(
+            db.get(), settings.sourceTable().localName().c_str()));
+  WrapBson query;
+  auto oid = makeOid(_boatId);
+  BSON_APPEND_OID(&query, "_id", &oid);
+  auto cursor = UNIQUE_MONGO_PTR(
+      mongoc_cursor,
+      mongoc_collection_find_with_opts(
+          collection.get(), &query, nullptr, nullptr));
+  const bson_t* doc = nullptr;
+  bson_iter_t channels, channel, source, field;
+  if (!mongoc_cursor_next(cursor.get(), &doc)
+      || !bson_iter_init_find(&channels, doc, "channels")
+      || !BSON_ITER_HOLDS_DOCUMENT(&channels)
+      || !bson_iter_recurse(&channels, &channel)) {
+    return;
+  }
+  while (bson_iter_next(&channel)) {
+    if (!BSON_ITER_HOLDS_DOCUMENT(&channel)
+        || !bson_iter_recurse(&channel, &source)) {
+      continue;
+    }
+    while (bson_iter_next(&source)) {
+      if (!BSON_ITER_HOLDS_DOCUMENT(&source)
+          || !bson_iter_recurse(&source, &field)) {
         continue;
       }
-
-      if (!uploadChartTiles(source.second.get(), boatId,
-                            settings, &inserter, &index)) {
-        return false;
+      ChartSourceInfo info;
+      while (bson_iter_next(&field)) {
+        std::string key = bson_iter_key(&field);
+        if (BSON_ITER_HOLDS_DATE_TIME(&field)) {
+          TimeStamp time = TimeStamp::fromMilliSecondsSince1970(
+              bson_iter_date_time(&field));
+          if (key == "first") {
+            info.first = time;
+          } else if (key == "last") {
+            info.last = time;
+          }
+        } else if (key == "priority") {
+          info.priority = int(bson_iter_as_int64(&field));
+        } else if (key == "tileCount") {
+          info.tileCount = bson_iter_as_int64(&field);
+        }
+      }
+      if (info.first.defined() && info.last.defined()) {
+        _channels[bson_iter_key(&channel)][bson_iter_key(&source)] = info;
       }
     }
   }
-  return index.upload(db, settings);
 }
 
-ChartSourceIndexBuilder::ChartSourceIndexBuilder(
-    const std::string& boatId, std::shared_ptr<Dispatcher> dispatcher)
-  : _channels(&_index, "channels"), _dispatcher(dispatcher),
-    _boatId(boatId) { }
-
 void ChartSourceIndexBuilder::add(const TileMetaData& metadata,
                                   TimeStamp first, TimeStamp last,
                                   int64_t tileCount) {
-  if (_currentChannelType != metadata.what.c_str()) {
-    if (_currentChannelDoc) {
-      _currentChannelDoc->finalize();
-    }
-    _currentChannelDoc.reset(new BsonSubDocument(&_channels, metadata.what.c_str()));
-    _currentChannelType = metadata.what;
+  ChartSourceInfo& info =
+    _channels[metadata.what][sourceNameToKey(metadata.source)];
+  if (info.first.defined()) {
+    // Stored, and updated for a time range. The tile count is only
+    // an estimate then.
+    info.first = std::min(info.first, first);
+    info.last = std::max(info.last, last);
+    info.tileCount = std::max(info.tileCount, tileCount);
+  } else {
+    info.first = first;
+    info.last = last;
+    info.tileCount = tileCount;
   }
-
-  std::string key = sourceNameToKey(metadata.source);
-  BsonSubDocument sourceObj(_currentChannelDoc.get(), key.c_str());
-
-  bsonAppend(&sourceObj, "first", first);
-  bsonAppend(&sourceObj, "last", last);
-  bsonAppend(&sourceObj, "priority",
-             _dispatcher->sourcePriority(metadata.source));
-  bsonAppend(&sourceObj, "tileCount", tileCount);
-  sourceObj.finalize();
+  info.priority = _dispatcher->sourcePriority(metadata.source);
 }
 
 bool ChartSourceIndexBuilder::upload(
     const std::shared_ptr<mongoc_database_t>& db,
     const ChartTileSettings& settings) {
-  if (_currentChannelDoc) {
-    _currentChannelDoc->finalize();
-    _currentChannelDoc.reset();
-    _currentChannelType.clear();
+  WrapBson index;
+  {
+    BsonSubDocument channels(&index, "channels");
+    for (const auto& channel: _channels) {
+      BsonSubDocument channelObj(&channels, channel.first.c_str());
+      for (const auto& source: channel.second) {
+        const ChartSourceInfo& info = source.second;
+        BsonSubDocument sourceObj(&channelObj, source.first.c_str());
+        bsonAppend(&sourceObj, "first", info.first);
+        bsonAppend(&sourceObj, "last", info.last);
+        bsonAppend(&sourceObj, "priority", info.priority);
+        bsonAppend(&sourceObj, "tileCount", info.tileCount);
+        sourceObj.finalize();
+      }
+      channelObj.finalize();
+    }
+    channels.finalize();
   }
-  _channels.finalize();
   auto oid = makeOid(_boatId);
-  BSON_APPEND_OID(&_index, "_id", &oid);
+  BSON_APPEND_OID(&index, "_id", &oid);
 
   auto collection = UNIQUE_MONGO_PTR(
         mongoc_collection,
@@ -538,11 +966,11 @@ bool ChartSourceIndexBuilder::upload(
         collection.get(),
         MONGOC_UPDATE_UPSERT,
         &selector,
-        &_index,
+        &index,
         concern,
         &error);
      if (!success) {
-       char* json = bson_as_canonical_extended_json(&_index, NULL);
+       char* json = bson_as_canonical_extended_json(&index, NULL);
        LOG(ERROR) << "for boat ID " << _boatId << ": "
          << bsonErrorToString(error) << "\nReplacement:\n" << json;
        bson_free(json);
@@ -27,6 +27,12 @@ struct ChartTileSettings {
   MongoTableName sourceTable() const {
     return MongoTableName(dbName, chartTileSourceTable);
   }
+
+  // Time covered by one sample of a tile at the highest zoom level.
+  Duration<double> coarsestSampleSpan() const {
+    return Duration<double>::seconds(
+        double(int64_t(1) << highestZoomLevel) / samplesPerTile);
+  }
 private:
   std::string chartTileTable = "charttiles";
   std::string chartTileSourceTable = "chartsources";
@@ -37,11 +43,60 @@ bool uploadChartTiles(const NavDataset& data,
                       const ChartTileSettings& settings,
                       const std::shared_ptr<mongoc_database_t>& db);
 
+// Replaces the chart tiles of a boat in [from, to[ by those of 'data',
+// which should not have samples outside of that range. The range must
+// be aligned on settings.coarsestSampleSpan(), so that every sample of
+// a tile is either inside or outside of it: the tiles that extend
+// outside of the range keep their stored samples there, and lose
+// those inside of it even if 'data' has nothing there.
+bool uploadChartTilesInRange(const NavDataset& data,
+                             const std::string& boatId,
+                             const ChartTileSettings& settings,
+                             const std::shared_ptr<mongoc_database_t>& db,
+                             TimeStamp from, TimeStamp to);
+
 struct StatArrays {
   std::vector<double> min, max, mean;
   std::vector<int64_t> count;
 };
 
+// The samples of the chart tiles in a time range [from, to[, see
+// uploadChartTilesInRange.
+class ChartTileRange {
+ public:
+  ChartTileRange(const ChartTileSettings& settings,
+                 TimeStamp from, TimeStamp to)
+    : _settings(settings), _from(from), _to(to) { }
+
+  TimeStamp from() const { return _from; }
+  TimeStamp to() const { return _to; }
+
+  bool containsTile(int zoom, int64_t tileno) const;
+
+  // The tiles entirely in the range are [*first, *end[.
+  void tilesInside(int zoom, int64_t* first, int64_t* end) const;
+
+  // The tiles partly in the range: at most the first and the last one.
+  std::vector<int64_t> straddlingTiles(int zoom) const;
+
+  // The samples of a tile in the range are [*first, *end[.
+  void samplesInside(int zoom, int64_t tileno, int* first, int* end) const;
+
+  // Empties the samples of a stored tile in the range. Returns false
+  // if no sample with data is left.
+  bool clearSamplesInside(int zoom, int64_t tileno,
+                          StatArrays* stored) const;
+
+  // Fills the samples of 'arrays' outside of the range with those of
+  // 'stored'. Returns false, leaving 'arrays' as it is, if the arrays
+  // don't have the same sizes.
+  bool keepSamplesOutside(int zoom, int64_t tileno, const StatArrays& stored,
+                          StatArrays* arrays) const;
+ private:
+  const ChartTileSettings& _settings;
+  TimeStamp _from, _to;
+};
+
 template <typename T> struct Statistics {
   MeanAndVar stats;
 
@@ -218,4 +218,106 @@ TEST(ChartTiles, UploadSourceIndex) {
 //  EXPECT_TRUE(uploadChartSourceIndex(ds, fakeBoatId, settings, &db));
 }
 
+namespace {
+
+StatArrays filledArrays(int n, bool withMinMax) {
+  StatArrays dst;
+  dst.mean.assign(n, 3.0);
+  dst.count.assign(n, 1);
+  if (withMinMax) {
+    dst.min.assign(n, 2.0);
+    dst.max.assign(n, 4.0);
+  }
+  return dst;
+}
+
+TimeStamp coarsestSample(const ChartTileSettings& settings, int i) {
+  return TimeStamp::UTC(1970, 1, 1, 0, 0, 0)
+    + settings.coarsestSampleSpan().scaled(i);
+}
+
+}  // namespace
+
+TEST(ChartTiles, TileRange) {
+  ChartTileSettings settings;
+  ChartTileRange range(settings, coarsestSample(settings, 1000),
+                       coarsestSample(settings, 1003));
+
+  // One sample of the highest zoom level is a tile at zoom 19.
+  int64_t first = 0, end = 0;
+  range.tilesInside(19, &first, &end);
+  EXPECT_EQ(1000, first);
+  EXPECT_EQ(1003, end);
+  EXPECT_TRUE(range.straddlingTiles(19).empty());
+
+  // Tile 500 at zoom 20 is inside, tile 501 only half.
+  range.tilesInside(20, &first, &end);
+  EXPECT_EQ(500, first);
+  EXPECT_EQ(501, end);
+  EXPECT_TRUE(range.containsTile(20, 500));
+  EXPECT_FALSE(range.containsTile(20, 501));
+  EXPECT_EQ(std::vector<int64_t>{501}, range.straddlingTiles(20));
+  int firstSample = 0, endSample = 0;
+  range.samplesInside(20, 501, &firstSample, &endSample);
+  EXPECT_EQ(0, firstSample);
+  EXPECT_EQ(256, endSample);
+
+  // At the highest zoom level, one tile holds the whole range.
+  range.tilesInside(28, &first, &end);
+  EXPECT_LE(end, first);
+  EXPECT_EQ(std::vector<int64_t>{1}, range.straddlingTiles(28));
+  range.samplesInside(28, 1, &firstSample, &endSample);
+  EXPECT_EQ(1000 - 512, firstSample);
+  EXPECT_EQ(1003 - 512, endSample);
+}
+
+TEST(ChartTiles, ClearStraddlingTileWithoutNewData) {
+  ChartTileSettings settings;
+  ChartTileRange range(settings, coarsestSample(settings, 1000),
+                       coarsestSample(settings, 1003));
+
+  // Nothing new was uploaded for that tile: its samples in the range
+  // are removed all the same.
+  StatArrays stored = filledArrays(settings.samplesPerTile, true);
+  EXPECT_TRUE(range.clearSamplesInside(28, 1, &stored));
+  for (int i = 0; i < settings.samplesPerTile; i++) {
+    bool inside = 1000 - 512 <= i && i < 1003 - 512;
+    EXPECT_EQ(inside? 0 : 1, stored.count[i]);
+    EXPECT_EQ(inside? 0.0 : 3.0, stored.mean[i]);
+    EXPECT_EQ(inside? 0.0 : 2.0, stored.min[i]);
+    EXPECT_EQ(inside? 0.0 : 4.0, stored.max[i]);
+  }
+
+  // Angles have no min and max. Nothing is left of a tile with data
+  // only in the range.
+  StatArrays angles = filledArrays(settings.samplesPerTile, false);
+  for (int i = 256; i < settings.samplesPerTile; i++) {
+    angles.count[i] = 0;
+  }
+  EXPECT_FALSE(range.clearSamplesInside(20, 501, &angles));
+  EXPECT_TRUE(angles.min.empty());
+}
+
+TEST(ChartTiles, KeepSamplesOutside) {
+  ChartTileSettings settings;
+  ChartTileRange range(settings, coarsestSample(settings, 1000),
+                       coarsestSample(settings, 1003));
+
+  StatArrays stored = filledArrays(settings.samplesPerTile, true);
+  StatArrays arrays = filledArrays(settings.samplesPerTile, true);
+  for (auto& count: arrays.count) {
+    count = 7;
+  }
+  EXPECT_TRUE(range.keepSamplesOutside(20, 501, stored, &arrays));
+  EXPECT_EQ(7, arrays.count[0]);
+  EXPECT_EQ(7, arrays.count[255]);
+  EXPECT_EQ(1, arrays.count[256]);
+
+  // A stored tile of another size is not merged.
+  StatArrays other = filledArrays(settings.samplesPerTile / 2, true);
+  EXPECT_FALSE(range.keepSamplesOutside(20, 501, other, &arrays));
+  EXPECT_EQ(1, arrays.count[256]);
+  EXPECT_EQ(settings.samplesPerTile, arrays.count.size());
+}
+
 }  // namespace sail
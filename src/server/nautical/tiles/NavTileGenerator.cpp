@@ -1,6 +1,8 @@
 #include <server/nautical/tiles/NavTileGenerator.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <server/common/ArrayBuilder.h>
 #include <server/common/string.h>
 #include <server/math/geometry/SimplifyCurve.h>
@@ -12,30 +14,64 @@ using namespace NavCompat;
 
 namespace {
 
+// Only the navs that are kept are made from the rows of the frame.
 Array<Nav> makeTileElement(TileKey tileKey,
-                           const Array<Nav>& navs,
+                           const NavFrame& navs,
                            int maxNumNavs) {
-  if (navs.size() <= maxNumNavs) {
-    return navs;
+  int n = navs.size();
+  if (n <= maxNumNavs) {
+    return navs.navs();
   }
 
   CurveSimplifier curve(false);
-  for (const Nav& nav : navs) {
-    curve.addPoint(
-       posToTileX(0, nav.geographicPosition()), 
-       posToTileY(0, nav.geographicPosition()));
+  for (const auto& pos : navs.geographicPosition()) {
+    curve.addPoint(posToTileX(0, pos), posToTileY(0, pos));
   }
   std::vector<int> priorities = curve.priorities();
 
-  ArrayBuilder<Nav> result;
-  for (int i = 0; i < navs.size(); ++i) {
+  ArrayBuilder<Nav> result(maxNumNavs);
+  for (int i = 0; i < n; ++i) {
     if (priorities[i] < maxNumNavs) {
-      result.add(navs[i]);
+      result.add(navs.nav(i));
     }
   }
   return result.get();
 }
 
+// Orders the tiles of one scale like TileKey::operator<.
+uint64_t tileCode(int x, int y) {
+  return (uint64_t(uint32_t(x) ^ 0x80000000u) << 32)
+    | uint64_t(uint32_t(y) ^ 0x80000000u);
+}
+
+// Stable least significant digit radix sort of the codes, moving the
+// values along. The digits that are the same for all codes are skipped,
+// which is most of them at the coarse scales.
+void radixSort(std::vector<uint64_t>* codes, std::vector<int>* values) {
+  int n = codes->size();
+  std::vector<uint64_t> codeBuffer(n);
+  std::vector<int> valueBuffer(n);
+  for (int shift = 0; shift < 64; shift += 8) {
+    int counts[257] = {0};
+    for (uint64_t code : *codes) {
+      counts[((code >> shift) & 0xff) + 1]++;
+    }
+    if (*std::max_element(counts, counts + 257) == n) {
+      continue;
+    }
+    for (int i = 1; i < 257; i++) {
+      counts[i] += counts[i - 1];
+    }
+    for (int i = 0; i < n; i++) {
+      int dst = counts[((*codes)[i] >> shift) & 0xff]++;
+      codeBuffer[dst] = (*codes)[i];
+      valueBuffer[dst] = (*values)[i];
+    }
+    codes->swap(codeBuffer);
+    values->swap(valueBuffer);
+  }
+}
+
 } // namespace
 
 // Inspired by
@@ -63,11 +99,12 @@ std::string TileKey::stringKey() const {
 }
 
 Array<Array<Nav>> generateTiles(TileKey tileKey,
-                                const Array<Nav>& navs,
-                                const std::vector<int>& navIndices,
+                                const NavFrame& navs,
+                                const Arrayi& navIndices,
                                 int maxNumNavs,
                                 Duration<> curveCutThreshold) {
   ArrayBuilder<Array<Nav>> result;
+  const Array<TimeStamp>& times = navs.time();
 
   // The curve might enter and leave the tile multiple times.
   // Group together consecutive points that are in the tile.
@@ -78,7 +115,7 @@ Array<Array<Nav>> generateTiles(TileKey tileKey,
       int a = navIndices[j];
       int b = navIndices[j + 1];
       if ((b != (a + 1))
-          || (navs[b].time() - navs[a].time()) > curveCutThreshold) {
+          || (times[b] - times[a]) > curveCutThreshold) {
         break;
       }
       end = b;
@@ -90,7 +127,8 @@ Array<Array<Nav>> generateTiles(TileKey tileKey,
     ++end;
 
     if (end > first) {
-      result.add(makeTileElement(tileKey, navs.slice(first, end), maxNumNavs));
+      result.add(makeTileElement(tileKey, navs.slice(first, end),
+                                 maxNumNavs));
     }
  
     // i is now the last processed index. Move the next index to process.
@@ -99,29 +137,73 @@ Array<Array<Nav>> generateTiles(TileKey tileKey,
   return result.get();
 }
 
-std::map<TileKey, std::vector<int>> tilesForNav(
-    const Array<Nav>& navs, int maxScale) {
-  std::map<TileKey, std::vector<int>> result;
-  for (int i = 0; i < navs.size(); ++i) {
-    const Nav& nav = navs[i];
-    for (int scale = 0; scale < maxScale; scale++) {
-      TileKey key = TileKey::fromPos(scale, nav.geographicPosition());
+TileNavIndex::TileNavIndex(const std::vector<TileKey>& keys,
+                           const Arrayi& begins, const Arrayi& navIndices)
+  : _keys(keys), _begins(begins), _navIndices(navIndices) {
+  assert(_begins.size() == int(_keys.size()) + 1);
+}
+
+Arrayi TileNavIndex::navIndices(const TileKey& key) const {
+  auto found = std::lower_bound(_keys.begin(), _keys.end(), key);
+  if (found == _keys.end() || !(*found == key)) {
+    return Arrayi();
+  }
+  return navIndices(found - _keys.begin());
+}
 
-      std::map<TileKey, std::vector<int>>::iterator it = result.find(key);
+TileNavIndex tilesForNav(const Array<GeographicPosition<double>>& positions,
+                         int maxScale) {
+  int n = positions.size();
+  if (n == 0 || maxScale <= 0) {
+    return TileNavIndex();
+  }
+
+  // floor(posToTileX(scale, pos)) is floor(u*2^scale) for some u that
+  // does not depend on the scale. Multiplying by a power of two is
+  // exact, so the key at a coarser scale is the key at the finest
+  // scale shifted to the right, and the projection is only computed
+  // once per nav.
+  int finest = maxScale - 1;
+  std::vector<int> x(n), y(n);
+  for (int i = 0; i < n; i++) {
+    TileKey key = TileKey::fromPos(finest, positions[i]);
+    x[i] = key.x();
+    y[i] = key.y();
+  }
 
-      if (it != result.end()) {
-        it->second.push_back(i);
-      } else {
-        result[key] = std::vector<int>{i};
+  std::vector<TileKey> keys;
+  ArrayBuilder<int> begins;
+  Arrayi navIndices(n*maxScale);
+  std::vector<uint64_t> codes(n);
+  std::vector<int> order(n);
+  for (int scale = 0; scale < maxScale; scale++) {
+    int shift = finest - scale;
+    for (int i = 0; i < n; i++) {
+      // The right shift of a negative int rounds down, like floor.
+      codes[i] = tileCode(x[i] >> shift, y[i] >> shift);
+      order[i] = i;
+    }
+    radixSort(&codes, &order);
+
+    // The scales come in increasing order, so the keys stay sorted.
+    int offset = scale*n;
+    for (int i = 0; i < n; i++) {
+      if (i == 0 || codes[i] != codes[i - 1]) {
+        keys.push_back(TileKey(scale, x[order[i]] >> shift,
+                               y[order[i]] >> shift));
+        begins.add(offset + i);
       }
+      navIndices[offset + i] = order[i];
     }
   }
-  return result;
+  begins.add(n*maxScale);
+  return TileNavIndex(keys, begins.get(), navIndices);
 }
 
-std::string tileCurveId(std::string boatId, const NavDataset& navs) {
+std::string tileCurveId(std::string boatId, const NavFrame& navs) {
   // TODO: hash this string.
-  return boatId + getFirst(navs).time().toString() + getLast(navs).time().toString();
+  return boatId + navs.time().first().toString()
+    + navs.time().last().toString();
 }
 
 }  // namespace sail
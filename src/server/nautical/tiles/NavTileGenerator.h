@@ -4,8 +4,10 @@
 #include <server/common/Array.h>
 #include <server/nautical/GeographicPosition.h>
 #include <server/nautical/NavCompatibility.h>
+#include <server/nautical/NavFrame.h>
 #include <set>
 #include <tuple>
+#include <vector>
 
 namespace sail {
 
@@ -44,19 +46,47 @@ class TileKey {
 double posToTileX(int scale, const GeographicPosition<double>& pos);
 double posToTileY(int scale, const GeographicPosition<double>& pos);
 
+// The tiles on which some navs appear, with the indices of those navs.
+// The tiles are sorted by key, and the nav indices of a tile are
+// increasing. All the indices are stored in one array, that the
+// arrays returned by navIndices share.
+class TileNavIndex {
+ public:
+  TileNavIndex() {}
+  TileNavIndex(const std::vector<TileKey>& keys,
+               const Arrayi& begins, const Arrayi& navIndices);
+
+  int size() const { return _keys.size(); }
+  const TileKey& key(int i) const { return _keys[i]; }
+  Arrayi navIndices(int i) const {
+    return _navIndices.slice(_begins[i], _begins[i + 1]);
+  }
+
+  // Empty if no nav is on that tile.
+  Arrayi navIndices(const TileKey& key) const;
+ private:
+  std::vector<TileKey> _keys;
+
+  // The navs of tile i are _navIndices[_begins[i]] to
+  // _navIndices[_begins[i + 1] - 1].
+  Arrayi _begins, _navIndices;
+};
+
+// The sub curves of "navs" in a tile, each simplified on its own to at
+// most maxNumNavs navs by CurveSimplifier.
 Array<Array<Nav>> generateTiles(TileKey tileKey,
-                                const Array<Nav>& navs,
-                                const std::vector<int>& navIndices,
+                                const NavFrame& navs,
+                                const Arrayi& navIndices,
                                 int maxNumNavs,
                                 Duration<> curveCutThreshold);
 
-// Return a map of tiles on which "navs" should appear, with the list of
-// corresponding navs index.
-std::map<TileKey, std::vector<int>> tilesForNav(
-    const Array<Nav>& navs, int maxScale);
+// The tiles of the scales 0 to maxScale-1 on which navs at "positions"
+// should appear, with the corresponding nav indices.
+TileNavIndex tilesForNav(const Array<GeographicPosition<double>>& positions,
+                         int maxScale);
 
 // Generate a unique identifier for this Nav curve.
-std::string tileCurveId(std::string boatId, const NavDataset& navs);
+std::string tileCurveId(std::string boatId, const NavFrame& navs);
 
 }  // namespace sail
 
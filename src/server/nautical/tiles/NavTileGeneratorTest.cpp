@@ -4,6 +4,11 @@
 #include <server/nautical/tiles/NavTileUploader.h>
 
 #include <gtest/gtest.h>
+#include <server/common/ArrayBuilder.h>
+#include <server/common/Env.h>
+#include <server/common/PathBuilder.h>
+#include <server/math/geometry/SimplifyCurve.h>
+#include <server/nautical/logimport/LogLoader.h>
 #include <iostream>
 
 namespace sail {
@@ -27,11 +32,12 @@ TEST(NavTileGenerator, SmokeTest) {
   }
 
   TileKey tile(1, 1, 0);
-  map<TileKey, vector<int>> tileIndex = tilesForNav(navs, 2);
+  NavFrame frame(navs);
+  TileNavIndex tileIndex = tilesForNav(frame.geographicPosition(), 2);
   Array<Array<Nav>> result = generateTiles(
       tile, // A quarter of the world
-      navs,
-      tileIndex[tile],
+      frame,
+      tileIndex.navIndices(tile),
       5, 1.0_minutes);
 
   EXPECT_EQ(1, result.size());
@@ -72,11 +78,12 @@ TEST(NavTileGenerator, SplitTest) {
   }
 
   TileKey tile(1, 1, 0);
-  map<TileKey, vector<int>> tileIndex = tilesForNav(navs, 2);
+  NavFrame frame(navs);
+  TileNavIndex tileIndex = tilesForNav(frame.geographicPosition(), 2);
   Array<Array<Nav>> result = generateTiles(
       tile, // A quarter of the world
-      navs,
-      tileIndex[tile],
+      frame,
+      tileIndex.navIndices(tile),
       5, 1.0_minutes);
 
   EXPECT_EQ(2, result.size());
@@ -84,6 +91,155 @@ TEST(NavTileGenerator, SplitTest) {
   EXPECT_EQ(5, result[1].size());
 }
 
+TEST(NavTileGenerator, TilesForNavSameAsFromPos) {
+  Array<Nav> navs(300);
+  for (int i = 0; i < navs.size(); ++i) {
+    navs[i].setGeographicPosition(
+        GeographicPosition<double>(
+            Angle<double>::degrees(179.9*sin(0.37*i)),
+            Angle<double>::degrees(84.0*cos(1.73*i))));
+  }
+  int maxScale = 20;
+
+  map<TileKey, vector<int>> expected;
+  for (int i = 0; i < navs.size(); ++i) {
+    for (int scale = 0; scale < maxScale; scale++) {
+      expected[TileKey::fromPos(scale, navs[i].geographicPosition())]
+        .push_back(i);
+    }
+  }
+
+  NavFrame frame(navs);
+  TileNavIndex actual = tilesForNav(frame.geographicPosition(), maxScale);
+  ASSERT_EQ(expected.size(), actual.size());
+  int i = 0;
+  for (auto it : expected) {
+    EXPECT_EQ(it.first, actual.key(i));
+    Arrayi indices = actual.navIndices(i);
+    EXPECT_EQ(it.second, vector<int>(indices.begin(), indices.end()));
+    i++;
+  }
+  EXPECT_TRUE(actual.navIndices(TileKey(3, 100, 100)).empty());
+  EXPECT_EQ(0, tilesForNav(frame.geographicPosition(), 0).size());
+}
+
+TEST(NavTileGenerator, SimplifySubCurves) {
+  Array<Nav> navs(200);
+  auto start = TimeStamp::UTC(2016, 02, 19, 16, 23, 0);
+  for (int i = 0; i < navs.size(); ++i) {
+    navs[i].setTime(start + Duration<double>::seconds(i));
+    navs[i].setGeographicPosition(
+        GeographicPosition<double>(
+            Angle<double>::degrees(10 + 0.01*i),
+            Angle<double>::degrees(40 + sin(0.1*i))));
+  }
+  NavFrame frame(navs);
+  Arrayi all(navs.size());
+  for (int i = 0; i < navs.size(); ++i) {
+    all[i] = i;
+  }
+
+  // The whole curve is simplified like CurveSimplifier does.
+  CurveSimplifier curve(false);
+  for (const Nav& nav : navs) {
+    curve.addPoint(posToTileX(0, nav.geographicPosition()),
+                   posToTileY(0, nav.geographicPosition()));
+  }
+  std::vector<int> priorities = curve.priorities();
+  Array<Array<Nav>> result = generateTiles(
+      TileKey(0, 0, 0), frame, all, 20, 1.0_minutes);
+  ASSERT_EQ(1, result.size());
+  ASSERT_EQ(20, result[0].size());
+  int k = 0;
+  for (int i = 0; i < navs.size(); ++i) {
+    if (priorities[i] < 20) {
+      EXPECT_EQ(navs[i].time(), result[0][k++].time());
+    }
+  }
+
+  // A sub curve keeps its ends.
+  result = generateTiles(
+      TileKey(0, 0, 0), frame, all.slice(50, 150), 20, 1.0_minutes);
+  ASSERT_EQ(1, result.size());
+  ASSERT_EQ(20, result[0].size());
+  EXPECT_EQ(navs[50].time(), result[0].first().time());
+  EXPECT_EQ(navs[149].time(), result[0].last().time());
+  for (int i = 1; i < result[0].size(); ++i) {
+    EXPECT_LT(result[0][i - 1].time(), result[0][i].time());
+  }
+}
+
+namespace {
+
+NavDataset getPsarosTestData() {
+  auto p = PathBuilder::makeDirectory(Env::SOURCE_DIR)
+    .pushDirectory("datasets")
+    .pushDirectory("psaros33_Banque_Sturdza")
+    .pushDirectory("2014")
+    .pushDirectory("20140821").get();
+  LogLoader loader;
+  loader.load(p.toString());
+  return loader.makeNavDataset().fitBounds();
+}
+
+// The tile elements, simplifying every sub curve in the tile on its own
+// and making navs of all its rows.
+Array<Array<Nav>> simplifyEachSubCurve(const NavFrame& navs,
+                                       const Arrayi& navIndices,
+                                       int maxNumNavs,
+                                       Duration<> curveCutThreshold) {
+  ArrayBuilder<Array<Nav>> result;
+  for (int i = 0; i < navIndices.size(); ) {
+    int j = i + 1;
+    while (j < navIndices.size()
+           && navIndices[j] == navIndices[j - 1] + 1
+           && (navs.time()[navIndices[j]] - navs.time()[navIndices[j - 1]])
+              <= curveCutThreshold) {
+      j++;
+    }
+    NavFrame sub = navs.slice(navIndices[i], navIndices[j - 1] + 1);
+    CurveSimplifier curve(false);
+    for (const auto& pos : sub.geographicPosition()) {
+      curve.addPoint(posToTileX(0, pos), posToTileY(0, pos));
+    }
+    std::vector<int> priorities = curve.priorities();
+    ArrayBuilder<Nav> element;
+    for (int k = 0; k < sub.size(); ++k) {
+      if (sub.size() <= maxNumNavs || priorities[k] < maxNumNavs) {
+        element.add(sub.nav(k));
+      }
+    }
+    result.add(element.get());
+    i = j;
+  }
+  return result.get();
+}
+
+}  // namespace
+
+TEST(NavTileGenerator, SameAsSimplifyingEachTile) {
+  NavFrame frame(getPsarosTestData());
+  ASSERT_LT(1000, frame.size());
+  const int maxNumNavs = 32;
+  const auto threshold = Duration<>::minutes(1);
+
+  TileNavIndex tiles = tilesForNav(frame.geographicPosition(), 20);
+  for (int k = 0; k < tiles.size(); ++k) {
+    Arrayi navIndices = tiles.navIndices(k);
+    Array<Array<Nav>> expected = simplifyEachSubCurve(
+        frame, navIndices, maxNumNavs, threshold);
+    Array<Array<Nav>> actual = generateTiles(
+        tiles.key(k), frame, navIndices, maxNumNavs, threshold);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int i = 0; i < actual.size(); ++i) {
+      ASSERT_EQ(expected[i].size(), actual[i].size());
+      for (int j = 0; j < actual[i].size(); ++j) {
+        EXPECT_EQ(expected[i][j].time(), actual[i][j].time());
+      }
+    }
+  }
+}
+
 TEST(NavTileGenerator, TileKeyTest) {
   for (int i = 0; i < 10; ++i) {
     GeographicPosition<double> a(
@@ -5,6 +5,7 @@
 #include <boost/noncopyable.hpp>
 #include <device/Arduino/libraries/TrueWindEstimator/TrueWindEstimator.h>
 #include <server/common/Optional.h>
+#include <server/common/ParallelFor.h>
 #include <server/common/Span.h>
 #include <server/common/logging.h>
 #include <server/nautical/MaxSpeed.h>
@@ -201,21 +202,22 @@ Angle<T> average(const Angle<T>& a, const Angle<T>& b) {
   return motion.angle();
 }
 
-void locationForSession(const Array<Nav>& navs, bson_t* dst) {
-  if (navs.size() == 0) {
+void locationForSession(const Array<GeographicPosition<double>>& positions,
+                        bson_t* dst) {
+  if (positions.size() == 0) {
     return;
   }
 
-  Angle<double> minLat(navs[0].geographicPosition().lat());
-  Angle<double> minLon(navs[0].geographicPosition().lon());
-  Angle<double> maxLat(navs[0].geographicPosition().lat());
-  Angle<double> maxLon(navs[0].geographicPosition().lon());
+  Angle<double> minLat(positions[0].lat());
+  Angle<double> minLon(positions[0].lon());
+  Angle<double> maxLat(positions[0].lat());
+  Angle<double> maxLon(positions[0].lon());
   
-  for (auto nav: navs) {
-    minLat = std::min(minLat, nav.geographicPosition().lat());
-    maxLat = std::max(maxLat, nav.geographicPosition().lat());
-    minLon = std::min(minLon, nav.geographicPosition().lon());
-    maxLon = std::max(maxLon, nav.geographicPosition().lon());
+  for (const auto& pos: positions) {
+    minLat = std::min(minLat, pos.lat());
+    maxLat = std::max(maxLat, pos.lat());
+    minLon = std::min(minLon, pos.lon());
+    maxLon = std::max(maxLon, pos.lon());
   }
 
   GeographicPosition<double> center(
@@ -232,19 +234,22 @@ void locationForSession(const Array<Nav>& navs, bson_t* dst) {
 }
 
 // Returns average wind speed and average wind direction.
-Optional<HorizontalMotion<double>> averageWind(const Array<Nav>& navs) {
+// The wind estimate needs a Nav, so one is made per row, only for the
+// rows that are used.
+Optional<HorizontalMotion<double>> averageWind(const NavFrame& navs) {
   int num = 0;
   HorizontalMotion<double> sum = HorizontalMotion<double>::zero();
   Velocity<double> sumSpeed = Velocity<double>::knots(0);
 
   auto marg = Duration<double>::minutes(5.0);
-  Span<TimeStamp> validTime(navs.first().time() + marg,
-                            navs.last().time());
+  const Array<TimeStamp>& times = navs.time();
+  Span<TimeStamp> validTime(times.first() + marg, times.last());
 
-  for (auto nav: navs) {
-    if (!validTime.contains(nav.time())) {
+  for (int i = 0; i < navs.size(); ++i) {
+    if (!validTime.contains(times[i])) {
       continue;
     }
+    const Nav nav = navs.nav(i);
 
     // We prefer Anemomind-calibrated wind over external instrument wind.
     if (nav.hasTrueWindOverGround()) {
@@ -280,22 +285,21 @@ Optional<HorizontalMotion<double>> averageWind(const Array<Nav>& navs) {
 
 // Returns the strongest wind and the corresponding nav index.
 // If no wind information is present, the returned index is -1.
-std::pair<Velocity<double>, int> indexOfStrongestWind(const Array<Nav>& navs) {
+std::pair<Velocity<double>, int> indexOfStrongestWind(const NavFrame& navs) {
   std::pair<Velocity<double>, int> result(Velocity<double>::knots(0), -1);
 
   auto marg = Duration<double>::minutes(5.0);
-  Span<TimeStamp> validTime(navs.first().time() + marg,
-                            navs.last().time());
+  const Array<TimeStamp>& times = navs.time();
+  Span<TimeStamp> validTime(times.first() + marg, times.last());
 
   std::vector<std::pair<Velocity<double>, int>> speedArray;
 
   for (int i = 0; i < navs.size(); ++i) {
-    const Nav& nav = navs[i];
-
     // If the boat is not moving, the strongest wind is not so interesting.
     // The following if avoids most outliers.
-    if (validTime.contains(nav.time())
-        && nav.gpsSpeed() > Velocity<double>::knots(1)) {
+    if (validTime.contains(times[i])
+        && navs.gpsSpeed()[i] > Velocity<double>::knots(1)) {
+      const Nav nav = navs.nav(i);
 
       if (nav.hasTrueWindOverGround()) {
         speedArray.push_back(make_pair(calcTws(nav.trueWindOverGround()), i));
@@ -319,8 +323,7 @@ std::pair<Velocity<double>, int> indexOfStrongestWind(const Array<Nav>& navs) {
 std::pair<std::string, std::shared_ptr<bson_t>> makeBsonSession(
     const std::string &curveId,
     const std::string &boatId,
-    NavDataset navs,
-    const Array<Nav>& navArray,
+    const NavFrame& navs,
     DOM::Node *li) {
 
   auto id = curveId;
@@ -332,10 +335,10 @@ std::pair<std::string, std::shared_ptr<bson_t>> makeBsonSession(
   BSON_APPEND_DOUBLE(
       session.get(),
       "trajectoryLength",
-      computeTrajectoryLength(navs).nauticalMiles());
+      computeTrajectoryLength(navs.geographicPosition()).nauticalMiles());
 
   Optional<TimedValue<Velocity<double>>> maxSpeed =
-    computeMaxSpeedOverPeriod(navs);
+    computeMaxSpeedOverPeriod(navs.time(), navs.geographicPosition());
 
   if (maxSpeed.defined()) {
     DOM::addSubTextNode(li, "p",
@@ -351,25 +354,25 @@ std::pair<std::string, std::shared_ptr<bson_t>> makeBsonSession(
         << curveId << "' and boat '" << boatId << "'";
   }
 
-  auto startTime = navArray[0].time();
+  auto startTime = navs.time().first();
   if (startTime.undefined()) {
     LOG(FATAL) << "Start time is undefined";
   }
   bsonAppend(session.get(), "startTime", startTime);
 
-  auto endTime = navArray.last().time();
+  auto endTime = navs.time().last();
   if (endTime.undefined()) {
     LOG(FATAL) << "End time is undefined";
   }
   bsonAppend(session.get(), "endTime", endTime);
   {
     BsonSubDocument loc(session.get(), "location");
-    locationForSession(navArray, &loc);
+    locationForSession(navs.geographicPosition(), &loc);
     loc.finalize();
   }
 
 
-  auto wind = averageWind(navArray);
+  auto wind = averageWind(navs);
   if (wind.defined()) {
     bsonAppend(session.get(), "avgWindSpeed", calcTws(wind()).knots());
     bsonAppend(session.get(), "avgWindDir", calcTwdir(wind()).degrees());
@@ -377,10 +380,10 @@ std::pair<std::string, std::shared_ptr<bson_t>> makeBsonSession(
     LOG(WARNING) << "No average wind";
   }
 
-  std::pair<Velocity<double>, int> strongestWind = indexOfStrongestWind(navArray);
+  std::pair<Velocity<double>, int> strongestWind = indexOfStrongestWind(navs);
   if (strongestWind.second >= 0) {
     bsonAppend(session.get(), "strongestWindSpeed", strongestWind.first.knots());
-    bsonAppend(session.get(), "strongestWindTime", navArray[strongestWind.second].time());
+    bsonAppend(session.get(), "strongestWindTime", navs.time()[strongestWind.second]);
   } else {
     LOG(WARNING) << "No strongest wind";
   }
@@ -453,6 +456,109 @@ void removeBoatWithId(
   }
 }
 
+namespace {
+
+void appendTimeRange(bson_t* query, TimeStamp from, TimeStamp to) {
+  {
+    BsonSubDocument gte(query, "startTime");
+    bsonAppend(&gte, "$gte", from);
+    gte.finalize();
+  }{
+    BsonSubDocument lte(query, "endTime");
+    bsonAppend(&lte, "$lte", to);
+    lte.finalize();
+  }
+}
+
+void removeBoatDocumentsInRange(
+    mongoc_database_t* db, const std::string& tableName,
+    const std::string& boatId, TimeStamp from, TimeStamp to) {
+  auto coll = UNIQUE_MONGO_PTR(
+      mongoc_collection,
+      mongoc_database_get_collection(
+          db, tableName.c_str()));
+  auto oid = makeOid(boatId);
+  {
+    WrapBson query;
+    bson_error_t error;
+    auto concern = nullptr;
+    BSON_APPEND_OID(&query, "boat", &oid);
+    appendTimeRange(&query, from, to);
+    if (!mongoc_collection_remove(
+        coll.get(),
+        MONGOC_REMOVE_NONE,
+        &query, concern, &error)) {
+      LOG(ERROR) << "Removing from " << tableName << " failed: "
+        << bsonErrorToString(error);
+    }
+  }
+}
+
+TimeStamp readTime(const bson_t* doc, const char* key) {
+  bson_iter_t iter;
+  if (bson_iter_init_find(&iter, doc, key)
+      && BSON_ITER_HOLDS_DATE_TIME(&iter)) {
+    return TimeStamp::fromMilliSecondsSince1970(
+        bson_iter_date_time(&iter));
+  }
+  return TimeStamp();
+}
+
+}  // namespace
+
+Span<TimeStamp> storedSessionSpan(
+    const std::string& boatId, TimeStamp from, TimeStamp to,
+    const std::shared_ptr<mongoc_database_t>& db,
+    const TileGeneratorParameters& params) {
+  auto coll = UNIQUE_MONGO_PTR(
+      mongoc_collection,
+      mongoc_database_get_collection(
+          db.get(), params.sessionTable().localName().c_str()));
+
+  WrapBson query;
+  auto oid = makeOid(boatId);
+  BSON_APPEND_OID(&query, "boat", &oid);
+  {
+    BsonSubDocument lt(&query, "startTime");
+    bsonAppend(&lt, "$lt", to);
+    lt.finalize();
+  }{
+    BsonSubDocument gte(&query, "endTime");
+    bsonAppend(&gte, "$gte", from);
+    gte.finalize();
+  }
+  auto cursor = UNIQUE_MONGO_PTR(
+      mongoc_cursor,
+      mongoc_collection_find_with_opts(
+          coll.get(), &query, nullptr, nullptr));
+
+  Span<TimeStamp> span;
+  const bson_t* doc = nullptr;
+  while (mongoc_cursor_next(cursor.get(), &doc)) {
+    TimeStamp startTime = readTime(doc, "startTime");
+    TimeStamp endTime = readTime(doc, "endTime");
+    if (startTime.defined() && endTime.defined()) {
+      span.extend(startTime);
+      span.extend(endTime);
+    }
+  }
+  bson_error_t error;
+  if (mongoc_cursor_error(cursor.get(), &error)) {
+    LOG(ERROR) << "Failed to look up sessions: " << bsonErrorToString(error);
+  }
+  return span;
+}
+
+void removeTilesAndSessionsInRange(
+    const std::string& boatId, TimeStamp from, TimeStamp to,
+    const std::shared_ptr<mongoc_database_t>& db,
+    const TileGeneratorParameters& params) {
+  removeBoatDocumentsInRange(
+      db.get(), params.tileTable().localName(), boatId, from, to);
+  removeBoatDocumentsInRange(
+      db.get(), params.sessionTable().localName(), boatId, from, to);
+}
+
 bool generateAndUploadTiles(std::string boatId,
                             Array<NavDataset> allNavs,
                             const std::shared_ptr<mongoc_database_t>& db,
@@ -466,43 +572,61 @@ bool generateAndUploadTiles(std::string boatId,
   DOM::Node d2 = params.log; // Workaround
   auto page = DOM::linkToSubPage(&d2, "generateAndUploadTiles");
   auto ul = DOM::makeSubNode(&page, "ul");
-  for (const NavDataset& curve : allNavs) {
-    auto li = DOM::makeSubNode(&ul, "li");
 
-    Array<Nav> navs = makeArray(curve);
+  // The tiles of a few sessions at a time are computed in parallel,
+  // and then uploaded in order. Every session is resampled from its own
+  // data, so that the navs at its edges only use samples within it.
+  int threadCount = 0 < params.threadCount?
+    params.threadCount : hardwareThreadCount();
+  for (int batch = 0; batch < allNavs.size(); batch += threadCount) {
+    int batchSize = std::min(threadCount, allNavs.size() - batch);
+    Array<NavFrame> batchNavs(batchSize);
+    Array<TileNavIndex> batchTiles(batchSize);
+    Array<Array<Array<Array<Nav>>>> batchSubCurves(batchSize);
+    parallelFor(batchSize, threadCount, [&](size_t i) {
+      batchNavs[i] = NavFrame(allNavs[batch + i]);
+      const TileNavIndex& tiles = batchTiles[i] = tilesForNav(
+          batchNavs[i].geographicPosition(), params.maxScale);
+      batchSubCurves[i] = Array<Array<Array<Nav>>>(tiles.size());
+      for (int k = 0; k < tiles.size(); k++) {
+        batchSubCurves[i][k] = generateTiles(
+            tiles.key(k), batchNavs[i], tiles.navIndices(k),
+            params.maxNumNavsPerSubCurve, params.curveCutThreshold);
+      }
+    });
 
-    std::string curveId = tileCurveId(boatId, curve);
+    for (int b = 0; b < batchSize; b++) {
+      const NavFrame& navs = batchNavs[b];
+      const TileNavIndex& tiles = batchTiles[b];
+      auto li = DOM::makeSubNode(&ul, "li");
 
-    DOM::addSubTextNode(&li, "p",
-        stringFormat("Curve with id %s and %d navs", curveId.c_str(), navs.size()));
+      std::string curveId = tileCurveId(boatId, navs);
 
-    map<TileKey, vector<int>> tiles = tilesForNav(navs, params.maxScale);
+      DOM::addSubTextNode(&li, "p",
+          stringFormat("Curve with id %s and %d navs", curveId.c_str(), navs.size()));
 
-    for (auto it : tiles) {
-      const TileKey& tileKey = it.first;
-      Array<Array<Nav>> subCurvesInTile = generateTiles(
-          tileKey,
-          navs,
-          it.second, // the vector of nav indices
-          params.maxNumNavsPerSubCurve, params.curveCutThreshold);
+      for (int i = 0; i < tiles.size(); i++) {
+        const TileKey& tileKey = tiles.key(i);
+        const Array<Array<Nav>>& subCurvesInTile = batchSubCurves[b][i];
 
-      if (subCurvesInTile.size() == 0) {
-        continue;
-      }
+        if (subCurvesInTile.size() == 0) {
+          continue;
+        }
 
-      auto tile = makeBsonTile(tileKey, subCurvesInTile, boatId, curveId);
+        auto tile = makeBsonTile(tileKey, subCurvesInTile, boatId, curveId);
 
-      if (!inserter.insert(tile)) {
-        LOG(ERROR) << "Failed to insert tile";
-        // There is no point to continue if we can't write to the DB.
+        if (!inserter.insert(tile)) {
+          LOG(ERROR) << "Failed to insert tile";
+          // There is no point to continue if we can't write to the DB.
+          return false;
+        }
+      }
+      auto session = makeBsonSession(curveId, boatId, navs, &li);
+      if (!insertSession(session, params, db)) {
+        LOG(ERROR) << "Failed to insert session";
         return false;
       }
     }
-    auto session = makeBsonSession(curveId, boatId, curve, navs, &li);
-    if (!insertSession(session, params, db)) {
-      LOG(ERROR) << "Failed to insert session";
-      return false;
-    }
   }
 
   return inserter.finish();
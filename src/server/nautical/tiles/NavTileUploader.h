@@ -4,6 +4,7 @@
 #include <device/Arduino/libraries/PhysicalQuantity/PhysicalQuantity.h>
 #include <string>
 #include <server/common/Array.h>
+#include <server/common/Span.h>
 #include <server/nautical/NavCompatibility.h>
 #include <server/nautical/tiles/MongoUtils.h>
 #include <server/common/DOMUtils.h>
@@ -16,6 +17,11 @@ struct TileGeneratorParameters  {
   int maxNumNavsPerSubCurve;
   bool fullClean;
   Duration<> curveCutThreshold;
+
+  // Number of threads computing the tiles of the sessions, 0 for one
+  // per hardware thread.
+  int threadCount = 1;
+
   std::string mongoUri = MongoDBConnection::defaultMongoUri();
 
   std::shared_ptr<mongoc_uri_t> uri() const {
@@ -53,6 +59,20 @@ bool generateAndUploadTiles(std::string boatId,
                             const std::shared_ptr<mongoc_database_t>& db,
                             const TileGeneratorParameters& params);
 
+// The time spanned by the stored sessions of a boat that overlap
+// [from, to[, uninitialized if there are none.
+Span<TimeStamp> storedSessionSpan(
+    const std::string& boatId, TimeStamp from, TimeStamp to,
+    const std::shared_ptr<mongoc_database_t>& db,
+    const TileGeneratorParameters& params);
+
+// Removes the tiles and the sessions of a boat that lie within
+// [from, to], before uploading what has been reprocessed there.
+void removeTilesAndSessionsInRange(
+    const std::string& boatId, TimeStamp from, TimeStamp to,
+    const std::shared_ptr<mongoc_database_t>& db,
+    const TileGeneratorParameters& params);
+
 }  // namespace sail
 
 #endif  // NAUTICAL_TILES_NAVTILEUPLOADER_H